@@ -21,6 +21,23 @@ function concatenate() {
 }
 
 function extract() {
+	# Native incremental extraction, opt-in with HOTBITS_INCREMENTAL=1: only
+	# segments added since the last run are processed, the rest comes from
+	# ./state. It has no highpass or detrend stage, so its bitstream differs
+	# from process_timeseries.sh's.
+	if [ "${HOTBITS_INCREMENTAL:-0}" = 1 ] && [ -x ./bin/hotbits-extract ]; then
+		./bin/hotbits-extract -v \
+			--incremental ./state \
+			--data-dir ./data \
+			--method adaptive_threshold \
+			--debias von_neumann \
+			--output ./state/cleaned_random.bin \
+				&>./working/extract.txt \
+			&& cp ./state/cleaned_random.bin ./working/cleaned_random.bin \
+			&& return
+	fi
+
+	concatenate
 	./process_timeseries.sh \
 		working/concatenated.txt \
 		working/cleaned_random.bin \
@@ -41,6 +58,18 @@ function prepare() {
 	# Current binary size (Bits)
 	SIZE=$(( $(stat -t --format=%s working/cleaned_random.bin)*8 ))
 
+	echo "Target (bits)	= ${SAMPLE_BITS}"
+	echo "File Size (bits)	= ${SIZE}"
+
+	# Progressive testing at every power of two the capture actually has;
+	# tiling a short capture only repeats it
+	if [ -x ./bin/hotbits-progressive ]; then
+		./bin/hotbits-progressive ./working/cleaned_random.bin \
+			>./working/progressive.txt 2>&1
+		cp ./working/cleaned_random.bin ./working/random-truncated.bin
+		return
+	fi
+
 	# Needed bits vs actual (Bits)
 	DIFF=$(( ${SAMPLE_BITS}-SIZE ))
 
@@ -48,8 +77,6 @@ function prepare() {
 	CHUNKS=$(( DIFF/SIZE ))
 	(( $(( DIFF%SIZE ))==0 )) || CHUNKS=$(( CHUNKS+1 ))
 
-	echo "Target (bits)	= ${TARGET}"
-	echo "File Size (bits)	= ${SIZE}"
 	echo "Difference (bits)	= ${DIFF}"
 	echo "Chunks needed	= ${CHUNKS}"
 
@@ -70,16 +97,21 @@ function prepare() {
 function evaluate() {
 	scripts/nist-template.sh
 	cp -r repos/sts-2.1.2/sts-2.1.2/experiments/AlgorithmTesting ./working/nist.txt
-	dieharder -a -f ./working/random-truncated.bin | tee ./working/dieharder.txt
+	# dieharder rewinds files shorter than its tests need, so untiled short
+	# captures are left to the progressive report
+	if (( $(stat -t --format=%s ./working/random-truncated.bin)*8 < SAMPLE_BITS )); then
+		echo "Skipped: fewer than ${SAMPLE_BITS} bits, see progressive.txt" | tee ./working/dieharder.txt
+	else
+		dieharder -a -f ./working/random-truncated.bin | tee ./working/dieharder.txt
+	fi
 }
 
 function backup() {
 	mv working complete/$(date +%s)
-	find complete/ -type f | grep -E "final|dieharder" | while read -r ROW; do IFS="/" read -ra SRC<<<${ROW}; cp "${ROW}" "reports/${SRC[1]}-${SRC[-1]}"; done
+	find complete/ -type f | grep -E "final|dieharder|progressive" | while read -r ROW; do IFS="/" read -ra SRC<<<${ROW}; cp "${ROW}" "reports/${SRC[1]}-${SRC[-1]}"; done
 }
 
 setup
-concatenate
 extract
 prepare
 evaluate
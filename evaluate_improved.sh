@@ -13,6 +13,8 @@ WORKING_DIR="${PROJECT_DIR}/working"
 COMPLETE_DIR="${PROJECT_DIR}/complete"
 DATA_DIR="${DATA_DIR:-${PROJECT_DIR}/data}"
 SRC_DIR="${PROJECT_DIR}/src"
+STATE_DIR="${STATE_DIR:-${PROJECT_DIR}/state}"
+HOTBITS_EXTRACT="${PROJECT_DIR}/bin/hotbits-extract"
 
 # Test suite paths
 NIST_PATH="${PROJECT_DIR}/repos/sts-2.1.2/sts-2.1.2"
@@ -58,10 +60,22 @@ prepare_data() {
     # Generate binary data using available extractors
     echo "Generating binary random data..."
     
-    # Try simple_extract.py first as it's more reliable
-    if [ -f "${SRC_DIR}/analysis/simple_extract.py" ]; then
+    # Native incremental extraction, opt-in with HOTBITS_INCREMENTAL=1, only
+    # processes segments added since the last run. It runs the extract.py
+    # defaults (adaptive threshold, window 100), not simple_extract.py, so
+    # its bitstream differs from the default path's.
+    if [ "${HOTBITS_INCREMENTAL:-0}" = 1 ] && [ -x "${HOTBITS_EXTRACT}" ]; then
+        echo "Using hotbits-extract (incremental, state in ${STATE_DIR})..."
+        if "${HOTBITS_EXTRACT}" -v --incremental "${STATE_DIR}" --data-dir "${DATA_DIR}" \
+            --method adaptive_threshold --output "${STATE_DIR}/random.bin" 2>"${WORKING_DIR}/extract.log"; then
+            cp "${STATE_DIR}/random.bin" "${BINARY_DATA}"
+        fi
+    fi
+
+    # Otherwise try simple_extract.py as it's more reliable
+    if [ ! -s "${BINARY_DATA}" ] && [ -f "${SRC_DIR}/analysis/simple_extract.py" ]; then
         echo "Using simple_extract.py..."
-        timeout 60 python3 "${SRC_DIR}/analysis/simple_extract.py" < "${CONCAT_DATA}" > "${BINARY_DATA}" 2>"${WORKING_DIR}/extract.log" || true
+        timeout 60 python3 "${SRC_DIR}/analysis/simple_extract.py" < "${CONCAT_DATA}" > "${BINARY_DATA}" 2>>"${WORKING_DIR}/extract.log" || true
     fi
     
     local byte_count=$(wc -c < "${BINARY_DATA}" 2>/dev/null || echo "0")
@@ -13,6 +13,20 @@ const readline = require('readline');
 // CLI configuration
 const CLI_VERSION = '1.0.0';
 const SCRIPT_PATH = path.join(__dirname, 'scripts', 'hot.sh');
+const DEFAULT_DATA_DIR = process.env.HOTBITS_DATA_DIR || path.join(process.cwd(), 'data');
+const READ_CHUNK = 1 << 20;
+const ALPHA = 0.01;
+
+// Native pipeline (make node-addon). Without it, or with HOTBITS_NO_NATIVE
+// set, monitor and generate run hot.sh as before.
+const native = (() => {
+    if (process.env.HOTBITS_NO_NATIVE) return null;
+    try {
+        return require(path.join(__dirname, 'lib', 'hotbits.node'));
+    } catch (err) {
+        return null;
+    }
+})();
 
 // Color codes for terminal output
 const colors = {
@@ -172,10 +186,13 @@ ${colors.yellow}Examples:${colors.reset}
 // Real-time monitoring
 async function runMonitor(args) {
     let interval = 60; // Default 60 seconds
+    let dataDir = DEFAULT_DATA_DIR;
     
     for (let i = 0; i < args.length; i++) {
         if (args[i] === '--interval' && i + 1 < args.length) {
             interval = parseInt(args[++i]);
+        } else if (args[i] === '--data-dir' && i + 1 < args.length) {
+            dataDir = args[++i];
         } else if (args[i] === '--help' || args[i] === '-h') {
             console.log(`
 ${colors.bright}HOTBITS MONITOR - Real-time TRNG quality monitoring${colors.reset}
@@ -183,6 +200,10 @@ ${colors.bright}HOTBITS MONITOR - Real-time TRNG quality monitoring${colors.rese
 ${colors.yellow}Options:${colors.reset}
   --interval N    Check interval in seconds (default: 60)
   --window N      Number of events to test per check (default: 1000)
+  --data-dir DIR  Directory with events-*.txt files (default: ./data)
+
+With the native addon (make node-addon) the newest events file is followed
+in place and each check reads only what was appended since the last one.
 
 ${colors.yellow}Example:${colors.reset}
   hotbits monitor --interval 30 --window 5000
@@ -194,6 +215,10 @@ ${colors.yellow}Example:${colors.reset}
     console.log(`${colors.cyan}Starting HOTBITS monitoring (interval: ${interval}s)${colors.reset}`);
     console.log('Press Ctrl+C to stop\n');
 
+    if (native) {
+        return monitorNative(interval, dataDir);
+    }
+
     // Run monitoring loop
     const monitor = async () => {
         const timestamp = new Date().toISOString();
@@ -222,11 +247,14 @@ async function runGenerate(args) {
     let min = 0;
     let max = 100;
     let format = 'decimal';
+    let dataDir = DEFAULT_DATA_DIR;
 
     for (let i = 0; i < args.length; i++) {
         const arg = args[i];
         if (arg === '--count' && i + 1 < args.length) {
             count = parseInt(args[++i]);
+        } else if (arg === '--data-dir' && i + 1 < args.length) {
+            dataDir = args[++i];
         } else if (arg === '--min' && i + 1 < args.length) {
             min = parseInt(args[++i]);
         } else if (arg === '--max' && i + 1 < args.length) {
@@ -242,6 +270,7 @@ ${colors.yellow}Options:${colors.reset}
   --min N          Minimum value (default: 0)
   --max N          Maximum value (default: 100)
   --format FORMAT  Output format: decimal, hex, binary (default: decimal)
+  --data-dir DIR   Directory with events-*.txt files (default: ./data)
 
 ${colors.yellow}Examples:${colors.reset}
   hotbits generate --count 100 --min 1 --max 1000
@@ -253,23 +282,30 @@ ${colors.yellow}Examples:${colors.reset}
 
     console.log(`${colors.cyan}Generating ${count} random values...${colors.reset}`);
     
-    // Run extraction
-    await runScript(['--quick', '--tests', 'none']);
-    
-    // Read binary data and generate numbers
-    const resultsDir = getLatestResults();
-    if (resultsDir) {
-        const binaryPath = path.join(resultsDir, 'random.bin');
-        if (fs.existsSync(binaryPath)) {
-            const data = fs.readFileSync(binaryPath);
-            const numbers = generateRandomNumbers(data, count, min, max, format);
-            
-            console.log(`\n${colors.green}Random values:${colors.reset}`);
-            numbers.forEach((num, i) => {
-                console.log(`  ${(i + 1).toString().padStart(3)}: ${num}`);
-            });
+    let data = null;
+    if (native) {
+        // Extract only as many bytes as the values need
+        data = await extractNative(dataDir, count * 4 + 1);
+    } else {
+        // Run extraction
+        await runScript(['--quick', '--tests', 'none']);
+
+        // Read binary data
+        const resultsDir = getLatestResults();
+        const binaryPath = resultsDir && path.join(resultsDir, 'random.bin');
+        if (binaryPath && fs.existsSync(binaryPath)) {
+            data = fs.readFileSync(binaryPath);
         }
     }
+
+    if (data) {
+        const numbers = generateRandomNumbers(data, count, min, max, format);
+        
+        console.log(`\n${colors.green}Random values:${colors.reset}`);
+        numbers.forEach((num, i) => {
+            console.log(`  ${(i + 1).toString().padStart(3)}: ${num}`);
+        });
+    }
 }
 
 // Generate random numbers from binary data
@@ -297,6 +333,123 @@ function generateRandomNumbers(data, count, min, max, format) {
     return numbers;
 }
 
+// events-*.txt in the order hot.sh concatenates them
+function listEventFiles(dataDir) {
+    if (!fs.existsSync(dataDir)) return [];
+    return fs.readdirSync(dataDir)
+        .filter(f => /^events-.*\.txt$/.test(f))
+        .sort()
+        .map(f => path.join(dataDir, f));
+}
+
+// Promise wrappers over the addon's async workers
+function readStream(stream, maxBytes) {
+    return new Promise((resolve, reject) => {
+        stream.read(maxBytes, (err, stats) => err ? reject(err) : resolve(stats));
+    });
+}
+
+function quickTests(buffer) {
+    return new Promise((resolve, reject) => {
+        native.quickTests(buffer, (err, tests) => err ? reject(err) : resolve(tests));
+    });
+}
+
+// Run the events files through the native pipeline until `bytes` bytes of
+// output are available (or the data runs out) and return them
+async function extractNative(dataDir, bytes) {
+    const files = listEventFiles(dataDir);
+    if (files.length === 0) {
+        throw new Error(`No events-*.txt files found in ${dataDir}`);
+    }
+
+    const stream = new native.Stream();
+    try {
+        for (const file of files) {
+            stream.open(file);
+            for (;;) {
+                const stats = await readStream(stream, READ_CHUNK);
+                if (stats.available >= bytes) return stream.pull(bytes);
+                if (stats.eof) break;
+            }
+        }
+        stream.finish();
+        const data = stream.pull(bytes);
+        console.log(`${colors.yellow}Only ${data.length} bytes available from ${files.length} file(s)${colors.reset}`);
+        return data;
+    } finally {
+        stream.close();
+    }
+}
+
+// Follow the newest events file: each check feeds what was appended since
+// the previous one, then tests both the cumulative output and the bytes
+// produced in this interval
+async function monitorNative(interval, dataDir) {
+    const stream = new native.Stream();
+    let file = null;
+
+    const check = async () => {
+        const timestamp = new Date().toISOString();
+        console.log(`${colors.yellow}[${timestamp}] Running quality check...${colors.reset}`);
+
+        const files = listEventFiles(dataDir);
+        if (files.length === 0) {
+            console.log(`  ${colors.red}No events-*.txt files found in ${dataDir}${colors.reset}\n`);
+            return;
+        }
+
+        let stats = null;
+        if (file) {
+            stats = await readStream(stream, Infinity);
+        }
+        // The capture rotated (or this is the first check): continue with
+        // the newest file, keeping the cumulative statistics
+        const latest = files[files.length - 1];
+        if (latest !== file) {
+            file = latest;
+            stream.open(file);
+            stats = await readStream(stream, Infinity);
+        }
+
+        const recent = stream.pull();
+        const recentTests = recent.length > 0 ? await quickTests(recent) : null;
+        showNativeSummary(file, stats, recent.length, recentTests);
+    };
+
+    // Schedule after each check completes so slow checks never overlap
+    const loop = async () => {
+        try {
+            await check();
+        } catch (err) {
+            console.error(`${colors.red}Error: ${err.message}${colors.reset}`);
+        }
+        setTimeout(loop, interval * 1000);
+    };
+    await loop();
+}
+
+function formatTests(tests) {
+    return Object.entries(tests)
+        .filter(([, r]) => !Number.isNaN(r.pValue))
+        .map(([name, r]) => {
+            const color = r.pValue >= ALPHA ? colors.green : colors.red;
+            return `${name} ${color}${r.pValue.toFixed(4)}${colors.reset}`;
+        })
+        .join(', ');
+}
+
+function showNativeSummary(file, stats, recentBytes, recentTests) {
+    console.log(`  ${colors.bright}Quality Metrics:${colors.reset} (${path.basename(file)})`);
+    console.log(`    Events processed: ${stats.events}`);
+    console.log(`    Random bytes generated: ${Math.floor(stats.bits / 8)} (+${recentBytes} this interval)`);
+    console.log(`    Cumulative p-values: ${formatTests(stats.tests)}`);
+    if (recentTests) {
+        console.log(`    Interval p-values:   ${formatTests(recentTests)}`);
+    }
+    console.log();
+}
+
 // Run the hot.sh script
 function runScript(args) {
     return new Promise((resolve, reject) => {
@@ -292,6 +292,25 @@ prepare_data() {
     
     echo "Found ${file_count} event files"
     
+    # Seek to a requested range through the segment indexes instead of
+    # concatenating everything, when hotbits-slice is built
+    local slicer="${PROJECT_DIR}/bin/hotbits-slice"
+    if { [ ${START_INDEX} -ne 0 ] || [ ${SAMPLE_COUNT} -ne 0 ]; } && [ -x "${slicer}" ]; then
+        echo "Slicing data via segment indexes..."
+        USED_SLICING=true
+
+        read -r TOTAL_EVENTS _ < <("${slicer}" --data-dir "${DATA_DIR}" --info)
+        echo "Total events: ${TOTAL_EVENTS}"
+
+        "${slicer}" --data-dir "${DATA_DIR}" --verbose \
+            --start-index ${START_INDEX} --sample-count ${SAMPLE_COUNT} > "${SLICED_DATA}"
+
+        local sliced_lines=$(wc -l < "${SLICED_DATA}")
+        echo "  Sliced to ${sliced_lines} events"
+        generate_binary "${SLICED_DATA}"
+        return
+    fi
+    
     # Concatenate all files
     echo "Concatenating files..."
     cat ${DATA_DIR}/events-*.txt > "${CONCAT_DATA}" 2>/dev/null
@@ -334,6 +353,13 @@ prepare_data() {
         echo "  Sliced to ${sliced_lines} events"
     fi
     
+    generate_binary "${input_file}"
+}
+
+# Extract the binary test data from an event file
+generate_binary() {
+    local input_file="$1"
+    
     # Generate binary data
     echo "Generating binary random data..."
     
@@ -542,7 +568,7 @@ generate_results() {
     "input": {
         "data_dir": "${DATA_DIR}",
         "event_files": $(ls -1 ${DATA_DIR}/events-*.txt 2>/dev/null | wc -l),
-        "total_events": $(wc -l < "${CONCAT_DATA}" 2>/dev/null || echo 0),
+        "total_events": ${TOTAL_EVENTS:-$(wc -l < "${CONCAT_DATA}" 2>/dev/null || echo 0)},
         "sliced_events": $([ -f "${SLICED_DATA}" ] && wc -l < "${SLICED_DATA}" || echo 0),
         "binary_bytes": $(wc -c < "${BINARY_DATA}" 2>/dev/null || echo 0)
     },
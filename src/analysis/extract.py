@@ -11,6 +11,8 @@ import hashlib
 from scipy import signal
 from collections import deque
 
+import hotbits_native as native
+
 class BitExtractor:
     def __init__(self, method='adaptive_threshold', **kwargs):
         self.method = method
@@ -38,6 +40,8 @@ class BitExtractor:
     def _adaptive_threshold(self, data):
         """Adaptive threshold based on sliding window median"""
         window_size = self.params.get('window', 100)
+        if native.available:
+            return native.adaptive_threshold(data, window_size)
         bits = []
         
         for i in range(len(data)):
@@ -56,6 +60,8 @@ class BitExtractor:
     def _lsb_extraction(self, data):
         """Extract least significant bits"""
         n_bits = self.params.get('n_bits', 8)
+        if native.available:
+            return native.lsb(data, n_bits)
         bits = []
         
         for value in data:
@@ -69,6 +75,8 @@ class BitExtractor:
     def _differential(self, data):
         """Compare consecutive values"""
         lag = self.params.get('lag', 1)
+        if native.available:
+            return native.differential(data, lag)
         bits = []
         
         for i in range(lag, len(data)):
@@ -84,6 +92,8 @@ class BitExtractor:
         raw_bits = (data > threshold).astype(int)
         
         # Apply Von Neumann
+        if native.available:
+            return native.von_neumann(raw_bits)
         bits = []
         for i in range(0, len(raw_bits)-1, 2):
             if raw_bits[i] != raw_bits[i+1]:
@@ -111,8 +121,11 @@ class BitExtractor:
     def _phase_extraction(self, data):
         """Extract phase information relative to detected period"""
         # Detect dominant period via autocorrelation
-        autocorr = np.correlate(data - np.mean(data), data - np.mean(data), mode='full')
-        autocorr = autocorr[len(autocorr)//2:]
+        if native.available:
+            autocorr = native.autocorrelation(data, 999)
+        else:
+            autocorr = np.correlate(data - np.mean(data), data - np.mean(data), mode='full')
+            autocorr = autocorr[len(autocorr)//2:]
         
         # Find first peak after lag 0
         peaks = signal.find_peaks(autocorr[:1000], height=autocorr[0]*0.1)[0]
@@ -241,6 +254,8 @@ class PostProcessor:
     @staticmethod
     def von_neumann_debias(bits):
         """Von Neumann debiasing"""
+        if native.available:
+            return native.von_neumann(bits)
         output = []
         for i in range(0, len(bits)-1, 2):
             if bits[i] != bits[i+1]:
@@ -250,6 +265,8 @@ class PostProcessor:
     @staticmethod
     def peres_debias(bits):
         """More efficient Peres debiasing"""
+        if native.available:
+            return native.peres(bits)
         output = []
         i = 0
         while i < len(bits) - 1:
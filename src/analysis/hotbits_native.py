@@ -0,0 +1,78 @@
+"""
+Optional native kernels for the analysis scripts
+
+Wraps the _hotbits extension (built by `make python-ext`, see
+src/hotbits/pyhotbits.c). Inputs are passed as contiguous NumPy arrays
+without copying; outputs are NumPy views over the buffers the extension
+fills. `available` is False when the extension is missing or
+HOTBITS_NO_NATIVE is set, and callers keep their Python implementations.
+"""
+
+import os
+import numpy as np
+
+try:
+    if os.environ.get('HOTBITS_NO_NATIVE'):
+        raise ImportError('disabled by HOTBITS_NO_NATIVE')
+    import _hotbits
+except ImportError:
+    _hotbits = None
+
+available = _hotbits is not None
+
+
+def _array(data):
+    # No copy for arrays that are already contiguous
+    return np.ascontiguousarray(data)
+
+
+def _bits(buf):
+    return np.frombuffer(buf, dtype=np.uint8)
+
+
+def adaptive_threshold(data, window, min_len=2):
+    """data[i] > median(data[i - window//2 : i + window//2]) where that
+    slice has at least min_len values"""
+    return _bits(_hotbits.adaptive_threshold(_array(data), int(window), int(min_len)))
+
+
+def lsb(data, n_bits):
+    return _bits(_hotbits.lsb(_array(data), int(n_bits)))
+
+
+def differential(data, lag):
+    return _bits(_hotbits.differential(_array(data), int(lag)))
+
+
+def von_neumann(bits):
+    return _bits(_hotbits.von_neumann(_array(bits)))
+
+
+def peres(bits):
+    return _bits(_hotbits.peres(_array(bits)))
+
+
+def xor_whitening(bits, block_size):
+    return _bits(_hotbits.xor_whitening(_array(bits), int(block_size)))
+
+
+def runs(bits):
+    """(number of runs, longest run, mean run length)"""
+    return _hotbits.runs(_array(bits))
+
+
+def window_counts(intervals, window_ns, n_windows):
+    return np.frombuffer(_hotbits.window_counts(_array(intervals), float(window_ns),
+                                                int(n_windows)), dtype=np.float64)
+
+
+def autocorrelation(data, max_lag, center=None):
+    """np.correlate(x, x, 'full')[len(x) - 1:][:max_lag + 1] for
+    x = data - center (default: the mean), in O(n * max_lag)"""
+    return np.frombuffer(_hotbits.autocorrelation(_array(data), int(max_lag), center),
+                         dtype=np.float64)
+
+
+def quick_tests(packed):
+    """{name: (statistic, p_value)} from the native quicktest battery"""
+    return _hotbits.quick_tests(packed)
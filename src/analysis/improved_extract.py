@@ -11,6 +11,8 @@ from scipy import signal
 from collections import deque
 import hashlib
 
+import hotbits_native as native
+
 class ImprovedTRNGPipeline:
     def __init__(self):
         self.sample_rate = None
@@ -83,6 +85,10 @@ class ImprovedTRNGPipeline:
     
     def adaptive_bit_extraction(self, data, window_size=50):
         """Extract bits using adaptive local thresholds"""
+        # A positive MAD only scales the z-score, so the bit is always
+        # data[i] > median; the native kernel computes exactly that
+        if native.available:
+            return native.adaptive_threshold(data, window_size, 3)
         bits = []
         
         # Use sliding window for local statistics
@@ -143,6 +149,8 @@ class ImprovedTRNGPipeline:
     
     def von_neumann_whitening(self, bits):
         """Apply Von Neumann debiasing for uniform distribution"""
+        if native.available:
+            return native.von_neumann(bits)
         output = []
         i = 0
         
@@ -164,6 +172,8 @@ class ImprovedTRNGPipeline:
         if len(bits) < block_size * 2:
             return bits
         
+        if native.available:
+            return native.xor_whitening(bits, block_size)
         output = []
         
         # Overlapping XOR for better mixing
@@ -298,9 +308,14 @@ def main():
             
             # Autocorrelation check
             if len(output_bits) > 1000:
-                autocorr = np.correlate(output_bits - 0.5, output_bits - 0.5, mode='same')
-                autocorr = autocorr / autocorr[len(autocorr)//2]
-                max_autocorr = np.max(np.abs(autocorr[len(autocorr)//2+1:len(autocorr)//2+100]))
+                if native.available:
+                    # Lags 0..99 instead of the O(n^2) 'same' correlation
+                    autocorr = native.autocorrelation(output_bits, 99, 0.5)
+                    max_autocorr = np.max(np.abs(autocorr[1:] / autocorr[0]))
+                else:
+                    autocorr = np.correlate(output_bits - 0.5, output_bits - 0.5, mode='same')
+                    autocorr = autocorr / autocorr[len(autocorr)//2]
+                    max_autocorr = np.max(np.abs(autocorr[len(autocorr)//2+1:len(autocorr)//2+100]))
                 print(f"# Max autocorrelation (lag 1-100): {max_autocorr:.4f}", file=sys.stderr)
         else:
             print(f"# Error: No bits produced from {len(data)} samples", file=sys.stderr)
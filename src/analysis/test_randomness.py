@@ -14,6 +14,8 @@ import time
 import numpy as np
 from pathlib import Path
 
+import hotbits_native as native
+
 class RandomnessTest:
     def __init__(self, verbose=False):
         self.verbose = verbose
@@ -40,18 +42,21 @@ class RandomnessTest:
         }
         
         # Runs test
-        runs = []
-        current_run = 1
-        for i in range(1, len(bits)):
-            if bits[i] == bits[i-1]:
-                current_run += 1
-            else:
-                runs.append(current_run)
-                current_run = 1
-        runs.append(current_run)
-        
-        max_run = max(runs) if runs else 0
-        avg_run = np.mean(runs) if runs else 0
+        if native.available:
+            _, max_run, avg_run = native.runs(bits)
+        else:
+            runs = []
+            current_run = 1
+            for i in range(1, len(bits)):
+                if bits[i] == bits[i-1]:
+                    current_run += 1
+                else:
+                    runs.append(current_run)
+                    current_run = 1
+            runs.append(current_run)
+            
+            max_run = max(runs) if runs else 0
+            avg_run = np.mean(runs) if runs else 0
         
         results['runs'] = {
             'max_run': max_run,
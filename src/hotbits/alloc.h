@@ -0,0 +1,37 @@
+#ifndef HOTBITS_ALLOC_H
+#define HOTBITS_ALLOC_H
+
+#include <stddef.h>
+#include <stdlib.h>
+
+// Caller-provided memory functions for embedding (see hotbits.h). Sizes
+// are passed back on realloc and free so arena or pool allocators need no
+// headers of their own. A NULL allocator means malloc/realloc/free.
+struct hb_allocator {
+    void *(*alloc)(void *ctx, size_t size);
+    void *(*realloc)(void *ctx, void *ptr, size_t old_size, size_t new_size);
+    void (*free)(void *ctx, void *ptr, size_t size);
+    void *ctx;
+};
+
+static inline void *hb_alloc(const struct hb_allocator *a, size_t size) {
+    return a ? a->alloc(a->ctx, size) : malloc(size);
+}
+
+static inline void *hb_realloc(const struct hb_allocator *a, void *ptr,
+                               size_t old_size, size_t new_size) {
+    return a ? a->realloc(a->ctx, ptr, old_size, new_size) : realloc(ptr, new_size);
+}
+
+static inline void hb_free(const struct hb_allocator *a, void *ptr, size_t size) {
+    if (!ptr) {
+        return;
+    }
+    if (a) {
+        a->free(a->ctx, ptr, size);
+    } else {
+        free(ptr);
+    }
+}
+
+#endif
@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "archive.h"
+
+// A packed segment's block directory is its index: one entry per block
+static int load_packed(struct hb_archive *ar, size_t seg) {
+    struct hb_codec_file *f = &ar->packed[seg];
+    struct hb_segment_index *idx = &ar->index[seg];
+
+    if (hb_codec_open(f, ar->segs.paths[seg]) < 0) {
+        return -1;
+    }
+
+    hb_index_init(idx, f->block_len);
+    idx->entries = malloc((f->block_count ? f->block_count : 1) * sizeof(struct hb_index_entry));
+    if (!idx->entries) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+    for (uint64_t b = 0; b < f->block_count; b++) {
+        hb_codec_dir_entry(f, b, &idx->entries[b]);
+    }
+    idx->entry_count = idx->entry_cap = f->block_count;
+    idx->events = f->events;
+    idx->total_ns = f->total_ns;
+    idx->size = f->len;
+    return 0;
+}
+
+int hb_archive_open(struct hb_archive *ar, const char *data_dir, int persist) {
+    memset(ar, 0, sizeof(*ar));
+
+    if (hb_segments_list(data_dir, &ar->segs) < 0) {
+        return -1;
+    }
+    ar->count = ar->segs.count;
+
+    ar->index = calloc(ar->count ? ar->count : 1, sizeof(struct hb_segment_index));
+    ar->packed = calloc(ar->count ? ar->count : 1, sizeof(struct hb_codec_file));
+    ar->first_event = calloc(ar->count + 1, sizeof(uint64_t));
+    ar->first_ns = calloc(ar->count + 1, sizeof(uint64_t));
+    if (!ar->index || !ar->packed || !ar->first_event || !ar->first_ns) {
+        fprintf(stderr, "Memory allocation failed\n");
+        hb_archive_close(ar);
+        return -1;
+    }
+
+    for (size_t i = 0; i < ar->count; i++) {
+        struct hb_segment_index *idx = &ar->index[i];
+        char path[PATH_MAX];
+
+        if (hb_codec_is_packed(ar->segs.paths[i])) {
+            if (load_packed(ar, i) < 0) {
+                hb_archive_close(ar);
+                return -1;
+            }
+            ar->first_event[i + 1] = ar->first_event[i] + idx->events;
+            ar->first_ns[i + 1] = ar->first_ns[i] + idx->total_ns;
+            continue;
+        }
+
+        hb_index_path(path, sizeof(path), ar->segs.paths[i]);
+        if (hb_index_load(path, idx) < 0) {
+            hb_index_init(idx, HB_INDEX_STRIDE);
+        }
+        int changed = hb_index_refresh(ar->segs.paths[i], idx);
+        if (changed < 0) {
+            hb_archive_close(ar);
+            return -1;
+        }
+        if (changed && persist) {
+            hb_index_save(path, idx);
+        }
+
+        ar->first_event[i + 1] = ar->first_event[i] + idx->events;
+        ar->first_ns[i + 1] = ar->first_ns[i] + idx->total_ns;
+    }
+    return 0;
+}
+
+void hb_archive_close(struct hb_archive *ar) {
+    if (ar->index) {
+        for (size_t i = 0; i < ar->count; i++) {
+            hb_index_free(&ar->index[i]);
+        }
+    }
+    if (ar->packed) {
+        for (size_t i = 0; i < ar->count; i++) {
+            hb_codec_close(&ar->packed[i]);
+        }
+    }
+    free(ar->index);
+    free(ar->packed);
+    free(ar->first_event);
+    free(ar->first_ns);
+    hb_segments_free(&ar->segs);
+    memset(ar, 0, sizeof(*ar));
+}
+
+uint64_t hb_archive_events(const struct hb_archive *ar) {
+    return ar->first_event ? ar->first_event[ar->count] : 0;
+}
+
+uint64_t hb_archive_duration_ns(const struct hb_archive *ar) {
+    return ar->first_ns ? ar->first_ns[ar->count] : 0;
+}
+
+// Last i in [0, n) with v[i] <= key, for ascending v with v[0] <= key
+static size_t upper_bound_1(const uint64_t *v, size_t n, uint64_t key) {
+    size_t lo = 0, hi = n;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (v[mid] <= key) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Last segment with at least one event whose range starts at or before
+// ordinal (skips empty segments that share the same prefix sum)
+static size_t segment_for_event(const struct hb_archive *ar, uint64_t ordinal) {
+    return upper_bound_1(ar->first_event, ar->count, ordinal);
+}
+
+// Sequential reader over one segment, positioned at an index entry
+struct cursor {
+    const char *data;            // text: mapped segment
+    size_t len;
+    size_t pos;
+    const struct hb_codec_file *packed;
+    uint64_t block;
+    uint64_t *buf;               // packed: current decoded block
+    size_t buf_len;
+    size_t buf_pos;
+};
+
+static int cursor_open(struct cursor *c, const struct hb_archive *ar, size_t seg, size_t entry) {
+    memset(c, 0, sizeof(*c));
+
+    if (ar->packed[seg].map) {
+        c->packed = &ar->packed[seg];
+        c->block = entry;
+        c->buf = malloc(c->packed->block_len * sizeof(uint64_t));
+        if (!c->buf) {
+            fprintf(stderr, "Memory allocation failed\n");
+            return -1;
+        }
+        long n = hb_codec_decode(c->packed, c->block, c->buf);
+        if (n < 0) {
+            fprintf(stderr, "%s: corrupt block %lu\n", ar->segs.paths[seg], c->block);
+            free(c->buf);
+            return -1;
+        }
+        c->buf_len = (size_t)n;
+        return 0;
+    }
+
+    c->len = ar->index[seg].size;
+    c->pos = ar->index[seg].entries[entry].offset;
+    if (c->len == 0) {
+        return 0;
+    }
+
+    int fd = open(ar->segs.paths[seg], O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open %s: %s\n", ar->segs.paths[seg], strerror(errno));
+        return -1;
+    }
+    void *map = mmap(NULL, c->len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    madvise(map, c->len, MADV_SEQUENTIAL);
+    c->data = map;
+    return 0;
+}
+
+static void cursor_close(struct cursor *c) {
+    if (c->data) {
+        munmap((void *)c->data, c->len);
+    }
+    free(c->buf);
+}
+
+// Next event of the segment; callers never read past the indexed count
+static inline int cursor_next(struct cursor *c, uint64_t *value) {
+    if (c->packed) {
+        if (c->buf_pos == c->buf_len) {
+            long n = hb_codec_decode(c->packed, ++c->block, c->buf);
+            if (n <= 0) {
+                return -1;
+            }
+            c->buf_len = (size_t)n;
+            c->buf_pos = 0;
+        }
+        *value = c->buf[c->buf_pos++];
+        return 0;
+    }
+
+    const char *buf = c->data;
+    size_t pos = c->pos;
+    while (pos < c->len) {
+        const char *nl = memchr(buf + pos, '\n', c->len - pos);
+        size_t end = nl ? (size_t)(nl - buf) : c->len;
+
+        size_t i = pos;
+        while (i < end && (buf[i] == ' ' || buf[i] == '\t')) {
+            i++;
+        }
+        pos = end + 1;
+        if (i < end && buf[i] >= '0' && buf[i] <= '9') {
+            uint64_t v = 0;
+            while (i < end && buf[i] >= '0' && buf[i] <= '9') {
+                v = v * 10 + (uint64_t)(buf[i] - '0');
+                i++;
+            }
+            *value = v;
+            c->pos = pos;
+            return 0;
+        }
+    }
+    c->pos = pos;
+    return -1;
+}
+
+int hb_archive_find_time(const struct hb_archive *ar, uint64_t t_ns, uint64_t *ordinal) {
+    uint64_t total = hb_archive_events(ar);
+
+    if (t_ns > hb_archive_duration_ns(ar)) {
+        *ordinal = total;
+        return 0;
+    }
+
+    // First segment whose end time reaches t_ns
+    size_t lo = 0, hi = ar->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ar->first_ns[mid + 1] < t_ns) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    while (lo < ar->count && ar->index[lo].events == 0) {
+        lo++;
+    }
+    if (lo == ar->count) {
+        *ordinal = total;
+        return 0;
+    }
+
+    const struct hb_segment_index *idx = &ar->index[lo];
+    uint64_t base = ar->first_ns[lo];
+    uint64_t rel = t_ns > base ? t_ns - base : 0;
+
+    // Last indexed event strictly before rel; scan forward from it
+    size_t a = 0, b = idx->entry_count;
+    while (a < b) {
+        size_t mid = a + (b - a) / 2;
+        if (idx->entries[mid].time_ns < rel) {
+            a = mid + 1;
+        } else {
+            b = mid;
+        }
+    }
+    if (a == 0) {
+        *ordinal = ar->first_event[lo];
+        return 0;
+    }
+
+    struct cursor c;
+    if (cursor_open(&c, ar, lo, a - 1) < 0) {
+        return -1;
+    }
+
+    uint64_t ord = (uint64_t)(a - 1) * idx->stride;
+    uint64_t time = idx->entries[a - 1].time_ns;
+    uint64_t value;
+    int rv = cursor_next(&c, &value);   // the indexed event itself
+    ord++;
+    while (rv == 0 && ord < idx->events) {
+        rv = cursor_next(&c, &value);
+        time += value;
+        if (time >= rel) {
+            break;
+        }
+        ord++;
+    }
+    cursor_close(&c);
+    if (rv < 0) {
+        fprintf(stderr, "%s: index does not match segment\n", ar->segs.paths[lo]);
+        return -1;
+    }
+
+    *ordinal = ar->first_event[lo] + ord;
+    return 0;
+}
+
+int hb_archive_read(const struct hb_archive *ar, uint64_t first, uint64_t count,
+                    struct hb_events *out) {
+    uint64_t total = hb_archive_events(ar);
+    if (first >= total || count == 0) {
+        return 0;
+    }
+    if (count > total - first) {
+        count = total - first;
+    }
+    if (hb_events_reserve(out, out->count + count) < 0) {
+        return -1;
+    }
+
+    size_t seg = segment_for_event(ar, first);
+    uint64_t want = count;
+
+    while (want > 0 && seg < ar->count) {
+        const struct hb_segment_index *idx = &ar->index[seg];
+        uint64_t rel = first - ar->first_event[seg];
+        if (rel >= idx->events) {
+            seg++;
+            continue;
+        }
+
+        struct cursor c;
+        if (cursor_open(&c, ar, seg, rel / idx->stride) < 0) {
+            return -1;
+        }
+
+        uint64_t skip = rel % idx->stride;
+        uint64_t avail = idx->events - rel;
+        uint64_t take = want < avail ? want : avail;
+        uint64_t value;
+        int rv = 0;
+        while (rv == 0 && skip > 0) {
+            rv = cursor_next(&c, &value);
+            skip--;
+        }
+        for (uint64_t i = 0; rv == 0 && i < take; i++) {
+            rv = cursor_next(&c, &out->values[out->count]);
+            out->count += rv == 0;
+        }
+        cursor_close(&c);
+        if (rv < 0) {
+            fprintf(stderr, "%s: index does not match segment\n", ar->segs.paths[seg]);
+            return -1;
+        }
+
+        first += take;
+        want -= take;
+        seg++;
+    }
+    return 0;
+}
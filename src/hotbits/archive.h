@@ -0,0 +1,45 @@
+#ifndef HOTBITS_ARCHIVE_H
+#define HOTBITS_ARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "codec.h"
+#include "events.h"
+#include "index.h"
+#include "segments.h"
+
+// Read-only view of data/events-*.txt as one event stream.
+//
+// Event ordinals are 0-based positions in `cat data/events-*.txt`; event
+// times are the running sum of deltas from the start of the first segment,
+// the same absolute time the pipeline's filter stage reconstructs. Opening
+// the archive loads (and refreshes) every segment's sparse index; reads then
+// seek straight to the nearest indexed line instead of scanning from the
+// start of the data. Packed .hbc segments are read through their block
+// directory, which plays the role of the index.
+struct hb_archive {
+    struct hb_segments segs;
+    struct hb_segment_index *index;
+    struct hb_codec_file *packed;   // map is NULL for text segments
+    uint64_t *first_event;   // count + 1 prefix sums of events per segment
+    uint64_t *first_ns;      // count + 1 prefix sums of time per segment
+    size_t count;
+};
+
+// persist: write refreshed indexes back next to the segments (failures,
+// e.g. a read-only data directory, only keep the index in memory)
+int hb_archive_open(struct hb_archive *ar, const char *data_dir, int persist);
+void hb_archive_close(struct hb_archive *ar);
+
+uint64_t hb_archive_events(const struct hb_archive *ar);
+uint64_t hb_archive_duration_ns(const struct hb_archive *ar);
+
+// Ordinal of the first event at or after t_ns (hb_archive_events() if none)
+int hb_archive_find_time(const struct hb_archive *ar, uint64_t t_ns, uint64_t *ordinal);
+
+// Append up to count events starting at ordinal first to out
+int hb_archive_read(const struct hb_archive *ar, uint64_t first, uint64_t count,
+                    struct hb_events *out);
+
+#endif
@@ -0,0 +1,583 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <endian.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "codec.h"
+
+#define FILE_MAGIC 0x31434248u      // "HBC1"
+#define FILE_VERSION 1
+#define FILE_HEADER_SIZE 56
+#define BLOCK_HEADER_SIZE 56
+#define DIR_ENTRY_SIZE 16
+#define PACK_PAD 16                 // slack so decoders may load 9 bytes past any value
+
+static inline uint64_t get64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return le64toh(v);
+}
+
+static inline uint32_t get32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return le32toh(v);
+}
+
+static inline uint16_t get16(const uint8_t *p) {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return le16toh(v);
+}
+
+static inline void put64(uint8_t *p, uint64_t v) {
+    v = htole64(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline void put32(uint8_t *p, uint32_t v) {
+    v = htole32(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline void put16(uint8_t *p, uint16_t v) {
+    v = htole16(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline uint64_t zigzag(uint64_t a, uint64_t b) {
+    int64_t d = (int64_t)(a - b);
+    return ((uint64_t)d << 1) ^ (uint64_t)(d >> 63);
+}
+
+static inline uint64_t unzigzag(uint64_t z) {
+    return (z >> 1) ^ (0 - (z & 1));
+}
+
+static inline unsigned bit_length(uint64_t v) {
+    return v ? 64 - (unsigned)__builtin_clzll(v) : 0;
+}
+
+static inline size_t packed_size(size_t count, unsigned width) {
+    return (count * width + 7) / 8 + PACK_PAD;
+}
+
+size_t hb_codec_block_bound(size_t count) {
+    return BLOCK_HEADER_SIZE + 2 * packed_size(count, 64) + 2 * count;
+}
+
+// LSB-first bitstream of width-bit values, written as little-endian words
+static void pack_bits(const uint64_t *x, size_t n, unsigned width, uint8_t *out) {
+    memset(out, 0, packed_size(n, width));
+    if (width == 0) {
+        return;
+    }
+
+    const uint64_t mask = width == 64 ? ~0ULL : (1ULL << width) - 1;
+    uint64_t acc = 0;
+    unsigned fill = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        uint64_t v = x[i] & mask;
+        acc |= v << fill;
+        if (fill + width >= 64) {
+            put64(out, acc);
+            out += 8;
+            acc = fill ? v >> (64 - fill) : 0;
+            fill = fill + width - 64;
+        } else {
+            fill += width;
+        }
+    }
+    for (unsigned b = 0; b < fill; b += 8) {
+        *out++ = (uint8_t)acc;
+        acc >>= 8;
+    }
+}
+
+static inline uint64_t extract_bits(const uint8_t *in, size_t i, unsigned width) {
+    uint64_t bit = (uint64_t)i * width;
+    const uint8_t *p = in + (bit >> 3);
+    unsigned shift = bit & 7;
+    uint64_t v = get64(p) >> shift;
+    if (shift + width > 64) {
+        v |= (uint64_t)p[8] << (64 - shift);
+    }
+    return width == 64 ? v : v & ((1ULL << width) - 1);
+}
+
+// Instantiated once per width below so the shift/mask arithmetic is
+// constant-folded and the loop body is a load, shift and mask per value
+static inline __attribute__((always_inline))
+void unpack_fixed(const uint8_t *in, size_t n, uint64_t *out, const unsigned width) {
+    const uint64_t mask = width == 64 ? ~0ULL : (1ULL << width) - 1;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t bit = (uint64_t)i * width;
+        const uint8_t *p = in + (bit >> 3);
+        unsigned shift = bit & 7;
+        uint64_t v = get64(p) >> shift;
+        if (width > 56 && shift + width > 64) {
+            v |= (uint64_t)p[8] << (64 - shift);
+        }
+        out[i] = v & mask;
+    }
+}
+
+#define UNPACK_CASE(w) case (w): unpack_fixed(in, n, out, (w)); return;
+#define UNPACK_CASES8(b) \
+    UNPACK_CASE(b + 1) UNPACK_CASE(b + 2) UNPACK_CASE(b + 3) UNPACK_CASE(b + 4) \
+    UNPACK_CASE(b + 5) UNPACK_CASE(b + 6) UNPACK_CASE(b + 7) UNPACK_CASE(b + 8)
+
+static void unpack_bits(const uint8_t *in, size_t n, unsigned width, uint64_t *out) {
+    switch (width) {
+        case 0:
+            memset(out, 0, n * sizeof(uint64_t));
+            return;
+        UNPACK_CASES8(0) UNPACK_CASES8(8) UNPACK_CASES8(16) UNPACK_CASES8(24)
+        UNPACK_CASES8(32) UNPACK_CASES8(40) UNPACK_CASES8(48) UNPACK_CASES8(56)
+    }
+}
+
+// Cheapest patched width for x: every value is stored in `width` bits and
+// the ones that need more carry a 16-bit index plus their high bits.
+static uint64_t choose_width(const uint64_t *x, size_t n, unsigned *width, unsigned *exc_width) {
+    size_t hist[65] = {0};
+    unsigned maxlen = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        unsigned len = bit_length(x[i]);
+        hist[len]++;
+        if (len > maxlen) maxlen = len;
+    }
+
+    uint64_t best = UINT64_MAX;
+    size_t above = 0;
+    for (int w = (int)maxlen; w >= 0; w--) {
+        uint64_t cost = (uint64_t)n * w + (uint64_t)above * (16 + maxlen - w);
+        if (cost < best) {
+            best = cost;
+            *width = (unsigned)w;
+            *exc_width = maxlen - (unsigned)w;
+        }
+        above += hist[w];
+    }
+    return best;
+}
+
+size_t hb_codec_encode_block(const uint64_t *values, size_t count, uint8_t *out) {
+    if (count == 0 || count > HB_CODEC_BLOCK_MAX) {
+        return 0;
+    }
+
+    uint64_t min = values[0], max = values[0], sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (values[i] < min) min = values[i];
+        if (values[i] > max) max = values[i];
+        sum += values[i];
+    }
+
+    uint64_t *x = malloc(2 * count * sizeof(uint64_t));
+    if (!x) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 0;
+    }
+    uint64_t *high = x + count;
+
+    // Delta-of-delta candidate; slot 0 repeats slot 1 so it does not pull
+    // the frame of reference down to zero
+    uint64_t dod_base = UINT64_MAX;
+    for (size_t i = 1; i < count; i++) {
+        x[i] = zigzag(values[i], values[i - 1]);
+        if (x[i] < dod_base) dod_base = x[i];
+    }
+    x[0] = count > 1 ? x[1] : 0;
+    if (count == 1) dod_base = 0;
+    for (size_t i = 0; i < count; i++) {
+        x[i] -= dod_base;
+    }
+    unsigned dod_width, dod_exc_width;
+    uint64_t dod_cost = choose_width(x, count, &dod_width, &dod_exc_width);
+
+    int mode = HB_CODEC_DOD;
+    uint64_t base = dod_base;
+    unsigned width = dod_width, exc_width = dod_exc_width;
+
+    for (size_t i = 0; i < count; i++) {
+        high[i] = values[i] - min;
+    }
+    unsigned for_width, for_exc_width;
+    uint64_t for_cost = choose_width(high, count, &for_width, &for_exc_width);
+    if (for_cost <= dod_cost) {
+        mode = HB_CODEC_FOR;
+        base = min;
+        width = for_width;
+        exc_width = for_exc_width;
+        memcpy(x, high, count * sizeof(uint64_t));
+    }
+
+    // Exceptions: indices and the bits above `width`
+    uint8_t *payload = out + BLOCK_HEADER_SIZE;
+    uint8_t *exc_idx = payload + packed_size(count, width);
+    uint32_t exc_count = 0;
+    if (width < 64) {
+        for (size_t i = 0; i < count; i++) {
+            if (x[i] >> width) {
+                put16(exc_idx + 2 * exc_count, (uint16_t)i);
+                high[exc_count++] = x[i] >> width;
+            }
+        }
+    }
+
+    pack_bits(x, count, width, payload);
+    uint8_t *exc_bits = exc_idx + 2 * exc_count;
+    size_t exc_bytes = 0;
+    if (exc_count) {
+        pack_bits(high, exc_count, exc_width, exc_bits);
+        exc_bytes = packed_size(exc_count, exc_width);
+    }
+    free(x);
+
+    size_t bytes = (size_t)(exc_bits + exc_bytes - out);
+    put32(out, (uint32_t)count);
+    out[4] = (uint8_t)mode;
+    out[5] = (uint8_t)width;
+    out[6] = exc_count ? (uint8_t)exc_width : 0;
+    out[7] = 0;
+    put32(out + 8, exc_count);
+    put32(out + 12, (uint32_t)bytes);
+    put64(out + 16, min);
+    put64(out + 24, max);
+    put64(out + 32, sum);
+    put64(out + 40, base);
+    put64(out + 48, values[0]);
+    return bytes;
+}
+
+int hb_codec_block_info(const uint8_t *in, size_t len, struct hb_block_info *info) {
+    if (len < BLOCK_HEADER_SIZE) {
+        return -1;
+    }
+    info->count = get32(in);
+    info->mode = in[4];
+    info->width = in[5];
+    info->exceptions = get32(in + 8);
+    info->min = get64(in + 16);
+    info->max = get64(in + 24);
+    info->sum = get64(in + 32);
+
+    if (info->count == 0 || info->count > HB_CODEC_BLOCK_MAX || info->width > 64 ||
+        info->width + in[6] > 64 || info->mode > HB_CODEC_DOD ||
+        info->exceptions > info->count || get32(in + 12) > len) {
+        return -1;
+    }
+    return 0;
+}
+
+long hb_codec_decode_block(const uint8_t *in, size_t len, uint64_t *out) {
+    struct hb_block_info info;
+    if (hb_codec_block_info(in, len, &info) < 0) {
+        return -1;
+    }
+
+    size_t n = info.count;
+    unsigned width = info.width;
+    unsigned exc_width = in[6];
+    uint64_t base = get64(in + 40);
+    uint64_t first = get64(in + 48);
+
+    const uint8_t *payload = in + BLOCK_HEADER_SIZE;
+    const uint8_t *exc_idx = payload + packed_size(n, width);
+    const uint8_t *exc_bits = exc_idx + 2 * (size_t)info.exceptions;
+    size_t need = (size_t)(exc_bits - in) + (info.exceptions ? packed_size(info.exceptions, exc_width) : 0);
+    if (need > get32(in + 12)) {
+        return -1;
+    }
+
+    unpack_bits(payload, n, width, out);
+
+    for (uint32_t k = 0; k < info.exceptions; k++) {
+        uint16_t i = get16(exc_idx + 2 * k);
+        if (i >= n) {
+            return -1;
+        }
+        out[i] |= extract_bits(exc_bits, k, exc_width) << width;
+    }
+
+    if (info.mode == HB_CODEC_FOR) {
+        for (size_t i = 0; i < n; i++) {
+            out[i] += base;
+        }
+    } else {
+        uint64_t v = first;
+        out[0] = first;
+        for (size_t i = 1; i < n; i++) {
+            v += unzigzag(out[i] + base);
+            out[i] = v;
+        }
+    }
+    return (long)n;
+}
+
+int hb_codec_writer_open(struct hb_codec_writer *w, const char *path, uint32_t block_len) {
+    memset(w, 0, sizeof(*w));
+    w->block_len = block_len ? block_len : HB_CODEC_BLOCK_DEFAULT;
+    if (w->block_len > HB_CODEC_BLOCK_MAX) {
+        fprintf(stderr, "Block length %u exceeds %d\n", w->block_len, HB_CODEC_BLOCK_MAX);
+        return -1;
+    }
+
+    snprintf(w->path, sizeof(w->path), "%s", path);
+    char tmp[4096 + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    w->pending = malloc(w->block_len * sizeof(uint64_t));
+    w->scratch = malloc(hb_codec_block_bound(w->block_len));
+    if (!w->pending || !w->scratch) {
+        fprintf(stderr, "Memory allocation failed\n");
+        hb_codec_writer_abort(w);
+        return -1;
+    }
+
+    w->f = fopen(tmp, "wb");
+    if (!w->f) {
+        perror(tmp);
+        hb_codec_writer_abort(w);
+        return -1;
+    }
+
+    uint8_t header[FILE_HEADER_SIZE] = {0};
+    if (fwrite(header, sizeof(header), 1, w->f) != 1) {
+        perror(tmp);
+        hb_codec_writer_abort(w);
+        return -1;
+    }
+    w->offset = FILE_HEADER_SIZE;
+    return 0;
+}
+
+static int flush_block(struct hb_codec_writer *w) {
+    if (w->pending_count == 0) {
+        return 0;
+    }
+
+    if (w->dir_count == w->dir_cap) {
+        size_t cap = w->dir_cap ? w->dir_cap * 2 : 64;
+        struct hb_index_entry *dir = realloc(w->dir, cap * sizeof(*dir));
+        if (!dir) {
+            fprintf(stderr, "Memory allocation failed\n");
+            return -1;
+        }
+        w->dir = dir;
+        w->dir_cap = cap;
+    }
+
+    size_t bytes = hb_codec_encode_block(w->pending, w->pending_count, w->scratch);
+    if (bytes == 0 || fwrite(w->scratch, 1, bytes, w->f) != bytes) {
+        perror(w->path);
+        return -1;
+    }
+
+    w->dir[w->dir_count].offset = w->offset;
+    w->dir[w->dir_count].time_ns = w->total_ns + w->pending[0];
+    w->dir_count++;
+
+    for (size_t i = 0; i < w->pending_count; i++) {
+        w->total_ns += w->pending[i];
+    }
+    w->events += w->pending_count;
+    w->offset += bytes;
+    w->pending_count = 0;
+    return 0;
+}
+
+int hb_codec_writer_add(struct hb_codec_writer *w, const uint64_t *values, size_t count) {
+    while (count > 0) {
+        size_t n = w->block_len - w->pending_count;
+        if (n > count) n = count;
+        memcpy(w->pending + w->pending_count, values, n * sizeof(uint64_t));
+        w->pending_count += n;
+        values += n;
+        count -= n;
+        if (w->pending_count == w->block_len && flush_block(w) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int hb_codec_writer_close(struct hb_codec_writer *w) {
+    if (flush_block(w) < 0) {
+        hb_codec_writer_abort(w);
+        return -1;
+    }
+
+    uint8_t entry[DIR_ENTRY_SIZE];
+    for (size_t i = 0; i < w->dir_count; i++) {
+        put64(entry, w->dir[i].offset);
+        put64(entry + 8, w->dir[i].time_ns);
+        if (fwrite(entry, sizeof(entry), 1, w->f) != 1) {
+            perror(w->path);
+            hb_codec_writer_abort(w);
+            return -1;
+        }
+    }
+
+    uint8_t header[FILE_HEADER_SIZE] = {0};
+    put32(header, FILE_MAGIC);
+    put32(header + 4, FILE_VERSION);
+    put32(header + 8, w->block_len);
+    put64(header + 16, w->events);
+    put64(header + 24, w->total_ns);
+    put64(header + 32, w->dir_count);
+    put64(header + 40, w->offset);
+
+    char tmp[4096 + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", w->path);
+    if (fseek(w->f, 0, SEEK_SET) != 0 || fwrite(header, sizeof(header), 1, w->f) != 1 ||
+        fclose(w->f) != 0) {
+        w->f = NULL;
+        perror(tmp);
+        hb_codec_writer_abort(w);
+        return -1;
+    }
+    w->f = NULL;
+
+    if (rename(tmp, w->path) < 0) {
+        perror(w->path);
+        hb_codec_writer_abort(w);
+        return -1;
+    }
+    hb_codec_writer_abort(w);
+    return 0;
+}
+
+// Release the writer; an unfinished temporary file is removed
+void hb_codec_writer_abort(struct hb_codec_writer *w) {
+    if (w->f) {
+        char tmp[4096 + 8];
+        snprintf(tmp, sizeof(tmp), "%s.tmp", w->path);
+        fclose(w->f);
+        unlink(tmp);
+        w->f = NULL;
+    }
+    free(w->pending);
+    free(w->scratch);
+    free(w->dir);
+    w->pending = NULL;
+    w->scratch = NULL;
+    w->dir = NULL;
+    w->dir_count = w->dir_cap = 0;
+}
+
+int hb_codec_open(struct hb_codec_file *f, const char *path) {
+    memset(f, 0, sizeof(*f));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < FILE_HEADER_SIZE) {
+        fprintf(stderr, "%s: not a packed segment\n", path);
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+
+    const uint8_t *h = map;
+    uint64_t block_count = get64(h + 32);
+    uint64_t dir_offset = get64(h + 40);
+    if (get32(h) != FILE_MAGIC || get32(h + 4) != FILE_VERSION || get32(h + 8) == 0 ||
+        dir_offset < FILE_HEADER_SIZE || dir_offset > (uint64_t)st.st_size ||
+        block_count > ((uint64_t)st.st_size - dir_offset) / DIR_ENTRY_SIZE) {
+        fprintf(stderr, "%s: not a packed segment\n", path);
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    f->map = map;
+    f->len = st.st_size;
+    f->block_len = get32(h + 8);
+    f->events = get64(h + 16);
+    f->total_ns = get64(h + 24);
+    f->block_count = block_count;
+    f->dir = f->map + dir_offset;
+    return 0;
+}
+
+void hb_codec_close(struct hb_codec_file *f) {
+    if (f->map) {
+        munmap((void *)f->map, f->len);
+    }
+    memset(f, 0, sizeof(*f));
+}
+
+void hb_codec_dir_entry(const struct hb_codec_file *f, uint64_t block, struct hb_index_entry *e) {
+    e->offset = get64(f->dir + block * DIR_ENTRY_SIZE);
+    e->time_ns = get64(f->dir + block * DIR_ENTRY_SIZE + 8);
+}
+
+long hb_codec_decode(const struct hb_codec_file *f, uint64_t block, uint64_t *out) {
+    struct hb_index_entry e;
+    if (block >= f->block_count) {
+        return -1;
+    }
+    hb_codec_dir_entry(f, block, &e);
+
+    // out only has room for block_len values
+    struct hb_block_info info;
+    size_t end = (size_t)(f->dir - f->map);
+    if (e.offset < FILE_HEADER_SIZE || e.offset >= end ||
+        hb_codec_block_info(f->map + e.offset, end - e.offset, &info) < 0 ||
+        info.count > f->block_len) {
+        return -1;
+    }
+    return hb_codec_decode_block(f->map + e.offset, end - e.offset, out);
+}
+
+int hb_codec_is_packed(const char *path) {
+    size_t len = strlen(path);
+    size_t suffix = strlen(HB_CODEC_SUFFIX);
+    return len > suffix && strcmp(path + len - suffix, HB_CODEC_SUFFIX) == 0;
+}
+
+int hb_codec_load_file(struct hb_events *ev, const char *path) {
+    struct hb_codec_file f;
+    if (hb_codec_open(&f, path) < 0) {
+        return -1;
+    }
+    if (hb_events_reserve(ev, ev->count + f.events + f.block_len) < 0) {
+        hb_codec_close(&f);
+        return -1;
+    }
+
+    for (uint64_t b = 0; b < f.block_count; b++) {
+        long n = hb_codec_decode(&f, b, ev->values + ev->count);
+        if (n < 0) {
+            fprintf(stderr, "%s: corrupt block %lu\n", path, b);
+            hb_codec_close(&f);
+            return -1;
+        }
+        ev->count += n;
+    }
+    hb_codec_close(&f);
+    return 0;
+}
@@ -0,0 +1,96 @@
+#ifndef HOTBITS_CODEC_H
+#define HOTBITS_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "events.h"
+#include "index.h"
+
+// Packed event segments (events-N.hbc).
+//
+// Deltas are coded in blocks of up to block_len values. Each block picks
+// the cheaper of two transforms, frame of reference over the deltas
+// themselves or zigzag delta-of-delta (Gorilla style, for periodic
+// sources), and bit-packs the result at a fixed width chosen from the
+// block's bit-length histogram. Values that do not fit are patched from an
+// exception list, so a handful of long gaps does not widen the whole block.
+// Block headers carry count, min, max and sum so readers can skip blocks
+// without decoding them; a directory at the end of the file maps every
+// block to its offset and the time of its first event, in the same form as
+// a text segment's sparse index.
+#define HB_CODEC_BLOCK_DEFAULT 4096
+#define HB_CODEC_BLOCK_MAX 65535
+#define HB_CODEC_SUFFIX ".hbc"
+
+enum hb_codec_mode {
+    HB_CODEC_FOR = 0,        // value - min
+    HB_CODEC_DOD = 1         // zigzag(value[i] - value[i-1]) - min
+};
+
+struct hb_block_info {
+    uint32_t count;
+    int mode;
+    unsigned width;
+    uint32_t exceptions;
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum;
+};
+
+// Upper bound on the encoded size of a block of count values
+size_t hb_codec_block_bound(size_t count);
+
+// Encode one block; returns the number of bytes written to out
+size_t hb_codec_encode_block(const uint64_t *values, size_t count, uint8_t *out);
+
+// Header of an encoded block (len bytes available); returns 0 or -1
+int hb_codec_block_info(const uint8_t *in, size_t len, struct hb_block_info *info);
+
+// Decode one block into out (room for info.count values). Returns the
+// number of values, or -1 if the block is malformed.
+long hb_codec_decode_block(const uint8_t *in, size_t len, uint64_t *out);
+
+struct hb_codec_writer {
+    FILE *f;
+    char path[4096];
+    uint32_t block_len;
+    uint64_t *pending;
+    size_t pending_count;
+    uint8_t *scratch;
+    uint64_t offset;
+    uint64_t events;
+    uint64_t total_ns;
+    struct hb_index_entry *dir;
+    size_t dir_count;
+    size_t dir_cap;
+};
+
+// Written to path.tmp and renamed by close, so a packed file is complete
+int hb_codec_writer_open(struct hb_codec_writer *w, const char *path, uint32_t block_len);
+int hb_codec_writer_add(struct hb_codec_writer *w, const uint64_t *values, size_t count);
+int hb_codec_writer_close(struct hb_codec_writer *w);
+void hb_codec_writer_abort(struct hb_codec_writer *w);
+
+struct hb_codec_file {
+    const uint8_t *map;
+    size_t len;
+    uint32_t block_len;
+    uint64_t events;
+    uint64_t total_ns;
+    uint64_t block_count;
+    const uint8_t *dir;      // block_count struct hb_index_entry records
+};
+
+int hb_codec_open(struct hb_codec_file *f, const char *path);
+void hb_codec_close(struct hb_codec_file *f);
+void hb_codec_dir_entry(const struct hb_codec_file *f, uint64_t block, struct hb_index_entry *e);
+
+// Decode block number `block` of an open file
+long hb_codec_decode(const struct hb_codec_file *f, uint64_t block, uint64_t *out);
+
+int hb_codec_is_packed(const char *path);
+int hb_codec_load_file(struct hb_events *ev, const char *path);
+
+#endif
@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+#include "cpu.h"
+
+int hb_cpu_selected = -1;
+
+static const char *isa_names[HB_ISA_LEVELS] = {
+#if HB_ISA_LEVELS == 4
+    "generic", "x86-64-v2", "x86-64-v3", "x86-64-v4"
+#elif HB_ISA_LEVELS == 3
+    "generic", "crypto", "sve"
+#else
+    "generic"
+#endif
+};
+
+static pthread_once_t detect_once = PTHREAD_ONCE_INIT;
+
+int hb_cpu_best(void) {
+#if HB_ISA_LEVELS == 4
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("x86-64-v4")) {
+        return 3;
+    }
+    if (__builtin_cpu_supports("x86-64-v3")) {
+        return 2;
+    }
+    if (__builtin_cpu_supports("x86-64-v2")) {
+        return 1;
+    }
+    return 0;
+#elif HB_ISA_LEVELS == 3 && defined(__linux__)
+    unsigned long hwcap = getauxval(AT_HWCAP);
+    unsigned long crypto = HWCAP_CRC32 | HWCAP_AES | HWCAP_PMULL | HWCAP_SHA2;
+    if ((hwcap & crypto) != crypto) {
+        return 0;
+    }
+    return hwcap & HWCAP_SVE ? 2 : 1;
+#else
+    return 0;
+#endif
+}
+
+const char *hb_isa_name(int level) {
+    return level >= 0 && level < HB_ISA_LEVELS ? isa_names[level] : "unknown";
+}
+
+int hb_isa_parse(const char *name) {
+    for (int i = 0; i < HB_ISA_LEVELS; i++) {
+        if (strcmp(name, isa_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int hb_cpu_force(const char *name) {
+    int level = hb_isa_parse(name);
+    if (level < 0) {
+        fprintf(stderr, "Unknown ISA level: %s (this build has", name);
+        for (int i = 0; i < HB_ISA_LEVELS; i++) {
+            fprintf(stderr, " %s", isa_names[i]);
+        }
+        fprintf(stderr, ")\n");
+        return -1;
+    }
+    if (level > hb_cpu_best()) {
+        fprintf(stderr, "This CPU does not support %s\n", name);
+        return -1;
+    }
+    __atomic_store_n(&hb_cpu_selected, level, __ATOMIC_RELAXED);
+    return 0;
+}
+
+static void detect(void) {
+    // Forced before the first kernel call
+    if (__atomic_load_n(&hb_cpu_selected, __ATOMIC_RELAXED) >= 0) {
+        return;
+    }
+    const char *forced = getenv("HOTBITS_ISA");
+    if (forced && *forced && hb_cpu_force(forced) == 0) {
+        return;
+    }
+    __atomic_store_n(&hb_cpu_selected, hb_cpu_best(), __ATOMIC_RELAXED);
+}
+
+int hb_cpu_detect(void) {
+    pthread_once(&detect_once, detect);
+    return __atomic_load_n(&hb_cpu_selected, __ATOMIC_RELAXED);
+}
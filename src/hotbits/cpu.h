@@ -0,0 +1,85 @@
+#ifndef HOTBITS_CPU_H
+#define HOTBITS_CPU_H
+
+// Runtime ISA dispatch for the hot kernels: delta parsing, extraction,
+// the popcount statistics and hashing.
+//
+// HB_KERNEL compiles a kernel once per level below from the same source,
+// using GCC target attributes, so one binary runs anywhere and still gets
+// the wider instructions where the CPU has them. The best level the CPU
+// supports is picked on first use; HOTBITS_ISA=NAME in the environment
+// (or hb_cpu_force, e.g. hotbits-extract --isa) selects a lower one. Every
+// level computes the same results.
+//
+//   x86-64   generic, x86-64-v2 (POPCNT, SSE4.2), x86-64-v3 (AVX2, BMI2),
+//            x86-64-v4 (AVX-512)
+//   aarch64  generic (armv8-a), crypto (CRC32, AES, SHA, PMULL),
+//            sve (armv8.2-a with SVE)
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HB_ISA_LEVELS 4
+#define HB_ISA_TARGET_1 "arch=x86-64-v2"
+#define HB_ISA_TARGET_2 "arch=x86-64-v3"
+#define HB_ISA_TARGET_3 "arch=x86-64-v4"
+#elif defined(__GNUC__) && defined(__aarch64__)
+#define HB_ISA_LEVELS 3
+#define HB_ISA_TARGET_1 "arch=armv8-a+crc+crypto"
+#define HB_ISA_TARGET_2 "arch=armv8.2-a+sve"
+#else
+#define HB_ISA_LEVELS 1
+#endif
+
+extern int hb_cpu_selected;     // -1 until the first kernel call
+
+int hb_cpu_detect(void);
+
+// Level the kernels run at, 0 (generic) to HB_ISA_LEVELS - 1
+static inline int hb_cpu_level(void) {
+    int level = __atomic_load_n(&hb_cpu_selected, __ATOMIC_RELAXED);
+    return level >= 0 ? level : hb_cpu_detect();
+}
+
+// Highest level this CPU supports
+int hb_cpu_best(void);
+const char *hb_isa_name(int level);
+// Level named name, or -1
+int hb_isa_parse(const char *name);
+// Run at the named level from now on. Returns -1 if it is unknown or the
+// CPU lacks it.
+int hb_cpu_force(const char *name);
+
+// Variant n of kernel name: the generic body inlined whole (flatten) into
+// a function compiled for that level's ISA
+#define HB_KERNEL_VARIANT_(ret, ret_kw, name, n, params, args) \
+    __attribute__((target(HB_ISA_TARGET_##n), flatten)) \
+    static ret name##_##n params { ret_kw name args; }
+
+#if HB_ISA_LEVELS == 4
+#define HB_KERNEL_VARIANTS_(ret, ret_kw, name, params, args) \
+    HB_KERNEL_VARIANT_(ret, ret_kw, name, 1, params, args) \
+    HB_KERNEL_VARIANT_(ret, ret_kw, name, 2, params, args) \
+    HB_KERNEL_VARIANT_(ret, ret_kw, name, 3, params, args) \
+    static ret (*const name##_variants[HB_ISA_LEVELS]) params = { \
+        name, name##_1, name##_2, name##_3 \
+    }
+#elif HB_ISA_LEVELS == 3
+#define HB_KERNEL_VARIANTS_(ret, ret_kw, name, params, args) \
+    HB_KERNEL_VARIANT_(ret, ret_kw, name, 1, params, args) \
+    HB_KERNEL_VARIANT_(ret, ret_kw, name, 2, params, args) \
+    static ret (*const name##_variants[HB_ISA_LEVELS]) params = { \
+        name, name##_1, name##_2 \
+    }
+#else
+#define HB_KERNEL_VARIANTS_(ret, ret_kw, name, params, args) \
+    static ret (*const name##_variants[HB_ISA_LEVELS]) params = { name }
+#endif
+
+// After `static inline ret name params { ... }`, declare its variants;
+// args names the parameters in order. Call it through HB_DISPATCH(name).
+#define HB_KERNEL(ret, name, params, args) \
+    HB_KERNEL_VARIANTS_(ret, return, name, params, args)
+#define HB_KERNEL_VOID(name, params, args) \
+    HB_KERNEL_VARIANTS_(void, , name, params, args)
+
+#define HB_DISPATCH(name) (name##_variants[hb_cpu_level()])
+
+#endif
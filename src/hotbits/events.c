@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "cpu.h"
+#include "events.h"
+#include "input.h"
+#include "instrument.h"
+#include "trace.h"
+
+#define READ_CHUNK (1 << 20)
+
+void hb_events_init(struct hb_events *ev) {
+    ev->values = NULL;
+    ev->count = 0;
+    ev->capacity = 0;
+}
+
+void hb_events_free(struct hb_events *ev) {
+    free(ev->values);
+    hb_events_init(ev);
+}
+
+int hb_events_reserve(struct hb_events *ev, size_t capacity) {
+    if (capacity <= ev->capacity) {
+        return 0;
+    }
+
+    size_t new_capacity = ev->capacity ? ev->capacity : 4096;
+    while (new_capacity < capacity) {
+        new_capacity *= 2;
+    }
+
+    uint64_t *values = realloc(ev->values, new_capacity * sizeof(uint64_t));
+    if (!values) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+
+    ev->values = values;
+    ev->capacity = new_capacity;
+    return 0;
+}
+
+int hb_events_append(struct hb_events *ev, const uint64_t *values, size_t count) {
+    if (hb_events_reserve(ev, ev->count + count) < 0) {
+        return -1;
+    }
+    memcpy(ev->values + ev->count, values, count * sizeof(uint64_t));
+    ev->count += count;
+    return 0;
+}
+
+static inline size_t parse_deltas(const char *buf, size_t len, uint64_t *out, size_t max,
+                                  size_t *consumed) {
+    size_t n = 0;
+    size_t pos = 0;
+
+    while (n < max) {
+        const char *nl = memchr(buf + pos, '\n', len - pos);
+        if (!nl) {
+            break;
+        }
+        size_t end = nl - buf;
+
+        size_t i = pos;
+        while (i < end && (buf[i] == ' ' || buf[i] == '\t')) {
+            i++;
+        }
+        if (i < end && buf[i] >= '0' && buf[i] <= '9') {
+            uint64_t value = 0;
+            while (i < end && buf[i] >= '0' && buf[i] <= '9') {
+                value = value * 10 + (uint64_t)(buf[i] - '0');
+                i++;
+            }
+            out[n++] = value;
+        }
+
+        pos = end + 1;
+    }
+
+    *consumed = pos;
+    return n;
+}
+
+HB_KERNEL(size_t, parse_deltas,
+          (const char *buf, size_t len, uint64_t *out, size_t max, size_t *consumed),
+          (buf, len, out, max, consumed));
+
+size_t hb_parse_deltas(const char *buf, size_t len, uint64_t *out, size_t max,
+                       size_t *consumed) {
+    HB_SCOPE(HB_STAGE_PARSE);
+    size_t n = HB_DISPATCH(parse_deltas)(buf, len, out, max, consumed);
+    HB_COUNT(HB_STAGE_PARSE, n);
+    HB_TRACE2(parse, n, *consumed);
+    return n;
+}
+
+int hb_events_parse_buffer(struct hb_events *ev, const char *buf, size_t len) {
+    if (hb_events_reserve(ev, ev->count + len / 2 + 1) < 0) {
+        return -1;
+    }
+
+    size_t consumed;
+    ev->count += hb_parse_deltas(buf, len, ev->values + ev->count, len / 2 + 1, &consumed);
+
+    // Final line without a trailing newline
+    size_t i = consumed;
+    while (i < len && (buf[i] == ' ' || buf[i] == '\t')) {
+        i++;
+    }
+    if (i < len && buf[i] >= '0' && buf[i] <= '9') {
+        uint64_t value = 0;
+        while (i < len && buf[i] >= '0' && buf[i] <= '9') {
+            value = value * 10 + (uint64_t)(buf[i] - '0');
+            i++;
+        }
+        ev->values[ev->count++] = value;
+    }
+    return 0;
+}
+
+int hb_events_read_fd(struct hb_events *ev, int fd) {
+    char *buf = malloc(READ_CHUNK + 1);
+    if (!buf) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+
+    size_t have = 0;
+    int eof = 0;
+
+    while (!eof) {
+        ssize_t r = read(fd, buf + have, READ_CHUNK - have);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            perror("read");
+            free(buf);
+            return -1;
+        }
+        if (r == 0) {
+            eof = 1;
+            // Terminate a final unterminated line so it is parsed too
+            if (have > 0 && buf[have - 1] != '\n') {
+                buf[have++] = '\n';
+            }
+        } else {
+            have += r;
+        }
+
+        // Every line yields at most one value, so have/2+1 bounds the count
+        if (hb_events_reserve(ev, ev->count + have / 2 + 1) < 0) {
+            free(buf);
+            return -1;
+        }
+
+        size_t consumed;
+        ev->count += hb_parse_deltas(buf, have, ev->values + ev->count,
+                                     have / 2 + 1, &consumed);
+
+        if (consumed == 0 && have == READ_CHUNK) {
+            // A single line longer than the buffer is not an event; drop it
+            consumed = have;
+        }
+        memmove(buf, buf + consumed, have - consumed);
+        have -= consumed;
+    }
+
+    free(buf);
+    return 0;
+}
+
+int hb_events_load_file(struct hb_events *ev, const char *path) {
+    struct hb_input in;
+    if (hb_input_open(&in, path, 0) < 0) {
+        return -1;
+    }
+
+    int rv = hb_events_read_fd(ev, in.fd);
+    if (hb_input_close(&in) < 0) {
+        rv = -1;
+    }
+    return rv;
+}
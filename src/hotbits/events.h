@@ -0,0 +1,36 @@
+#ifndef HOTBITS_EVENTS_H
+#define HOTBITS_EVENTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Growable array of event deltas (nanoseconds), one per line of an
+// events-*.txt file as written by trng.
+struct hb_events {
+    uint64_t *values;
+    size_t count;
+    size_t capacity;
+};
+
+void hb_events_init(struct hb_events *ev);
+void hb_events_free(struct hb_events *ev);
+int hb_events_reserve(struct hb_events *ev, size_t capacity);
+int hb_events_append(struct hb_events *ev, const uint64_t *values, size_t count);
+
+// Parse newline-terminated decimal values from buf. Lines without leading
+// digits are skipped, matching the fgets/strtoull loops in the C tools.
+// Stops at the last complete line (or at max values) and returns the number
+// of values written; *consumed receives the number of bytes used.
+size_t hb_parse_deltas(const char *buf, size_t len, uint64_t *out, size_t max,
+                       size_t *consumed);
+
+// Parse an in-memory buffer (e.g. an mmap'd segment) and append to ev
+int hb_events_parse_buffer(struct hb_events *ev, const char *buf, size_t len);
+
+// Read every value from a file descriptor / path and append to ev.
+// A trailing line without a newline is still parsed; gzip and zstd files
+// are decompressed on the fly. Returns 0 or -1.
+int hb_events_read_fd(struct hb_events *ev, int fd);
+int hb_events_load_file(struct hb_events *ev, const char *path);
+
+#endif
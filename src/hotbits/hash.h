@@ -0,0 +1,13 @@
+#ifndef HOTBITS_HASH_H
+#define HOTBITS_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 64-bit content hash (XXH64 algorithm) used to key segment manifests
+uint64_t hb_hash64(const void *data, size_t len, uint64_t seed);
+
+// Hash a whole file; returns 0 or -1
+int hb_hash_file(const char *path, uint64_t *hash);
+
+#endif
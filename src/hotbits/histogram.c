@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "histogram.h"
+
+#define SUB_COUNT (1 << HB_HISTOGRAM_SUB_BITS)
+#define SUB_HALF (SUB_COUNT / 2)
+
+#define STORE(field, value) __atomic_store_n(&(field), (value), __ATOMIC_RELAXED)
+#define LOAD(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+static int bucket_index(uint64_t v) {
+    if (v < SUB_COUNT) {
+        return (int)v;
+    }
+    if (v >> HB_HISTOGRAM_MAX_BITS) {
+        v = (1ULL << HB_HISTOGRAM_MAX_BITS) - 1;
+    }
+    int msb = 63 - __builtin_clzll(v);
+    int shift = msb - (HB_HISTOGRAM_SUB_BITS - 1);
+    return shift * SUB_HALF + (int)(v >> shift);
+}
+
+// Highest value that lands in bucket i
+static uint64_t bucket_value(int i) {
+    if (i < SUB_COUNT) {
+        return (uint64_t)i;
+    }
+    int shift = i / SUB_HALF - 1;
+    uint64_t low = (uint64_t)(SUB_HALF + i % SUB_HALF) << shift;
+    return low + (1ULL << shift) - 1;
+}
+
+void hb_histogram_init(struct hb_histogram *h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+void hb_histogram_record(struct hb_histogram *h, uint64_t ns) {
+    int i = bucket_index(ns);
+    // The fence keeps the field stores after the odd seq
+    STORE(h->seq, h->seq + 1);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    STORE(h->buckets[i], h->buckets[i] + 1);
+    STORE(h->count, h->count + 1);
+    STORE(h->sum, h->sum + ns);
+    if (ns < h->min) {
+        STORE(h->min, ns);
+    }
+    if (ns > h->max) {
+        STORE(h->max, ns);
+    }
+    __atomic_store_n(&h->seq, h->seq + 1, __ATOMIC_RELEASE);
+}
+
+// A copy takes a few microseconds; a recorder that never pauses that long
+// gets the last attempt, each counter whole but from different instants
+#define SNAPSHOT_TRIES 1000
+
+void hb_histogram_snapshot(struct hb_histogram *dst, const struct hb_histogram *src) {
+    for (int tries = 1;; tries++) {
+        uint64_t before = __atomic_load_n(&src->seq, __ATOMIC_ACQUIRE);
+        for (int i = 0; i < HB_HISTOGRAM_BUCKETS; i++) {
+            dst->buckets[i] = LOAD(src->buckets[i]);
+        }
+        dst->count = LOAD(src->count);
+        dst->sum = LOAD(src->sum);
+        dst->min = LOAD(src->min);
+        dst->max = LOAD(src->max);
+        // Keeps the field loads before the second seq load
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        uint64_t after = LOAD(src->seq);
+        if ((before == after && !(before & 1)) || tries == SNAPSHOT_TRIES) {
+            break;
+        }
+    }
+    dst->seq = 0;
+}
+
+void hb_histogram_merge(struct hb_histogram *dst, const struct hb_histogram *src) {
+    struct hb_histogram h;
+    hb_histogram_snapshot(&h, src);
+    for (int i = 0; i < HB_HISTOGRAM_BUCKETS; i++) {
+        dst->buckets[i] += h.buckets[i];
+    }
+    dst->count += h.count;
+    dst->sum += h.sum;
+    dst->min = h.min < dst->min ? h.min : dst->min;
+    dst->max = h.max > dst->max ? h.max : dst->max;
+}
+
+uint64_t hb_histogram_percentile(const struct hb_histogram *h, double q) {
+    // Total from the buckets, not count: a snapshot that gave up waiting
+    // may have one bumped but not yet the other
+    uint64_t total = 0;
+    for (int i = 0; i < HB_HISTOGRAM_BUCKETS; i++) {
+        total += h->buckets[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(q * total + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < HB_HISTOGRAM_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            uint64_t v = bucket_value(i);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+int hb_histogram_json(const struct hb_histogram *h, char *buf, size_t len) {
+    return snprintf(buf, len,
+                    "\"count\":%lu,\"total_ns\":%lu,\"mean_ns\":%.1f,\"min_ns\":%lu,"
+                    "\"p50_ns\":%lu,\"p90_ns\":%lu,\"p99_ns\":%lu,\"p999_ns\":%lu,\"max_ns\":%lu",
+                    h->count, h->sum, h->count ? (double)h->sum / h->count : 0.0,
+                    h->count ? h->min : 0, hb_histogram_percentile(h, 0.50),
+                    hb_histogram_percentile(h, 0.90), hb_histogram_percentile(h, 0.99),
+                    hb_histogram_percentile(h, 0.999), h->max);
+}
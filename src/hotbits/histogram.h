@@ -0,0 +1,44 @@
+#ifndef HOTBITS_HISTOGRAM_H
+#define HOTBITS_HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// HDR-style latency histogram in nanoseconds. Values below 2^7 are exact;
+// larger ones keep 7 significant bits (under 1% relative error) up to 2^41
+// ns (about 37 minutes), larger values are clamped.
+//
+// One thread records; others may copy or merge it concurrently. Every
+// field is stored and loaded with relaxed atomics, inside a sequence lock:
+// seq is odd while a record is in progress, and readers retry until they
+// have copied the whole histogram between two equal, even values of it,
+// so a copy is one consistent instant (count equals the bucket total).
+#define HB_HISTOGRAM_SUB_BITS 7
+#define HB_HISTOGRAM_MAX_BITS 41
+#define HB_HISTOGRAM_BUCKETS \
+    ((HB_HISTOGRAM_MAX_BITS - HB_HISTOGRAM_SUB_BITS + 2) << (HB_HISTOGRAM_SUB_BITS - 1))
+
+struct hb_histogram {
+    uint64_t seq;                // odd while hb_histogram_record runs
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;                // UINT64_MAX while empty
+    uint64_t max;
+    uint64_t buckets[HB_HISTOGRAM_BUCKETS];
+};
+
+void hb_histogram_init(struct hb_histogram *h);
+void hb_histogram_record(struct hb_histogram *h, uint64_t ns);
+// Consistent copy of src, which may be recorded into meanwhile
+void hb_histogram_snapshot(struct hb_histogram *dst, const struct hb_histogram *src);
+// Add a snapshot of src to dst
+void hb_histogram_merge(struct hb_histogram *dst, const struct hb_histogram *src);
+// Value at quantile q (0..1), reported as the top of its bucket
+uint64_t hb_histogram_percentile(const struct hb_histogram *h, double q);
+
+// "count":N,"total_ns":..,"mean_ns":..,"min_ns":..,"p50_ns":..,"p90_ns":..,
+// "p99_ns":..,"p999_ns":..,"max_ns":.. without braces, so callers can add
+// fields. Returns the length snprintf would have written.
+int hb_histogram_json(const struct hb_histogram *h, char *buf, size_t len);
+
+#endif
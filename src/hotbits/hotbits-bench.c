@@ -0,0 +1,886 @@
+// hotbits-bench - microbenchmarks for the extraction kernels
+//
+// Times every kernel on the first N values of two inputs, a synthetic
+// exponential delta stream and real events (test-data.txt, repeated to
+// fill sizes beyond the file), for N = 1e3, 1e4, ... up to --max-size, and
+// reports nanoseconds per element and input bytes per second. Kernels:
+//
+//   parse.*      the C tools' fgets/strtoull loop, hb_parse_deltas and
+//                packed (.hbc) block decoding
+//   filter.*     filter's apply_dead_time and apply_window
+//   extract.*    the four rng-extractor methods
+//   debias.*     Peres and XOR whitening as in the _hotbits extension
+//   pipeline.*   the native pipeline per method, with and without Von
+//                Neumann debiasing
+//   quick.*, monitor.push, progressive.update, hash.xxh64
+//
+// A measurement is the fastest of the runs made after one warm-up run,
+// repeated until they add up to --min-time. --json writes the results;
+// --compare reads a file written that way and reports the change for each
+// kernel, input and size, exiting 1 if any is slower than --threshold
+// allows.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <math.h>
+
+#include "codec.h"
+#include "cpu.h"
+#include "events.h"
+#include "hash.h"
+#include "monitor.h"
+#include "pipeline.h"
+#include "progressive.h"
+#include "quicktest.h"
+#include "timing.h"
+
+#define MAX_SIZES 16
+#define MAX_RUNS 1000000
+#define MAX_BASELINE 4096
+#define SYNTHETIC_MEAN_NS 1e6       // 1000 events/s
+#define WHITENING_BLOCK 16          // _hotbits.xor_whitening default
+
+// src/testing/filter.c and rng-extractor.c, linked with their main renamed
+uint64_t *apply_dead_time(uint64_t *timestamps, size_t count, uint64_t dead_time, size_t *new_count);
+uint64_t *apply_window(uint64_t *timestamps, size_t count, uint64_t window_size,
+                       int mode, size_t *new_count);
+void von_neumann_extract(uint8_t *input, size_t input_len, uint8_t *output, size_t *output_len);
+void interval_compare(uint64_t *intervals, size_t count, uint8_t *output, size_t *output_len);
+void xor_fold(uint64_t *timestamps, size_t count, uint8_t *output, size_t *output_len);
+void extract_lsbs(uint64_t *values, size_t count, int bit_pos, uint8_t *output, size_t *output_len);
+
+typedef struct {
+    double min_size;
+    double max_size;
+    double min_time;
+    const char *kernels;        // comma-separated name prefixes, NULL = all
+    const char *inputs;         // synthetic, real or all
+    const char *data_path;
+    const char *json_path;
+    const char *compare_path;
+    double threshold;
+    uint64_t seed;
+} Config;
+
+static Config config = {
+    .min_size = 1e3,
+    .max_size = 1e8,
+    .min_time = 0.2,
+    .kernels = NULL,
+    .inputs = "all",
+    .data_path = "src/analysis/test-data.txt",
+    .json_path = NULL,
+    .compare_path = NULL,
+    .threshold = 0.10,
+    .seed = 1
+};
+
+// What a kernel's elements are; the text kernels run first so the text
+// can be freed before the other inputs are built
+enum {
+    INPUT_TEXT,                 // lines of decimal deltas
+    INPUT_DELTAS,               // uint64 deltas
+    INPUT_TIMESTAMPS,           // uint64 running sums of the deltas
+    INPUT_BITS,                 // delta LSBs, one per byte
+    INPUT_BYTES                 // delta low bytes
+};
+
+struct bench {
+    const char *name;
+    size_t count;
+    uint64_t *deltas;
+    uint64_t *timestamps;
+    uint8_t *bits;
+    uint8_t *bytes;
+    char *text;
+    size_t text_len[MAX_SIZES]; // bytes holding the first sizes[i] lines
+    uint64_t dead_time_ns;      // half the mean delta
+    uint64_t window_ns;         // four times the mean delta
+    uint64_t *scratch;          // count values of output room
+    uint8_t *packed;            // parse.packed input, block_count blocks
+    size_t *block_off;
+    size_t block_count;
+    struct hb_buffer out;
+    struct hb_monitor monitor;
+    struct hb_progressive progressive;
+};
+
+struct kernel {
+    const char *name;
+    int input;
+    // Returns the input bytes consumed
+    size_t (*run)(struct bench *b, const struct kernel *k, size_t n);
+    // Optional: build the input for size n, and free it after the last size
+    int (*prepare)(struct bench *b, size_t n);
+    void (*release)(struct bench *b);
+    int arg;                    // method, window mode or bit position
+    int debias;
+};
+
+struct result {
+    char kernel[64];
+    char input[16];
+    size_t size;
+    int runs;
+    double ns_per_element;
+    double bytes_per_second;
+};
+
+static size_t sizes[MAX_SIZES];
+static int size_count;
+static struct result *results;
+static size_t result_count;
+static volatile uint64_t sink;  // keeps outputs live
+
+static size_t text_bytes(const struct bench *b, size_t n) {
+    for (int i = 0; i < size_count; i++) {
+        if (sizes[i] == n) {
+            return b->text_len[i];
+        }
+    }
+    return 0;
+}
+
+// The loop filter and rng-extractor read stdin with
+static size_t run_parse_strtoull(struct bench *b, const struct kernel *k, size_t n) {
+    (void)k;
+    size_t len = text_bytes(b, n);
+    FILE *f = fmemopen(b->text, len, "r");
+    if (!f) {
+        return 0;
+    }
+    char line[100];
+    size_t count = 0;
+    while (fgets(line, sizeof(line), f)) {
+        b->scratch[count] = strtoull(line, NULL, 10);
+        if (b->scratch[count] > 0 || line[0] == '0') {
+            count++;
+        }
+    }
+    fclose(f);
+    sink += count;
+    return len;
+}
+
+static size_t run_parse_native(struct bench *b, const struct kernel *k, size_t n) {
+    (void)k;
+    size_t len = text_bytes(b, n), consumed;
+    sink += hb_parse_deltas(b->text, len, b->scratch, n, &consumed);
+    return len;
+}
+
+// Encode the first n deltas in default-sized blocks
+static int pack_deltas(struct bench *b, size_t n) {
+    size_t blocks = (n + HB_CODEC_BLOCK_DEFAULT - 1) / HB_CODEC_BLOCK_DEFAULT;
+    size_t cap = hb_codec_block_bound(HB_CODEC_BLOCK_DEFAULT) * blocks;
+    free(b->packed);
+    free(b->block_off);
+    b->packed = malloc(cap);
+    b->block_off = malloc((blocks + 1) * sizeof(size_t));
+    if (!b->packed || !b->block_off) {
+        fprintf(stderr, "Out of memory packing %zu deltas\n", n);
+        return -1;
+    }
+    size_t off = 0;
+    for (size_t i = 0; i < blocks; i++) {
+        size_t first = i * HB_CODEC_BLOCK_DEFAULT;
+        size_t count = n - first < HB_CODEC_BLOCK_DEFAULT ? n - first : HB_CODEC_BLOCK_DEFAULT;
+        b->block_off[i] = off;
+        off += hb_codec_encode_block(b->deltas + first, count, b->packed + off);
+    }
+    b->block_off[blocks] = off;
+    b->block_count = blocks;
+    return 0;
+}
+
+static void unpack_release(struct bench *b) {
+    free(b->packed);
+    free(b->block_off);
+    b->packed = NULL;
+    b->block_off = NULL;
+}
+
+static size_t run_parse_packed(struct bench *b, const struct kernel *k, size_t n) {
+    (void)k;
+    (void)n;
+    size_t count = 0;
+    for (size_t i = 0; i < b->block_count; i++) {
+        long got = hb_codec_decode_block(b->packed + b->block_off[i],
+                                         b->block_off[i + 1] - b->block_off[i], b->scratch + count);
+        if (got < 0) {
+            break;
+        }
+        count += got;
+    }
+    sink += count;
+    return b->block_off[b->block_count];
+}
+
+static size_t run_dead_time(struct bench *b, const struct kernel *k, size_t n) {
+    (void)k;
+    size_t kept;
+    uint64_t *out = apply_dead_time(b->timestamps, n, b->dead_time_ns, &kept);
+    sink += kept;
+    free(out);
+    return n * sizeof(uint64_t);
+}
+
+static size_t run_window(struct bench *b, const struct kernel *k, size_t n) {
+    size_t kept;
+    uint64_t *out = apply_window(b->timestamps, n, b->window_ns, k->arg, &kept);
+    sink += kept;
+    free(out);
+    return n * sizeof(uint64_t);
+}
+
+static size_t run_extract(struct bench *b, const struct kernel *k, size_t n) {
+    uint8_t *out = (uint8_t *)b->scratch;
+    size_t len = 0;
+    switch (k->arg) {
+        case HB_METHOD_INTERVAL:
+            interval_compare(b->deltas, n, out, &len);
+            break;
+        case HB_METHOD_VON_NEUMANN:
+            von_neumann_extract(b->bits, n, out, &len);
+            break;
+        case HB_METHOD_XOR_FOLD:
+            xor_fold(b->deltas, n, out, &len);
+            break;
+        case HB_METHOD_LSB:
+            extract_lsbs(b->deltas, n, 0, out, &len);
+            break;
+    }
+    sink += len;
+    return k->arg == HB_METHOD_VON_NEUMANN ? n : n * sizeof(uint64_t);
+}
+
+// _hotbits.peres: after an equal pair, the first bit of the next unequal
+// pair is emitted and that pair skipped
+static size_t run_peres(struct bench *b, const struct kernel *k, size_t n) {
+    (void)k;
+    const uint8_t *in = b->bits;
+    uint8_t *out = (uint8_t *)b->scratch;
+    size_t used = 0, i = 0;
+    while (i + 1 < n) {
+        if (in[i] != in[i + 1]) {
+            out[used++] = in[i];
+            i += 2;
+            continue;
+        }
+        size_t j = i + 2;
+        while (j + 1 < n && in[j] == in[j + 1]) {
+            j += 2;
+        }
+        if (j + 1 < n) {
+            out[used++] = in[j];
+        }
+        i = j + 2;
+    }
+    sink += used;
+    return n;
+}
+
+// _hotbits.xor_whitening: blocks overlapping by half are XORed and the
+// middle half of each result kept
+static size_t run_xor_whitening(struct bench *b, const struct kernel *k, size_t n) {
+    (void)k;
+    const uint8_t *in = b->bits;
+    uint8_t *out = (uint8_t *)b->scratch;
+    size_t bs = WHITENING_BLOCK, step = bs / 2;
+    size_t used = 0;
+    for (size_t i = 0; i + step + bs <= n; i += step) {
+        for (size_t j = bs / 4; j < 3 * bs / 4; j++) {
+            out[used++] = in[i + j] ^ in[i + step + j];
+        }
+    }
+    sink += used;
+    return n;
+}
+
+static size_t run_pipeline(struct bench *b, const struct kernel *k, size_t n) {
+    struct hb_pipeline_config cfg;
+    hb_pipeline_config_default(&cfg);
+    cfg.method = k->arg;
+    cfg.debias = k->debias;
+    cfg.bit_pos = 0;
+
+    struct hb_pipeline p;
+    if (hb_pipeline_init(&p, &cfg) < 0) {
+        return 0;
+    }
+    b->out.len = 0;
+    if (hb_pipeline_push(&p, b->deltas, n, &b->out) == 0) {
+        hb_pipeline_finish(&p, &b->out);
+    }
+    hb_pipeline_free(&p);
+    sink += b->out.len;
+    return n * sizeof(uint64_t);
+}
+
+static size_t run_quick_update(struct bench *b, const struct kernel *k, size_t n) {
+    (void)k;
+    struct hb_quick_sums s;
+    memset(&s, 0, sizeof(s));
+    hb_quick_update(&s, b->bytes, n);
+    sink += s.ones;
+    return n;
+}
+
+static size_t run_quick_tests(struct bench *b, const struct kernel *k, size_t n) {
+    (void)k;
+    struct hb_test_result r[HB_QUICK_TESTS];
+    hb_quick_tests(b->bytes, n, r);
+    sink += r[0].p_value > 0.5;
+    return n;
+}
+
+// The monitor and progressive state carry over between runs, as in a
+// long-running stream
+static size_t run_monitor(struct bench *b, const struct kernel *k, size_t n) {
+    (void)k;
+    hb_monitor_push(&b->monitor, b->bytes, n);
+    sink += b->monitor.pushed;
+    return n;
+}
+
+static size_t run_progressive(struct bench *b, const struct kernel *k, size_t n) {
+    (void)k;
+    hb_progressive_update(&b->progressive, b->bytes, n);
+    sink += b->progressive.longest;
+    return n;
+}
+
+static size_t run_hash(struct bench *b, const struct kernel *k, size_t n) {
+    (void)k;
+    sink += hb_hash64(b->bytes, n, 0);
+    return n;
+}
+
+static const struct kernel kernels[] = {
+    {"parse.strtoull",       INPUT_TEXT,       run_parse_strtoull, NULL,        NULL,           0, 0},
+    {"parse.native",         INPUT_TEXT,       run_parse_native,   NULL,        NULL,           0, 0},
+    {"parse.packed",         INPUT_DELTAS,     run_parse_packed,   pack_deltas, unpack_release, 0, 0},
+    {"filter.dead_time",     INPUT_TIMESTAMPS, run_dead_time,      NULL,        NULL,           0, 0},
+    {"filter.window_first",  INPUT_TIMESTAMPS, run_window,         NULL,        NULL,           0, 0},
+    {"filter.window_last",   INPUT_TIMESTAMPS, run_window,         NULL,        NULL,           1, 0},
+    {"filter.window_mean",   INPUT_TIMESTAMPS, run_window,         NULL,        NULL,           2, 0},
+    {"extract.interval",     INPUT_DELTAS,     run_extract,        NULL,        NULL,           HB_METHOD_INTERVAL, 0},
+    {"extract.von_neumann",  INPUT_BITS,       run_extract,        NULL,        NULL,           HB_METHOD_VON_NEUMANN, 0},
+    {"extract.xor_fold",     INPUT_DELTAS,     run_extract,        NULL,        NULL,           HB_METHOD_XOR_FOLD, 0},
+    {"extract.lsb",          INPUT_DELTAS,     run_extract,        NULL,        NULL,           HB_METHOD_LSB, 0},
+    {"debias.peres",         INPUT_BITS,       run_peres,          NULL,        NULL,           0, 0},
+    {"debias.xor_whitening", INPUT_BITS,       run_xor_whitening,  NULL,        NULL,           0, 0},
+    {"pipeline.interval",    INPUT_DELTAS,     run_pipeline,       NULL,        NULL,           HB_METHOD_INTERVAL, HB_DEBIAS_NONE},
+    {"pipeline.interval+vn", INPUT_DELTAS,     run_pipeline,       NULL,        NULL,           HB_METHOD_INTERVAL, HB_DEBIAS_VON_NEUMANN},
+    {"pipeline.von_neumann", INPUT_DELTAS,     run_pipeline,       NULL,        NULL,           HB_METHOD_VON_NEUMANN, HB_DEBIAS_NONE},
+    {"pipeline.xor_fold",    INPUT_DELTAS,     run_pipeline,       NULL,        NULL,           HB_METHOD_XOR_FOLD, HB_DEBIAS_NONE},
+    {"pipeline.xor_fold+vn", INPUT_DELTAS,     run_pipeline,       NULL,        NULL,           HB_METHOD_XOR_FOLD, HB_DEBIAS_VON_NEUMANN},
+    {"pipeline.lsb",         INPUT_DELTAS,     run_pipeline,       NULL,        NULL,           HB_METHOD_LSB, HB_DEBIAS_NONE},
+    {"pipeline.lsb+vn",      INPUT_DELTAS,     run_pipeline,       NULL,        NULL,           HB_METHOD_LSB, HB_DEBIAS_VON_NEUMANN},
+    {"pipeline.adaptive",    INPUT_DELTAS,     run_pipeline,       NULL,        NULL,           HB_METHOD_ADAPTIVE, HB_DEBIAS_NONE},
+    {"pipeline.adaptive+vn", INPUT_DELTAS,     run_pipeline,       NULL,        NULL,           HB_METHOD_ADAPTIVE, HB_DEBIAS_VON_NEUMANN},
+    {"pipeline.ordinal",     INPUT_DELTAS,     run_pipeline,       NULL,        NULL,           HB_METHOD_ORDINAL, HB_DEBIAS_NONE},
+    {"pipeline.quantile",    INPUT_DELTAS,     run_pipeline,       NULL,        NULL,           HB_METHOD_QUANTILE, HB_DEBIAS_NONE},
+    {"pipeline.phase",       INPUT_DELTAS,     run_pipeline,       NULL,        NULL,           HB_METHOD_PHASE, HB_DEBIAS_NONE},
+    {"quick.update",         INPUT_BYTES,      run_quick_update,   NULL,        NULL,           0, 0},
+    {"quick.tests",          INPUT_BYTES,      run_quick_tests,    NULL,        NULL,           0, 0},
+    {"monitor.push",         INPUT_BYTES,      run_monitor,        NULL,        NULL,           0, 0},
+    {"progressive.update",   INPUT_BYTES,      run_progressive,    NULL,        NULL,           0, 0},
+    {"hash.xxh64",           INPUT_BYTES,      run_hash,           NULL,        NULL,           0, 0},
+};
+#define KERNEL_COUNT (sizeof(kernels) / sizeof(kernels[0]))
+
+void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [OPTIONS]\n", prog);
+    fprintf(stderr, "Times the extraction kernels at sizes from --min-size to --max-size in steps\n");
+    fprintf(stderr, "of ten, on synthetic exponential deltas and on real events.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -n, --min-size N           Smallest size in elements (default: 1e3)\n");
+    fprintf(stderr, "  -N, --max-size N           Largest size in elements (default: 1e8)\n");
+    fprintf(stderr, "  -t, --min-time SECONDS     Time spent per kernel and size (default: 0.2)\n");
+    fprintf(stderr, "  -k, --kernels LIST         Comma-separated kernel name prefixes (default: all)\n");
+    fprintf(stderr, "  -i, --input NAME           synthetic, real or all (default: all)\n");
+    fprintf(stderr, "  -d, --data PATH            Real events (default: src/analysis/test-data.txt)\n");
+    fprintf(stderr, "  -o, --json PATH            Write the results as JSON\n");
+    fprintf(stderr, "  -c, --compare PATH         Compare with results saved by --json\n");
+    fprintf(stderr, "      --threshold FRACTION   Slowdown that fails --compare (default: 0.10)\n");
+    fprintf(stderr, "      --seed N               Synthetic input seed (default: 1)\n");
+    fprintf(stderr, "      --isa NAME             Run the kernels for this instruction set instead of\n");
+    fprintf(stderr, "                             the best the CPU supports (also HOTBITS_ISA)\n");
+    fprintf(stderr, "  -l, --list                 List the kernels and exit\n");
+    fprintf(stderr, "  -?, --help                 Show this help message\n");
+}
+
+int parse_arguments(int argc, char *argv[]) {
+    enum { OPT_THRESHOLD = 256, OPT_SEED, OPT_ISA };
+    static struct option long_options[] = {
+        {"min-size",  required_argument, 0, 'n'},
+        {"max-size",  required_argument, 0, 'N'},
+        {"min-time",  required_argument, 0, 't'},
+        {"kernels",   required_argument, 0, 'k'},
+        {"input",     required_argument, 0, 'i'},
+        {"data",      required_argument, 0, 'd'},
+        {"json",      required_argument, 0, 'o'},
+        {"compare",   required_argument, 0, 'c'},
+        {"threshold", required_argument, 0, OPT_THRESHOLD},
+        {"seed",      required_argument, 0, OPT_SEED},
+        {"isa",       required_argument, 0, OPT_ISA},
+        {"list",      no_argument,       0, 'l'},
+        {"help",      no_argument,       0, '?'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "n:N:t:k:i:d:o:c:l?", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'n':
+                config.min_size = atof(optarg);
+                break;
+            case 'N':
+                config.max_size = atof(optarg);
+                break;
+            case 't':
+                config.min_time = atof(optarg);
+                break;
+            case 'k':
+                config.kernels = optarg;
+                break;
+            case 'i':
+                config.inputs = optarg;
+                break;
+            case 'd':
+                config.data_path = optarg;
+                break;
+            case 'o':
+                config.json_path = optarg;
+                break;
+            case 'c':
+                config.compare_path = optarg;
+                break;
+            case OPT_THRESHOLD:
+                config.threshold = atof(optarg);
+                break;
+            case OPT_SEED:
+                config.seed = strtoull(optarg, NULL, 10);
+                break;
+            case OPT_ISA:
+                if (hb_cpu_force(optarg) < 0) {
+                    return -1;
+                }
+                break;
+            case 'l':
+                for (size_t i = 0; i < KERNEL_COUNT; i++) {
+                    printf("%s\n", kernels[i].name);
+                }
+                exit(0);
+            case '?':
+                print_usage(argv[0]);
+                exit(0);
+            default:
+                print_usage(argv[0]);
+                return -1;
+        }
+    }
+
+    if (strcmp(config.inputs, "synthetic") != 0 && strcmp(config.inputs, "real") != 0 &&
+        strcmp(config.inputs, "all") != 0) {
+        fprintf(stderr, "Unknown input: %s\n", config.inputs);
+        return -1;
+    }
+    if (config.min_size < 1 || config.max_size < config.min_size) {
+        fprintf(stderr, "Invalid size range\n");
+        return -1;
+    }
+    for (double s = config.min_size; s <= config.max_size * 1.000001; s *= 10) {
+        if (size_count == MAX_SIZES) {
+            fprintf(stderr, "Too many sizes\n");
+            return -1;
+        }
+        sizes[size_count++] = (size_t)(s + 0.5);
+    }
+    return 0;
+}
+
+static int kernel_selected(const struct kernel *k) {
+    if (!config.kernels) {
+        return 1;
+    }
+    const char *p = config.kernels;
+    while (*p) {
+        size_t len = strcspn(p, ",");
+        if (len > 0 && strncmp(k->name, p, len) == 0) {
+            return 1;
+        }
+        p += len + (p[len] == ',');
+    }
+    return 0;
+}
+
+// xorshift64*
+static uint64_t next_random(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+// Exponential deltas, as from a Poisson source
+static int build_synthetic(struct bench *b, size_t count) {
+    b->deltas = malloc(count * sizeof(uint64_t));
+    if (!b->deltas) {
+        fprintf(stderr, "Out of memory for %zu deltas\n", count);
+        return -1;
+    }
+    uint64_t state = config.seed * 0x9E3779B97F4A7C15ULL + 1;
+    for (size_t i = 0; i < count; i++) {
+        double u = ((next_random(&state) >> 11) + 0.5) / 9007199254740992.0;
+        b->deltas[i] = (uint64_t)(-log(u) * SYNTHETIC_MEAN_NS) + 1;
+    }
+    b->count = count;
+    return 0;
+}
+
+// The file's deltas, repeated up to count
+static int build_real(struct bench *b, size_t count) {
+    struct hb_events ev;
+    hb_events_init(&ev);
+    if (hb_events_load_file(&ev, config.data_path) < 0) {
+        hb_events_free(&ev);
+        return -1;
+    }
+    if (ev.count == 0) {
+        fprintf(stderr, "%s: no events\n", config.data_path);
+        hb_events_free(&ev);
+        return -1;
+    }
+    b->deltas = malloc(count * sizeof(uint64_t));
+    if (!b->deltas) {
+        fprintf(stderr, "Out of memory for %zu deltas\n", count);
+        hb_events_free(&ev);
+        return -1;
+    }
+    for (size_t i = 0; i < count; i += ev.count) {
+        size_t n = count - i < ev.count ? count - i : ev.count;
+        memcpy(b->deltas + i, ev.values, n * sizeof(uint64_t));
+    }
+    b->count = count;
+    hb_events_free(&ev);
+    return 0;
+}
+
+static size_t format_delta(char *out, uint64_t v) {
+    char digits[20];
+    size_t n = 0;
+    do {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    for (size_t i = 0; i < n; i++) {
+        out[i] = digits[n - 1 - i];
+    }
+    out[n] = '\n';
+    return n + 1;
+}
+
+static int build_text(struct bench *b) {
+    b->text = malloc(b->count * 21);
+    if (!b->text) {
+        fprintf(stderr, "Out of memory for %zu lines\n", b->count);
+        return -1;
+    }
+    size_t len = 0;
+    int next = 0;
+    for (size_t i = 0; i < b->count; i++) {
+        len += format_delta(b->text + len, b->deltas[i]);
+        while (next < size_count && sizes[next] == i + 1) {
+            b->text_len[next++] = len;
+        }
+    }
+    return 0;
+}
+
+static int build_derived(struct bench *b) {
+    b->timestamps = malloc(b->count * sizeof(uint64_t));
+    b->bits = malloc(b->count);
+    b->bytes = malloc(b->count);
+    if (!b->timestamps || !b->bits || !b->bytes) {
+        fprintf(stderr, "Out of memory for %zu values\n", b->count);
+        return -1;
+    }
+    uint64_t now = 0;
+    for (size_t i = 0; i < b->count; i++) {
+        now += b->deltas[i];
+        b->timestamps[i] = now;
+        b->bits[i] = b->deltas[i] & 1;
+        b->bytes[i] = (uint8_t)b->deltas[i];
+    }
+    uint64_t mean = now / b->count;
+    b->dead_time_ns = mean / 2;
+    b->window_ns = mean > 0 ? mean * 4 : 1;
+    return 0;
+}
+
+static void bench_free(struct bench *b) {
+    free(b->deltas);
+    free(b->timestamps);
+    free(b->bits);
+    free(b->bytes);
+    free(b->text);
+    free(b->scratch);
+    hb_buffer_free(&b->out);
+    hb_monitor_free(&b->monitor);
+    hb_progressive_free(&b->progressive);
+}
+
+static int add_result(const struct result *r) {
+    static size_t cap;
+    if (result_count == cap) {
+        size_t n = cap ? cap * 2 : 256;
+        struct result *grown = realloc(results, n * sizeof(*grown));
+        if (!grown) {
+            fprintf(stderr, "Out of memory\n");
+            return -1;
+        }
+        results = grown;
+        cap = n;
+    }
+    results[result_count++] = *r;
+    return 0;
+}
+
+static int measure(struct bench *b, const struct kernel *k) {
+    for (int s = 0; s < size_count; s++) {
+        size_t n = sizes[s];
+        if (k->prepare && k->prepare(b, n) < 0) {
+            return -1;
+        }
+
+        // Warm-up: faults in the output buffers
+        k->run(b, k, n);
+        double best = INFINITY, total = 0;
+        size_t bytes = 0;
+        int runs = 0;
+        while (runs < MAX_RUNS && (runs == 0 || total < config.min_time)) {
+            uint64_t start = hb_monotonic_ns();
+            bytes = k->run(b, k, n);
+            double elapsed = (hb_monotonic_ns() - start) / 1e9;
+            total += elapsed;
+            best = elapsed < best ? elapsed : best;
+            runs++;
+        }
+        best = best > 0 ? best : 1e-9;
+
+        struct result r;
+        snprintf(r.kernel, sizeof(r.kernel), "%s", k->name);
+        snprintf(r.input, sizeof(r.input), "%s", b->name);
+        r.size = n;
+        r.runs = runs;
+        r.ns_per_element = best * 1e9 / n;
+        r.bytes_per_second = bytes / best;
+        printf("%-22s %-10s %10zu %12.3f %12.1f %8d\n", r.kernel, r.input, r.size,
+               r.ns_per_element, r.bytes_per_second / 1e6, r.runs);
+        fflush(stdout);
+        if (add_result(&r) < 0) {
+            return -1;
+        }
+    }
+    if (k->release) {
+        k->release(b);
+    }
+    return 0;
+}
+
+static int run_input(const char *name) {
+    size_t count = sizes[size_count - 1];
+    struct bench *b = calloc(1, sizeof(*b));
+    if (!b) {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+    b->name = name;
+    hb_buffer_init(&b->out);
+    uint64_t window_bits[] = {1 << 16, 1 << 20};
+    if (hb_monitor_init(&b->monitor, window_bits, 2) < 0 ||
+        hb_progressive_init(&b->progressive) < 0) {
+        fprintf(stderr, "Out of memory\n");
+        bench_free(b);
+        free(b);
+        return -1;
+    }
+    int rv = strcmp(name, "real") == 0 ? build_real(b, count) : build_synthetic(b, count);
+    if (rv == 0) {
+        b->scratch = malloc(count * sizeof(uint64_t));
+        if (!b->scratch) {
+            fprintf(stderr, "Out of memory for %zu values\n", count);
+            rv = -1;
+        }
+    }
+
+    // Text kernels first, then the text makes room for the other inputs
+    int need_text = 0;
+    for (size_t i = 0; i < KERNEL_COUNT; i++) {
+        need_text |= kernels[i].input == INPUT_TEXT && kernel_selected(&kernels[i]);
+    }
+    if (rv == 0 && need_text) {
+        rv = build_text(b);
+        for (size_t i = 0; i < KERNEL_COUNT && rv == 0; i++) {
+            if (kernels[i].input == INPUT_TEXT && kernel_selected(&kernels[i])) {
+                rv = measure(b, &kernels[i]);
+            }
+        }
+        free(b->text);
+        b->text = NULL;
+    }
+    if (rv == 0) {
+        rv = build_derived(b);
+    }
+    for (size_t i = 0; i < KERNEL_COUNT && rv == 0; i++) {
+        if (kernels[i].input != INPUT_TEXT && kernel_selected(&kernels[i])) {
+            rv = measure(b, &kernels[i]);
+        }
+    }
+
+    bench_free(b);
+    free(b);
+    return rv;
+}
+
+static int write_json(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    fprintf(f, "{\n  \"isa\": \"%s\",\n  \"min_time_s\": %g,\n  \"results\": [\n",
+            hb_isa_name(hb_cpu_level()), config.min_time);
+    for (size_t i = 0; i < result_count; i++) {
+        const struct result *r = &results[i];
+        fprintf(f, "    {\"kernel\": \"%s\", \"input\": \"%s\", \"size\": %zu, \"runs\": %d, "
+                "\"ns_per_element\": %.6g, \"bytes_per_second\": %.6g}%s\n",
+                r->kernel, r->input, r->size, r->runs, r->ns_per_element, r->bytes_per_second,
+                i + 1 < result_count ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    if (fclose(f) != 0) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+// Reads the one-result-per-line layout write_json produces
+static int load_baseline(const char *path, struct result *base, size_t *count, char *isa, size_t isa_len) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    char line[512];
+    *count = 0;
+    snprintf(isa, isa_len, "unknown");
+    while (fgets(line, sizeof(line), f)) {
+        char name[32];
+        if (sscanf(line, " \"isa\": \"%31[^\"]\"", name) == 1) {
+            snprintf(isa, isa_len, "%s", name);
+            continue;
+        }
+        struct result r;
+        if (sscanf(line, " {\"kernel\": \"%63[^\"]\", \"input\": \"%15[^\"]\", \"size\": %zu, "
+                   "\"runs\": %d, \"ns_per_element\": %lf",
+                   r.kernel, r.input, &r.size, &r.runs, &r.ns_per_element) != 5) {
+            continue;
+        }
+        if (*count == MAX_BASELINE) {
+            fprintf(stderr, "%s: more than %d results\n", path, MAX_BASELINE);
+            break;
+        }
+        base[(*count)++] = r;
+    }
+    fclose(f);
+    if (*count == 0) {
+        fprintf(stderr, "%s: no results\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+// Returns the number of results slower than the threshold allows
+static int compare(const struct result *base, size_t base_count, const char *base_isa) {
+    const char *isa = hb_isa_name(hb_cpu_level());
+    printf("\n# Against %s", config.compare_path);
+    if (strcmp(base_isa, isa) != 0) {
+        printf(" (kernels %s there, %s here)", base_isa, isa);
+    }
+    printf("\n%-22s %-10s %10s %12s %12s %8s\n", "kernel", "input", "size", "base ns/el",
+           "ns/el", "change");
+    int slower = 0, matched = 0;
+    for (size_t i = 0; i < result_count; i++) {
+        const struct result *r = &results[i];
+        for (size_t j = 0; j < base_count; j++) {
+            const struct result *b = &base[j];
+            if (b->size != r->size || strcmp(b->kernel, r->kernel) != 0 ||
+                strcmp(b->input, r->input) != 0 || b->ns_per_element <= 0) {
+                continue;
+            }
+            double change = r->ns_per_element / b->ns_per_element - 1;
+            int flag = change > config.threshold;
+            printf("%-22s %-10s %10zu %12.3f %12.3f %+7.1f%%%s\n", r->kernel, r->input, r->size,
+                   b->ns_per_element, r->ns_per_element, change * 100, flag ? "  SLOWER" : "");
+            slower += flag;
+            matched++;
+            break;
+        }
+    }
+    printf("# %d of %d slower by more than %.0f%%\n", slower, matched, config.threshold * 100);
+    return slower;
+}
+
+int main(int argc, char *argv[]) {
+    if (parse_arguments(argc, argv) < 0) {
+        return 1;
+    }
+
+    // Read the baseline first so a bad path fails before the long run
+    struct result *base = NULL;
+    size_t base_count = 0;
+    char base_isa[32];
+    if (config.compare_path) {
+        base = malloc(MAX_BASELINE * sizeof(*base));
+        if (!base || load_baseline(config.compare_path, base, &base_count,
+                                   base_isa, sizeof(base_isa)) < 0) {
+            free(base);
+            return 1;
+        }
+    }
+
+    printf("# Kernels: %s (best supported: %s)\n", hb_isa_name(hb_cpu_level()),
+           hb_isa_name(hb_cpu_best()));
+    printf("%-22s %-10s %10s %12s %12s %8s\n", "kernel", "input", "size", "ns/element",
+           "MB/s", "runs");
+
+    int rv = 0;
+    if (strcmp(config.inputs, "real") != 0) {
+        rv = run_input("synthetic");
+    }
+    if (rv == 0 && strcmp(config.inputs, "synthetic") != 0 && run_input("real") < 0) {
+        // A missing data file only loses the real rows
+        if (strcmp(config.inputs, "real") == 0) {
+            rv = -1;
+        }
+    }
+
+    if (rv == 0 && config.json_path && write_json(config.json_path) < 0) {
+        rv = -1;
+    }
+    int slower = 0;
+    if (rv == 0 && base) {
+        slower = compare(base, base_count, base_isa);
+    }
+
+    free(base);
+    free(results);
+    return rv < 0 ? 1 : slower > 0;
+}
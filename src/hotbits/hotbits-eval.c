@@ -0,0 +1,784 @@
+// hotbits-eval - native evaluation orchestrator
+//
+// Replaces the timeout-driven stages of scripts/hot.sh: the selected event
+// range is read once through the segment indexes, extraction runs in-process, and every requested
+// test battery is scheduled on a thread pool. Each battery runs to
+// completion, so results no longer depend on which stage was killed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "archive.h"
+#include "events.h"
+#include "pipeline.h"
+#include "quicktest.h"
+#include "pool.h"
+#include "timing.h"
+
+#define DEFAULT_TESTS "quick,python,nist,dieharder"
+#define DEFAULT_MIN_BYTES 125000
+#define DEFAULT_EXTRACT_LIMIT 100000
+#define DEFAULT_DIEHARDER_TESTS "0,1,2,3,4,5"
+#define MAX_STAGES 64
+#define MAX_ARGS 16
+
+typedef struct {
+    const char *data_dir;
+    const char *output_dir;
+    const char *project_dir;
+    char run_id[64];
+    long long start_index;
+    long long sample_count;
+    long long extract_limit;
+    long long min_bytes;
+    int threads;
+    int run_quick;
+    int run_python;
+    int run_nist;
+    int run_dieharder;
+    const char *dieharder_tests;
+    struct hb_pipeline_config pipeline;
+} Config;
+
+typedef struct {
+    char name[64];              // key under "stages" in results.json
+    char *argv[MAX_ARGS];       // NULL argv[0] means in-process
+    char stdin_path[PATH_MAX];
+    char output_path[PATH_MAX];
+    char cwd[PATH_MAX];
+    char status[32];
+    struct hb_stage_time time;
+} Stage;
+
+static Config config = {
+    .data_dir = NULL,
+    .output_dir = NULL,
+    .project_dir = NULL,
+    .start_index = 0,
+    .sample_count = 0,
+    .extract_limit = DEFAULT_EXTRACT_LIMIT,
+    .min_bytes = DEFAULT_MIN_BYTES,
+    .threads = 0,
+    .dieharder_tests = DEFAULT_DIEHARDER_TESTS
+};
+
+static Stage stages[MAX_STAGES];
+static int stage_count = 0;
+
+static struct hb_buffer binary;
+static struct hb_test_result quick_results[HB_QUICK_TESTS];
+
+void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [OPTIONS]\n", prog);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -d, --data-dir DIR         Directory with events-*.txt files (default: ./data)\n");
+    fprintf(stderr, "  -o, --output-dir DIR       Results directory (default: ./complete)\n");
+    fprintf(stderr, "  -s, --start-index N        First line to use (1-based, negative counts from end)\n");
+    fprintf(stderr, "  -c, --sample-count N       Number of lines to use (0 = all)\n");
+    fprintf(stderr, "  -t, --tests TESTS          Comma-separated: quick, python, nist, dieharder, all, none\n");
+    fprintf(stderr, "                             (default: %s)\n", DEFAULT_TESTS);
+    fprintf(stderr, "  -j, --threads N            Worker threads (default: online CPUs)\n");
+    fprintf(stderr, "      --extract-limit N      Max events fed to extraction (default: %d, 0 = all)\n",
+            DEFAULT_EXTRACT_LIMIT);
+    fprintf(stderr, "      --min-bytes N          Bytes required for NIST/Dieharder (default: %d)\n",
+            DEFAULT_MIN_BYTES);
+    fprintf(stderr, "      --run-id ID            Custom run ID (default: timestamp)\n");
+    fprintf(stderr, "      --project-dir DIR      Repository root for scripts and test suites\n");
+    fprintf(stderr, "      --dieharder-tests LIST Dieharder -d ids, or 'all' for -a (default: %s)\n",
+            DEFAULT_DIEHARDER_TESTS);
+    fprintf(stderr, "  -m, --method NAME          interval, von_neumann, xor_fold, lsb, adaptive_threshold,\n");
+    fprintf(stderr, "                             ordinal, quantile, phase\n");
+    fprintf(stderr, "  -b, --bit N                Bit position for lsb\n");
+    fprintf(stderr, "  -w, --window N             Adaptive threshold window (default: 100)\n");
+    fprintf(stderr, "  -k, --order K              Ordinal block length (default: 8)\n");
+    fprintf(stderr, "      --rate-window N        Values the quantile rate is fitted to (default: 4096)\n");
+    fprintf(stderr, "      --debias NAME          none, von_neumann (default: none)\n");
+    fprintf(stderr, "      --dead-time NS         Dead time filter in nanoseconds\n");
+    fprintf(stderr, "  -?, --help                 Show this help message\n");
+    fprintf(stderr, "\nThe default extraction matches `python3 src/analysis/extract.py`.\n");
+}
+
+static int parse_tests(const char *list) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", list);
+
+    config.run_quick = config.run_python = config.run_nist = config.run_dieharder = 0;
+
+    for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+        if (strcmp(tok, "all") == 0) {
+            config.run_quick = config.run_python = config.run_nist = config.run_dieharder = 1;
+        } else if (strcmp(tok, "none") == 0) {
+            config.run_quick = config.run_python = config.run_nist = config.run_dieharder = 0;
+        } else if (strcmp(tok, "quick") == 0) {
+            config.run_quick = 1;
+        } else if (strcmp(tok, "python") == 0) {
+            config.run_python = 1;
+        } else if (strcmp(tok, "nist") == 0) {
+            config.run_nist = 1;
+        } else if (strcmp(tok, "dieharder") == 0) {
+            config.run_dieharder = 1;
+        } else {
+            fprintf(stderr, "Unknown test battery: %s\n", tok);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int parse_arguments(int argc, char *argv[]) {
+    enum {
+        OPT_EXTRACT_LIMIT = 256, OPT_MIN_BYTES, OPT_RUN_ID, OPT_PROJECT_DIR,
+        OPT_DIEHARDER_TESTS, OPT_DEBIAS, OPT_DEAD_TIME, OPT_RATE_WINDOW
+    };
+    static struct option long_options[] = {
+        {"data-dir",        required_argument, 0, 'd'},
+        {"output-dir",      required_argument, 0, 'o'},
+        {"start-index",     required_argument, 0, 's'},
+        {"sample-count",    required_argument, 0, 'c'},
+        {"tests",           required_argument, 0, 't'},
+        {"threads",         required_argument, 0, 'j'},
+        {"extract-limit",   required_argument, 0, OPT_EXTRACT_LIMIT},
+        {"min-bytes",       required_argument, 0, OPT_MIN_BYTES},
+        {"run-id",          required_argument, 0, OPT_RUN_ID},
+        {"project-dir",     required_argument, 0, OPT_PROJECT_DIR},
+        {"dieharder-tests", required_argument, 0, OPT_DIEHARDER_TESTS},
+        {"method",          required_argument, 0, 'm'},
+        {"bit",             required_argument, 0, 'b'},
+        {"window",          required_argument, 0, 'w'},
+        {"order",           required_argument, 0, 'k'},
+        {"rate-window",     required_argument, 0, OPT_RATE_WINDOW},
+        {"debias",          required_argument, 0, OPT_DEBIAS},
+        {"dead-time",       required_argument, 0, OPT_DEAD_TIME},
+        {"help",            no_argument,       0, '?'},
+        {0, 0, 0, 0}
+    };
+
+    hb_pipeline_config_default(&config.pipeline);
+    snprintf(config.run_id, sizeof(config.run_id), "%ld", (long)time(NULL));
+    if (parse_tests(DEFAULT_TESTS) < 0) {
+        return -1;
+    }
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "d:o:s:c:t:j:m:b:w:k:?", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'd':
+                config.data_dir = optarg;
+                break;
+            case 'o':
+                config.output_dir = optarg;
+                break;
+            case 's':
+                config.start_index = strtoll(optarg, NULL, 10);
+                break;
+            case 'c':
+                config.sample_count = strtoll(optarg, NULL, 10);
+                break;
+            case 't':
+                if (parse_tests(optarg) < 0) {
+                    return -1;
+                }
+                break;
+            case 'j':
+                config.threads = atoi(optarg);
+                break;
+            case OPT_EXTRACT_LIMIT:
+                config.extract_limit = strtoll(optarg, NULL, 10);
+                break;
+            case OPT_MIN_BYTES:
+                config.min_bytes = strtoll(optarg, NULL, 10);
+                break;
+            case OPT_RUN_ID:
+                snprintf(config.run_id, sizeof(config.run_id), "%s", optarg);
+                break;
+            case OPT_PROJECT_DIR:
+                config.project_dir = optarg;
+                break;
+            case OPT_DIEHARDER_TESTS:
+                config.dieharder_tests = optarg;
+                break;
+            case 'm':
+                config.pipeline.method = hb_method_parse(optarg);
+                if (config.pipeline.method < 0) {
+                    fprintf(stderr, "Invalid method: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'b':
+                config.pipeline.bit_pos = atoi(optarg);
+                break;
+            case 'w':
+                config.pipeline.window = atoi(optarg);
+                break;
+            case 'k':
+                config.pipeline.order = atoi(optarg);
+                break;
+            case OPT_RATE_WINDOW:
+                config.pipeline.rate_window = atoi(optarg);
+                break;
+            case OPT_DEBIAS:
+                config.pipeline.debias = hb_debias_parse(optarg);
+                if (config.pipeline.debias < 0) {
+                    fprintf(stderr, "Invalid debias method: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPT_DEAD_TIME:
+                config.pipeline.dead_time_ns = strtoull(optarg, NULL, 10);
+                break;
+            case '?':
+                print_usage(argv[0]);
+                exit(0);
+            default:
+                print_usage(argv[0]);
+                return -1;
+        }
+    }
+
+    if (optind < argc) {
+        fprintf(stderr, "Unexpected argument: %s\n", argv[optind]);
+        return -1;
+    }
+
+    if (!config.project_dir) config.project_dir = ".";
+    if (!config.data_dir) config.data_dir = "data";
+    if (!config.output_dir) config.output_dir = "complete";
+
+    return 0;
+}
+
+static int mkdir_p(const char *path) {
+    char buf[PATH_MAX];
+    snprintf(buf, sizeof(buf), "%s", path);
+
+    for (char *p = buf + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            if (mkdir(buf, 0755) < 0 && errno != EEXIST) {
+                perror(buf);
+                return -1;
+            }
+            *p = '/';
+        }
+    }
+    if (mkdir(buf, 0755) < 0 && errno != EEXIST) {
+        perror(buf);
+        return -1;
+    }
+    return 0;
+}
+
+static int write_file(const char *path, const void *data, size_t len) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    size_t written = fwrite(data, 1, len, f);
+    if (fclose(f) != 0 || written != len) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+static int write_events(const char *path, const uint64_t *values, size_t count) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        fprintf(f, "%lu\n", values[i]);
+    }
+    if (fclose(f) != 0) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+static Stage *add_stage(const char *name) {
+    if (stage_count == MAX_STAGES) {
+        fprintf(stderr, "Too many stages\n");
+        return NULL;
+    }
+    Stage *st = &stages[stage_count++];
+    memset(st, 0, sizeof(*st));
+    snprintf(st->name, sizeof(st->name), "%s", name);
+    snprintf(st->status, sizeof(st->status), "pending");
+    return st;
+}
+
+static void run_quick_stage(Stage *st) {
+    double wall = hb_wall_seconds();
+    double cpu = hb_thread_cpu_seconds();
+
+    hb_quick_tests(binary.data, binary.len, quick_results);
+
+    st->time.wall_s = hb_wall_seconds() - wall;
+    st->time.cpu_s = hb_thread_cpu_seconds() - cpu;
+    snprintf(st->status, sizeof(st->status), "completed");
+}
+
+// fork/exec a battery and wait for it without a timeout. CPU time comes
+// from the child's rusage, so concurrent batteries are accounted separately.
+static void run_child_stage(Stage *st) {
+    double wall = hb_wall_seconds();
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        snprintf(st->status, sizeof(st->status), "failed");
+        return;
+    }
+
+    if (pid == 0) {
+        int in = open(st->stdin_path[0] ? st->stdin_path : "/dev/null", O_RDONLY);
+        int out = open(st->output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (in < 0 || out < 0) {
+            _exit(126);
+        }
+        dup2(in, STDIN_FILENO);
+        dup2(out, STDOUT_FILENO);
+        dup2(out, STDERR_FILENO);
+        if (st->cwd[0] && chdir(st->cwd) < 0) {
+            _exit(126);
+        }
+        execvp(st->argv[0], st->argv);
+        _exit(127);
+    }
+
+    int status;
+    struct rusage ru;
+    while (wait4(pid, &status, 0, &ru) < 0) {
+        if (errno != EINTR) {
+            perror("wait4");
+            snprintf(st->status, sizeof(st->status), "failed");
+            return;
+        }
+    }
+
+    st->time.wall_s = hb_wall_seconds() - wall;
+    st->time.cpu_s = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+                     ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        snprintf(st->status, sizeof(st->status), "completed");
+    } else if (WIFEXITED(status) && WEXITSTATUS(status) == 127) {
+        snprintf(st->status, sizeof(st->status), "not_available");
+    } else {
+        snprintf(st->status, sizeof(st->status), "failed");
+    }
+}
+
+static void run_stage(void *arg) {
+    Stage *st = arg;
+    if (st->argv[0]) {
+        run_child_stage(st);
+    } else {
+        run_quick_stage(st);
+    }
+}
+
+static void set_args(Stage *st, const char *a0, const char *a1, const char *a2,
+                     const char *a3, const char *a4, const char *a5, const char *a6) {
+    const char *args[] = {a0, a1, a2, a3, a4, a5, a6};
+    for (int i = 0; i < 7 && args[i]; i++) {
+        st->argv[i] = strdup(args[i]);
+    }
+}
+
+static const char *find_dieharder(char *buf, size_t len) {
+    if (access("/usr/bin/dieharder", X_OK) == 0) {
+        return "/usr/bin/dieharder";
+    }
+    snprintf(buf, len, "%s/repos/dieharder-3.31.1/dieharder/dieharder", config.project_dir);
+    if (access(buf, X_OK) == 0) {
+        return buf;
+    }
+    return NULL;
+}
+
+static void json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fprintf(f, "\\%c", *s);
+        } else if ((unsigned char)*s < 0x20) {
+            fprintf(f, "\\u%04x", *s);
+        } else {
+            fputc(*s, f);
+        }
+    }
+    fputc('"', f);
+}
+
+static void iso_timestamp(char *buf, size_t len) {
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    // date -Iseconds style: +hh:mm rather than strftime's +hhmm
+    char zone[8];
+    strftime(buf, len, "%Y-%m-%dT%H:%M:%S", &tm);
+    strftime(zone, sizeof(zone), "%z", &tm);
+    size_t n = strlen(buf);
+    snprintf(buf + n, len - n, "%.3s:%.2s", zone, zone + 3);
+}
+
+static int write_results(const char *path, size_t event_files, size_t total_events,
+                         size_t sliced_events) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    char ts[64];
+    iso_timestamp(ts, sizeof(ts));
+
+    fprintf(f, "{\n");
+    fprintf(f, "    \"run_id\": ");
+    json_string(f, config.run_id);
+    fprintf(f, ",\n    \"timestamp\": \"%s\",\n", ts);
+    fprintf(f, "    \"configuration\": {\n");
+    fprintf(f, "        \"start_index\": %lld,\n", config.start_index);
+    fprintf(f, "        \"sample_count\": %lld,\n", config.sample_count);
+    fprintf(f, "        \"extract_limit\": %lld,\n", config.extract_limit);
+    fprintf(f, "        \"min_bytes\": %lld,\n", config.min_bytes);
+    fprintf(f, "        \"timeouts\": {\n");
+    fprintf(f, "            \"extract\": 0,\n");
+    fprintf(f, "            \"python\": 0,\n");
+    fprintf(f, "            \"nist\": 0,\n");
+    fprintf(f, "            \"dieharder\": 0\n");
+    fprintf(f, "        },\n");
+    fprintf(f, "        \"extraction\": {\n");
+    fprintf(f, "            \"method\": \"%s\",\n", hb_method_name(config.pipeline.method));
+    fprintf(f, "            \"bit_pos\": %d,\n", config.pipeline.bit_pos);
+    fprintf(f, "            \"window\": %d,\n", config.pipeline.window);
+    fprintf(f, "            \"order\": %d,\n", config.pipeline.order);
+    fprintf(f, "            \"rate_window\": %d,\n", config.pipeline.rate_window);
+    fprintf(f, "            \"debias\": \"%s\",\n", hb_debias_name(config.pipeline.debias));
+    fprintf(f, "            \"dead_time_ns\": %lu\n", config.pipeline.dead_time_ns);
+    fprintf(f, "        }\n");
+    fprintf(f, "    },\n");
+    fprintf(f, "    \"input\": {\n");
+    fprintf(f, "        \"data_dir\": ");
+    json_string(f, config.data_dir);
+    fprintf(f, ",\n        \"event_files\": %zu,\n", event_files);
+    fprintf(f, "        \"total_events\": %zu,\n", total_events);
+    fprintf(f, "        \"sliced_events\": %zu,\n", sliced_events);
+    fprintf(f, "        \"binary_bytes\": %zu\n", binary.len);
+    fprintf(f, "    },\n");
+    fprintf(f, "    \"tests_run\": {\n");
+    fprintf(f, "        \"quick\": %s,\n", config.run_quick ? "true" : "false");
+    fprintf(f, "        \"python\": %s,\n", config.run_python ? "true" : "false");
+    fprintf(f, "        \"nist\": %s,\n", config.run_nist ? "true" : "false");
+    fprintf(f, "        \"dieharder\": %s\n", config.run_dieharder ? "true" : "false");
+    fprintf(f, "    },\n");
+
+    if (config.run_quick) {
+        fprintf(f, "    \"quick\": {\n");
+        for (int t = 0; t < HB_QUICK_TESTS; t++) {
+            fprintf(f, "        \"%s\": {\"statistic\": %.6g, \"p_value\": %.6g, \"pass\": %s}%s\n",
+                    quick_results[t].name, quick_results[t].statistic,
+                    quick_results[t].p_value,
+                    quick_results[t].p_value >= HB_ALPHA ? "true" : "false",
+                    t + 1 < HB_QUICK_TESTS ? "," : "");
+        }
+        fprintf(f, "    },\n");
+    }
+
+    fprintf(f, "    \"stages\": {\n");
+    for (int i = 0; i < stage_count; i++) {
+        fprintf(f, "        \"%s\": {\"status\": \"%s\", \"wall_s\": %.6f, \"cpu_s\": %.6f}%s\n",
+                stages[i].name, stages[i].status, stages[i].time.wall_s,
+                stages[i].time.cpu_s, i + 1 < stage_count ? "," : "");
+    }
+    fprintf(f, "    }\n");
+    fprintf(f, "}\n");
+
+    if (fclose(f) != 0) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+// Append each per-test Dieharder log to results.txt in test order, so the
+// combined file does not depend on completion order.
+static void merge_dieharder(const char *dir) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/results.txt", dir);
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        perror(path);
+        return;
+    }
+
+    for (int i = 0; i < stage_count; i++) {
+        if (strncmp(stages[i].name, "dieharder", 9) != 0 || !stages[i].output_path[0]) {
+            continue;
+        }
+        FILE *in = fopen(stages[i].output_path, "r");
+        if (!in) {
+            continue;
+        }
+        char buf[8192];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+            fwrite(buf, 1, n, out);
+        }
+        fclose(in);
+    }
+    fclose(out);
+}
+
+static void finish_stage(Stage *st, double wall, double cpu) {
+    st->time.wall_s = hb_wall_seconds() - wall;
+    st->time.cpu_s = hb_thread_cpu_seconds() - cpu;
+    snprintf(st->status, sizeof(st->status), "completed");
+}
+
+int main(int argc, char *argv[]) {
+    if (parse_arguments(argc, argv) < 0) {
+        return 1;
+    }
+
+    char run_dir[PATH_MAX];
+    char path[PATH_MAX];
+    snprintf(run_dir, sizeof(run_dir), "%s/%s", config.output_dir, config.run_id);
+    if (mkdir_p(run_dir) < 0) {
+        return 1;
+    }
+
+    printf("========================================\n");
+    printf("    HOTBITS - Native Evaluation\n");
+    printf("========================================\n");
+    printf("Run ID:          %s\n", config.run_id);
+    printf("Data Directory:  %s\n", config.data_dir);
+    printf("Output:          %s\n", run_dir);
+
+    // Load
+    Stage *st = add_stage("load");
+    double wall = hb_wall_seconds();
+    double cpu = hb_thread_cpu_seconds();
+
+    struct hb_archive archive;
+    if (hb_archive_open(&archive, config.data_dir, 1) < 0) {
+        return 1;
+    }
+    if (archive.count == 0) {
+        fprintf(stderr, "ERROR: No events-*.txt files found in %s\n", config.data_dir);
+        return 1;
+    }
+
+    // Slice with hot.sh semantics: 1-based start, negative counts from end
+    size_t total = hb_archive_events(&archive);
+    size_t start = 0;
+    size_t count = total;
+    int sliced = config.start_index != 0 || config.sample_count != 0;
+    long long first = 1;
+    if (sliced) {
+        first = config.start_index;
+        if (first < 0) {
+            first = (long long)total + first + 1;
+            if (first < 1) first = 1;
+        } else if (first == 0) {
+            first = 1;
+        }
+        start = (size_t)first - 1;
+        if (start > total) start = total;
+        count = total - start;
+        if (config.sample_count > 0 && (size_t)config.sample_count < count) {
+            count = (size_t)config.sample_count;
+        }
+    }
+
+    // Only the selected range is read, seeking via the segment indexes
+    struct hb_events events;
+    hb_events_init(&events);
+    if (hb_archive_read(&archive, start, count, &events) < 0) {
+        return 1;
+    }
+    finish_stage(st, wall, cpu);
+    printf("Indexed %zu events in %zu files\n", total, archive.count);
+    if (sliced) {
+        printf("Sliced to %zu events starting at line %lld\n", count, first);
+    }
+    const uint64_t *slice = events.values;
+
+    // Extract
+    st = add_stage("extract");
+    wall = hb_wall_seconds();
+    cpu = hb_thread_cpu_seconds();
+
+    size_t extract_count = count;
+    if (config.extract_limit > 0 && (size_t)config.extract_limit < extract_count) {
+        extract_count = (size_t)config.extract_limit;
+    }
+
+    struct hb_pipeline pipeline;
+    hb_buffer_init(&binary);
+    if (hb_pipeline_init(&pipeline, &config.pipeline) < 0 ||
+        hb_pipeline_push(&pipeline, slice, extract_count, &binary) < 0 ||
+        hb_pipeline_finish(&pipeline, &binary) < 0) {
+        return 1;
+    }
+    hb_pipeline_free(&pipeline);
+
+    char binary_path[PATH_MAX];
+    snprintf(binary_path, sizeof(binary_path), "%s/random.bin", run_dir);
+    if (write_file(binary_path, binary.data, binary.len) < 0) {
+        return 1;
+    }
+    finish_stage(st, wall, cpu);
+    printf("Extracted %zu bytes from %zu events (%s)\n", binary.len, extract_count,
+           hb_method_name(config.pipeline.method));
+
+    // Python batteries read the event text rather than the binary
+    char events_path[PATH_MAX] = "";
+    if (config.run_python) {
+        st = add_stage("prepare");
+        wall = hb_wall_seconds();
+        cpu = hb_thread_cpu_seconds();
+        snprintf(events_path, sizeof(events_path), "%s/%s", run_dir,
+                 sliced ? "sliced_events.txt" : "concatenated_events.txt");
+        if (write_events(events_path, slice, count) < 0) {
+            return 1;
+        }
+        finish_stage(st, wall, cpu);
+    }
+
+    // Schedule batteries
+    int enough = (long long)binary.len >= config.min_bytes;
+    int first_battery = stage_count;
+
+    if (config.run_quick) {
+        add_stage("quick");
+    }
+
+    if (config.run_python) {
+        static const char *scripts[] = {"analyze", "test_randomness"};
+        snprintf(path, sizeof(path), "%s/python_results", run_dir);
+        mkdir_p(path);
+        for (int i = 0; i < 2; i++) {
+            char name[64];
+            char script[PATH_MAX];
+            snprintf(name, sizeof(name), "python.%s", scripts[i]);
+            st = add_stage(name);
+            snprintf(script, sizeof(script), "%s/src/analysis/%s.py", config.project_dir, scripts[i]);
+            set_args(st, "python3", script, NULL, NULL, NULL, NULL, NULL);
+            snprintf(st->stdin_path, sizeof(st->stdin_path), "%s", events_path);
+            snprintf(st->output_path, sizeof(st->output_path), "%s/python_results/%s.txt",
+                     run_dir, scripts[i]);
+        }
+    }
+
+    if (config.run_nist) {
+        snprintf(path, sizeof(path), "%s/nist_results", run_dir);
+        mkdir_p(path);
+        st = add_stage("nist");
+        char assess[PATH_MAX];
+        snprintf(assess, sizeof(assess), "%s/repos/sts-2.1.2/sts-2.1.2/assess", config.project_dir);
+        if (!enough) {
+            snprintf(st->status, sizeof(st->status), "insufficient_data");
+        } else if (access(assess, X_OK) != 0) {
+            snprintf(st->status, sizeof(st->status), "not_available");
+        } else {
+            char script[PATH_MAX];
+            char abs_binary[PATH_MAX];
+            snprintf(script, sizeof(script), "%s/scripts/nist_quick_test.sh", config.project_dir);
+            if (!realpath(binary_path, abs_binary)) {
+                snprintf(abs_binary, sizeof(abs_binary), "%s", binary_path);
+            }
+            set_args(st, script, abs_binary, NULL, NULL, NULL, NULL, NULL);
+            snprintf(st->output_path, sizeof(st->output_path), "%s/nist_results/quick_output.log",
+                     run_dir);
+        }
+    }
+
+    if (config.run_dieharder) {
+        char dh_buf[PATH_MAX];
+        const char *dieharder = find_dieharder(dh_buf, sizeof(dh_buf));
+        char dh_dir[PATH_MAX];
+        snprintf(dh_dir, sizeof(dh_dir), "%s/dieharder_results", run_dir);
+        mkdir_p(dh_dir);
+
+        if (!enough || !dieharder) {
+            st = add_stage("dieharder");
+            snprintf(st->status, sizeof(st->status), "%s",
+                     !enough ? "insufficient_data" : "not_available");
+        } else if (strcmp(config.dieharder_tests, "all") == 0) {
+            st = add_stage("dieharder");
+            set_args(st, dieharder, "-g", "201", "-f", binary_path, "-a", NULL);
+            snprintf(st->output_path, sizeof(st->output_path), "%s/test-all.txt", dh_dir);
+        } else {
+            char list[256];
+            snprintf(list, sizeof(list), "%s", config.dieharder_tests);
+            for (char *tok = strtok(list, ","); tok; tok = strtok(NULL, ",")) {
+                char name[64];
+                snprintf(name, sizeof(name), "dieharder.%s", tok);
+                st = add_stage(name);
+                if (!st) break;
+                set_args(st, dieharder, "-g", "201", "-f", binary_path, "-d", tok);
+                snprintf(st->output_path, sizeof(st->output_path), "%s/test-%s.txt", dh_dir, tok);
+            }
+        }
+    }
+
+    struct hb_pool *pool = hb_pool_create(config.threads);
+    if (!pool) {
+        return 1;
+    }
+    printf("Running %d stages on %d threads...\n", stage_count - first_battery,
+           hb_pool_threads(pool));
+
+    for (int i = first_battery; i < stage_count; i++) {
+        if (strcmp(stages[i].status, "pending") == 0) {
+            hb_pool_submit(pool, run_stage, &stages[i]);
+        }
+    }
+    hb_pool_wait(pool);
+    hb_pool_destroy(pool);
+
+    if (config.run_dieharder) {
+        char dh_dir[PATH_MAX];
+        snprintf(dh_dir, sizeof(dh_dir), "%s/dieharder_results", run_dir);
+        merge_dieharder(dh_dir);
+    }
+
+    for (int i = first_battery; i < stage_count; i++) {
+        printf("  %-28s %-18s %8.3fs wall %8.3fs cpu\n", stages[i].name, stages[i].status,
+               stages[i].time.wall_s, stages[i].time.cpu_s);
+    }
+
+    snprintf(path, sizeof(path), "%s/results.json", run_dir);
+    if (write_results(path, archive.count, total, sliced ? count : 0) < 0) {
+        return 1;
+    }
+
+    printf("Summary: %s\n", path);
+
+    for (int i = 0; i < stage_count; i++) {
+        for (int a = 0; a < MAX_ARGS && stages[i].argv[a]; a++) {
+            free(stages[i].argv[a]);
+        }
+    }
+    hb_archive_close(&archive);
+    hb_events_free(&events);
+    hb_buffer_free(&binary);
+    return 0;
+}
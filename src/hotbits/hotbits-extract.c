@@ -0,0 +1,444 @@
+// hotbits-extract - native streaming extractor
+//
+// Reads event deltas from files (or stdin) and writes packed random bytes.
+// With --incremental it keeps a manifest and per-segment checkpoints so
+// repeated runs over data/ only process new or changed segments. With
+// -j it parses and extracts on a thread pool (parallel.h); the output is
+// the same bytes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+
+#include "codec.h"
+#include "cpu.h"
+#include "events.h"
+#include "pipeline.h"
+#include "incremental.h"
+#include "input.h"
+#include "instrument.h"
+#include "parallel.h"
+#include "trace.h"
+
+#define CHUNK_VALUES 65536
+// Text read per parallel push, per thread
+#define PARALLEL_BLOCK_BYTES (8 << 20)
+
+typedef struct {
+    const char *state_dir;
+    const char *data_dir;
+    const char *output;
+    int verbose;
+    int threads;
+    size_t chunk_values;
+    struct hb_pipeline_config pipeline;
+} Config;
+
+static Config config = {
+    .state_dir = NULL,
+    .data_dir = "data",
+    .output = NULL,
+    .verbose = 0,
+    .threads = 1,
+    .chunk_values = 0
+};
+
+void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [OPTIONS] [FILE...]\n", prog);
+    fprintf(stderr, "FILEs are event text (optionally gzip/zstd compressed) or packed .hbc\n");
+    fprintf(stderr, "segments (default: stdin)\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -m, --method NAME        interval, von_neumann, xor_fold, lsb, adaptive_threshold,\n");
+    fprintf(stderr, "                           ordinal, quantile, phase\n");
+    fprintf(stderr, "                           (or rng-extractor numbers 0-3; default: adaptive_threshold)\n");
+    fprintf(stderr, "  -b, --bit N              Bit position for lsb (default: 0)\n");
+    fprintf(stderr, "  -w, --window N           Adaptive threshold window (default: 100)\n");
+    fprintf(stderr, "  -k, --order K            Ordinal block length, 2 to %d (default: 8)\n", HB_ORDINAL_MAX);
+    fprintf(stderr, "      --rate-window N      Values the quantile rate is fitted to (default: 4096)\n");
+    fprintf(stderr, "      --debias NAME        none, von_neumann (default: none)\n");
+    fprintf(stderr, "      --dead-time NS       Dead time filter in nanoseconds\n");
+    fprintf(stderr, "      --window-ns NS       Aggregate events per time window\n");
+    fprintf(stderr, "      --window-mode N      0: first, 1: last, 2: mean event per window\n");
+    fprintf(stderr, "  -o, --output FILE        Output file (default: stdout)\n");
+    fprintf(stderr, "  -i, --incremental DIR    Manifest/checkpoint directory; extracts data/events-*.txt\n");
+    fprintf(stderr, "                           and appends only new segments to --output\n");
+    fprintf(stderr, "  -d, --data-dir DIR       Segment directory for --incremental (default: ./data)\n");
+    fprintf(stderr, "  -j, --threads N          Parse and extract on N threads, 0 for one per CPU\n");
+    fprintf(stderr, "                           (default: 1; same output either way)\n");
+    fprintf(stderr, "      --chunk N            Values per parallel work item (default: 262144)\n");
+    fprintf(stderr, "      --isa NAME           Run the kernels for this instruction set instead of\n");
+    fprintf(stderr, "                           the best the CPU supports (also HOTBITS_ISA)\n");
+    fprintf(stderr, "  -v, --verbose            Print statistics to stderr\n");
+    fprintf(stderr, "  -?, --help               Show this help message\n");
+}
+
+int parse_arguments(int argc, char *argv[]) {
+    enum { OPT_DEBIAS = 256, OPT_DEAD_TIME, OPT_WINDOW_NS, OPT_WINDOW_MODE, OPT_ISA, OPT_CHUNK,
+           OPT_RATE_WINDOW };
+    static struct option long_options[] = {
+        {"method",      required_argument, 0, 'm'},
+        {"bit",         required_argument, 0, 'b'},
+        {"window",      required_argument, 0, 'w'},
+        {"order",       required_argument, 0, 'k'},
+        {"rate-window", required_argument, 0, OPT_RATE_WINDOW},
+        {"debias",      required_argument, 0, OPT_DEBIAS},
+        {"dead-time",   required_argument, 0, OPT_DEAD_TIME},
+        {"window-ns",   required_argument, 0, OPT_WINDOW_NS},
+        {"window-mode", required_argument, 0, OPT_WINDOW_MODE},
+        {"isa",         required_argument, 0, OPT_ISA},
+        {"threads",     required_argument, 0, 'j'},
+        {"chunk",       required_argument, 0, OPT_CHUNK},
+        {"output",      required_argument, 0, 'o'},
+        {"incremental", required_argument, 0, 'i'},
+        {"data-dir",    required_argument, 0, 'd'},
+        {"verbose",     no_argument,       0, 'v'},
+        {"help",        no_argument,       0, '?'},
+        {0, 0, 0, 0}
+    };
+
+    hb_pipeline_config_default(&config.pipeline);
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "m:b:w:k:o:i:d:j:v?", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'm':
+                config.pipeline.method = hb_method_parse(optarg);
+                if (config.pipeline.method < 0) {
+                    fprintf(stderr, "Invalid method: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'b':
+                config.pipeline.bit_pos = atoi(optarg);
+                break;
+            case 'w':
+                config.pipeline.window = atoi(optarg);
+                break;
+            case 'k':
+                config.pipeline.order = atoi(optarg);
+                break;
+            case OPT_RATE_WINDOW:
+                config.pipeline.rate_window = atoi(optarg);
+                break;
+            case OPT_DEBIAS:
+                config.pipeline.debias = hb_debias_parse(optarg);
+                if (config.pipeline.debias < 0) {
+                    fprintf(stderr, "Invalid debias method: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPT_DEAD_TIME:
+                config.pipeline.dead_time_ns = strtoull(optarg, NULL, 10);
+                break;
+            case OPT_WINDOW_NS:
+                config.pipeline.window_ns = strtoull(optarg, NULL, 10);
+                break;
+            case OPT_WINDOW_MODE:
+                config.pipeline.window_mode = atoi(optarg);
+                break;
+            case OPT_ISA:
+                if (hb_cpu_force(optarg) < 0) {
+                    return -1;
+                }
+                break;
+            case 'j':
+                config.threads = atoi(optarg);
+                if (config.threads < 0) {
+                    fprintf(stderr, "Invalid thread count: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPT_CHUNK:
+                config.chunk_values = strtoull(optarg, NULL, 10);
+                if (config.chunk_values == 0) {
+                    fprintf(stderr, "Invalid chunk size: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'o':
+                config.output = optarg;
+                break;
+            case 'i':
+                config.state_dir = optarg;
+                break;
+            case 'd':
+                config.data_dir = optarg;
+                break;
+            case 'v':
+                config.verbose = 1;
+                break;
+            case '?':
+                print_usage(argv[0]);
+                exit(0);
+            default:
+                print_usage(argv[0]);
+                return -1;
+        }
+    }
+
+    if (config.state_dir && !config.output) {
+        fprintf(stderr, "--incremental requires -o/--output\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int write_all(FILE *out, const struct hb_buffer *buf) {
+    HB_SCOPE(HB_STAGE_SINK);
+    HB_COUNT(HB_STAGE_SINK, buf->len);
+    HB_TRACE1(output, buf->len);
+    if (buf->len && fwrite(buf->data, 1, buf->len, out) != buf->len) {
+        perror("fwrite");
+        return -1;
+    }
+    return 0;
+}
+
+static int run_incremental(void) {
+    struct hb_incremental_stats stats;
+
+    if (hb_incremental_run(config.data_dir, config.state_dir, config.output,
+                           &config.pipeline, &stats) < 0) {
+        return 1;
+    }
+
+    if (config.verbose) {
+        fprintf(stderr, "# Segments: %lu (%lu reused, %lu processed)\n",
+                stats.segments, stats.segments_reused, stats.segments_processed);
+        fprintf(stderr, "# Events processed: %lu\n", stats.events_processed);
+        fprintf(stderr, "# Bytes appended: %lu (output now %lu bytes)\n",
+                stats.bytes_appended, stats.output_bytes);
+    }
+    return 0;
+}
+
+// Stream one input through the pipeline without loading it whole
+static int extract_stream(struct hb_pipeline *p, int fd, FILE *out, struct hb_buffer *buf) {
+    static char text[1 << 20];
+    static uint64_t values[CHUNK_VALUES];
+    size_t have = 0;
+    int eof = 0;
+
+    while (!eof) {
+        size_t want = sizeof(text) - 1 - have;
+        ssize_t r = read(fd, text + have, want);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            perror("read");
+            return -1;
+        }
+        if (r == 0) {
+            eof = 1;
+            if (have > 0 && text[have - 1] != '\n') {
+                text[have++] = '\n';
+            }
+        }
+        have += r > 0 ? (size_t)r : 0;
+
+        size_t pos = 0;
+        for (;;) {
+            size_t consumed;
+            size_t n = hb_parse_deltas(text + pos, have - pos, values, CHUNK_VALUES, &consumed);
+            if (n == 0 && consumed == 0) {
+                break;
+            }
+            pos += consumed;
+            buf->len = 0;
+            if (hb_pipeline_push(p, values, n, buf) < 0 || write_all(out, buf) < 0) {
+                return -1;
+            }
+        }
+
+        if (pos == 0 && have == sizeof(text) - 1) {
+            pos = have;   // overlong line, not an event
+        }
+        // A short read means we caught up with a live source (trng through a
+        // pipe); pass the bits on now rather than when stdio's buffer fills
+        if (r > 0 && (size_t)r < want && fflush(out) != 0) {
+            perror("fflush");
+            return -1;
+        }
+        memmove(text, text + pos, have - pos);
+        have -= pos;
+    }
+    return 0;
+}
+
+// extract_stream on the pool: whole lines a block at a time. A block is
+// pushed when full, at the end, or when a live source has nothing more
+// ready, so trng piped in is still passed on as it arrives.
+static int extract_stream_parallel(struct hb_parallel *px, int fd, size_t block, FILE *out,
+                                   struct hb_buffer *buf) {
+    char *text = malloc(block + 1);
+    if (!text) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+    size_t have = 0;
+    int eof = 0;
+    int rv = 0;
+
+    while (!eof && rv == 0) {
+        ssize_t r = read(fd, text + have, block - have);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            perror("read");
+            rv = -1;
+            break;
+        }
+        if (r == 0) {
+            eof = 1;
+            if (have > 0 && text[have - 1] != '\n') {
+                text[have++] = '\n';
+            }
+        }
+        have += r > 0 ? (size_t)r : 0;
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        int caught_up = r > 0 && poll(&pfd, 1, 0) == 0;
+        if (!eof && have < block && !caught_up) {
+            continue;
+        }
+
+        size_t lines = have;
+        while (lines > 0 && text[lines - 1] != '\n') {
+            lines--;
+        }
+        if (lines == 0 && have == block) {
+            have = 0;   // overlong line, not an event
+            continue;
+        }
+        buf->len = 0;
+        if (hb_parallel_push_text(px, text, lines, buf) < 0 || write_all(out, buf) < 0 ||
+            (caught_up && fflush(out) != 0)) {
+            rv = -1;
+        }
+        memmove(text, text + lines, have - lines);
+        have -= lines;
+    }
+    free(text);
+    return rv;
+}
+
+// One of p or px is set
+static int extract_packed(struct hb_pipeline *p, struct hb_parallel *px, const char *path,
+                          FILE *out, struct hb_buffer *buf) {
+    struct hb_events ev;
+    hb_events_init(&ev);
+
+    int rv = hb_codec_load_file(&ev, path);
+    if (rv == 0) {
+        buf->len = 0;
+        rv = (px ? hb_parallel_push(px, ev.values, ev.count, buf)
+                 : hb_pipeline_push(p, ev.values, ev.count, buf)) < 0 ||
+             write_all(out, buf) < 0 ? -1 : 0;
+    }
+    hb_events_free(&ev);
+    return rv;
+}
+
+int main(int argc, char *argv[]) {
+    if (parse_arguments(argc, argv) < 0) {
+        return 1;
+    }
+    hb_instrument_init("hotbits-extract");
+
+    if (config.state_dir) {
+        return run_incremental();
+    }
+
+    FILE *out = stdout;
+    if (config.output) {
+        out = fopen(config.output, "wb");
+        if (!out) {
+            perror(config.output);
+            return 1;
+        }
+    }
+
+    struct hb_pipeline pipeline;
+    struct hb_buffer buf;
+    if (hb_pipeline_init(&pipeline, &config.pipeline) < 0) {
+        return 1;
+    }
+    hb_buffer_init(&buf);
+
+    struct hb_pool *pool = NULL;
+    struct hb_parallel *px = NULL;
+    if (config.threads != 1) {
+        pool = hb_pool_create(config.threads);
+        px = pool ? hb_parallel_create(&config.pipeline, pool, config.chunk_values) : NULL;
+        if (!px) {
+            hb_pool_destroy(pool);
+            hb_pipeline_free(&pipeline);
+            return 1;
+        }
+    }
+
+    int rv = 0;
+    int nfiles = argc - optind;
+    for (int i = 0; i < (nfiles ? nfiles : 1) && rv == 0; i++) {
+        const char *path = nfiles ? argv[optind + i] : "-";
+        if (hb_codec_is_packed(path)) {
+            rv = extract_packed(&pipeline, px, path, out, &buf);
+            continue;
+        }
+        // Compressed input is inflated on a separate thread while we parse
+        struct hb_input in;
+        if (hb_input_open(&in, path, 0) < 0) {
+            rv = -1;
+            break;
+        }
+        rv = px ? extract_stream_parallel(px, in.fd, PARALLEL_BLOCK_BYTES * hb_pool_threads(pool),
+                                          out, &buf)
+                : extract_stream(&pipeline, in.fd, out, &buf);
+        if (hb_input_close(&in) < 0) {
+            rv = -1;
+        }
+        if (config.verbose && in.format != HB_INPUT_PLAIN) {
+            fprintf(stderr, "# %s: %s", in.name, hb_input_format_name(in.format));
+            if (in.frames) {
+                fprintf(stderr, ", %zu frames decoded in parallel", in.frames);
+            }
+            fprintf(stderr, "\n");
+        }
+    }
+
+    if (rv == 0) {
+        buf.len = 0;
+        if ((px ? hb_parallel_finish(px, &buf) : hb_pipeline_finish(&pipeline, &buf)) < 0 ||
+            write_all(out, &buf) < 0) {
+            rv = -1;
+        }
+    }
+
+    if (config.verbose) {
+        uint64_t events = px ? hb_parallel_events(px) : pipeline.events_in;
+        uint64_t bits = px ? hb_parallel_bits(px) : pipeline.bits_out;
+        fprintf(stderr, "# Kernels: %s (best supported: %s)\n", hb_isa_name(hb_cpu_level()),
+                hb_isa_name(hb_cpu_best()));
+        if (pool) {
+            fprintf(stderr, "# Threads: %d\n", hb_pool_threads(pool));
+        }
+        fprintf(stderr, "# Input samples: %lu\n", events);
+        fprintf(stderr, "# Output bits: %lu\n", bits);
+        if (events) {
+            fprintf(stderr, "# Compression: %.2f bits/sample\n", (double)bits / events);
+        }
+    }
+
+    hb_parallel_free(px);
+    hb_pool_destroy(pool);
+    hb_pipeline_free(&pipeline);
+    hb_buffer_free(&buf);
+    if (out != stdout && fclose(out) != 0) {
+        perror(config.output);
+        rv = -1;
+    }
+    return rv == 0 ? 0 : 1;
+}
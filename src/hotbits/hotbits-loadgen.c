@@ -0,0 +1,579 @@
+// hotbits-loadgen - load generator for hotbits-serve
+//
+// Keeps a fixed number of keep-alive connections busy, each with up to
+// --depth pipelined requests in flight, from one epoll loop. Every
+// response's latency is measured from the moment its request was written
+// to the moment its last body byte arrived, and the percentiles are
+// reported at the end, so a change to the server can be checked against a
+// latency target (--p99-target) as well as for throughput.
+
+#define _GNU_SOURCE     // memmem
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <errno.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <signal.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "timing.h"
+
+#define MAX_DEPTH 256
+#define READ_SIZE (1 << 16)
+#define DRAIN_S 2.0               // wait this long for in-flight responses
+
+typedef struct {
+    const char *host;
+    const char *port;
+    int connections;
+    int depth;
+    double duration;
+    uint64_t requests;
+    size_t bytes;
+    const char *format;
+    const char *path;
+    double p99_target_us;
+    int json;
+} Config;
+
+static Config config = {
+    .host = "127.0.0.1",
+    .port = "8093",
+    .connections = 8,
+    .depth = 1,
+    .duration = 5.0,
+    .requests = 0,
+    .bytes = 32,
+    .format = "raw",
+    .path = NULL,
+    .p99_target_us = 0.0,
+    .json = 0
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [OPTIONS]\n", prog);
+    fprintf(stderr, "Sends GET /random requests to hotbits-serve and reports latency percentiles.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -H, --host HOST          Server address (default: 127.0.0.1)\n");
+    fprintf(stderr, "  -p, --port PORT          Server port (default: 8093)\n");
+    fprintf(stderr, "  -c, --connections N      Keep-alive connections (default: 8)\n");
+    fprintf(stderr, "  -D, --depth N            Pipelined requests in flight per connection\n");
+    fprintf(stderr, "                           (default: 1, at most %d)\n", MAX_DEPTH);
+    fprintf(stderr, "  -d, --duration S         Run for S seconds (default: 5)\n");
+    fprintf(stderr, "  -n, --requests N         Stop after N requests instead\n");
+    fprintf(stderr, "  -b, --bytes N            Bytes per request (default: 32)\n");
+    fprintf(stderr, "  -f, --format FORMAT      raw, hex or json (default: raw)\n");
+    fprintf(stderr, "      --path PATH          Request PATH instead of /random?bytes=N&format=F\n");
+    fprintf(stderr, "  -t, --p99-target US      Exit with status 2 if p99 latency exceeds US\n");
+    fprintf(stderr, "  -j, --json               Print the results as JSON\n");
+    fprintf(stderr, "  -?, --help               Show this help message\n");
+}
+
+enum { OPT_PATH = 256 };
+
+int parse_arguments(int argc, char *argv[]) {
+    static struct option long_options[] = {
+        {"host",        required_argument, 0, 'H'},
+        {"port",        required_argument, 0, 'p'},
+        {"connections", required_argument, 0, 'c'},
+        {"depth",       required_argument, 0, 'D'},
+        {"duration",    required_argument, 0, 'd'},
+        {"requests",    required_argument, 0, 'n'},
+        {"bytes",       required_argument, 0, 'b'},
+        {"format",      required_argument, 0, 'f'},
+        {"path",        required_argument, 0, OPT_PATH},
+        {"p99-target",  required_argument, 0, 't'},
+        {"json",        no_argument,       0, 'j'},
+        {"help",        no_argument,       0, '?'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "H:p:c:D:d:n:b:f:t:j?", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'H':
+                config.host = optarg;
+                break;
+            case 'p':
+                config.port = optarg;
+                break;
+            case 'c':
+                config.connections = atoi(optarg);
+                break;
+            case 'D':
+                config.depth = atoi(optarg);
+                break;
+            case 'd':
+                config.duration = atof(optarg);
+                break;
+            case 'n':
+                config.requests = strtoull(optarg, NULL, 10);
+                break;
+            case 'b':
+                config.bytes = strtoull(optarg, NULL, 10);
+                break;
+            case 'f':
+                config.format = optarg;
+                break;
+            case OPT_PATH:
+                config.path = optarg;
+                break;
+            case 't':
+                config.p99_target_us = atof(optarg);
+                break;
+            case 'j':
+                config.json = 1;
+                break;
+            case '?':
+                print_usage(argv[0]);
+                exit(0);
+            default:
+                print_usage(argv[0]);
+                return -1;
+        }
+    }
+
+    if (config.connections < 1 || config.depth < 1 || config.depth > MAX_DEPTH) {
+        fprintf(stderr, "--connections must be positive and --depth between 1 and %d\n",
+                MAX_DEPTH);
+        return -1;
+    }
+    if (config.duration <= 0.0 && config.requests == 0) {
+        fprintf(stderr, "--duration or --requests must be positive\n");
+        return -1;
+    }
+    if (optind != argc) {
+        print_usage(argv[0]);
+        return -1;
+    }
+    return 0;
+}
+
+static void handle_signal(int sig) {
+    (void)sig;
+    stopping = 1;
+}
+
+struct client {
+    int fd;
+    int connected;
+    double sent[MAX_DEPTH];    // write times of the requests in flight
+    int head;
+    int inflight;
+    char *out;                 // request bytes not yet written
+    size_t out_len;
+    char in[READ_SIZE];
+    size_t in_len;
+    int in_body;
+    int status;
+    size_t body_left;
+    int closing;               // server said Connection: close
+};
+
+struct stats {
+    uint32_t *latency_ns;
+    size_t count;
+    size_t cap;
+    uint64_t issued;
+    uint64_t status_200;
+    uint64_t status_429;
+    uint64_t status_503;
+    uint64_t status_other;
+    uint64_t errors;
+    uint64_t body_bytes;
+    uint64_t reconnects;
+};
+
+static struct addrinfo *server_addr;
+static char request[512];
+static size_t request_len;
+static int epfd;
+static struct stats stats;
+
+static int record(double latency) {
+    if (stats.count == stats.cap) {
+        size_t cap = stats.cap ? stats.cap * 2 : 1 << 16;
+        uint32_t *p = realloc(stats.latency_ns, cap * sizeof(*p));
+        if (!p) {
+            fprintf(stderr, "Memory allocation failed\n");
+            return -1;
+        }
+        stats.latency_ns = p;
+        stats.cap = cap;
+    }
+    double ns = latency * 1e9;
+    stats.latency_ns[stats.count++] = ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+    return 0;
+}
+
+static int client_connect(struct client *c) {
+    c->fd = socket(server_addr->ai_family, server_addr->ai_socktype | SOCK_NONBLOCK,
+                   server_addr->ai_protocol);
+    if (c->fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(c->fd, server_addr->ai_addr, server_addr->ai_addrlen) < 0 &&
+        errno != EINPROGRESS) {
+        perror("connect");
+        close(c->fd);
+        return -1;
+    }
+    c->connected = 0;
+    c->head = c->inflight = 0;
+    c->out_len = c->in_len = 0;
+    c->in_body = 0;
+    c->closing = 0;
+
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT, .data.ptr = c };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev) < 0) {
+        perror("epoll_ctl");
+        close(c->fd);
+        return -1;
+    }
+    return 0;
+}
+
+static int more_requests(double now, double end) {
+    if (stopping) return 0;
+    if (config.requests) return stats.issued < config.requests;
+    return now < end;
+}
+
+// Queue requests up to the pipeline depth and write what the socket takes
+static int client_send(struct client *c, double now, double end) {
+    while (c->connected && !c->closing && c->inflight < config.depth && more_requests(now, end)) {
+        memcpy(c->out + c->out_len, request, request_len);
+        c->out_len += request_len;
+        c->sent[(c->head + c->inflight) % MAX_DEPTH] = now;
+        c->inflight++;
+        stats.issued++;
+    }
+    while (c->out_len > 0) {
+        ssize_t w = write(c->fd, c->out, c->out_len);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) break;
+            return -1;
+        }
+        memmove(c->out, c->out + w, c->out_len - w);
+        c->out_len -= (size_t)w;
+    }
+    struct epoll_event ev = {
+        .events = EPOLLIN | (c->out_len > 0 || !c->connected ? EPOLLOUT : 0),
+        .data.ptr = c
+    };
+    epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    return 0;
+}
+
+static void client_drop(struct client *c) {
+    stats.errors += c->inflight;
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+    c->inflight = 0;
+}
+
+// Parse complete responses out of the input buffer
+static int client_parse(struct client *c, double now) {
+    size_t pos = 0;
+    while (pos < c->in_len) {
+        if (!c->in_body) {
+            char *start = c->in + pos;
+            char *end = memmem(start, c->in_len - pos, "\r\n\r\n", 4);
+            if (!end) {
+                break;
+            }
+            *end = '\0';
+            if (strncmp(start, "HTTP/1.", 7) != 0 || strlen(start) < 12) {
+                fprintf(stderr, "Malformed response\n");
+                return -1;
+            }
+            c->status = atoi(start + 9);
+            c->body_left = 0;
+            c->closing = 0;
+            for (char *line = strstr(start, "\r\n"); line; line = strstr(line + 2, "\r\n")) {
+                if (strncasecmp(line + 2, "Content-Length:", 15) == 0) {
+                    c->body_left = strtoull(line + 17, NULL, 10);
+                } else if (strncasecmp(line + 2, "Connection: close", 17) == 0) {
+                    c->closing = 1;
+                }
+            }
+            if (c->status == 200) {
+                stats.body_bytes += c->body_left;
+            }
+            c->in_body = 1;
+            pos = (size_t)(end - c->in) + 4;
+        }
+
+        size_t take = c->in_len - pos < c->body_left ? c->in_len - pos : c->body_left;
+        pos += take;
+        c->body_left -= take;
+        if (c->body_left > 0) {
+            break;
+        }
+
+        c->in_body = 0;
+        if (c->inflight == 0) {
+            fprintf(stderr, "Response without a request\n");
+            return -1;
+        }
+        if (c->status == 200) {
+            stats.status_200++;
+            if (record(now - c->sent[c->head]) < 0) {
+                return -1;
+            }
+        } else if (c->status == 429) {
+            stats.status_429++;
+        } else if (c->status == 503) {
+            stats.status_503++;
+        } else {
+            stats.status_other++;
+        }
+        c->head = (c->head + 1) % MAX_DEPTH;
+        c->inflight--;
+    }
+    memmove(c->in, c->in + pos, c->in_len - pos);
+    c->in_len -= pos;
+    return 0;
+}
+
+// Returns -1 if the connection was dropped
+static int client_event(struct client *c, uint32_t events, double now, double end) {
+    if (!c->connected && events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err) {
+            fprintf(stderr, "connect: %s\n", strerror(err));
+            client_drop(c);
+            return -1;
+        }
+        c->connected = 1;
+    }
+
+    if (events & EPOLLIN) {
+        for (;;) {
+            ssize_t r = read(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len);
+            if (r < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN) break;
+                client_drop(c);
+                return -1;
+            }
+            if (r == 0) {
+                client_drop(c);
+                return -1;
+            }
+            c->in_len += (size_t)r;
+            if (client_parse(c, now) < 0) {
+                client_drop(c);
+                return -1;
+            }
+            if (c->in_len == sizeof(c->in)) {
+                fprintf(stderr, "Response header too large\n");
+                client_drop(c);
+                return -1;
+            }
+        }
+    }
+
+    if (c->closing && c->inflight == 0) {
+        client_drop(c);
+        return -1;
+    }
+    if (client_send(c, now, end) < 0) {
+        client_drop(c);
+        return -1;
+    }
+    return 0;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile_us(double q) {
+    if (stats.count == 0) {
+        return 0.0;
+    }
+    size_t i = (size_t)(q * (stats.count - 1) + 0.5);
+    return stats.latency_ns[i] / 1e3;
+}
+
+static void report(double elapsed) {
+    qsort(stats.latency_ns, stats.count, sizeof(uint32_t), compare_u32);
+    uint64_t responses = stats.status_200 + stats.status_429 + stats.status_503 +
+                         stats.status_other;
+    double rps = responses / elapsed;
+    double mean = 0.0;
+    for (size_t i = 0; i < stats.count; i++) {
+        mean += stats.latency_ns[i];
+    }
+    mean = stats.count ? mean / stats.count / 1e3 : 0.0;
+
+    if (config.json) {
+        printf("{\"connections\": %d, \"depth\": %d, \"request\": \"%.*s\", "
+               "\"duration_s\": %.3f, \"responses\": %lu, \"rps\": %.0f, "
+               "\"body_bytes\": %lu, \"status\": {\"200\": %lu, \"429\": %lu, \"503\": %lu, "
+               "\"other\": %lu}, \"errors\": %lu, \"reconnects\": %lu, "
+               "\"latency_us\": {\"mean\": %.2f, \"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, "
+               "\"p999\": %.2f, \"max\": %.2f}}\n",
+               config.connections, config.depth, (int)(strchr(request + 4, ' ') - request - 4),
+               request + 4, elapsed, responses, rps, stats.body_bytes, stats.status_200,
+               stats.status_429, stats.status_503, stats.status_other, stats.errors,
+               stats.reconnects, mean, percentile_us(0.5), percentile_us(0.9),
+               percentile_us(0.99), percentile_us(0.999), percentile_us(1.0));
+        return;
+    }
+
+    printf("# %d connections x depth %d, %.1f s: %.*s\n", config.connections, config.depth,
+           elapsed, (int)(strchr(request + 4, ' ') - request - 4), request + 4);
+    printf("responses:  %lu (%.0f/s), %.2f MB/s of body\n", responses, rps,
+           stats.body_bytes / elapsed / 1e6);
+    printf("status:     200=%lu 429=%lu 503=%lu other=%lu, errors=%lu, reconnects=%lu\n",
+           stats.status_200, stats.status_429, stats.status_503, stats.status_other,
+           stats.errors, stats.reconnects);
+    printf("latency us: mean=%.1f p50=%.1f p90=%.1f p99=%.1f p999=%.1f max=%.1f (200 only)\n",
+           mean, percentile_us(0.5), percentile_us(0.9), percentile_us(0.99),
+           percentile_us(0.999), percentile_us(1.0));
+}
+
+int main(int argc, char *argv[]) {
+    if (parse_arguments(argc, argv) < 0) {
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int rv = getaddrinfo(config.host, config.port, &hints, &server_addr);
+    if (rv != 0) {
+        fprintf(stderr, "%s:%s: %s\n", config.host, config.port, gai_strerror(rv));
+        return 1;
+    }
+
+    int n;
+    if (config.path) {
+        n = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: %s\r\n\r\n",
+                     config.path, config.host);
+    } else {
+        n = snprintf(request, sizeof(request),
+                     "GET /random?bytes=%zu&format=%s HTTP/1.1\r\nHost: %s\r\n\r\n",
+                     config.bytes, config.format, config.host);
+    }
+    if (n < 0 || (size_t)n >= sizeof(request)) {
+        fprintf(stderr, "Request too long\n");
+        return 1;
+    }
+    request_len = (size_t)n;
+
+    epfd = epoll_create1(0);
+    if (epfd < 0) {
+        perror("epoll_create1");
+        return 1;
+    }
+    struct client *clients = calloc(config.connections, sizeof(*clients));
+    if (!clients) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 1;
+    }
+    for (int i = 0; i < config.connections; i++) {
+        clients[i].out = malloc(request_len * config.depth);
+        if (!clients[i].out || client_connect(&clients[i]) < 0) {
+            return 1;
+        }
+    }
+
+    double start = hb_wall_seconds();
+    double end = config.requests ? 0.0 : start + config.duration;
+    double drain_until = 0.0;
+    struct epoll_event events[256];
+    int failed = 0;
+
+    for (;;) {
+        double now = hb_wall_seconds();
+        int inflight = 0, open = 0;
+        for (int i = 0; i < config.connections; i++) {
+            inflight += clients[i].inflight;
+            open += clients[i].fd >= 0;
+        }
+        if (!more_requests(now, end)) {
+            if (inflight == 0) break;
+            if (drain_until == 0.0) drain_until = now + DRAIN_S;
+            if (now > drain_until) break;
+        }
+        if (open == 0 && stats.status_200 + stats.status_429 + stats.status_503 == 0) {
+            failed = 1;
+            break;
+        }
+
+        int ready = epoll_wait(epfd, events, 256, 100);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            return 1;
+        }
+        now = hb_wall_seconds();
+        for (int i = 0; i < ready; i++) {
+            client_event(events[i].data.ptr, events[i].events, now, end);
+        }
+
+        // Replace connections the server closed while there is work left
+        for (int i = 0; i < config.connections; i++) {
+            if (clients[i].fd < 0 && more_requests(now, end) &&
+                stats.status_200 + stats.status_429 + stats.status_503 > 0) {
+                if (client_connect(&clients[i]) == 0) {
+                    stats.reconnects++;
+                }
+            }
+        }
+    }
+    double elapsed = hb_wall_seconds() - start;
+
+    for (int i = 0; i < config.connections; i++) {
+        if (clients[i].fd >= 0) client_drop(&clients[i]);
+        free(clients[i].out);
+    }
+    free(clients);
+    freeaddrinfo(server_addr);
+    close(epfd);
+
+    if (failed) {
+        fprintf(stderr, "No connection to %s:%s succeeded\n", config.host, config.port);
+        return 1;
+    }
+    report(elapsed);
+
+    rv = 0;
+    if (stats.count == 0) {
+        rv = 1;
+    } else if (config.p99_target_us > 0.0 && percentile_us(0.99) > config.p99_target_us) {
+        fprintf(stderr, "# p99 %.1f us exceeds the %.1f us target\n", percentile_us(0.99),
+                config.p99_target_us);
+        rv = 2;
+    }
+    free(stats.latency_ns);
+    return rv;
+}
@@ -0,0 +1,374 @@
+// hotbits-monitor - continuous quality monitor for the extracted bit stream
+//
+// Consumes packed random bytes (stdin or a file, optionally followed as it
+// grows) and keeps the quicktest battery over rolling windows of the most
+// recent bits. Each window is updated in constant time per 64-bit word, and
+// a report is published every interval, so a degrading source shows up
+// within seconds instead of at the next hourly batch run.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "input.h"
+#include "monitor.h"
+#include "timing.h"
+
+#define READ_SIZE (1 << 16)
+#define FOLLOW_POLL_S 0.2
+
+typedef struct {
+    uint64_t window_bits[HB_MONITOR_MAX_WINDOWS];
+    char window_labels[HB_MONITOR_MAX_WINDOWS][16];
+    size_t window_count;
+    double interval;
+    uint64_t every_bits;
+    int follow;
+    const char *status_path;
+    double alpha;
+    int verbose;
+} Config;
+
+static Config config = {
+    .window_count = 0,
+    .interval = 10.0,
+    .every_bits = 0,
+    .follow = 0,
+    .status_path = NULL,
+    .alpha = HB_ALPHA,
+    .verbose = 0
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [OPTIONS] [FILE]\n", prog);
+    fprintf(stderr, "Monitors packed random bytes from FILE (default: stdin), e.g. the output of\n");
+    fprintf(stderr, "hotbits-extract. Reports are JSON lines on stdout.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -w, --windows LIST       Window lengths in bits with K/M/G suffixes\n");
+    fprintf(stderr, "                           (default: 1M,10M,100M; at most %d)\n",
+            HB_MONITOR_MAX_WINDOWS);
+    fprintf(stderr, "  -i, --interval SECONDS   Publish a report every SECONDS (default: 10)\n");
+    fprintf(stderr, "  -e, --every BITS         Publish every BITS of input instead (for replays)\n");
+    fprintf(stderr, "  -f, --follow             Keep reading FILE as it grows, like tail -f\n");
+    fprintf(stderr, "  -s, --status FILE        Also keep FILE replaced with the latest report\n");
+    fprintf(stderr, "  -a, --alpha P            Significance level for failures (default: %g)\n", HB_ALPHA);
+    fprintf(stderr, "  -v, --verbose            Print a summary per window to stderr\n");
+    fprintf(stderr, "  -?, --help               Show this help message\n");
+}
+
+// Decimal bit counts with an optional K, M or G suffix
+static int parse_bits(const char *s, uint64_t *bits) {
+    char *end;
+    double v = strtod(s, &end);
+    switch (*end) {
+        case 'k': case 'K': v *= 1e3; end++; break;
+        case 'm': case 'M': v *= 1e6; end++; break;
+        case 'g': case 'G': v *= 1e9; end++; break;
+    }
+    if (end == s || *end != '\0' || v < 1.0) {
+        return -1;
+    }
+    *bits = (uint64_t)v;
+    return 0;
+}
+
+static int parse_windows(const char *list) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", list);
+
+    config.window_count = 0;
+    for (char *save, *tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        if (config.window_count == HB_MONITOR_MAX_WINDOWS) {
+            fprintf(stderr, "At most %d windows\n", HB_MONITOR_MAX_WINDOWS);
+            return -1;
+        }
+        if (parse_bits(tok, &config.window_bits[config.window_count]) < 0) {
+            fprintf(stderr, "Invalid window length: %s\n", tok);
+            return -1;
+        }
+        snprintf(config.window_labels[config.window_count],
+                 sizeof(config.window_labels[0]), "%s", tok);
+        config.window_count++;
+    }
+    return config.window_count ? 0 : -1;
+}
+
+int parse_arguments(int argc, char *argv[]) {
+    static struct option long_options[] = {
+        {"windows",  required_argument, 0, 'w'},
+        {"interval", required_argument, 0, 'i'},
+        {"every",    required_argument, 0, 'e'},
+        {"follow",   no_argument,       0, 'f'},
+        {"status",   required_argument, 0, 's'},
+        {"alpha",    required_argument, 0, 'a'},
+        {"verbose",  no_argument,       0, 'v'},
+        {"help",     no_argument,       0, '?'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "w:i:e:fs:a:v?", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'w':
+                if (parse_windows(optarg) < 0) {
+                    return -1;
+                }
+                break;
+            case 'i':
+                config.interval = atof(optarg);
+                if (config.interval <= 0.0) {
+                    fprintf(stderr, "Invalid interval: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'e':
+                if (parse_bits(optarg, &config.every_bits) < 0) {
+                    fprintf(stderr, "Invalid bit count: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'f':
+                config.follow = 1;
+                break;
+            case 's':
+                config.status_path = optarg;
+                break;
+            case 'a':
+                config.alpha = atof(optarg);
+                if (config.alpha <= 0.0 || config.alpha >= 1.0) {
+                    fprintf(stderr, "Invalid alpha: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'v':
+                config.verbose = 1;
+                break;
+            case '?':
+                print_usage(argv[0]);
+                exit(0);
+            default:
+                print_usage(argv[0]);
+                return -1;
+        }
+    }
+
+    if (config.window_count == 0) {
+        parse_windows("1M,10M,100M");
+    }
+    if (argc - optind > 1) {
+        print_usage(argv[0]);
+        return -1;
+    }
+    if (config.follow && optind == argc) {
+        fprintf(stderr, "--follow needs a FILE\n");
+        return -1;
+    }
+    return 0;
+}
+
+static void handle_signal(int sig) {
+    (void)sig;
+    stopping = 1;
+}
+
+static void iso_timestamp(char *buf, size_t len) {
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    // date -Iseconds style: +hh:mm rather than strftime's +hhmm
+    char zone[8];
+    strftime(buf, len, "%Y-%m-%dT%H:%M:%S", &tm);
+    strftime(zone, sizeof(zone), "%z", &tm);
+    size_t n = strlen(buf);
+    snprintf(buf + n, len - n, "%.3s:%.2s", zone, zone + 3);
+}
+
+static void write_report(FILE *f, const struct hb_monitor *m, uint64_t bits, double rate) {
+    char ts[64];
+    iso_timestamp(ts, sizeof(ts));
+
+    fprintf(f, "{\"timestamp\": \"%s\", \"bits\": %lu, \"rate_bps\": %.0f, \"windows\": [",
+            ts, bits, rate);
+    for (size_t w = 0; w < m->window_count; w++) {
+        struct hb_test_result results[HB_QUICK_TESTS];
+        hb_monitor_results(m, w, results);
+
+        int pass = 1;
+        fprintf(f, "%s{\"window\": \"%s\", \"window_bits\": %lu, \"bits\": %lu, \"tests\": {",
+                w ? ", " : "", config.window_labels[w], m->windows[w].words * 64,
+                hb_monitor_window_bits(m, w));
+        for (int t = 0; t < HB_QUICK_TESTS; t++) {
+            int ok = results[t].p_value >= config.alpha;
+            pass &= ok;
+            fprintf(f, "%s\"%s\": {\"statistic\": %.6g, \"p_value\": %.6g, \"pass\": %s}",
+                    t ? ", " : "", results[t].name, results[t].statistic, results[t].p_value,
+                    ok ? "true" : "false");
+        }
+        fprintf(f, "}, \"pass\": %s}", pass ? "true" : "false");
+    }
+    fprintf(f, "]}\n");
+}
+
+static void print_summary(const struct hb_monitor *m, uint64_t bits, double rate) {
+    fprintf(stderr, "# %lu bits (%.0f bit/s)\n", bits, rate);
+    for (size_t w = 0; w < m->window_count; w++) {
+        struct hb_test_result results[HB_QUICK_TESTS];
+        hb_monitor_results(m, w, results);
+
+        fprintf(stderr, "#   %-6s", config.window_labels[w]);
+        int failed = 0;
+        for (int t = 0; t < HB_QUICK_TESTS; t++) {
+            fprintf(stderr, " %s=%.4f", results[t].name, results[t].p_value);
+            failed += results[t].p_value < config.alpha;
+        }
+        if (hb_monitor_window_bits(m, w) < m->windows[w].words * 64) {
+            fprintf(stderr, " (filling: %lu bits)", hb_monitor_window_bits(m, w));
+        }
+        fprintf(stderr, "%s\n", failed ? " FAIL" : "");
+    }
+}
+
+static int write_status(const struct hb_monitor *m, uint64_t bits, double rate) {
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", config.status_path);
+
+    FILE *f = fopen(tmp, "w");
+    if (!f) {
+        perror(tmp);
+        return -1;
+    }
+    write_report(f, m, bits, rate);
+    if (fclose(f) != 0 || rename(tmp, config.status_path) < 0) {
+        perror(config.status_path);
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+static void publish(const struct hb_monitor *m, uint64_t bits, double rate) {
+    write_report(stdout, m, bits, rate);
+    fflush(stdout);
+    if (config.status_path) {
+        write_status(m, bits, rate);
+    }
+    if (config.verbose) {
+        print_summary(m, bits, rate);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (parse_arguments(argc, argv) < 0) {
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_signal;    // no SA_RESTART: wake poll() to publish
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    struct hb_monitor monitor;
+    if (hb_monitor_init(&monitor, config.window_bits, config.window_count) < 0) {
+        return 1;
+    }
+
+    struct hb_input in;
+    if (hb_input_open(&in, optind < argc ? argv[optind] : "-", 0) < 0) {
+        hb_monitor_free(&monitor);
+        return 1;
+    }
+    if (config.follow && in.running) {
+        fprintf(stderr, "--follow needs an uncompressed regular file\n");
+        hb_input_close(&in);
+        hb_monitor_free(&monitor);
+        return 1;
+    }
+
+    static uint8_t buf[READ_SIZE];
+    uint64_t bytes = 0;
+    uint64_t published_bytes = 0;
+    int published = 0;
+    double last = hb_wall_seconds();
+    int rv = 0;
+
+    while (!stopping) {
+        double now = hb_wall_seconds();
+        double wait = last + config.interval - now;
+
+        // Publish on time even while the source is stalled; that is when
+        // the report matters most
+        if (!config.every_bits && wait <= 0.0) {
+            publish(&monitor, bytes * 8, (bytes - published_bytes) * 8 / (now - last));
+            published_bytes = bytes;
+            published = 1;
+            last = now;
+            continue;
+        }
+
+        if (!config.every_bits) {
+            struct pollfd pfd = { .fd = in.fd, .events = POLLIN };
+            int r = poll(&pfd, 1, (int)(wait * 1000) + 1);
+            if (r == 0 || (r < 0 && errno == EINTR)) {
+                continue;
+            }
+        }
+
+        ssize_t n = read(in.fd, buf, sizeof(buf));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("read");
+            rv = -1;
+            break;
+        }
+        if (n == 0) {
+            if (!config.follow) {
+                break;
+            }
+            // A truncated or replaced file starts over from its beginning
+            struct stat st;
+            off_t pos = lseek(in.fd, 0, SEEK_CUR);
+            if (fstat(in.fd, &st) == 0 && pos > st.st_size) {
+                fprintf(stderr, "%s: file truncated, reading from start\n", in.name);
+                lseek(in.fd, 0, SEEK_SET);
+            }
+            double pause = config.every_bits || wait > FOLLOW_POLL_S ? FOLLOW_POLL_S : wait;
+            struct timespec ts = { 0, (long)(pause * 1e9) };
+            nanosleep(&ts, NULL);
+            continue;
+        }
+
+        hb_monitor_push(&monitor, buf, n);
+        bytes += n;
+
+        if (config.every_bits && (bytes - published_bytes) * 8 >= config.every_bits) {
+            now = hb_wall_seconds();
+            publish(&monitor, bytes * 8, (bytes - published_bytes) * 8 / (now - last));
+            published_bytes = bytes;
+            published = 1;
+            last = now;
+        }
+    }
+
+    // Final report for whatever arrived since the last one
+    if (!published || bytes != published_bytes) {
+        double now = hb_wall_seconds();
+        publish(&monitor, bytes * 8, now > last ? (bytes - published_bytes) * 8 / (now - last) : 0.0);
+    }
+
+    if (hb_input_close(&in) < 0 && !stopping) {
+        rv = -1;
+    }
+    hb_monitor_free(&monitor);
+    return rv == 0 ? 0 : 1;
+}
@@ -0,0 +1,266 @@
+// hotbits-pack - pack event segments into the .hbc block codec
+//
+// Converts closed events-N.txt segments to events-N.hbc (and back with -d).
+// The archive reader, hotbits-eval and hotbits-extract read either form, so
+// old segments can be packed in place.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include "codec.h"
+#include "events.h"
+#include "index.h"
+#include "timing.h"
+
+typedef struct {
+    uint32_t block_len;
+    int decompress;
+    int to_stdout;
+    const char *output;
+    int remove_source;
+    int verbose;
+} Config;
+
+static Config config = {
+    .block_len = HB_CODEC_BLOCK_DEFAULT,
+    .decompress = 0,
+    .to_stdout = 0,
+    .output = NULL,
+    .remove_source = 0,
+    .verbose = 0
+};
+
+void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [OPTIONS] FILE...\n", prog);
+    fprintf(stderr, "Packs events-N.txt[.gz|.zst] into events-N%s; '-' reads stdin (requires -o).\n",
+            HB_CODEC_SUFFIX);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -b, --block N        Values per block (default: %d, max: %d)\n",
+            HB_CODEC_BLOCK_DEFAULT, HB_CODEC_BLOCK_MAX);
+    fprintf(stderr, "  -d, --decompress     Unpack %s files back to event text\n", HB_CODEC_SUFFIX);
+    fprintf(stderr, "  -c, --stdout         With -d, write event text to stdout\n");
+    fprintf(stderr, "  -o, --output FILE    Output path (single input only)\n");
+    fprintf(stderr, "  -r, --remove         Remove the text segment and its index after a verified pack\n");
+    fprintf(stderr, "  -v, --verbose        Print sizes, bits per event and decode speed\n");
+    fprintf(stderr, "  -?, --help           Show this help message\n");
+}
+
+int parse_arguments(int argc, char *argv[]) {
+    static struct option long_options[] = {
+        {"block",      required_argument, 0, 'b'},
+        {"decompress", no_argument,       0, 'd'},
+        {"stdout",     no_argument,       0, 'c'},
+        {"output",     required_argument, 0, 'o'},
+        {"remove",     no_argument,       0, 'r'},
+        {"verbose",    no_argument,       0, 'v'},
+        {"help",       no_argument,       0, '?'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "b:dco:rv?", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'b': {
+                long n = atol(optarg);
+                if (n <= 0 || n > HB_CODEC_BLOCK_MAX) {
+                    fprintf(stderr, "Invalid block length: %s\n", optarg);
+                    return -1;
+                }
+                config.block_len = (uint32_t)n;
+                break;
+            }
+            case 'd':
+                config.decompress = 1;
+                break;
+            case 'c':
+                config.to_stdout = 1;
+                break;
+            case 'o':
+                config.output = optarg;
+                break;
+            case 'r':
+                config.remove_source = 1;
+                break;
+            case 'v':
+                config.verbose = 1;
+                break;
+            case '?':
+                print_usage(argv[0]);
+                exit(0);
+            default:
+                print_usage(argv[0]);
+                return -1;
+        }
+    }
+
+    if (optind == argc) {
+        print_usage(argv[0]);
+        return -1;
+    }
+    if (config.output && argc - optind > 1) {
+        fprintf(stderr, "-o/--output takes a single input\n");
+        return -1;
+    }
+    return 0;
+}
+
+// events-N.txt -> events-N.hbc and back
+static void output_path(char *buf, size_t len, const char *input, const char *from, const char *to) {
+    size_t n = strlen(input);
+    size_t f = strlen(from);
+    if (n > f && strcmp(input + n - f, from) == 0) {
+        snprintf(buf, len, "%.*s%s", (int)(n - f), input, to);
+    } else {
+        snprintf(buf, len, "%s%s", input, to);
+    }
+}
+
+static uint64_t file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (uint64_t)st.st_size : 0;
+}
+
+static int pack_file(const char *input) {
+    char out[PATH_MAX];
+    struct hb_events ev, check;
+    int rv = -1;
+
+    if (config.output) {
+        snprintf(out, sizeof(out), "%s", config.output);
+    } else if (strcmp(input, "-") == 0) {
+        fprintf(stderr, "Packing stdin requires -o/--output\n");
+        return -1;
+    } else {
+        char gz[PATH_MAX], zst[PATH_MAX];
+        output_path(gz, sizeof(gz), input, ".gz", "");
+        output_path(zst, sizeof(zst), gz, ".zst", "");
+        output_path(out, sizeof(out), zst, ".txt", HB_CODEC_SUFFIX);
+    }
+
+    hb_events_init(&ev);
+    hb_events_init(&check);
+
+    // "-" and compressed files both go through the decompressing reader
+    if (hb_events_load_file(&ev, input) < 0) {
+        goto out;
+    }
+
+    struct hb_codec_writer w;
+    if (hb_codec_writer_open(&w, out, config.block_len) < 0) {
+        goto out;
+    }
+    if (hb_codec_writer_add(&w, ev.values, ev.count) < 0) {
+        hb_codec_writer_abort(&w);
+        goto out;
+    }
+    if (hb_codec_writer_close(&w) < 0) {
+        goto out;
+    }
+
+    // Verify the round trip before the source may be removed
+    double wall = hb_wall_seconds();
+    if (hb_codec_load_file(&check, out) < 0) {
+        goto out;
+    }
+    wall = hb_wall_seconds() - wall;
+    if (check.count != ev.count ||
+        memcmp(check.values, ev.values, ev.count * sizeof(uint64_t)) != 0) {
+        fprintf(stderr, "%s: round trip mismatch, keeping %s\n", out, input);
+        unlink(out);
+        goto out;
+    }
+
+    if (config.verbose) {
+        uint64_t in_bytes = strcmp(input, "-") == 0 ? 0 : file_size(input);
+        uint64_t out_bytes = file_size(out);
+        fprintf(stderr, "%s: %zu events, %lu -> %lu bytes", out, ev.count, in_bytes, out_bytes);
+        if (ev.count) {
+            fprintf(stderr, " (%.2f bits/event", 8.0 * out_bytes / ev.count);
+            if (wall > 0) {
+                fprintf(stderr, ", decode %.0f Mevents/s, %.2f GB/s",
+                        ev.count / wall / 1e6, ev.count * 8.0 / wall / 1e9);
+            }
+            fprintf(stderr, ")");
+        }
+        fprintf(stderr, "\n");
+    }
+
+    if (config.remove_source && strcmp(input, "-") != 0) {
+        char idx[PATH_MAX];
+        hb_index_path(idx, sizeof(idx), input);
+        if (unlink(input) < 0) {
+            perror(input);
+            goto out;
+        }
+        unlink(idx);
+    }
+    rv = 0;
+
+out:
+    hb_events_free(&ev);
+    hb_events_free(&check);
+    return rv;
+}
+
+static int unpack_file(const char *input) {
+    char out_path[PATH_MAX];
+    struct hb_events ev;
+    FILE *out = stdout;
+
+    hb_events_init(&ev);
+    if (hb_codec_load_file(&ev, input) < 0) {
+        return -1;
+    }
+
+    if (!config.to_stdout) {
+        if (config.output) {
+            snprintf(out_path, sizeof(out_path), "%s", config.output);
+        } else {
+            output_path(out_path, sizeof(out_path), input, HB_CODEC_SUFFIX, ".txt");
+        }
+        out = fopen(out_path, "w");
+        if (!out) {
+            perror(out_path);
+            hb_events_free(&ev);
+            return -1;
+        }
+    }
+
+    for (size_t i = 0; i < ev.count; i++) {
+        fprintf(out, "%lu\n", ev.values[i]);
+    }
+
+    int rv = 0;
+    if (out != stdout) {
+        if (fclose(out) != 0) {
+            perror(out_path);
+            rv = -1;
+        }
+    } else if (fflush(out) != 0) {
+        perror("stdout");
+        rv = -1;
+    }
+    hb_events_free(&ev);
+    return rv;
+}
+
+int main(int argc, char *argv[]) {
+    if (parse_arguments(argc, argv) < 0) {
+        return 1;
+    }
+
+    int rv = 0;
+    for (int i = optind; i < argc; i++) {
+        if ((config.decompress ? unpack_file(argv[i]) : pack_file(argv[i])) < 0) {
+            rv = 1;
+        }
+    }
+    return rv;
+}
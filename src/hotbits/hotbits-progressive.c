@@ -0,0 +1,259 @@
+// hotbits-progressive - progressive randomness testing (PractRand style)
+//
+// Reads packed random bytes once and evaluates the battery at every
+// power-of-two length from cumulative state, so a short capture is tested
+// at the lengths it actually has instead of being tiled up to a fixed
+// sample size. Reports the first length at which any result becomes
+// suspicious.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+
+#include "input.h"
+#include "progressive.h"
+#include "timing.h"
+
+#define READ_SIZE (1 << 20)
+
+typedef struct {
+    int min_exp;
+    int max_exp;
+    int stop;
+    int json;
+    int verbose;
+} Config;
+
+static Config config = {
+    .min_exp = 10,
+    .max_exp = 62,
+    .stop = 0,
+    .json = 0,
+    .verbose = 0
+};
+
+void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [OPTIONS] [FILE]\n", prog);
+    fprintf(stderr, "Tests packed random bytes from FILE (default: stdin) at 2^min, 2^(min+1), ...\n");
+    fprintf(stderr, "bytes. Exits with status 2 if any result is suspicious or worse.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -m, --min-exp N          First length tested is 2^N bytes (default: 10)\n");
+    fprintf(stderr, "  -x, --max-exp N          Stop after testing 2^N bytes\n");
+    fprintf(stderr, "  -s, --stop               Stop at the first suspicious length\n");
+    fprintf(stderr, "  -j, --json               One JSON object per length instead of text\n");
+    fprintf(stderr, "  -v, --verbose            List every result, not only anomalies\n");
+    fprintf(stderr, "  -?, --help               Show this help message\n");
+}
+
+int parse_arguments(int argc, char *argv[]) {
+    static struct option long_options[] = {
+        {"min-exp", required_argument, 0, 'm'},
+        {"max-exp", required_argument, 0, 'x'},
+        {"stop",    no_argument,       0, 's'},
+        {"json",    no_argument,       0, 'j'},
+        {"verbose", no_argument,       0, 'v'},
+        {"help",    no_argument,       0, '?'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "m:x:sjv?", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'm':
+                config.min_exp = atoi(optarg);
+                break;
+            case 'x':
+                config.max_exp = atoi(optarg);
+                break;
+            case 's':
+                config.stop = 1;
+                break;
+            case 'j':
+                config.json = 1;
+                break;
+            case 'v':
+                config.verbose = 1;
+                break;
+            case '?':
+                print_usage(argv[0]);
+                exit(0);
+            default:
+                print_usage(argv[0]);
+                return -1;
+        }
+    }
+
+    if (config.min_exp < 3 || config.max_exp > 62 || config.min_exp > config.max_exp) {
+        fprintf(stderr, "Exponents must satisfy 3 <= min <= max <= 62\n");
+        return -1;
+    }
+    if (argc - optind > 1) {
+        print_usage(argv[0]);
+        return -1;
+    }
+    return 0;
+}
+
+static void format_length(char *buf, size_t len, int exp) {
+    static const char *units[] = { "byte", "kilobyte", "megabyte", "gigabyte", "terabyte" };
+    int unit = exp / 10 < 4 ? exp / 10 : 4;
+    uint64_t value = 1ull << (exp - 10 * unit);
+    snprintf(buf, len, "%lu %s%s (2^%d bytes)", value, units[unit], value > 1 ? "s" : "", exp);
+}
+
+static void print_json(int exp, double elapsed, const struct hb_test_result *results,
+                       enum hb_grade worst) {
+    printf("{\"exp\": %d, \"bytes\": %lu, \"time_s\": %.3f, \"tests\": {", exp, 1ul << exp, elapsed);
+    int first = 1;
+    for (int t = 0; t < HB_PROGRESSIVE_TESTS; t++) {
+        if (isnan(results[t].p_value)) {
+            continue;
+        }
+        printf("%s\"%s\": {\"statistic\": %.6g, \"p_value\": %.6g, \"evaluation\": \"%s\"}",
+               first ? "" : ", ", results[t].name, results[t].statistic, results[t].p_value,
+               hb_grade_name(hb_progressive_grade(t, results[t].p_value)));
+        first = 0;
+    }
+    printf("}, \"evaluation\": \"%s\"}\n", hb_grade_name(worst));
+}
+
+static void print_text(int exp, double elapsed, const struct hb_test_result *results) {
+    char length[64];
+    format_length(length, sizeof(length), exp);
+    printf("length= %s, time= %.1f seconds\n", length, elapsed);
+
+    int tested = 0, listed = 0;
+    for (int t = 0; t < HB_PROGRESSIVE_TESTS; t++) {
+        if (isnan(results[t].p_value)) {
+            continue;
+        }
+        tested++;
+        enum hb_grade grade = hb_progressive_grade(t, results[t].p_value);
+        if (grade == HB_GRADE_NORMAL && !config.verbose) {
+            continue;
+        }
+        if (listed++ == 0) {
+            printf("  %-20s %16s %14s   %s\n", "Test Name", "Raw", "Processed", "Evaluation");
+        }
+        printf("  %-20s R=%14.6g p = %10.3g   %s\n", results[t].name, results[t].statistic,
+               results[t].p_value, grade == HB_GRADE_NORMAL ? "" : hb_grade_name(grade));
+    }
+    if (listed == 0) {
+        printf("  no anomalies in %d test result(s)\n", tested);
+    } else if (listed < tested) {
+        printf("  ...and %d test result(s) without anomalies\n", tested - listed);
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+    if (parse_arguments(argc, argv) < 0) {
+        return 1;
+    }
+
+    struct hb_progressive prog;
+    if (hb_progressive_init(&prog) < 0) {
+        return 1;
+    }
+
+    struct hb_input in;
+    if (hb_input_open(&in, optind < argc ? argv[optind] : "-", 0) < 0) {
+        hb_progressive_free(&prog);
+        return 1;
+    }
+
+    static uint8_t buf[READ_SIZE];
+    size_t pos = 0;
+    size_t have = 0;
+    uint64_t total = 0;
+    int exp = config.min_exp;
+    int first_suspicious = -1;
+    char first_test[64] = "";
+    double first_p = 0.0;
+    double start = hb_wall_seconds();
+    int rv = 0;
+
+    while (exp <= config.max_exp) {
+        // Feed at most up to the next power of two so it can be evaluated
+        if (have == 0) {
+            ssize_t r = read(in.fd, buf, sizeof(buf));
+            if (r < 0) {
+                if (errno == EINTR) continue;
+                perror("read");
+                rv = -1;
+                break;
+            }
+            if (r == 0) {
+                break;
+            }
+            pos = 0;
+            have = r;
+        }
+        uint64_t target = 1ull << exp;
+        size_t n = target - total < have ? (size_t)(target - total) : have;
+        hb_progressive_update(&prog, buf + pos, n);
+        pos += n;
+        have -= n;
+        total += n;
+        if (total < target) {
+            continue;
+        }
+
+        struct hb_test_result results[HB_PROGRESSIVE_TESTS];
+        hb_progressive_results(&prog, results);
+
+        enum hb_grade worst = HB_GRADE_NORMAL;
+        for (int t = 0; t < HB_PROGRESSIVE_TESTS; t++) {
+            enum hb_grade grade = hb_progressive_grade(t, results[t].p_value);
+            if (grade > worst) {
+                worst = grade;
+            }
+            if (grade >= HB_GRADE_SUSPICIOUS && first_suspicious < 0) {
+                first_suspicious = exp;
+                snprintf(first_test, sizeof(first_test), "%s", results[t].name);
+                first_p = results[t].p_value;
+            }
+        }
+
+        double elapsed = hb_wall_seconds() - start;
+        if (config.json) {
+            print_json(exp, elapsed, results, worst);
+        } else {
+            print_text(exp, elapsed, results);
+        }
+
+        if (config.stop && first_suspicious >= 0) {
+            break;
+        }
+        exp++;
+    }
+
+    if (hb_input_close(&in) < 0 && !(config.stop && first_suspicious >= 0) &&
+        exp <= config.max_exp) {
+        rv = -1;
+    }
+
+    if (!config.json) {
+        if (total < (1ull << config.min_exp)) {
+            fprintf(stderr, "# Only %lu bytes; the first length tested is 2^%d bytes\n",
+                    total, config.min_exp);
+        } else if (first_suspicious >= 0) {
+            fprintf(stderr, "# First suspicious length: 2^%d bytes (%s p = %.3g)\n",
+                    first_suspicious, first_test, first_p);
+        } else {
+            fprintf(stderr, "# No suspicious results up to 2^%d bytes (%lu bytes read)\n",
+                    exp - 1, total);
+        }
+    }
+
+    hb_progressive_free(&prog);
+    if (rv < 0) {
+        return 1;
+    }
+    return first_suspicious >= 0 ? 2 : 0;
+}
@@ -0,0 +1,1066 @@
+// hotbits-serve - HTTP/1.1 random byte service
+//
+// Serves GET /random?bytes=N&format=raw|hex|json from a pool that a fill
+// thread keeps topped up with packed random bytes (hotbits-extract output,
+// or trng events run through the pipeline with --events). One epoll loop
+// handles every connection: requests may be pipelined on keep-alive
+// connections, and the responses queued on a connection go out together
+// in a single writev. Each client address has a token bucket in bytes per
+// second, and a connection answers at most a few requests per turn of the
+// loop, so one greedy client cannot starve the others. Bytes are served
+// once; when the pool runs dry requests get 503 rather than waiting.
+
+#define _GNU_SOURCE     // accept4, memmem
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "histogram.h"
+#include "hotbits.h"
+#include "input.h"
+#include "randpool.h"
+#include "timing.h"
+
+#define READ_SIZE (1 << 16)
+#define MAX_REQUEST 8192          // request line and headers
+#define MAX_EVENTS 256
+#define TURN_REQUESTS 16          // requests answered per connection per turn
+#define MAX_QUEUED (1 << 20)      // stop reading a connection above this output
+#define MAX_IOV 64
+#define BUCKET_SLOTS 4096
+#define FOLLOW_POLL_MS 200
+
+typedef struct {
+    const char *address;
+    const char *port;
+    size_t pool_bytes;
+    size_t max_request;
+    double rate;
+    double burst;
+    int max_conns;
+    double idle_timeout;
+    int events;
+    int follow;
+    int verbose;
+} Config;
+
+static Config config = {
+    .address = "127.0.0.1",
+    .port = "8093",
+    .pool_bytes = 1 << 20,
+    .max_request = 65536,
+    .rate = 65536.0,
+    .burst = 262144.0,
+    .max_conns = 1024,
+    .idle_timeout = 60.0,
+    .events = 0,
+    .follow = 0,
+    .verbose = 0
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [OPTIONS] [FILE]\n", prog);
+    fprintf(stderr, "Serves random bytes from FILE (default: stdin) over HTTP/1.1:\n");
+    fprintf(stderr, "  GET /random?bytes=N&format=raw|hex|json   N random bytes (default 32, raw)\n");
+    fprintf(stderr, "  GET /stats                                pool and request counters\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -l, --listen ADDR        Address to bind (default: 127.0.0.1)\n");
+    fprintf(stderr, "  -p, --port PORT          Port to listen on (default: 8093)\n");
+    fprintf(stderr, "  -e, --events             FILE holds trng events; extract them with the\n");
+    fprintf(stderr, "                           default pipeline instead of serving packed bytes\n");
+    fprintf(stderr, "  -f, --follow             Keep reading FILE as it grows\n");
+    fprintf(stderr, "  -P, --pool BYTES         Pool size, filled before serving (default: 1048576)\n");
+    fprintf(stderr, "  -m, --max-bytes N        Largest request (default: 65536)\n");
+    fprintf(stderr, "  -r, --rate BYTES         Per-client bytes per second, 0 = unlimited\n");
+    fprintf(stderr, "                           (default: 65536)\n");
+    fprintf(stderr, "  -b, --burst BYTES        Per-client burst (default: 262144)\n");
+    fprintf(stderr, "  -c, --max-conns N        Concurrent connections (default: 1024)\n");
+    fprintf(stderr, "  -t, --idle-timeout S     Close idle keep-alive connections (default: 60)\n");
+    fprintf(stderr, "  -v, --verbose            Report the source and request totals on stderr\n");
+    fprintf(stderr, "  -?, --help               Show this help message\n");
+}
+
+int parse_arguments(int argc, char *argv[]) {
+    static struct option long_options[] = {
+        {"listen",       required_argument, 0, 'l'},
+        {"port",         required_argument, 0, 'p'},
+        {"events",       no_argument,       0, 'e'},
+        {"follow",       no_argument,       0, 'f'},
+        {"pool",         required_argument, 0, 'P'},
+        {"max-bytes",    required_argument, 0, 'm'},
+        {"rate",         required_argument, 0, 'r'},
+        {"burst",        required_argument, 0, 'b'},
+        {"max-conns",    required_argument, 0, 'c'},
+        {"idle-timeout", required_argument, 0, 't'},
+        {"verbose",      no_argument,       0, 'v'},
+        {"help",         no_argument,       0, '?'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "l:p:efP:m:r:b:c:t:v?", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'l':
+                config.address = optarg;
+                break;
+            case 'p':
+                config.port = optarg;
+                break;
+            case 'e':
+                config.events = 1;
+                break;
+            case 'f':
+                config.follow = 1;
+                break;
+            case 'P':
+                config.pool_bytes = strtoull(optarg, NULL, 10);
+                break;
+            case 'm':
+                config.max_request = strtoull(optarg, NULL, 10);
+                break;
+            case 'r':
+                config.rate = atof(optarg);
+                break;
+            case 'b':
+                config.burst = atof(optarg);
+                break;
+            case 'c':
+                config.max_conns = atoi(optarg);
+                break;
+            case 't':
+                config.idle_timeout = atof(optarg);
+                break;
+            case 'v':
+                config.verbose = 1;
+                break;
+            case '?':
+                print_usage(argv[0]);
+                exit(0);
+            default:
+                print_usage(argv[0]);
+                return -1;
+        }
+    }
+
+    if (config.max_request < 1 || config.pool_bytes < config.max_request) {
+        fprintf(stderr, "--max-bytes must be at least 1 and no larger than --pool\n");
+        return -1;
+    }
+    if (config.rate < 0.0 || (config.rate > 0.0 && config.burst < (double)config.max_request)) {
+        fprintf(stderr, "--burst must be at least --max-bytes, or no request could pass\n");
+        return -1;
+    }
+    if (config.max_conns < 1 || config.idle_timeout <= 0.0) {
+        fprintf(stderr, "--max-conns and --idle-timeout must be positive\n");
+        return -1;
+    }
+    if (argc - optind > 1) {
+        print_usage(argv[0]);
+        return -1;
+    }
+    if (config.follow && optind == argc) {
+        fprintf(stderr, "--follow needs a FILE\n");
+        return -1;
+    }
+    return 0;
+}
+
+static void handle_signal(int sig) {
+    (void)sig;
+    stopping = 1;
+}
+
+// ---------------------------------------------------------------------------
+// Fill thread
+
+struct filler {
+    struct hb_randpool *pool;
+    struct hb_input in;
+    struct hb_stream *stream;  // --events
+    int wake_fd;               // eventfd: the loop took bytes, or stop
+    int stop;
+    int eof;                   // source exhausted, set once
+    int status;
+    uint64_t filled;
+    struct hb_histogram source_read;   // one read and extraction of --events input
+};
+
+static int fill_from_stream(struct filler *f) {
+    size_t space = hb_randpool_space(f->pool);
+    size_t avail = hb_stream_available(f->stream);
+    if (avail > 0 && space > 0) {
+        uint8_t buf[READ_SIZE];
+        size_t n = hb_stream_pull(f->stream, buf, space < sizeof(buf) ? space : sizeof(buf));
+        __atomic_add_fetch(&f->filled, hb_randpool_put(f->pool, buf, n), __ATOMIC_RELAXED);
+        return 1;
+    }
+    if (avail > 0) {
+        return 0;
+    }
+    uint64_t start = hb_monotonic_ns();
+    ssize_t r = hb_stream_read_fd(f->stream, f->in.fd);
+    if (r > 0) {
+        hb_histogram_record(&f->source_read, hb_monotonic_ns() - start);
+        return 1;
+    }
+    if (r < 0) {
+        return errno == EINTR || errno == EAGAIN ? 0 : -1;
+    }
+    if (config.follow) {
+        return 0;
+    }
+    hb_stream_finish(f->stream);
+    if (hb_stream_available(f->stream) == 0) {
+        return -2;
+    }
+    return 1;
+}
+
+static int fill_from_bytes(struct filler *f) {
+    static uint8_t buf[READ_SIZE];
+    size_t space = hb_randpool_space(f->pool);
+    if (space == 0) {
+        return 0;
+    }
+    ssize_t r = read(f->in.fd, buf, space < sizeof(buf) ? space : sizeof(buf));
+    if (r > 0) {
+        // The pool only shrinks meanwhile, so everything read fits
+        __atomic_add_fetch(&f->filled, hb_randpool_put(f->pool, buf, (size_t)r), __ATOMIC_RELAXED);
+        return 1;
+    }
+    if (r < 0) {
+        return errno == EINTR || errno == EAGAIN ? 0 : -1;
+    }
+    return config.follow ? 0 : -2;
+}
+
+static void *fill_thread(void *arg) {
+    struct filler *f = arg;
+
+    while (!__atomic_load_n(&f->stop, __ATOMIC_ACQUIRE)) {
+        int r = f->stream ? fill_from_stream(f) : fill_from_bytes(f);
+        if (r == 1) {
+            continue;
+        }
+        if (r < 0) {
+            if (r == -1) {
+                perror("read");
+                f->status = -1;
+            } else if (config.verbose) {
+                fprintf(stderr, "# Source exhausted after %lu bytes\n", f->filled);
+            }
+            __atomic_store_n(&f->eof, 1, __ATOMIC_RELEASE);
+            break;
+        }
+
+        // Pool full, or following a file at its end: wait for the loop
+        // to take bytes (or for the timeout, to look for appended data)
+        struct pollfd pfd = { .fd = f->wake_fd, .events = POLLIN };
+        if (poll(&pfd, 1, FOLLOW_POLL_MS) > 0) {
+            uint64_t n;
+            if (read(f->wake_fd, &n, sizeof(n)) < 0 && errno != EAGAIN) {
+                perror("eventfd");
+            }
+        }
+    }
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Connections
+
+struct response {
+    struct response *next;
+    uint64_t received_ns;      // when the request was read
+    size_t header_len;
+    size_t body_len;
+    char header[256];
+    uint8_t body[];
+};
+
+struct conn {
+    int fd;
+    uint8_t key[16];
+    char in[MAX_REQUEST];
+    size_t in_len;
+    struct response *out_head;
+    struct response *out_tail;
+    size_t out_off;            // bytes of out_head already written
+    size_t queued;             // bytes waiting in the output queue
+    int closing;               // close once the queue drains
+    int eof;                   // peer finished sending
+    int reading;               // EPOLLIN registered
+    int writing;               // EPOLLOUT registered
+    int backlog;               // complete requests left for the next turn
+    uint64_t read_ns;          // last read that brought request bytes
+    double last_active;
+    struct conn *prev;
+    struct conn *next;
+};
+
+struct server {
+    int epfd;
+    int listen_fd;
+    struct hb_randpool pool;
+    struct hb_buckets buckets;
+    struct filler filler;
+    struct conn *conns;
+    int nconns;
+    int backlogged;            // connections with backlog set
+    double now;
+    uint8_t *scratch;          // bytes taken from the pool for one response
+
+    uint64_t requests;
+    uint64_t served_bytes;
+    uint64_t status_200;
+    uint64_t status_4xx;
+    uint64_t status_429;
+    uint64_t status_503;
+    uint64_t accepted;
+
+    struct hb_histogram pool_age;   // how long served bytes sat in the pool
+    struct hb_histogram response;   // request read to response written
+};
+
+static struct server server;
+
+static void conn_close(struct conn *c) {
+    struct server *s = &server;
+    epoll_ctl(s->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    while (c->out_head) {
+        struct response *r = c->out_head;
+        c->out_head = r->next;
+        free(r);
+    }
+    if (c->backlog) {
+        s->backlogged--;
+    }
+    if (c->prev) c->prev->next = c->next;
+    else s->conns = c->next;
+    if (c->next) c->next->prev = c->prev;
+    s->nconns--;
+    free(c);
+}
+
+static void conn_update_events(struct conn *c) {
+    int reading = !c->closing && !c->eof && c->queued < MAX_QUEUED;
+    int writing = c->out_head != NULL;
+    if (reading == c->reading && writing == c->writing) {
+        return;
+    }
+    struct epoll_event ev = {
+        .events = (reading ? EPOLLIN : 0) | (writing ? EPOLLOUT : 0),
+        .data.ptr = c
+    };
+    epoll_ctl(server.epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->reading = reading;
+    c->writing = writing;
+}
+
+// Queue a response; body is copied after the header buffer
+static struct response *queue_response(struct conn *c, int status, const char *reason,
+                                       const char *type, size_t body_len,
+                                       const char *extra_headers) {
+    struct response *r = malloc(sizeof(*r) + body_len);
+    if (!r) {
+        fprintf(stderr, "Memory allocation failed\n");
+        c->closing = 1;
+        return NULL;
+    }
+    r->next = NULL;
+    r->received_ns = c->read_ns;
+    r->body_len = body_len;
+    int n = snprintf(r->header, sizeof(r->header),
+                     "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+                     "Cache-Control: no-store\r\n%s%s\r\n",
+                     status, reason, type, body_len, extra_headers ? extra_headers : "",
+                     c->closing ? "Connection: close\r\n" : "");
+    r->header_len = (size_t)n < sizeof(r->header) ? (size_t)n : sizeof(r->header) - 1;
+
+    if (c->out_tail) c->out_tail->next = r;
+    else c->out_head = r;
+    c->out_tail = r;
+    c->queued += r->header_len + body_len;
+
+    if (status == 200) server.status_200++;
+    else if (status == 429) server.status_429++;
+    else if (status == 503) server.status_503++;
+    else server.status_4xx++;
+    return r;
+}
+
+static void queue_text(struct conn *c, int status, const char *reason, const char *text,
+                       const char *extra_headers) {
+    size_t len = strlen(text);
+    struct response *r = queue_response(c, status, reason, "text/plain", len, extra_headers);
+    if (r) {
+        memcpy(r->body, text, len);
+    }
+}
+
+static void queue_random(struct conn *c, size_t bytes, const char *format) {
+    struct server *s = &server;
+
+    if (s->buckets.slots) {
+        double wait;
+        if (hb_buckets_take(&s->buckets, c->key, s->now, (double)bytes, &wait) < 0) {
+            char retry[64];
+            snprintf(retry, sizeof(retry), "Retry-After: %.0f\r\n", wait < 1.0 ? 1.0 : wait + 0.5);
+            queue_text(c, 429, "Too Many Requests", "rate limit exceeded\n", retry);
+            return;
+        }
+    }
+    uint64_t age = hb_randpool_age(&s->pool, hb_monotonic_ns());
+    if (hb_randpool_take(&s->pool, s->scratch, bytes) < 0) {
+        queue_text(c, 503, "Service Unavailable",
+                   __atomic_load_n(&s->filler.eof, __ATOMIC_ACQUIRE) ?
+                   "random source exhausted\n" : "pool refilling\n",
+                   "Retry-After: 1\r\n");
+        return;
+    }
+
+    // Wake the fill thread when the pool drops below half full; between
+    // wakeups it also tops up on its own poll timeout
+    size_t level = hb_randpool_level(&s->pool);
+    if (level < s->pool.cap / 2 && level + bytes >= s->pool.cap / 2) {
+        uint64_t one = 1;
+        if (write(s->filler.wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            perror("eventfd");
+        }
+    }
+    s->served_bytes += bytes;
+    if (age != UINT64_MAX) {
+        hb_histogram_record(&s->pool_age, age);
+    }
+
+    static const char hex[] = "0123456789abcdef";
+    struct response *r;
+    if (strcmp(format, "hex") == 0) {
+        r = queue_response(c, 200, "OK", "text/plain", bytes * 2 + 1, NULL);
+        if (!r) return;
+        for (size_t i = 0; i < bytes; i++) {
+            r->body[2 * i] = hex[s->scratch[i] >> 4];
+            r->body[2 * i + 1] = hex[s->scratch[i] & 15];
+        }
+        r->body[bytes * 2] = '\n';
+    } else if (strcmp(format, "json") == 0) {
+        // {"bytes": N, "data": [b, b, ...]}: at most 4 characters per byte
+        char head[64];
+        int hl = snprintf(head, sizeof(head), "{\"bytes\": %zu, \"data\": [", bytes);
+        size_t len = (size_t)hl;
+        for (size_t i = 0; i < bytes; i++) {
+            len += (i ? 2 : 0) + (s->scratch[i] >= 100 ? 3 : s->scratch[i] >= 10 ? 2 : 1);
+        }
+        len += 3;
+        r = queue_response(c, 200, "OK", "application/json", len, NULL);
+        if (!r) return;
+        char *p = (char *)r->body;
+        memcpy(p, head, hl);
+        p += hl;
+        for (size_t i = 0; i < bytes; i++) {
+            unsigned v = s->scratch[i];
+            if (i) { *p++ = ','; *p++ = ' '; }
+            if (v >= 100) *p++ = '0' + v / 100;
+            if (v >= 10) *p++ = '0' + v / 10 % 10;
+            *p++ = '0' + v % 10;
+        }
+        memcpy(p, "]}\n", 3);
+    } else {
+        r = queue_response(c, 200, "OK", "application/octet-stream", bytes, NULL);
+        if (!r) return;
+        memcpy(r->body, s->scratch, bytes);
+    }
+    memset(s->scratch, 0, bytes);
+}
+
+// "name": {count, mean and percentiles}, after sep
+static int stats_histogram(char *buf, size_t len, const char *sep, const char *name,
+                           const struct hb_histogram *h) {
+    int n = snprintf(buf, len, "%s\"%s\": {", sep, name);
+    n += hb_histogram_json(h, buf + n, len - n);
+    n += snprintf(buf + n, len - n, "}");
+    return n;
+}
+
+static void queue_stats(struct conn *c) {
+    struct server *s = &server;
+    static struct hb_histogram source_read;
+    char body[4096];
+    int n = snprintf(body, sizeof(body),
+                     "{\"pool_bytes\": %zu, \"pool_capacity\": %zu, \"filled_bytes\": %lu, "
+                     "\"served_bytes\": %lu, \"requests\": %lu, \"connections\": %d, "
+                     "\"accepted\": %lu, \"source_exhausted\": %s, \"responses\": "
+                     "{\"200\": %lu, \"429\": %lu, \"503\": %lu, \"other\": %lu}, "
+                     "\"latency\": {",
+                     hb_randpool_level(&s->pool), s->pool.cap,
+                     __atomic_load_n(&s->filler.filled, __ATOMIC_RELAXED), s->served_bytes,
+                     s->requests, s->nconns, s->accepted,
+                     __atomic_load_n(&s->filler.eof, __ATOMIC_ACQUIRE) ? "true" : "false",
+                     s->status_200, s->status_429, s->status_503, s->status_4xx);
+    // Recorded by the fill thread meanwhile
+    hb_histogram_snapshot(&source_read, &s->filler.source_read);
+    n += stats_histogram(body + n, sizeof(body) - n, "", "source_read", &source_read);
+    n += stats_histogram(body + n, sizeof(body) - n, ", ", "pool_age", &s->pool_age);
+    n += stats_histogram(body + n, sizeof(body) - n, ", ", "response", &s->response);
+    n += snprintf(body + n, sizeof(body) - n, "}}\n");
+    struct response *r = queue_response(c, 200, "OK", "application/json", (size_t)n, NULL);
+    if (r) {
+        memcpy(r->body, body, n);
+    }
+}
+
+// Value of query parameter name, copied into buf
+static int query_param(const char *query, const char *name, char *buf, size_t len) {
+    size_t name_len = strlen(name);
+    const char *p = query;
+    while (p && *p) {
+        const char *end = strchr(p, '&');
+        size_t plen = end ? (size_t)(end - p) : strlen(p);
+        if (plen > name_len && strncmp(p, name, name_len) == 0 && p[name_len] == '=') {
+            size_t vlen = plen - name_len - 1;
+            if (vlen >= len) {
+                return -1;
+            }
+            memcpy(buf, p + name_len + 1, vlen);
+            buf[vlen] = '\0';
+            return 1;
+        }
+        p = end ? end + 1 : NULL;
+    }
+    return 0;
+}
+
+static void handle_target(struct conn *c, char *target) {
+    char *query = strchr(target, '?');
+    if (query) {
+        *query++ = '\0';
+    }
+
+    if (strcmp(target, "/stats") == 0) {
+        queue_stats(c);
+        return;
+    }
+    if (strcmp(target, "/random") != 0) {
+        queue_text(c, 404, "Not Found", "not found\n", NULL);
+        return;
+    }
+
+    char value[32];
+    size_t bytes = 32;
+    int r = query_param(query, "bytes", value, sizeof(value));
+    if (r != 0) {
+        char *end;
+        unsigned long long n = r > 0 ? strtoull(value, &end, 10) : 0;
+        if (r < 0 || *value == '\0' || *end != '\0' || n < 1 || n > config.max_request) {
+            char msg[96];
+            snprintf(msg, sizeof(msg), "bytes must be between 1 and %zu\n", config.max_request);
+            queue_text(c, 400, "Bad Request", msg, NULL);
+            return;
+        }
+        bytes = (size_t)n;
+    }
+
+    char format[8] = "raw";
+    if (query_param(query, "format", format, sizeof(format)) < 0 ||
+        (strcmp(format, "raw") != 0 && strcmp(format, "hex") != 0 &&
+         strcmp(format, "json") != 0)) {
+        queue_text(c, 400, "Bad Request", "format must be raw, hex or json\n", NULL);
+        return;
+    }
+    queue_random(c, bytes, format);
+}
+
+// Header value, case-insensitive name; NULL if absent
+static const char *find_header(const char *headers, const char *name, size_t *len) {
+    size_t name_len = strlen(name);
+    for (const char *p = headers; *p; ) {
+        const char *eol = strstr(p, "\r\n");
+        if (!eol) break;
+        if ((size_t)(eol - p) > name_len && strncasecmp(p, name, name_len) == 0 &&
+            p[name_len] == ':') {
+            const char *v = p + name_len + 1;
+            while (*v == ' ' || *v == '\t') v++;
+            *len = (size_t)(eol - v);
+            return v;
+        }
+        p = eol + 2;
+    }
+    return NULL;
+}
+
+static int header_has(const char *value, size_t len, const char *token) {
+    size_t tlen = strlen(token);
+    for (size_t i = 0; i + tlen <= len; i++) {
+        if (strncasecmp(value + i, token, tlen) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Answer one complete request in req (NUL-terminated, headers included)
+static void handle_request(struct conn *c, char *req) {
+    server.requests++;
+
+    char *line_end = strstr(req, "\r\n");
+    *line_end = '\0';
+    char *headers = line_end + 2;
+
+    char *method = req;
+    char *target = strchr(method, ' ');
+    char *version = target ? strchr(target + 1, ' ') : NULL;
+    if (!target || !version) {
+        c->closing = 1;
+        queue_text(c, 400, "Bad Request", "malformed request line\n", NULL);
+        return;
+    }
+    *target++ = '\0';
+    *version++ = '\0';
+
+    int http10 = strcmp(version, "HTTP/1.0") == 0;
+    if (!http10 && strcmp(version, "HTTP/1.1") != 0) {
+        c->closing = 1;
+        queue_text(c, 505, "HTTP Version Not Supported", "HTTP/1.0 or 1.1 only\n", NULL);
+        return;
+    }
+
+    size_t len;
+    const char *conn = find_header(headers, "Connection", &len);
+    if (conn ? header_has(conn, len, "close") : http10) {
+        c->closing = 1;
+    }
+    if (http10 && conn && header_has(conn, len, "keep-alive")) {
+        c->closing = 0;
+    }
+    // No request bodies: their length would be ambiguous to skip
+    const char *cl = find_header(headers, "Content-Length", &len);
+    if (find_header(headers, "Transfer-Encoding", &len) || (cl && atoll(cl) != 0)) {
+        c->closing = 1;
+        queue_text(c, 400, "Bad Request", "request bodies are not accepted\n", NULL);
+        return;
+    }
+
+    // HEAD included: taking bytes for a response nobody reads wastes them
+    if (strcmp(method, "GET") != 0) {
+        queue_text(c, 405, "Method Not Allowed", "GET only\n", "Allow: GET\r\n");
+        return;
+    }
+    handle_target(c, target);
+}
+
+static void set_backlog(struct conn *c, int backlog) {
+    if (backlog != c->backlog) {
+        server.backlogged += backlog ? 1 : -1;
+        c->backlog = backlog;
+    }
+}
+
+// Answer up to TURN_REQUESTS complete requests from the input buffer
+static void process_input(struct conn *c) {
+    size_t pos = 0;
+    int answered = 0;
+
+    while (!c->closing && answered < TURN_REQUESTS && c->queued < MAX_QUEUED) {
+        char *start = c->in + pos;
+        size_t avail = c->in_len - pos;
+        char *end = avail >= 4 ? memmem(start, avail, "\r\n\r\n", 4) : NULL;
+        if (!end) {
+            break;
+        }
+        // Headers keep their final CRLF; the blank line becomes the NUL
+        end[2] = '\0';
+        handle_request(c, start);
+        pos += (size_t)(end - start) + 4;
+        answered++;
+    }
+
+    if (pos > 0) {
+        memmove(c->in, c->in + pos, c->in_len - pos);
+        c->in_len -= pos;
+    }
+    int complete = c->in_len >= 4 && memmem(c->in, c->in_len, "\r\n\r\n", 4) != NULL;
+    if (!c->closing && !complete && c->in_len == sizeof(c->in)) {
+        c->closing = 1;
+        queue_text(c, 431, "Request Header Fields Too Large", "request too large\n", NULL);
+    }
+    set_backlog(c, complete && !c->closing && c->queued < MAX_QUEUED);
+}
+
+// Write as much of the output queue as the socket takes in one writev.
+// Returns -1 if the connection should be dropped.
+static int flush_output(struct conn *c) {
+    while (c->out_head) {
+        struct iovec iov[MAX_IOV];
+        int n = 0;
+        size_t skip = c->out_off;
+        for (struct response *r = c->out_head; r && n + 2 <= MAX_IOV; r = r->next) {
+            if (skip < r->header_len) {
+                iov[n].iov_base = r->header + skip;
+                iov[n++].iov_len = r->header_len - skip;
+                skip = 0;
+            } else {
+                skip -= r->header_len;
+            }
+            if (r->body_len > skip) {
+                iov[n].iov_base = r->body + skip;
+                iov[n++].iov_len = r->body_len - skip;
+            }
+            skip = 0;
+        }
+
+        ssize_t w = writev(c->fd, iov, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN ? 0 : -1;
+        }
+
+        size_t done = (size_t)w;
+        c->queued -= done;
+        while (c->out_head && done > 0) {
+            struct response *r = c->out_head;
+            size_t left = r->header_len + r->body_len - c->out_off;
+            if (done < left) {
+                c->out_off += done;
+                break;
+            }
+            done -= left;
+            c->out_head = r->next;
+            c->out_off = 0;
+            hb_histogram_record(&server.response, hb_monotonic_ns() - r->received_ns);
+            free(r);
+        }
+        if (!c->out_head) {
+            c->out_tail = NULL;
+        }
+    }
+    return c->closing ? -1 : 0;
+}
+
+static int conn_read(struct conn *c) {
+    for (;;) {
+        size_t room = sizeof(c->in) - c->in_len;
+        if (room == 0) {
+            return 0;
+        }
+        ssize_t r = read(c->fd, c->in + c->in_len, room);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN ? 0 : -1;
+        }
+        if (r == 0) {
+            // Answer what is already buffered before closing
+            c->eof = 1;
+            return 0;
+        }
+        c->in_len += (size_t)r;
+        c->read_ns = hb_monotonic_ns();
+        if ((size_t)r < room) {
+            return 0;
+        }
+    }
+}
+
+// Run one turn for c: answer buffered requests and write. Returns -1 when
+// c was closed.
+static int conn_turn(struct conn *c) {
+    process_input(c);
+    if (c->eof && !c->backlog) {
+        c->closing = 1;
+    }
+    if (flush_output(c) < 0) {
+        conn_close(c);
+        return -1;
+    }
+    conn_update_events(c);
+    return 0;
+}
+
+static void accept_connections(void) {
+    struct server *s = &server;
+    for (;;) {
+        struct sockaddr_storage addr;
+        socklen_t addr_len = sizeof(addr);
+        int fd = accept4(s->listen_fd, (struct sockaddr *)&addr, &addr_len,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EINTR && errno != ECONNABORTED) {
+                perror("accept");
+            }
+            return;
+        }
+        if (s->nconns >= config.max_conns) {
+            close(fd);
+            continue;
+        }
+
+        struct conn *c = calloc(1, sizeof(*c));
+        if (!c) {
+            fprintf(stderr, "Memory allocation failed\n");
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        if (addr.ss_family == AF_INET6) {
+            memcpy(c->key, &((struct sockaddr_in6 *)&addr)->sin6_addr, 16);
+        } else {
+            // ::ffff:a.b.c.d, as the IPv6 socket would report it
+            c->key[10] = c->key[11] = 0xff;
+            memcpy(c->key + 12, &((struct sockaddr_in *)&addr)->sin_addr, 4);
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+        if (epoll_ctl(s->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            perror("epoll_ctl");
+            close(fd);
+            free(c);
+            continue;
+        }
+        c->reading = 1;
+        c->last_active = s->now;
+        c->next = s->conns;
+        if (s->conns) s->conns->prev = c;
+        s->conns = c;
+        s->nconns++;
+        s->accepted++;
+    }
+}
+
+static int open_listener(void) {
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    int rv = getaddrinfo(config.address, config.port, &hints, &res);
+    if (rv != 0) {
+        fprintf(stderr, "%s:%s: %s\n", config.address, config.port, gai_strerror(rv));
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                    ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, SOMAXCONN) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    if (fd < 0) {
+        fprintf(stderr, "Cannot listen on %s:%s: %s\n", config.address, config.port,
+                strerror(errno));
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+static void close_idle(void) {
+    struct server *s = &server;
+    for (struct conn *c = s->conns, *next; c; c = next) {
+        next = c->next;
+        if (!c->out_head && s->now - c->last_active > config.idle_timeout) {
+            conn_close(c);
+        }
+    }
+}
+
+static int run(void) {
+    struct server *s = &server;
+    struct epoll_event events[MAX_EVENTS];
+    double last_sweep = s->now;
+
+    while (!stopping) {
+        int n = epoll_wait(s->epfd, events, MAX_EVENTS, s->backlogged ? 0 : 1000);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            return -1;
+        }
+        s->now = hb_wall_seconds();
+
+        for (int i = 0; i < n; i++) {
+            struct conn *c = events[i].data.ptr;
+            if (!c) {
+                accept_connections();
+                continue;
+            }
+            c->last_active = s->now;
+            if (events[i].events & (EPOLLERR | EPOLLHUP) && !(events[i].events & EPOLLIN)) {
+                conn_close(c);
+                continue;
+            }
+            if (events[i].events & EPOLLIN && conn_read(c) < 0) {
+                conn_close(c);
+                continue;
+            }
+            if (c->backlog) {
+                // Answered below with the other backlogged connections
+                continue;
+            }
+            conn_turn(c);
+        }
+
+        // Connections with requests left over from an earlier turn get one
+        // more turn each, in list order
+        if (s->backlogged) {
+            for (struct conn *c = s->conns, *next; c; c = next) {
+                next = c->next;
+                if (c->backlog) {
+                    conn_turn(c);
+                }
+            }
+        }
+
+        if (s->now - last_sweep >= 1.0) {
+            close_idle();
+            last_sweep = s->now;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (parse_arguments(argc, argv) < 0) {
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    struct server *s = &server;
+    struct filler *f = &s->filler;
+    s->epfd = -1;
+    s->listen_fd = -1;
+    hb_histogram_init(&s->pool_age);
+    hb_histogram_init(&s->response);
+    hb_histogram_init(&f->source_read);
+    if (hb_randpool_init(&s->pool, config.pool_bytes) < 0) {
+        return 1;
+    }
+    s->scratch = malloc(config.max_request);
+    if (!s->scratch) {
+        fprintf(stderr, "Memory allocation failed\n");
+        hb_randpool_free(&s->pool);
+        return 1;
+    }
+    if (config.rate > 0.0 &&
+        hb_buckets_init(&s->buckets, BUCKET_SLOTS, config.rate, config.burst) < 0) {
+        return 1;
+    }
+
+    f->pool = &s->pool;
+    f->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (f->wake_fd < 0) {
+        perror("eventfd");
+        return 1;
+    }
+    if (hb_input_open(&f->in, optind < argc ? argv[optind] : "-", 0) < 0) {
+        return 1;
+    }
+    if (config.follow && f->in.running) {
+        fprintf(stderr, "--follow needs an uncompressed regular file\n");
+        hb_input_close(&f->in);
+        return 1;
+    }
+    if (config.events && !(f->stream = hb_stream_create(NULL, NULL))) {
+        hb_input_close(&f->in);
+        return 1;
+    }
+
+    // Prefill before serving, so the first requests do not find it empty
+    double start = hb_wall_seconds();
+    int rv = 0;
+    pthread_t thread;
+    int started = pthread_create(&thread, NULL, fill_thread, f) == 0;
+    if (!started) {
+        fprintf(stderr, "Cannot start the fill thread\n");
+        rv = -1;
+    }
+    while (rv == 0 && !stopping && hb_randpool_space(&s->pool) > 0 &&
+           !__atomic_load_n(&f->eof, __ATOMIC_ACQUIRE)) {
+        poll(NULL, 0, 10);
+    }
+    if (rv == 0 && hb_randpool_level(&s->pool) == 0) {
+        fprintf(stderr, "No random bytes to serve\n");
+        rv = -1;
+    }
+
+    if (rv == 0) {
+        s->listen_fd = open_listener();
+        s->epfd = epoll_create1(EPOLL_CLOEXEC);
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+        if (s->listen_fd < 0 || s->epfd < 0 ||
+            epoll_ctl(s->epfd, EPOLL_CTL_ADD, s->listen_fd, &ev) < 0) {
+            if (s->epfd < 0) perror("epoll");
+            rv = -1;
+        }
+    }
+    if (rv == 0) {
+        fprintf(stderr, "# Serving on %s:%s, pool %zu/%zu bytes prefilled in %.2f s\n",
+                config.address, config.port, hb_randpool_level(&s->pool), s->pool.cap,
+                hb_wall_seconds() - start);
+        s->now = hb_wall_seconds();
+        rv = run();
+    }
+
+    __atomic_store_n(&f->stop, 1, __ATOMIC_RELEASE);
+    uint64_t one = 1;
+    if (write(f->wake_fd, &one, sizeof(one)) < 0) {
+        perror("eventfd");
+    }
+    if (started) {
+        pthread_join(thread, NULL);
+    }
+
+    if (config.verbose || rv < 0) {
+        fprintf(stderr, "# %lu requests, %lu bytes served, %lu rate limited, %lu pool empty\n",
+                s->requests, s->served_bytes, s->status_429, s->status_503);
+    }
+    while (s->conns) {
+        conn_close(s->conns);
+    }
+    if (s->listen_fd >= 0) close(s->listen_fd);
+    if (s->epfd >= 0) close(s->epfd);
+    close(f->wake_fd);
+    if (hb_input_close(&f->in) < 0 || f->status < 0) {
+        rv = -1;
+    }
+    hb_stream_destroy(f->stream);
+    hb_buckets_free(&s->buckets);
+    hb_randpool_free(&s->pool);
+    free(s->scratch);
+    return rv < 0 ? 1 : 0;
+}
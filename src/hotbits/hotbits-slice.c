@@ -0,0 +1,205 @@
+// hotbits-slice - read an event range from the segment archive
+//
+// Resolves a line range (hot.sh --start-index/--sample-count semantics) or a
+// time range against the sparse segment indexes and prints only those
+// deltas, seeking directly to them instead of concatenating data/.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+
+#include "archive.h"
+
+typedef struct {
+    const char *data_dir;
+    const char *output;
+    long long start_index;
+    long long sample_count;
+    uint64_t from_ns;
+    uint64_t to_ns;
+    int by_time;
+    int info;
+    int persist;
+    int verbose;
+} Config;
+
+static Config config = {
+    .data_dir = "data",
+    .output = NULL,
+    .start_index = 0,
+    .sample_count = 0,
+    .from_ns = 0,
+    .to_ns = UINT64_MAX,
+    .by_time = 0,
+    .info = 0,
+    .persist = 1,
+    .verbose = 0
+};
+
+void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [OPTIONS]\n", prog);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -d, --data-dir DIR       Directory with events-*.txt files (default: ./data)\n");
+    fprintf(stderr, "  -s, --start-index N      First line (1-based, negative counts from end)\n");
+    fprintf(stderr, "  -c, --sample-count N     Number of lines (0 = all)\n");
+    fprintf(stderr, "  -f, --from-ns NS         First event at or after NS since the first segment start\n");
+    fprintf(stderr, "  -t, --to-ns NS           Stop before the first event at or after NS\n");
+    fprintf(stderr, "  -o, --output FILE        Output file (default: stdout)\n");
+    fprintf(stderr, "  -i, --info               Only print event count and duration\n");
+    fprintf(stderr, "  -n, --no-write-index     Do not write refreshed indexes to the data directory\n");
+    fprintf(stderr, "  -v, --verbose            Print the resolved range to stderr\n");
+    fprintf(stderr, "  -?, --help               Show this help message\n");
+}
+
+int parse_arguments(int argc, char *argv[]) {
+    static struct option long_options[] = {
+        {"data-dir",       required_argument, 0, 'd'},
+        {"start-index",    required_argument, 0, 's'},
+        {"sample-count",   required_argument, 0, 'c'},
+        {"from-ns",        required_argument, 0, 'f'},
+        {"to-ns",          required_argument, 0, 't'},
+        {"output",         required_argument, 0, 'o'},
+        {"info",           no_argument,       0, 'i'},
+        {"no-write-index", no_argument,       0, 'n'},
+        {"verbose",        no_argument,       0, 'v'},
+        {"help",           no_argument,       0, '?'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "d:s:c:f:t:o:inv?", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'd':
+                config.data_dir = optarg;
+                break;
+            case 's':
+                config.start_index = atoll(optarg);
+                break;
+            case 'c':
+                config.sample_count = atoll(optarg);
+                break;
+            case 'f':
+                config.from_ns = strtoull(optarg, NULL, 10);
+                config.by_time = 1;
+                break;
+            case 't':
+                config.to_ns = strtoull(optarg, NULL, 10);
+                config.by_time = 1;
+                break;
+            case 'o':
+                config.output = optarg;
+                break;
+            case 'i':
+                config.info = 1;
+                break;
+            case 'n':
+                config.persist = 0;
+                break;
+            case 'v':
+                config.verbose = 1;
+                break;
+            case '?':
+                print_usage(argv[0]);
+                exit(0);
+            default:
+                print_usage(argv[0]);
+                return -1;
+        }
+    }
+
+    if (config.by_time && (config.start_index != 0 || config.sample_count != 0)) {
+        fprintf(stderr, "Use either a line range or a time range, not both\n");
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (parse_arguments(argc, argv) < 0) {
+        return 1;
+    }
+
+    struct hb_archive archive;
+    if (hb_archive_open(&archive, config.data_dir, config.persist) < 0) {
+        return 1;
+    }
+
+    uint64_t total = hb_archive_events(&archive);
+    if (config.info) {
+        printf("%lu %lu\n", total, hb_archive_duration_ns(&archive));
+        hb_archive_close(&archive);
+        return 0;
+    }
+
+    uint64_t start = 0;
+    uint64_t count = total;
+
+    if (config.by_time) {
+        uint64_t end = total;
+        if (hb_archive_find_time(&archive, config.from_ns, &start) < 0 ||
+            (config.to_ns != UINT64_MAX && hb_archive_find_time(&archive, config.to_ns, &end) < 0)) {
+            hb_archive_close(&archive);
+            return 1;
+        }
+        count = end > start ? end - start : 0;
+    } else if (config.start_index != 0 || config.sample_count != 0) {
+        long long first = config.start_index;
+        if (first < 0) {
+            first = (long long)total + first + 1;
+            if (first < 1) first = 1;
+        } else if (first == 0) {
+            first = 1;
+        }
+        start = (uint64_t)first - 1;
+        if (start > total) start = total;
+        count = total - start;
+        if (config.sample_count > 0 && (uint64_t)config.sample_count < count) {
+            count = (uint64_t)config.sample_count;
+        }
+    }
+
+    if (config.verbose) {
+        fprintf(stderr, "# Archive: %lu events in %zu segments, %lu ns\n",
+                total, archive.count, hb_archive_duration_ns(&archive));
+        fprintf(stderr, "# Range: lines %lu to %lu (%lu events)\n",
+                start + 1, start + count, count);
+    }
+
+    FILE *out = stdout;
+    if (config.output) {
+        out = fopen(config.output, "w");
+        if (!out) {
+            perror(config.output);
+            hb_archive_close(&archive);
+            return 1;
+        }
+    }
+
+    // Read in bounded chunks so large ranges do not need to fit in memory
+    struct hb_events events;
+    hb_events_init(&events);
+    int rv = 0;
+    while (count > 0) {
+        uint64_t n = count < (1 << 20) ? count : (1 << 20);
+        events.count = 0;
+        if (hb_archive_read(&archive, start, n, &events) < 0) {
+            rv = 1;
+            break;
+        }
+        for (size_t i = 0; i < events.count; i++) {
+            fprintf(out, "%lu\n", events.values[i]);
+        }
+        start += n;
+        count -= n;
+    }
+
+    if (out != stdout && fclose(out) != 0) {
+        perror(config.output);
+        rv = 1;
+    }
+    hb_events_free(&events);
+    hb_archive_close(&archive);
+    return rv;
+}
@@ -0,0 +1,662 @@
+// hotbits-sweep - parallel parameter sweep over extractor configurations
+//
+// Loads a dataset once and runs every configuration in a grid of filter,
+// method, bit position, window and debias settings through the native
+// pipeline on a work-stealing pool. Each cell is scored by yield (bits per
+// event) and the quicktest battery, then ranked. Finished cells are cached
+// under a hash of the dataset and the configuration, so a re-sweep only
+// computes the cells it has not seen.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "archive.h"
+#include "events.h"
+#include "hash.h"
+#include "pipeline.h"
+#include "pool.h"
+#include "quicktest.h"
+#include "timing.h"
+
+#define MAX_VALUES 32
+#define MAX_CELLS 65536
+#define CACHE_VERSION 1     // bump when pipeline output for a config changes
+#define DEFAULT_CACHE "state/sweep-cache.tsv"
+
+// One dimension of the grid: a comma-separated list of integers
+struct axis {
+    long long values[MAX_VALUES];
+    int count;
+};
+
+typedef struct {
+    const char *data_dir;
+    long long start_index;
+    long long sample_count;
+    const char *cache_path;
+    const char *json_path;
+    int threads;
+    int top;
+    double alpha;
+    int verbose;
+    struct axis methods;
+    struct axis bits;
+    struct axis windows;
+    struct axis orders;
+    struct axis rate_windows;
+    struct axis debias;
+    struct axis dead_times;
+    struct axis window_ns;
+    struct axis window_modes;
+} Config;
+
+static Config config = {
+    .data_dir = "./data",
+    .start_index = 0,
+    .sample_count = 0,
+    .cache_path = DEFAULT_CACHE,
+    .json_path = NULL,
+    .threads = 0,
+    .top = 20,
+    .alpha = HB_ALPHA,
+    .verbose = 0
+};
+
+struct cell {
+    struct hb_pipeline_config cfg;
+    char label[160];
+    uint64_t key;
+    int cached;
+    int failed;
+    uint64_t bits;
+    uint64_t bytes;
+    double wall_s;
+    struct hb_test_result results[HB_QUICK_TESTS];
+    int passed;
+    double min_p;
+};
+
+struct cache_entry {
+    uint64_t key;
+    uint64_t bits;
+    uint64_t bytes;
+    double statistic[HB_QUICK_TESTS];
+    double p_value[HB_QUICK_TESTS];
+};
+
+static const uint64_t *events;
+static size_t event_count;
+static struct cell *cells;
+static size_t cell_count;
+static FILE *cache_out;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t done_count;
+
+void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [OPTIONS] [EVENT_FILE...]\n", prog);
+    fprintf(stderr, "Sweeps extractor configurations over events from the files given (gzip and\n");
+    fprintf(stderr, "zstd accepted) or, without files, from the data directory. Every list option\n");
+    fprintf(stderr, "takes comma-separated values; the grid is their product.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -d, --data-dir DIR         Directory with events-*.txt files (default: ./data)\n");
+    fprintf(stderr, "  -s, --start-index N        First line to use (1-based, negative counts from end)\n");
+    fprintf(stderr, "  -c, --sample-count N       Number of lines to use (0 = all)\n");
+    fprintf(stderr, "  -m, --method LIST          Methods (default: all eight)\n");
+    fprintf(stderr, "  -b, --bit LIST             Bit positions for lsb (default: 0,1,2,3)\n");
+    fprintf(stderr, "  -w, --window LIST          Adaptive threshold windows (default: 50,100,200)\n");
+    fprintf(stderr, "  -k, --order LIST           Ordinal block lengths (default: 4,8,12)\n");
+    fprintf(stderr, "      --rate-window LIST     Quantile rate windows (default: 1024,4096)\n");
+    fprintf(stderr, "      --debias LIST          none, von_neumann (default: both)\n");
+    fprintf(stderr, "      --dead-time LIST       Dead time filters in nanoseconds (default: 0)\n");
+    fprintf(stderr, "      --window-ns LIST       Aggregation windows in nanoseconds (default: 0)\n");
+    fprintf(stderr, "      --window-mode LIST     0: first, 1: last, 2: mean (default: 0)\n");
+    fprintf(stderr, "  -C, --cache PATH           Result cache (default: %s, '' = none)\n", DEFAULT_CACHE);
+    fprintf(stderr, "  -o, --json PATH            Write every ranked cell as JSON\n");
+    fprintf(stderr, "  -j, --threads N            Worker threads (default: online CPUs)\n");
+    fprintf(stderr, "  -n, --top N                Rows printed (default: 20, 0 = all)\n");
+    fprintf(stderr, "  -a, --alpha P              Significance level for passing (default: %g)\n", HB_ALPHA);
+    fprintf(stderr, "  -v, --verbose              Report each cell as it finishes\n");
+    fprintf(stderr, "  -?, --help                 Show this help message\n");
+}
+
+// Parse a list of integers, or of names when parse is given
+static int parse_axis(struct axis *axis, const char *list, int (*parse)(const char *)) {
+    char buf[512];
+    snprintf(buf, sizeof(buf), "%s", list);
+
+    axis->count = 0;
+    for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+        if (axis->count == MAX_VALUES) {
+            fprintf(stderr, "Too many values in list: %s\n", list);
+            return -1;
+        }
+        long long v;
+        if (parse) {
+            v = parse(tok);
+        } else {
+            char *end;
+            errno = 0;
+            v = strtoll(tok, &end, 10);
+            if (errno || *end != '\0' || v < 0) {
+                v = -1;
+            }
+        }
+        if (v < 0) {
+            fprintf(stderr, "Invalid value: %s\n", tok);
+            return -1;
+        }
+        axis->values[axis->count++] = v;
+    }
+    if (axis->count == 0) {
+        fprintf(stderr, "Empty list\n");
+        return -1;
+    }
+    return 0;
+}
+
+int parse_arguments(int argc, char *argv[]) {
+    enum { OPT_DEBIAS = 256, OPT_DEAD_TIME, OPT_WINDOW_NS, OPT_WINDOW_MODE,
+           OPT_RATE_WINDOW };
+    static struct option long_options[] = {
+        {"data-dir",     required_argument, 0, 'd'},
+        {"start-index",  required_argument, 0, 's'},
+        {"sample-count", required_argument, 0, 'c'},
+        {"method",       required_argument, 0, 'm'},
+        {"bit",          required_argument, 0, 'b'},
+        {"window",       required_argument, 0, 'w'},
+        {"order",        required_argument, 0, 'k'},
+        {"rate-window",  required_argument, 0, OPT_RATE_WINDOW},
+        {"debias",       required_argument, 0, OPT_DEBIAS},
+        {"dead-time",    required_argument, 0, OPT_DEAD_TIME},
+        {"window-ns",    required_argument, 0, OPT_WINDOW_NS},
+        {"window-mode",  required_argument, 0, OPT_WINDOW_MODE},
+        {"cache",        required_argument, 0, 'C'},
+        {"json",         required_argument, 0, 'o'},
+        {"threads",      required_argument, 0, 'j'},
+        {"top",          required_argument, 0, 'n'},
+        {"alpha",        required_argument, 0, 'a'},
+        {"verbose",      no_argument,       0, 'v'},
+        {"help",         no_argument,       0, '?'},
+        {0, 0, 0, 0}
+    };
+
+    if (parse_axis(&config.methods, "interval,von_neumann,xor_fold,lsb,adaptive_threshold,ordinal,quantile,phase",
+                   hb_method_parse) < 0 ||
+        parse_axis(&config.bits, "0,1,2,3", NULL) < 0 ||
+        parse_axis(&config.windows, "50,100,200", NULL) < 0 ||
+        parse_axis(&config.orders, "4,8,12", NULL) < 0 ||
+        parse_axis(&config.rate_windows, "1024,4096", NULL) < 0 ||
+        parse_axis(&config.debias, "none,von_neumann", hb_debias_parse) < 0 ||
+        parse_axis(&config.dead_times, "0", NULL) < 0 ||
+        parse_axis(&config.window_ns, "0", NULL) < 0 ||
+        parse_axis(&config.window_modes, "0", NULL) < 0) {
+        return -1;
+    }
+
+    int opt, rv = 0;
+    while ((opt = getopt_long(argc, argv, "d:s:c:m:b:w:k:C:o:j:n:a:v?", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'd':
+                config.data_dir = optarg;
+                break;
+            case 's':
+                config.start_index = strtoll(optarg, NULL, 10);
+                break;
+            case 'c':
+                config.sample_count = strtoll(optarg, NULL, 10);
+                break;
+            case 'm':
+                rv = parse_axis(&config.methods, optarg, hb_method_parse);
+                break;
+            case 'b':
+                rv = parse_axis(&config.bits, optarg, NULL);
+                break;
+            case 'w':
+                rv = parse_axis(&config.windows, optarg, NULL);
+                break;
+            case 'k':
+                rv = parse_axis(&config.orders, optarg, NULL);
+                break;
+            case OPT_RATE_WINDOW:
+                rv = parse_axis(&config.rate_windows, optarg, NULL);
+                break;
+            case OPT_DEBIAS:
+                rv = parse_axis(&config.debias, optarg, hb_debias_parse);
+                break;
+            case OPT_DEAD_TIME:
+                rv = parse_axis(&config.dead_times, optarg, NULL);
+                break;
+            case OPT_WINDOW_NS:
+                rv = parse_axis(&config.window_ns, optarg, NULL);
+                break;
+            case OPT_WINDOW_MODE:
+                rv = parse_axis(&config.window_modes, optarg, NULL);
+                break;
+            case 'C':
+                config.cache_path = optarg[0] ? optarg : NULL;
+                break;
+            case 'o':
+                config.json_path = optarg;
+                break;
+            case 'j':
+                config.threads = atoi(optarg);
+                break;
+            case 'n':
+                config.top = atoi(optarg);
+                break;
+            case 'a':
+                config.alpha = atof(optarg);
+                break;
+            case 'v':
+                config.verbose = 1;
+                break;
+            case '?':
+                print_usage(argv[0]);
+                exit(0);
+            default:
+                print_usage(argv[0]);
+                return -1;
+        }
+        if (rv < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Canonical description of a configuration; settings a method ignores are
+// left out so equivalent cells share one label (and one cache key)
+static void cell_label(const struct hb_pipeline_config *cfg, char *buf, size_t len) {
+    int n = snprintf(buf, len, "%s", hb_method_name(cfg->method));
+    if (cfg->method == HB_METHOD_LSB) {
+        n += snprintf(buf + n, len - n, " bit=%d", cfg->bit_pos);
+    } else if (cfg->method == HB_METHOD_ADAPTIVE) {
+        n += snprintf(buf + n, len - n, " window=%d", cfg->window);
+    } else if (cfg->method == HB_METHOD_ORDINAL) {
+        n += snprintf(buf + n, len - n, " order=%d", cfg->order);
+    } else if (cfg->method == HB_METHOD_QUANTILE) {
+        n += snprintf(buf + n, len - n, " rate_window=%d", cfg->rate_window);
+    }
+    n += snprintf(buf + n, len - n, " debias=%s", hb_debias_name(cfg->debias));
+    if (cfg->dead_time_ns > 0) {
+        n += snprintf(buf + n, len - n, " dead_time=%lu", cfg->dead_time_ns);
+    }
+    if (cfg->window_ns > 0) {
+        snprintf(buf + n, len - n, " window_ns=%lu mode=%d", cfg->window_ns, cfg->window_mode);
+    }
+}
+
+static int add_cell(const struct hb_pipeline_config *cfg, uint64_t dataset) {
+    char label[sizeof(cells[0].label)];
+    cell_label(cfg, label, sizeof(label));
+    for (size_t i = 0; i < cell_count; i++) {
+        if (strcmp(cells[i].label, label) == 0) {
+            return 0;
+        }
+    }
+    if (cell_count == MAX_CELLS) {
+        fprintf(stderr, "Grid has more than %d cells\n", MAX_CELLS);
+        return -1;
+    }
+
+    struct cell *c = &cells[cell_count++];
+    memset(c, 0, sizeof(*c));
+    c->cfg = *cfg;
+    memcpy(c->label, label, sizeof(label));
+    c->key = hb_hash64(label, strlen(label), dataset + CACHE_VERSION);
+    return 0;
+}
+
+static int build_grid(uint64_t dataset) {
+    cells = calloc(MAX_CELLS, sizeof(*cells));
+    if (!cells) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+
+    struct hb_pipeline_config cfg;
+    hb_pipeline_config_default(&cfg);
+    for (int m = 0; m < config.methods.count; m++)
+    for (int b = 0; b < config.bits.count; b++)
+    for (int w = 0; w < config.windows.count; w++)
+    for (int o = 0; o < config.orders.count; o++)
+    for (int r = 0; r < config.rate_windows.count; r++)
+    for (int d = 0; d < config.debias.count; d++)
+    for (int t = 0; t < config.dead_times.count; t++)
+    for (int n = 0; n < config.window_ns.count; n++)
+    for (int k = 0; k < config.window_modes.count; k++) {
+        cfg.method = (int)config.methods.values[m];
+        cfg.bit_pos = cfg.method == HB_METHOD_LSB ? (int)config.bits.values[b] : 0;
+        cfg.window = cfg.method == HB_METHOD_ADAPTIVE ? (int)config.windows.values[w] : 100;
+        cfg.order = cfg.method == HB_METHOD_ORDINAL ? (int)config.orders.values[o] : 8;
+        cfg.rate_window = cfg.method == HB_METHOD_QUANTILE ? (int)config.rate_windows.values[r]
+                                                           : 4096;
+        cfg.debias = (int)config.debias.values[d];
+        cfg.dead_time_ns = (uint64_t)config.dead_times.values[t];
+        cfg.window_ns = (uint64_t)config.window_ns.values[n];
+        cfg.window_mode = cfg.window_ns > 0 ? (int)config.window_modes.values[k] : 0;
+        if (add_cell(&cfg, dataset) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int compare_entry(const void *a, const void *b) {
+    uint64_t x = ((const struct cache_entry *)a)->key;
+    uint64_t y = ((const struct cache_entry *)b)->key;
+    return x < y ? -1 : x > y;
+}
+
+// Cache lines: key, bits, bytes, then statistic and p-value per test, then
+// the cell label for people reading the file. Unparseable lines are skipped.
+static size_t load_cache(const char *path, struct cache_entry **out) {
+    *out = NULL;
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return 0;
+    }
+
+    struct cache_entry *entries = NULL;
+    size_t count = 0, cap = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        struct cache_entry e;
+        char *p = line, *end;
+        e.key = strtoull(p, &end, 16);
+        if (end == p) continue;
+        e.bits = strtoull(p = end, &end, 10);
+        e.bytes = strtoull(p = end, &end, 10);
+        int ok = end != p;
+        for (int t = 0; ok && t < HB_QUICK_TESTS; t++) {
+            e.statistic[t] = strtod(p = end, &end);
+            e.p_value[t] = strtod(p = end, &end);
+            ok = end != p;
+        }
+        if (!ok) continue;
+
+        if (count == cap) {
+            cap = cap ? cap * 2 : 256;
+            struct cache_entry *grown = realloc(entries, cap * sizeof(*entries));
+            if (!grown) {
+                fprintf(stderr, "Memory allocation failed\n");
+                break;
+            }
+            entries = grown;
+        }
+        entries[count++] = e;
+    }
+    fclose(f);
+
+    qsort(entries, count, sizeof(*entries), compare_entry);
+    *out = entries;
+    return count;
+}
+
+static void score_cell(struct cell *c) {
+    c->passed = 0;
+    c->min_p = c->bytes > 0 ? 1.0 : 0.0;
+    for (int t = 0; t < HB_QUICK_TESTS; t++) {
+        double p = c->results[t].p_value;
+        if (c->bytes == 0 || isnan(p)) {
+            c->min_p = 0.0;
+            continue;
+        }
+        if (p >= config.alpha) c->passed++;
+        if (p < c->min_p) c->min_p = p;
+    }
+}
+
+static void report_cell(const struct cell *c, const char *how) {
+    double yield = event_count ? (double)c->bits / event_count : 0.0;
+    fprintf(stderr, "[%zu/%zu] %-9s %-48s %.4f bits/event, %d/%d passed, %.2fs\n",
+            done_count, cell_count, how, c->label, yield, c->passed, HB_QUICK_TESTS, c->wall_s);
+}
+
+static void run_cell(void *arg) {
+    struct cell *c = arg;
+    double start = hb_wall_seconds();
+
+    struct hb_pipeline pipeline;
+    struct hb_buffer out;
+    hb_buffer_init(&out);
+    if (hb_pipeline_init(&pipeline, &c->cfg) < 0) {
+        c->failed = 1;
+    } else {
+        if (hb_pipeline_push(&pipeline, events, event_count, &out) < 0 ||
+            hb_pipeline_finish(&pipeline, &out) < 0) {
+            c->failed = 1;
+        }
+        c->bits = pipeline.bits_out;
+        hb_pipeline_free(&pipeline);
+    }
+    c->bytes = out.len;
+    hb_quick_tests(out.data, out.len, c->results);
+    hb_buffer_free(&out);
+    c->wall_s = hb_wall_seconds() - start;
+    score_cell(c);
+
+    pthread_mutex_lock(&cache_lock);
+    done_count++;
+    if (cache_out && !c->failed) {
+        fprintf(cache_out, "%016lx\t%lu\t%lu", c->key, c->bits, c->bytes);
+        for (int t = 0; t < HB_QUICK_TESTS; t++) {
+            fprintf(cache_out, "\t%.17g\t%.17g", c->results[t].statistic, c->results[t].p_value);
+        }
+        fprintf(cache_out, "\t%s\n", c->label);
+        fflush(cache_out);
+    }
+    if (config.verbose) {
+        report_cell(c, c->failed ? "failed" : "computed");
+    }
+    pthread_mutex_unlock(&cache_lock);
+}
+
+// Passing more tests first, then higher yield, then the larger worst p-value
+static int compare_cells(const void *a, const void *b) {
+    const struct cell *x = a, *y = b;
+    if (x->failed != y->failed) return x->failed - y->failed;
+    if (x->passed != y->passed) return y->passed - x->passed;
+    if (x->bits != y->bits) return x->bits < y->bits ? 1 : -1;
+    if (x->min_p != y->min_p) return x->min_p < y->min_p ? 1 : -1;
+    return strcmp(x->label, y->label);
+}
+
+static int load_events(int argc, char *argv[], struct hb_events *ev) {
+    hb_events_init(ev);
+    if (optind < argc) {
+        for (int i = optind; i < argc; i++) {
+            if (hb_events_load_file(ev, argv[i]) < 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    struct hb_archive archive;
+    if (hb_archive_open(&archive, config.data_dir, 1) < 0) {
+        return -1;
+    }
+
+    // Slice with hot.sh semantics: 1-based start, negative counts from end
+    uint64_t total = hb_archive_events(&archive);
+    uint64_t start = 0;
+    if (config.start_index < 0) {
+        long long first = (long long)total + config.start_index;
+        start = first > 0 ? (uint64_t)first : 0;
+    } else if (config.start_index > 0) {
+        start = (uint64_t)config.start_index - 1;
+    }
+    if (start > total) start = total;
+    uint64_t count = total - start;
+    if (config.sample_count > 0 && (uint64_t)config.sample_count < count) {
+        count = (uint64_t)config.sample_count;
+    }
+
+    int rv = hb_archive_read(&archive, start, count, ev);
+    hb_archive_close(&archive);
+    return rv;
+}
+
+static void write_json(const char *path, uint64_t dataset) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return;
+    }
+
+    fprintf(f, "{\n  \"events\": %zu,\n  \"dataset_hash\": \"%016lx\",\n  \"alpha\": %g,\n",
+            event_count, dataset, config.alpha);
+    fprintf(f, "  \"cells\": [\n");
+    for (size_t i = 0; i < cell_count; i++) {
+        const struct cell *c = &cells[i];
+        fprintf(f, "    {\"rank\": %zu, \"config\": \"%s\", \"method\": \"%s\", \"bit\": %d, "
+                "\"window\": %d, \"order\": %d, \"rate_window\": %d, \"debias\": \"%s\", "
+                "\"dead_time_ns\": %lu, \"window_ns\": %lu, \"window_mode\": %d,\n", i + 1,
+                c->label, hb_method_name(c->cfg.method), c->cfg.bit_pos, c->cfg.window,
+                c->cfg.order, c->cfg.rate_window, hb_debias_name(c->cfg.debias),
+                c->cfg.dead_time_ns, c->cfg.window_ns, c->cfg.window_mode);
+        fprintf(f, "     \"bits\": %lu, \"bits_per_event\": %.6f, \"passed\": %d, "
+                "\"min_p_value\": %.6g, \"cached\": %s, \"tests\": {",
+                c->bits, event_count ? (double)c->bits / event_count : 0.0, c->passed, c->min_p,
+                c->cached ? "true" : "false");
+        for (int t = 0; t < HB_QUICK_TESTS; t++) {
+            fprintf(f, "%s\"%s\": {\"statistic\": %.6g, \"p_value\": %.6g, \"pass\": %s}",
+                    t ? ", " : "", c->results[t].name, c->results[t].statistic,
+                    c->results[t].p_value, c->results[t].p_value >= config.alpha ? "true" : "false");
+        }
+        fprintf(f, "}}%s\n", i + 1 < cell_count ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+}
+
+int main(int argc, char *argv[]) {
+    if (parse_arguments(argc, argv) < 0) {
+        return 1;
+    }
+
+    double start = hb_wall_seconds();
+    struct hb_events ev;
+    if (load_events(argc, argv, &ev) < 0) {
+        return 1;
+    }
+    events = ev.values;
+    event_count = ev.count;
+    if (event_count == 0) {
+        fprintf(stderr, "No events to sweep\n");
+        return 1;
+    }
+    uint64_t dataset = hb_hash64(events, event_count * sizeof(uint64_t), 0);
+    printf("Loaded %zu events in %.2fs (dataset %016lx)\n", event_count,
+           hb_wall_seconds() - start, dataset);
+
+    if (build_grid(dataset) < 0) {
+        return 1;
+    }
+
+    // Cells already in the cache only need their results filled in
+    struct cache_entry *entries = NULL;
+    size_t entry_count = 0;
+    if (config.cache_path) {
+        entry_count = load_cache(config.cache_path, &entries);
+    }
+    size_t hits = 0;
+    for (size_t i = 0; i < cell_count; i++) {
+        struct cell *c = &cells[i];
+        struct cache_entry probe = { .key = c->key };
+        const struct cache_entry *e = entry_count ?
+            bsearch(&probe, entries, entry_count, sizeof(*entries), compare_entry) : NULL;
+        if (!e) {
+            continue;
+        }
+        // Names come from a real run so the battery stays the one source
+        hb_quick_tests(NULL, 0, c->results);
+        for (int t = 0; t < HB_QUICK_TESTS; t++) {
+            c->results[t].statistic = e->statistic[t];
+            c->results[t].p_value = e->p_value[t];
+        }
+        c->bits = e->bits;
+        c->bytes = e->bytes;
+        c->cached = 1;
+        score_cell(c);
+        hits++;
+    }
+    free(entries);
+
+    if (config.cache_path && hits < cell_count) {
+        // Create the cache's directory when it is a single missing level
+        char dir[4096];
+        snprintf(dir, sizeof(dir), "%s", config.cache_path);
+        char *slash = strrchr(dir, '/');
+        if (slash && slash != dir) {
+            *slash = '\0';
+            if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+                perror(dir);
+            }
+        }
+        cache_out = fopen(config.cache_path, "a");
+        if (!cache_out) {
+            perror(config.cache_path);
+            fprintf(stderr, "Continuing without caching new results\n");
+        }
+    }
+
+    struct hb_pool *pool = hb_pool_create(config.threads);
+    if (!pool) {
+        return 1;
+    }
+    printf("Sweeping %zu configurations (%zu cached) on %d threads\n", cell_count, hits,
+           hb_pool_threads(pool));
+
+    start = hb_wall_seconds();
+    for (size_t i = 0; i < cell_count; i++) {
+        if (cells[i].cached) {
+            continue;
+        }
+        if (hb_pool_submit(pool, run_cell, &cells[i]) < 0) {
+            cells[i].failed = 1;
+        }
+    }
+    hb_pool_wait(pool);
+    hb_pool_destroy(pool);
+    if (cache_out) {
+        fclose(cache_out);
+    }
+    printf("Computed %zu cells in %.2fs\n\n", cell_count - hits, hb_wall_seconds() - start);
+
+    qsort(cells, cell_count, sizeof(*cells), compare_cells);
+
+    printf("%4s  %-48s %10s %10s %7s %10s\n", "Rank", "Configuration", "Bits/event",
+           "Bytes", "Passed", "Min p");
+    size_t shown = config.top > 0 && (size_t)config.top < cell_count ? (size_t)config.top : cell_count;
+    for (size_t i = 0; i < shown; i++) {
+        const struct cell *c = &cells[i];
+        if (c->failed) {
+            printf("%4zu  %-48s %10s\n", i + 1, c->label, "failed");
+            continue;
+        }
+        printf("%4zu  %-48s %10.4f %10lu %4d/%d %10.3g%s\n", i + 1, c->label,
+               (double)c->bits / event_count, c->bytes, c->passed, HB_QUICK_TESTS, c->min_p,
+               c->cached ? "  (cached)" : "");
+    }
+    if (shown < cell_count) {
+        printf("  ... %zu more (--top 0 lists all)\n", cell_count - shown);
+    }
+
+    if (config.json_path) {
+        write_json(config.json_path, dataset);
+    }
+
+    free(cells);
+    hb_events_free(&ev);
+    return 0;
+}
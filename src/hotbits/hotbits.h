@@ -0,0 +1,76 @@
+#ifndef HOTBITS_H
+#define HOTBITS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "alloc.h"
+#include "pipeline.h"
+#include "quicktest.h"
+
+// libhotbits: the native pipeline as an embeddable stream.
+//
+// A stream runs the same filter (dead time, time windows) -> extractor
+// (interval, von_neumann, xor_fold, lsb, adaptive_threshold) -> conditioner
+// (von Neumann debias) -> pack chain as hotbits-extract, with the quick
+// tests kept over everything it has produced. Event deltas go in with
+// push() or as trng text with push_text()/read_fd(); packed random bytes
+// come out with pull(). All state lives in the stream and every allocation
+// goes through the allocator given at creation, so independent streams can
+// run on separate threads without locking. Link with libhotbits.a or
+// libhotbits.so (plus -lm -pthread and, if built with them, -lz -lzstd).
+struct hb_stream;
+
+// cfg NULL uses hb_pipeline_config_default (extract.py's defaults). alloc
+// NULL uses malloc; otherwise it is copied, and its ctx must outlive the
+// stream.
+struct hb_stream *hb_stream_create(const struct hb_pipeline_config *cfg,
+                                   const struct hb_allocator *alloc);
+void hb_stream_destroy(struct hb_stream *s);
+
+// Push a batch of event deltas in nanoseconds. Returns 0 or -1.
+int hb_stream_push(struct hb_stream *s, const uint64_t *deltas, size_t count);
+
+// Push trng text (one decimal delta per line) in chunks of any size; a
+// line split across calls is held until its newline arrives.
+int hb_stream_push_text(struct hb_stream *s, const char *text, size_t len);
+
+// Capture source: read whatever is available from fd (a trng pipe, socket
+// or events file) and push it as text. Returns the bytes read, 0 at end
+// of file or -1 with errno set (EAGAIN on an empty non-blocking fd).
+ssize_t hb_stream_read_fd(struct hb_stream *s, int fd);
+
+// End of input: parses a final unterminated line and flushes the values
+// held for lookahead and the last partial byte. Push after finish fails.
+int hb_stream_finish(struct hb_stream *s);
+
+// Packed output waiting to be pulled
+size_t hb_stream_available(const struct hb_stream *s);
+
+// Copy up to len bytes of output to out; returns the number copied
+size_t hb_stream_pull(struct hb_stream *s, void *out, size_t len);
+
+// Output handed over without a copy: len bytes at data, inside block (size
+// bytes from the stream's allocator, freed with hb_free once data is no
+// longer needed; it may outlive the stream)
+struct hb_output {
+    void *block;
+    size_t size;
+    const uint8_t *data;
+    size_t len;
+};
+
+// Take everything hb_stream_pull would return, in place; later output
+// goes to a new buffer. With nothing available, out->block is NULL.
+void hb_stream_detach(struct hb_stream *s, struct hb_output *out);
+
+// Totals since creation
+uint64_t hb_stream_events(const struct hb_stream *s);
+uint64_t hb_stream_bits(const struct hb_stream *s);
+
+// Quick test battery over every byte the stream has produced so far
+void hb_stream_quick_tests(const struct hb_stream *s,
+                           struct hb_test_result results[HB_QUICK_TESTS]);
+
+#endif
@@ -0,0 +1,382 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "incremental.h"
+#include "codec.h"
+#include "events.h"
+#include "hash.h"
+#include "segments.h"
+
+#define MANIFEST_HEADER "# hotbits incremental manifest v1"
+
+struct manifest_entry {
+    char name[256];
+    uint64_t size;
+    int64_t mtime;
+    uint64_t hash;
+    uint64_t output_bytes;
+};
+
+struct manifest {
+    struct manifest_entry *entries;
+    size_t count;
+};
+
+static int64_t mtime_ns(const struct stat *st) {
+    return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+static const char *base_name(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+// The ordinal block length and quantile rate window are appended only for
+// their method, so manifests written before they existed stay valid
+static void config_line(char *buf, size_t len, const struct hb_pipeline_config *cfg) {
+    int n = snprintf(buf, len, "config %d %d %d %d %lu %lu %d",
+                     cfg->method, cfg->bit_pos, cfg->window, cfg->debias,
+                     cfg->dead_time_ns, cfg->window_ns, cfg->window_mode);
+    if (cfg->method == HB_METHOD_ORDINAL) {
+        snprintf(buf + n, len - n, " %d", cfg->order);
+    } else if (cfg->method == HB_METHOD_QUANTILE) {
+        snprintf(buf + n, len - n, " %d", cfg->rate_window);
+    }
+}
+
+// Load the manifest if it was written for the same configuration and
+// output file; otherwise start from an empty one.
+static int manifest_load(const char *path, const char *expect_config,
+                         const char *expect_output, struct manifest *m) {
+    m->entries = NULL;
+    m->count = 0;
+
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return 0;
+    }
+
+    char line[PATH_MAX + 64];
+    size_t cap = 0;
+    int valid = 1;
+
+    if (!fgets(line, sizeof(line), f) || strncmp(line, MANIFEST_HEADER, strlen(MANIFEST_HEADER)) != 0) {
+        valid = 0;
+    }
+    if (valid && (!fgets(line, sizeof(line), f) ||
+                  strncmp(line, expect_config, strlen(expect_config)) != 0 ||
+                  line[strlen(expect_config)] != '\n')) {
+        valid = 0;
+    }
+    if (valid && (!fgets(line, sizeof(line), f) || strncmp(line, "output ", 7) != 0)) {
+        valid = 0;
+    }
+    if (valid) {
+        line[strcspn(line, "\n")] = '\0';
+        valid = strcmp(line + 7, expect_output) == 0;
+    }
+
+    while (valid && fgets(line, sizeof(line), f)) {
+        struct manifest_entry e;
+        if (sscanf(line, "%255s %lu %ld %lx %lu", e.name, &e.size, &e.mtime,
+                   &e.hash, &e.output_bytes) != 5) {
+            continue;
+        }
+        if (m->count == cap) {
+            cap = cap ? cap * 2 : 64;
+            struct manifest_entry *entries = realloc(m->entries, cap * sizeof(*entries));
+            if (!entries) {
+                fprintf(stderr, "Memory allocation failed\n");
+                fclose(f);
+                free(m->entries);
+                m->entries = NULL;
+                m->count = 0;
+                return -1;
+            }
+            m->entries = entries;
+        }
+        m->entries[m->count++] = e;
+    }
+
+    if (!valid) {
+        m->count = 0;
+    }
+    fclose(f);
+    return 0;
+}
+
+// Written to a temporary file and renamed, so a crash leaves either the old
+// or the new manifest. The manifest is always written last; outputs and
+// checkpoints beyond what it records are discarded by the next run.
+static int manifest_save(const char *path, const char *config, const char *output,
+                         const struct manifest *m) {
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    FILE *f = fopen(tmp, "w");
+    if (!f) {
+        perror(tmp);
+        return -1;
+    }
+
+    fprintf(f, "%s\n%s\noutput %s\n", MANIFEST_HEADER, config, output);
+    for (size_t i = 0; i < m->count; i++) {
+        const struct manifest_entry *e = &m->entries[i];
+        fprintf(f, "%s %lu %ld %016lx %lu\n", e->name, e->size, e->mtime, e->hash,
+                e->output_bytes);
+    }
+
+    if (fflush(f) != 0 || fsync(fileno(f)) != 0 || fclose(f) != 0) {
+        perror(tmp);
+        return -1;
+    }
+    if (rename(tmp, path) < 0) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+static void checkpoint_path(char *buf, size_t len, const char *state_dir, const char *name) {
+    snprintf(buf, len, "%s/%s.ckpt", state_dir, name);
+}
+
+// Map a segment once to both hash and parse it
+static int read_segment(const char *path, struct hb_events *ev, uint64_t *hash) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+
+    ev->count = 0;
+    if (st.st_size == 0) {
+        *hash = hb_hash64("", 0, 0);
+        close(fd);
+        return 0;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+
+    *hash = hb_hash64(map, st.st_size, 0);
+    int rv = hb_codec_is_packed(path) ? hb_codec_load_file(ev, path)
+                                      : hb_events_parse_buffer(ev, map, st.st_size);
+    munmap(map, st.st_size);
+    return rv;
+}
+
+// A segment is unchanged if name and size match and either the mtime is the
+// same or the content hash still matches.
+static int segment_unchanged(const char *path, const struct manifest_entry *e) {
+    struct stat st;
+
+    if (strcmp(base_name(path), e->name) != 0 || stat(path, &st) < 0 ||
+        (uint64_t)st.st_size != e->size) {
+        return 0;
+    }
+    if (mtime_ns(&st) == e->mtime) {
+        return 1;
+    }
+
+    uint64_t hash;
+    return hb_hash_file(path, &hash) == 0 && hash == e->hash;
+}
+
+static int restore_checkpoint(struct hb_pipeline *p, const struct hb_pipeline_config *cfg,
+                              const char *state_dir, const char *name) {
+    char path[PATH_MAX];
+    checkpoint_path(path, sizeof(path), state_dir, name);
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return -1;
+    }
+    int rv = hb_pipeline_load(p, cfg, f);
+    fclose(f);
+    return rv;
+}
+
+static int save_checkpoint(const struct hb_pipeline *p, const char *state_dir, const char *name) {
+    char path[PATH_MAX];
+    char tmp[PATH_MAX];
+    checkpoint_path(path, sizeof(path), state_dir, name);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        perror(tmp);
+        return -1;
+    }
+    if (hb_pipeline_save(p, f) < 0 || fclose(f) != 0) {
+        return -1;
+    }
+    if (rename(tmp, path) < 0) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+int hb_incremental_run(const char *data_dir, const char *state_dir,
+                       const char *output_path, const struct hb_pipeline_config *cfg,
+                       struct hb_incremental_stats *stats) {
+    char manifest_path[PATH_MAX];
+    char config[256];
+    struct hb_segments segs;
+    struct manifest old, cur;
+    struct hb_pipeline pipeline;
+    int rv = -1;
+
+    memset(stats, 0, sizeof(*stats));
+
+    if (mkdir(state_dir, 0755) < 0 && errno != EEXIST) {
+        perror(state_dir);
+        return -1;
+    }
+
+    snprintf(manifest_path, sizeof(manifest_path), "%s/manifest", state_dir);
+    config_line(config, sizeof(config), cfg);
+
+    if (hb_segments_list(data_dir, &segs) < 0) {
+        return -1;
+    }
+    stats->segments = segs.count;
+
+    if (manifest_load(manifest_path, config, output_path, &old) < 0) {
+        hb_segments_free(&segs);
+        return -1;
+    }
+
+    // Longest unchanged prefix whose output and checkpoint are still intact
+    struct stat out_st;
+    uint64_t out_size = stat(output_path, &out_st) == 0 ? (uint64_t)out_st.st_size : 0;
+    size_t keep = 0;
+    while (keep < segs.count && keep < old.count &&
+           segment_unchanged(segs.paths[keep], &old.entries[keep]) &&
+           old.entries[keep].output_bytes <= out_size) {
+        keep++;
+    }
+
+    while (keep > 0 && restore_checkpoint(&pipeline, cfg, state_dir,
+                                          old.entries[keep - 1].name) < 0) {
+        keep--;
+    }
+    if (keep == 0 && hb_pipeline_init(&pipeline, cfg) < 0) {
+        free(old.entries);
+        hb_segments_free(&segs);
+        return -1;
+    }
+
+    cur.entries = calloc(segs.count ? segs.count : 1, sizeof(struct manifest_entry));
+    if (!cur.entries) {
+        fprintf(stderr, "Memory allocation failed\n");
+        goto out_pipeline;
+    }
+    memcpy(cur.entries, old.entries, keep * sizeof(struct manifest_entry));
+    cur.count = keep;
+
+    uint64_t committed = keep ? old.entries[keep - 1].output_bytes : 0;
+    stats->segments_reused = keep;
+
+    int fd = open(output_path, O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) {
+        perror(output_path);
+        goto out_entries;
+    }
+    if (ftruncate(fd, (off_t)committed) < 0 || lseek(fd, (off_t)committed, SEEK_SET) < 0) {
+        perror(output_path);
+        close(fd);
+        goto out_entries;
+    }
+
+    struct hb_events ev;
+    struct hb_buffer out;
+    hb_events_init(&ev);
+    hb_buffer_init(&out);
+
+    for (size_t i = keep; i < segs.count; i++) {
+        struct manifest_entry *e = &cur.entries[i];
+        struct stat st;
+
+        if (stat(segs.paths[i], &st) < 0) {
+            perror(segs.paths[i]);
+            goto out_io;
+        }
+        if (read_segment(segs.paths[i], &ev, &e->hash) < 0) {
+            goto out_io;
+        }
+
+        out.len = 0;
+        if (hb_pipeline_push(&pipeline, ev.values, ev.count, &out) < 0) {
+            goto out_io;
+        }
+
+        size_t off = 0;
+        while (off < out.len) {
+            ssize_t w = write(fd, out.data + off, out.len - off);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                perror(output_path);
+                goto out_io;
+            }
+            off += w;
+        }
+
+        committed += out.len;
+        snprintf(e->name, sizeof(e->name), "%s", base_name(segs.paths[i]));
+        e->size = st.st_size;
+        e->mtime = mtime_ns(&st);
+        e->output_bytes = committed;
+
+        if (save_checkpoint(&pipeline, state_dir, e->name) < 0) {
+            goto out_io;
+        }
+        cur.count = i + 1;
+
+        stats->segments_processed++;
+        stats->events_processed += ev.count;
+        stats->bytes_appended += out.len;
+    }
+
+    if (fsync(fd) < 0) {
+        perror(output_path);
+        goto out_io;
+    }
+    if (manifest_save(manifest_path, config, output_path, &cur) < 0) {
+        goto out_io;
+    }
+
+    stats->output_bytes = committed;
+    rv = 0;
+
+out_io:
+    close(fd);
+    hb_events_free(&ev);
+    hb_buffer_free(&out);
+out_entries:
+    free(cur.entries);
+out_pipeline:
+    hb_pipeline_free(&pipeline);
+    free(old.entries);
+    hb_segments_free(&segs);
+    return rv;
+}
@@ -0,0 +1,31 @@
+#ifndef HOTBITS_INCREMENTAL_H
+#define HOTBITS_INCREMENTAL_H
+
+#include <stdint.h>
+
+#include "pipeline.h"
+
+// Incremental extraction over data/events-*.txt.
+//
+// state_dir holds a manifest with one line per segment (name, size, mtime in ns,
+// content hash, output length after the segment) and a pipeline checkpoint
+// taken at each segment boundary. A run keeps the longest unchanged prefix
+// of segments, truncates the output to that prefix, restores the matching
+// checkpoint and processes only the remaining segments, appending to the
+// output. The output holds every byte the extractor has committed; bits
+// still waiting on lookahead or a partial byte stay in the last checkpoint
+// until more events arrive.
+struct hb_incremental_stats {
+    uint64_t segments;
+    uint64_t segments_reused;
+    uint64_t segments_processed;
+    uint64_t events_processed;
+    uint64_t bytes_appended;
+    uint64_t output_bytes;
+};
+
+int hb_incremental_run(const char *data_dir, const char *state_dir,
+                       const char *output_path, const struct hb_pipeline_config *cfg,
+                       struct hb_incremental_stats *stats);
+
+#endif
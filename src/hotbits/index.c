@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "index.h"
+#include "hash.h"
+
+#define INDEX_MAGIC 0x58494248u     // "HBIX"
+#define INDEX_VERSION 1
+#define TAIL_BYTES 4096
+
+struct index_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t stride;
+    uint32_t reserved;
+    uint64_t size;
+    int64_t mtime_ns;
+    uint64_t tail_hash;
+    uint64_t events;
+    uint64_t total_ns;
+    uint64_t entry_count;
+};
+
+void hb_index_init(struct hb_segment_index *idx, uint32_t stride) {
+    memset(idx, 0, sizeof(*idx));
+    idx->stride = stride ? stride : HB_INDEX_STRIDE;
+}
+
+void hb_index_free(struct hb_segment_index *idx) {
+    free(idx->entries);
+    hb_index_init(idx, idx->stride);
+}
+
+void hb_index_path(char *buf, size_t len, const char *segment_path) {
+    snprintf(buf, len, "%s.idx", segment_path);
+}
+
+int hb_index_add(struct hb_segment_index *idx, uint64_t delta_ns, uint64_t line_bytes) {
+    idx->total_ns += delta_ns;
+
+    if (idx->events % idx->stride == 0) {
+        if (idx->entry_count == idx->entry_cap) {
+            size_t cap = idx->entry_cap ? idx->entry_cap * 2 : 64;
+            struct hb_index_entry *entries = realloc(idx->entries, cap * sizeof(*entries));
+            if (!entries) {
+                fprintf(stderr, "Memory allocation failed\n");
+                return -1;
+            }
+            idx->entries = entries;
+            idx->entry_cap = cap;
+        }
+        idx->entries[idx->entry_count].offset = idx->size;
+        idx->entries[idx->entry_count].time_ns = idx->total_ns;
+        idx->entry_count++;
+    }
+
+    idx->events++;
+    idx->size += line_bytes;
+    return 0;
+}
+
+static int64_t mtime_ns(const struct stat *st) {
+    return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+static int tail_hash(int fd, uint64_t size, uint64_t *hash) {
+    char buf[TAIL_BYTES];
+    size_t n = size < TAIL_BYTES ? (size_t)size : TAIL_BYTES;
+    off_t off = (off_t)(size - n);
+    size_t got = 0;
+
+    while (got < n) {
+        ssize_t r = pread(fd, buf + got, n - got, off + got);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) {
+            return -1;
+        }
+        got += r;
+    }
+    *hash = hb_hash64(buf, n, 0);
+    return 0;
+}
+
+int hb_index_finish(struct hb_segment_index *idx, const char *segment_path) {
+    int fd = open(segment_path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open %s: %s\n", segment_path, strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || tail_hash(fd, idx->size, &idx->tail_hash) < 0) {
+        fprintf(stderr, "Cannot index %s: %s\n", segment_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    idx->mtime_ns = mtime_ns(&st);
+    close(fd);
+    return 0;
+}
+
+int hb_index_load(const char *index_path, struct hb_segment_index *idx) {
+    struct index_header hdr;
+
+    FILE *f = fopen(index_path, "rb");
+    if (!f) {
+        return -1;
+    }
+
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != INDEX_MAGIC ||
+        hdr.version != INDEX_VERSION || hdr.stride == 0 ||
+        hdr.entry_count != (hdr.events + hdr.stride - 1) / hdr.stride) {
+        fclose(f);
+        return -1;
+    }
+
+    hb_index_init(idx, hdr.stride);
+    idx->entries = malloc((hdr.entry_count ? hdr.entry_count : 1) * sizeof(struct hb_index_entry));
+    if (!idx->entries) {
+        fprintf(stderr, "Memory allocation failed\n");
+        fclose(f);
+        return -1;
+    }
+    if (fread(idx->entries, sizeof(struct hb_index_entry), hdr.entry_count, f) != hdr.entry_count) {
+        hb_index_free(idx);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    idx->size = hdr.size;
+    idx->mtime_ns = hdr.mtime_ns;
+    idx->tail_hash = hdr.tail_hash;
+    idx->events = hdr.events;
+    idx->total_ns = hdr.total_ns;
+    idx->entry_count = hdr.entry_count;
+    idx->entry_cap = hdr.entry_count;
+    return 0;
+}
+
+// Written to a temporary file and renamed so readers never see a torn index.
+// Failures are left to the caller to report: archive readers treat an
+// unwritable data directory as "keep the index in memory".
+int hb_index_save(const char *index_path, const struct hb_segment_index *idx) {
+    struct index_header hdr = {
+        INDEX_MAGIC, INDEX_VERSION, idx->stride, 0, idx->size, idx->mtime_ns,
+        idx->tail_hash, idx->events, idx->total_ns, idx->entry_count
+    };
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", index_path);
+
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        return -1;
+    }
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+        (idx->entry_count &&
+         fwrite(idx->entries, sizeof(struct hb_index_entry), idx->entry_count, f) != idx->entry_count)) {
+        fclose(f);
+        unlink(tmp);
+        return -1;
+    }
+    if (fclose(f) != 0 || rename(tmp, index_path) < 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+// Index every complete line from idx->size onwards. Lines without leading
+// digits are not events but still advance the offset, as in hb_parse_deltas.
+static int scan_segment(struct hb_segment_index *idx, const char *buf, size_t len) {
+    size_t pos = idx->size;
+
+    while (pos < len) {
+        const char *nl = memchr(buf + pos, '\n', len - pos);
+        if (!nl) {
+            break;
+        }
+        size_t end = nl - buf;
+
+        size_t i = pos;
+        while (i < end && (buf[i] == ' ' || buf[i] == '\t')) {
+            i++;
+        }
+        if (i < end && buf[i] >= '0' && buf[i] <= '9') {
+            uint64_t value = 0;
+            while (i < end && buf[i] >= '0' && buf[i] <= '9') {
+                value = value * 10 + (uint64_t)(buf[i] - '0');
+                i++;
+            }
+            if (hb_index_add(idx, value, end + 1 - pos) < 0) {
+                return -1;
+            }
+        } else {
+            idx->size += end + 1 - pos;
+        }
+        pos = end + 1;
+    }
+    return 0;
+}
+
+int hb_index_refresh(const char *segment_path, struct hb_segment_index *idx) {
+    int fd = open(segment_path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open %s: %s\n", segment_path, strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror(segment_path);
+        close(fd);
+        return -1;
+    }
+
+    uint64_t size = (uint64_t)st.st_size;
+    if (idx->stride && size == idx->size && mtime_ns(&st) == idx->mtime_ns) {
+        close(fd);
+        return 0;
+    }
+
+    // Appended to since the index was written: keep the covered prefix
+    uint64_t hash;
+    int extend = idx->stride && size >= idx->size &&
+                 tail_hash(fd, idx->size, &hash) == 0 && hash == idx->tail_hash;
+    if (!extend) {
+        hb_index_free(idx);
+    }
+
+    int rv = 0;
+    if (size > idx->size) {
+        void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            perror("mmap");
+            close(fd);
+            return -1;
+        }
+        madvise(map, size, MADV_SEQUENTIAL);
+        rv = scan_segment(idx, map, size);
+        munmap(map, size);
+    }
+
+    if (rv == 0 && tail_hash(fd, idx->size, &idx->tail_hash) < 0) {
+        perror(segment_path);
+        rv = -1;
+    }
+    idx->mtime_ns = mtime_ns(&st);
+    close(fd);
+    return rv < 0 ? -1 : 1;
+}
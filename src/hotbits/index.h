@@ -0,0 +1,52 @@
+#ifndef HOTBITS_INDEX_H
+#define HOTBITS_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Sparse per-segment index, stored next to the segment as events-N.txt.idx.
+//
+// Every stride-th event gets an entry with the byte offset of its line and
+// its time relative to the segment start (the running sum of deltas up to
+// and including it). Only newline-terminated lines are covered, matching
+// `wc -l` in the shell scripts, so a segment trng is still writing can be
+// indexed and later extended from where the previous index stopped.
+#define HB_INDEX_STRIDE 4096
+
+struct hb_index_entry {
+    uint64_t offset;
+    uint64_t time_ns;
+};
+
+struct hb_segment_index {
+    uint32_t stride;
+    uint64_t size;           // bytes covered (end of the last complete line)
+    int64_t mtime_ns;        // segment mtime when the index was finished
+    uint64_t tail_hash;      // hash of the last covered bytes, for extension
+    uint64_t events;
+    uint64_t total_ns;       // sum of every covered delta
+    struct hb_index_entry *entries;
+    size_t entry_count;
+    size_t entry_cap;
+};
+
+void hb_index_init(struct hb_segment_index *idx, uint32_t stride);
+void hb_index_free(struct hb_segment_index *idx);
+void hb_index_path(char *buf, size_t len, const char *segment_path);
+
+// Record one event whose line of line_bytes bytes starts at idx->size.
+// Writers that produce the segment (trng) call this as they go.
+int hb_index_add(struct hb_segment_index *idx, uint64_t delta_ns, uint64_t line_bytes);
+
+// Stamp size/mtime/tail hash from the segment file once it is closed
+int hb_index_finish(struct hb_segment_index *idx, const char *segment_path);
+
+int hb_index_load(const char *index_path, struct hb_segment_index *idx);
+int hb_index_save(const char *index_path, const struct hb_segment_index *idx);
+
+// Bring idx up to date with the segment: keep it if the segment is
+// unchanged, extend it if the segment only grew, otherwise rebuild it.
+// Returns 1 if idx changed, 0 if it was current, -1 on error.
+int hb_index_refresh(const char *segment_path, struct hb_segment_index *idx);
+
+#endif
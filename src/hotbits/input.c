@@ -0,0 +1,785 @@
+#define _GNU_SOURCE     // pipe2, splice, F_SETPIPE_SZ
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "input.h"
+#include "pool.h"
+
+#define IO_CHUNK (1 << 18)
+#define PIPE_SIZE (1 << 20)
+#define TASK_BYTES (1 << 20)    // compressed bytes per parallel task
+
+const char *hb_input_format_name(int format) {
+    switch (format) {
+        case HB_INPUT_GZIP: return "gzip";
+        case HB_INPUT_ZSTD: return "zstd";
+        default: return "plain";
+    }
+}
+
+static int sniff(const uint8_t *p, size_t n) {
+    if (n >= 2 && p[0] == 0x1f && p[1] == 0x8b) {
+        return HB_INPUT_GZIP;
+    }
+    if (n >= 4 && p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f && p[3] == 0xfd) {
+        return HB_INPUT_ZSTD;
+    }
+    // zstd skippable frame (0x184D2A50 - 0x184D2A5F)
+    if (n >= 4 && (p[0] & 0xf0) == 0x50 && p[1] == 0x2a && p[2] == 0x4d && p[3] == 0x18) {
+        return HB_INPUT_ZSTD;
+    }
+    return HB_INPUT_PLAIN;
+}
+
+// Source bytes, replaying whatever sniffing consumed from a pipe first
+static ssize_t read_src(struct hb_input *in, void *buf, size_t len) {
+    if (in->prefix_len) {
+        size_t n = in->prefix_len < len ? in->prefix_len : len;
+        memcpy(buf, in->prefix, n);
+        memmove(in->prefix, in->prefix + n, in->prefix_len - n);
+        in->prefix_len -= n;
+        return n;
+    }
+    for (;;) {
+        ssize_t r = read(in->src, buf, len);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r < 0) {
+            perror(in->name);
+        }
+        return r;
+    }
+}
+
+// A reader that stops early closes its end; that is not an error to report
+static int emit(struct hb_input *in, const void *buf, size_t len) {
+    const uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t w = write(in->out, p, len);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EPIPE) {
+                perror("write");
+            }
+            return -1;
+        }
+        p += w;
+        len -= w;
+    }
+    return 0;
+}
+
+// Plain text from a pipe: hand back the sniffed bytes, then splice the rest
+static int copy_plain(struct hb_input *in, uint8_t *buf) {
+    if (in->prefix_len && emit(in, in->prefix, in->prefix_len) < 0) {
+        return -1;
+    }
+    in->prefix_len = 0;
+
+    for (;;) {
+        ssize_t n = splice(in->src, NULL, in->out, NULL, PIPE_SIZE, SPLICE_F_MOVE);
+        if (n > 0) continue;
+        if (n == 0) return 0;
+        if (errno == EINTR) continue;
+        if (errno == EPIPE) return -1;
+        break;    // not spliceable (e.g. a tty); copy instead
+    }
+
+    for (;;) {
+        ssize_t n = read_src(in, buf, IO_CHUNK);
+        if (n <= 0) {
+            return n == 0 ? 0 : -1;
+        }
+        if (emit(in, buf, n) < 0) {
+            return -1;
+        }
+    }
+}
+
+// Without the library, decode with the command line tool; the thread feeds
+// it so sniffed bytes and pipes work the same way as with the library
+static int run_external(struct hb_input *in, uint8_t *buf) {
+    char *const gzip_argv[] = { "gzip", "-dc", NULL };
+    char *const zstd_argv[] = { "zstd", "-dcq", NULL };
+    char *const *argv = in->format == HB_INPUT_GZIP ? gzip_argv : zstd_argv;
+
+    int feed[2];
+    if (pipe2(feed, O_CLOEXEC) < 0) {
+        perror("pipe");
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(feed[0]);
+        close(feed[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        dup2(feed[0], STDIN_FILENO);
+        dup2(in->out, STDOUT_FILENO);
+        execvp(argv[0], argv);
+        fprintf(stderr, "%s: cannot run %s for %s input: %s\n",
+                in->name, argv[0], hb_input_format_name(in->format), strerror(errno));
+        _exit(127);
+    }
+    close(feed[0]);
+
+    int rv = 0;
+    for (;;) {
+        ssize_t n = read_src(in, buf, IO_CHUNK);
+        if (n <= 0) {
+            rv = n == 0 ? 0 : -1;
+            break;
+        }
+        const uint8_t *p = buf;
+        while (n > 0) {
+            ssize_t w = write(feed[1], p, n);
+            if (w < 0 && errno == EINTR) continue;
+            if (w < 0) break;    // decompressor exited; its status says why
+            p += w;
+            n -= w;
+        }
+        if (n > 0) break;
+    }
+    close(feed[1]);
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        // A reader that stopped early kills the child with SIGPIPE
+        if (!(WIFSIGNALED(status) && WTERMSIG(status) == SIGPIPE)) {
+            fprintf(stderr, "%s: %s -d failed\n", in->name, argv[0]);
+        }
+        rv = -1;
+    }
+    return rv;
+}
+
+#ifdef HAVE_ZLIB
+static int gunzip_stream(struct hb_input *in, uint8_t *ibuf, uint8_t *obuf) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) {
+        fprintf(stderr, "%s: inflateInit failed\n", in->name);
+        return -1;
+    }
+
+    int rv = -1;
+    int eof = 0;
+    int ended = 0;
+    for (;;) {
+        if (zs.avail_in == 0 && !eof) {
+            ssize_t r = read_src(in, ibuf, IO_CHUNK);
+            if (r < 0) {
+                break;
+            }
+            eof = r == 0;
+            zs.next_in = ibuf;
+            zs.avail_in = r;
+        }
+        if (ended) {
+            // Concatenated members decode as one stream, like gzip -d
+            if (zs.avail_in == 0) {
+                if (eof) {
+                    rv = 0;
+                    break;
+                }
+                continue;
+            }
+            if (zs.next_in[0] != 0x1f) {
+                rv = 0;    // trailing padding
+                break;
+            }
+            inflateReset(&zs);
+            ended = 0;
+        }
+        if (zs.avail_in == 0 && eof) {
+            fprintf(stderr, "%s: unexpected end of gzip data\n", in->name);
+            break;
+        }
+
+        zs.next_out = obuf;
+        zs.avail_out = IO_CHUNK;
+        int ret = inflate(&zs, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            fprintf(stderr, "%s: corrupt gzip data (%s)\n", in->name,
+                    zs.msg ? zs.msg : "inflate failed");
+            break;
+        }
+        if (emit(in, obuf, IO_CHUNK - zs.avail_out) < 0) {
+            break;
+        }
+        ended = ret == Z_STREAM_END;
+    }
+
+    inflateEnd(&zs);
+    return rv;
+}
+#endif
+
+#ifdef HAVE_ZSTD
+static int unzstd_stream(struct hb_input *in, uint8_t *ibuf, uint8_t *obuf) {
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    if (!dctx) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+
+    int rv = -1;
+    size_t last = 0;
+    int full = 0;
+    ZSTD_inBuffer zin = { ibuf, 0, 0 };
+    for (;;) {
+        // A full output buffer may leave decoded data inside the context
+        if (zin.pos == zin.size && !full) {
+            ssize_t r = read_src(in, ibuf, IO_CHUNK);
+            if (r < 0) {
+                break;
+            }
+            if (r == 0) {
+                if (last != 0) {
+                    fprintf(stderr, "%s: unexpected end of zstd data\n", in->name);
+                } else {
+                    rv = 0;
+                }
+                break;
+            }
+            zin.size = r;
+            zin.pos = 0;
+        }
+
+        ZSTD_outBuffer zout = { obuf, IO_CHUNK, 0 };
+        last = ZSTD_decompressStream(dctx, &zout, &zin);
+        if (ZSTD_isError(last)) {
+            fprintf(stderr, "%s: corrupt zstd data (%s)\n", in->name, ZSTD_getErrorName(last));
+            break;
+        }
+        full = zout.pos == zout.size;
+        if (emit(in, obuf, zout.pos) < 0) {
+            break;
+        }
+    }
+
+    ZSTD_freeDCtx(dctx);
+    return rv;
+}
+#endif
+
+// Parallel decoding of independently compressed frames in a regular file.
+// Frames are grouped into tasks of about TASK_BYTES, decoded on a pool and
+// written in file order; at most two tasks per thread are in flight so
+// memory stays bounded on large inputs.
+struct frame_set;
+
+struct frame_task {
+    const uint8_t *data;
+    size_t len;
+    size_t hint;          // decoded size if the headers give it
+    int format;
+    const char *name;
+    uint8_t *out;
+    size_t out_len;
+    size_t out_cap;
+    int state;            // 0 queued, 1 done, -1 failed
+    struct frame_set *set;
+};
+
+struct frame_set {
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+};
+
+static int task_reserve(struct frame_task *t, size_t need) {
+    if (need <= t->out_cap) {
+        return 0;
+    }
+    size_t cap = t->out_cap ? t->out_cap * 2 : need;
+    while (cap < need) {
+        cap *= 2;
+    }
+    uint8_t *out = realloc(t->out, cap);
+    if (!out) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+    t->out = out;
+    t->out_cap = cap;
+    return 0;
+}
+
+#ifdef HAVE_ZLIB
+// BGZF members carry their own size in a 'BC' extra subfield
+static size_t bgzf_member(const uint8_t *p, size_t len, size_t *isize) {
+    if (len < 28 || p[0] != 0x1f || p[1] != 0x8b || p[2] != 8 || !(p[3] & 4)) {
+        return 0;
+    }
+    size_t xlen = p[10] | (size_t)p[11] << 8;
+    if (12 + xlen > len) {
+        return 0;
+    }
+    for (size_t i = 12; i + 4 <= 12 + xlen; ) {
+        size_t slen = p[i + 2] | (size_t)p[i + 3] << 8;
+        if (p[i] == 'B' && p[i + 1] == 'C' && slen == 2 && i + 6 <= 12 + xlen) {
+            size_t bsize = (p[i + 4] | (size_t)p[i + 5] << 8) + 1;
+            if (bsize < 28 || bsize > len) {
+                return 0;
+            }
+            const uint8_t *t = p + bsize - 4;
+            *isize = t[0] | (size_t)t[1] << 8 | (size_t)t[2] << 16 | (size_t)t[3] << 24;
+            return bsize;
+        }
+        i += 4 + slen;
+    }
+    return 0;
+}
+
+static int inflate_task(struct frame_task *t) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) {
+        fprintf(stderr, "%s: inflateInit failed\n", t->name);
+        return -1;
+    }
+
+    int rv = 0;
+    int ended = 0;
+    zs.next_in = (uint8_t *)t->data;
+    zs.avail_in = t->len;
+    while (zs.avail_in > 0) {
+        if (ended) {
+            inflateReset(&zs);
+            ended = 0;
+        }
+        if (task_reserve(t, t->out_len + IO_CHUNK) < 0) {
+            rv = -1;
+            break;
+        }
+        zs.next_out = t->out + t->out_len;
+        zs.avail_out = t->out_cap - t->out_len;
+        int ret = inflate(&zs, Z_NO_FLUSH);
+        t->out_len = t->out_cap - zs.avail_out;
+        if (ret != Z_OK && ret != Z_STREAM_END) {
+            fprintf(stderr, "%s: corrupt gzip data (%s)\n", t->name,
+                    zs.msg ? zs.msg : "inflate failed");
+            rv = -1;
+            break;
+        }
+        ended = ret == Z_STREAM_END;
+    }
+    if (rv == 0 && !ended) {
+        fprintf(stderr, "%s: unexpected end of gzip data\n", t->name);
+        rv = -1;
+    }
+    inflateEnd(&zs);
+    return rv;
+}
+#endif
+
+#ifdef HAVE_ZSTD
+static int unzstd_task(struct frame_task *t) {
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    if (!dctx) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+
+    int rv = 0;
+    size_t last = 0;
+    ZSTD_inBuffer zin = { t->data, t->len, 0 };
+    for (;;) {
+        if (task_reserve(t, t->out_len + IO_CHUNK) < 0) {
+            rv = -1;
+            break;
+        }
+        ZSTD_outBuffer zout = { t->out + t->out_len, t->out_cap - t->out_len, 0 };
+        last = ZSTD_decompressStream(dctx, &zout, &zin);
+        if (ZSTD_isError(last)) {
+            fprintf(stderr, "%s: corrupt zstd data (%s)\n", t->name, ZSTD_getErrorName(last));
+            rv = -1;
+            break;
+        }
+        t->out_len += zout.pos;
+        if (zin.pos == zin.size && zout.pos < zout.size) {
+            break;
+        }
+    }
+    if (rv == 0 && last != 0) {
+        fprintf(stderr, "%s: unexpected end of zstd data\n", t->name);
+        rv = -1;
+    }
+    ZSTD_freeDCtx(dctx);
+    return rv;
+}
+#endif
+
+static void decode_task(void *arg) {
+    struct frame_task *t = arg;
+    int rv = -1;
+
+    if (task_reserve(t, t->hint ? t->hint + 1 : t->len * 4) == 0) {
+#ifdef HAVE_ZLIB
+        if (t->format == HB_INPUT_GZIP) {
+            rv = inflate_task(t);
+        }
+#endif
+#ifdef HAVE_ZSTD
+        if (t->format == HB_INPUT_ZSTD) {
+            rv = unzstd_task(t);
+        }
+#endif
+    }
+
+    pthread_mutex_lock(&t->set->lock);
+    t->state = rv == 0 ? 1 : -1;
+    pthread_cond_broadcast(&t->set->done);
+    pthread_mutex_unlock(&t->set->lock);
+}
+
+// Split the file into tasks at frame boundaries; returns the task count
+// (0 if the frames cannot be located without decoding)
+static size_t plan_tasks(struct hb_input *in, const uint8_t *data, size_t len,
+                         struct frame_task **tasks_out) {
+    struct frame_task *tasks = NULL;
+    size_t count = 0;
+    size_t cap = 0;
+    size_t frames = 0;
+    size_t pos = 0;
+    size_t task_bytes = len / (4 * (size_t)in->threads);
+
+    if (task_bytes > TASK_BYTES) task_bytes = TASK_BYTES;
+    if (task_bytes < IO_CHUNK) task_bytes = IO_CHUNK;
+
+    while (pos < len) {
+        size_t size = 0;
+        size_t decoded = 0;
+#ifdef HAVE_ZLIB
+        if (in->format == HB_INPUT_GZIP) {
+            size = bgzf_member(data + pos, len - pos, &decoded);
+        }
+#endif
+#ifdef HAVE_ZSTD
+        // Seekable zstd is a run of ordinary frames plus a skippable frame
+        // holding the seek table, so walking frame headers covers it too
+        if (in->format == HB_INPUT_ZSTD) {
+            size = ZSTD_findFrameCompressedSize(data + pos, len - pos);
+            if (ZSTD_isError(size)) {
+                size = 0;
+            } else {
+                unsigned long long n = ZSTD_getFrameContentSize(data + pos, size);
+                decoded = n == ZSTD_CONTENTSIZE_UNKNOWN || n == ZSTD_CONTENTSIZE_ERROR ? 0 : n;
+            }
+        }
+#endif
+        if (size == 0) {
+            free(tasks);
+            return 0;
+        }
+
+        struct frame_task *t = count ? &tasks[count - 1] : NULL;
+        if (!t || t->len >= task_bytes) {
+            if (count == cap) {
+                cap = cap ? cap * 2 : 64;
+                struct frame_task *grown = realloc(tasks, cap * sizeof(*tasks));
+                if (!grown) {
+                    free(tasks);
+                    return 0;
+                }
+                tasks = grown;
+            }
+            t = &tasks[count++];
+            memset(t, 0, sizeof(*t));
+            t->data = data + pos;
+            t->format = in->format;
+            t->name = in->name;
+        }
+        t->len += size;
+        t->hint += decoded;
+        frames++;
+        pos += size;
+    }
+
+    if (count < 2) {
+        free(tasks);
+        return 0;
+    }
+    in->frames = frames;
+    *tasks_out = tasks;
+    return count;
+}
+
+static int decode_parallel(struct hb_input *in, struct frame_task *tasks, size_t count) {
+    struct frame_set set;
+    pthread_mutex_init(&set.lock, NULL);
+    pthread_cond_init(&set.done, NULL);
+
+    struct hb_pool *pool = hb_pool_create(in->threads);
+    if (!pool) {
+        return -1;
+    }
+    size_t window = 2 * (size_t)hb_pool_threads(pool);
+    size_t submitted = 0;
+    int rv = 0;
+
+    for (size_t i = 0; i < count && rv == 0; i++) {
+        while (submitted < count && submitted < i + window) {
+            tasks[submitted].set = &set;
+            if (hb_pool_submit(pool, decode_task, &tasks[submitted]) < 0) {
+                rv = -1;
+                break;
+            }
+            submitted++;
+        }
+        if (rv < 0 || i >= submitted) {
+            break;
+        }
+
+        pthread_mutex_lock(&set.lock);
+        while (tasks[i].state == 0) {
+            pthread_cond_wait(&set.done, &set.lock);
+        }
+        pthread_mutex_unlock(&set.lock);
+
+        if (tasks[i].state < 0 || emit(in, tasks[i].out, tasks[i].out_len) < 0) {
+            rv = -1;
+        }
+        free(tasks[i].out);
+        tasks[i].out = NULL;
+    }
+
+    hb_pool_wait(pool);
+    hb_pool_destroy(pool);
+    for (size_t i = 0; i < count; i++) {
+        free(tasks[i].out);
+    }
+    pthread_cond_destroy(&set.done);
+    pthread_mutex_destroy(&set.lock);
+    return rv;
+}
+
+// Returns 1 if the input was not split (decode sequentially instead)
+static int try_parallel(struct hb_input *in) {
+    struct stat st;
+    if (in->threads < 2 || in->prefix_len || fstat(in->src, &st) < 0 || !S_ISREG(st.st_mode)) {
+        return 1;
+    }
+    off_t base = lseek(in->src, 0, SEEK_CUR);
+    if (base < 0 || base >= st.st_size) {
+        return 1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, in->src, 0);
+    if (map == MAP_FAILED) {
+        return 1;
+    }
+
+    struct frame_task *tasks = NULL;
+    size_t count = plan_tasks(in, (const uint8_t *)map + base, st.st_size - base, &tasks);
+    int rv = 1;
+    if (count) {
+        madvise(map, st.st_size, MADV_SEQUENTIAL);
+        rv = decode_parallel(in, tasks, count);
+        free(tasks);
+    }
+    munmap(map, st.st_size);
+    return rv;
+}
+
+static int decode(struct hb_input *in) {
+    if (in->format != HB_INPUT_PLAIN) {
+        int rv = try_parallel(in);
+        if (rv <= 0) {
+            return rv;
+        }
+    }
+
+    uint8_t *ibuf = malloc(IO_CHUNK);
+    uint8_t *obuf = malloc(IO_CHUNK);
+    if (!ibuf || !obuf) {
+        fprintf(stderr, "Memory allocation failed\n");
+        free(ibuf);
+        free(obuf);
+        return -1;
+    }
+
+    int rv;
+    if (in->format == HB_INPUT_PLAIN) {
+        rv = copy_plain(in, ibuf);
+#ifdef HAVE_ZLIB
+    } else if (in->format == HB_INPUT_GZIP) {
+        rv = gunzip_stream(in, ibuf, obuf);
+#endif
+#ifdef HAVE_ZSTD
+    } else if (in->format == HB_INPUT_ZSTD) {
+        rv = unzstd_stream(in, ibuf, obuf);
+#endif
+    } else {
+        rv = run_external(in, ibuf);
+    }
+
+    free(ibuf);
+    free(obuf);
+    return rv;
+}
+
+static void *decoder_main(void *arg) {
+    struct hb_input *in = arg;
+
+    // Writes to a reader that went away fail with EPIPE instead
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    in->status = decode(in);
+    close(in->out);
+    in->out = -1;
+    return NULL;
+}
+
+int hb_input_open_fd(struct hb_input *in, int fd, const char *name, int threads) {
+    memset(in, 0, sizeof(*in));
+    in->fd = fd;
+    in->src = fd;
+    in->out = -1;
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+    in->threads = threads;
+    snprintf(in->name, sizeof(in->name), "%s", name);
+
+    // Sniff without consuming anything when the input can be re-read
+    uint8_t magic[4];
+    ssize_t n;
+    struct stat st;
+    int regular = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+    if (regular) {
+        off_t pos = lseek(fd, 0, SEEK_CUR);
+        do {
+            n = pread(fd, magic, sizeof(magic), pos < 0 ? 0 : pos);
+        } while (n < 0 && errno == EINTR);
+    } else {
+        n = 0;
+        while (n < (ssize_t)sizeof(magic)) {
+            ssize_t r = read(fd, in->prefix + n, sizeof(in->prefix) - n);
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) {
+                if (r < 0) n = -1;
+                break;
+            }
+            n += r;
+        }
+        if (n > 0) {
+            memcpy(magic, in->prefix, n);
+            in->prefix_len = n;
+        }
+    }
+    if (n < 0) {
+        fprintf(stderr, "Cannot read %s: %s\n", in->name, strerror(errno));
+        return -1;
+    }
+
+    in->format = sniff(magic, n);
+    if (in->format == HB_INPUT_PLAIN && regular) {
+        return 0;
+    }
+
+    int p[2];
+    if (pipe2(p, O_CLOEXEC) < 0) {
+        perror("pipe");
+        return -1;
+    }
+    fcntl(p[1], F_SETPIPE_SZ, PIPE_SIZE);
+    in->fd = p[0];
+    in->out = p[1];
+
+    if (pthread_create(&in->thread, NULL, decoder_main, in) != 0) {
+        perror("pthread_create");
+        close(p[0]);
+        close(p[1]);
+        in->fd = in->out = -1;
+        return -1;
+    }
+    in->running = 1;
+    return 0;
+}
+
+int hb_input_open(struct hb_input *in, const char *path, int threads) {
+    if (strcmp(path, "-") == 0) {
+        return hb_input_open_fd(in, STDIN_FILENO, "stdin", threads);
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (hb_input_open_fd(in, fd, path, threads) < 0) {
+        close(fd);
+        return -1;
+    }
+    in->owns_src = 1;
+    return 0;
+}
+
+int hb_input_close(struct hb_input *in) {
+    int rv = 0;
+    if (in->running) {
+        close(in->fd);
+        pthread_join(in->thread, NULL);
+        in->running = 0;
+        rv = in->status;
+    }
+    if (in->owns_src) {
+        close(in->src);
+        in->owns_src = 0;
+    }
+    in->fd = in->src = -1;
+    return rv;
+}
+
+int hb_input_stdin(struct hb_input *in) {
+    // The decoder reads a duplicate so fd 0 can become the pipe
+    int src = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 0);
+    if (src < 0) {
+        perror("stdin");
+        return -1;
+    }
+    if (hb_input_open_fd(in, src, "stdin", 0) < 0) {
+        close(src);
+        return -1;
+    }
+    in->owns_src = 1;
+    if (!in->running) {
+        return 0;
+    }
+
+    if (dup2(in->fd, STDIN_FILENO) < 0) {
+        perror("dup2");
+        hb_input_close(in);
+        return -1;
+    }
+    close(in->fd);
+    in->fd = STDIN_FILENO;
+    return 0;
+}
@@ -0,0 +1,53 @@
+#ifndef HOTBITS_INPUT_H
+#define HOTBITS_INPUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+// Event input that may be gzip or zstd compressed.
+//
+// Opening sniffs the first bytes; plain regular files are read directly.
+// Compressed input is decoded on its own thread into a pipe, so callers
+// keep reading text from in->fd while the next chunk is being inflated.
+// When the input is a regular file whose frames can be located without
+// decoding them (multi-frame or seekable zstd, BGZF gzip with block sizes
+// in the member headers), frames are decoded on a thread pool and written
+// back in order. Builds without zlib or libzstd run gzip -dc / zstd -dc.
+enum hb_input_format {
+    HB_INPUT_PLAIN = 0,
+    HB_INPUT_GZIP,
+    HB_INPUT_ZSTD
+};
+
+struct hb_input {
+    int fd;              // decompressed text
+    int out;             // write end of the pipe, owned by the decoder thread
+    int src;             // underlying file or descriptor
+    int owns_src;
+    int format;
+    int threads;
+    int running;         // decoder thread started
+    pthread_t thread;
+    int status;          // decoder result, valid after close
+    size_t frames;       // frames decoded in parallel (0: sequential)
+    uint8_t prefix[4];   // bytes consumed from a pipe while sniffing
+    size_t prefix_len;
+    char name[256];
+};
+
+// "-" reads stdin. threads <= 0 uses one decoder per online CPU.
+int hb_input_open(struct hb_input *in, const char *path, int threads);
+// Does not take ownership of fd
+int hb_input_open_fd(struct hb_input *in, int fd, const char *name, int threads);
+// Returns -1 if the decoder failed (corrupt or truncated input)
+int hb_input_close(struct hb_input *in);
+
+// For the fgets(stdin) tools: swap fd 0 for the decompressed stream before
+// the first read. Finish with hb_input_close.
+int hb_input_stdin(struct hb_input *in);
+
+const char *hb_input_format_name(int format);
+
+#endif
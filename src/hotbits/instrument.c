@@ -0,0 +1,168 @@
+#include "instrument.h"
+
+#ifdef HB_INSTRUMENT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include "histogram.h"
+
+#define DUMP_BYTES 8192
+
+// One per thread that records, kept after the thread exits so pool
+// workers still count. Each is written by its own thread only; the dump
+// reads it with relaxed atomics.
+struct recorder {
+    struct recorder *next;
+    struct hb_histogram stages[HB_STAGE_COUNT];
+    uint64_t items[HB_STAGE_COUNT];
+};
+
+int hb_instrument_enabled;
+
+static const char *stage_names[HB_STAGE_COUNT] = {
+    "parse", "filter", "extract", "condition", "sink"
+};
+
+static struct {
+    const char *tool;
+    const char *path;
+    uint64_t started;
+    struct recorder *recorders;
+    pthread_mutex_t lock;       // recorder list and dump output
+} instrument = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static __thread struct recorder *local;
+
+static struct recorder *recorder(void) {
+    if (local) {
+        return local;
+    }
+    struct recorder *r = calloc(1, sizeof(*r));
+    if (!r) {
+        return NULL;
+    }
+    for (int s = 0; s < HB_STAGE_COUNT; s++) {
+        hb_histogram_init(&r->stages[s]);
+    }
+    pthread_mutex_lock(&instrument.lock);
+    r->next = instrument.recorders;
+    __atomic_store_n(&instrument.recorders, r, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&instrument.lock);
+    local = r;
+    return r;
+}
+
+void hb_instrument_record(int stage, uint64_t ns) {
+    struct recorder *r = recorder();
+    if (r) {
+        hb_histogram_record(&r->stages[stage], ns);
+    }
+}
+
+void hb_instrument_count(int stage, uint64_t items) {
+    struct recorder *r = recorder();
+    if (r) {
+        __atomic_store_n(&r->items[stage], r->items[stage] + items, __ATOMIC_RELAXED);
+    }
+}
+
+// Merge stage s across threads into h; returns its item count
+static uint64_t merge(int s, struct hb_histogram *h) {
+    uint64_t items = 0;
+    hb_histogram_init(h);
+    for (struct recorder *r = __atomic_load_n(&instrument.recorders, __ATOMIC_ACQUIRE);
+         r; r = r->next) {
+        hb_histogram_merge(h, &r->stages[s]);
+        items += __atomic_load_n(&r->items[s], __ATOMIC_RELAXED);
+    }
+    return items;
+}
+
+void hb_instrument_dump(void) {
+    if (!hb_instrument_enabled) {
+        return;
+    }
+
+    static struct hb_histogram h;
+    static char out[DUMP_BYTES];
+    pthread_mutex_lock(&instrument.lock);
+
+    int threads = 0;
+    for (struct recorder *r = instrument.recorders; r; r = r->next) {
+        threads++;
+    }
+    size_t len = snprintf(out, sizeof(out),
+                          "{\"tool\":\"%s\",\"pid\":%d,\"elapsed_s\":%.3f,\"threads\":%d,\"stages\":{",
+                          instrument.tool, (int)getpid(),
+                          (hb_instrument_now() - instrument.started) / 1e9, threads);
+    int first = 1;
+    for (int s = 0; s < HB_STAGE_COUNT; s++) {
+        uint64_t items = merge(s, &h);
+        if (h.count == 0 && items == 0) {
+            continue;
+        }
+        len += snprintf(out + len, sizeof(out) - len, "%s\"%s\":{\"items\":%lu,",
+                        first ? "" : ",", stage_names[s], items);
+        len += hb_histogram_json(&h, out + len, sizeof(out) - len);
+        len += snprintf(out + len, sizeof(out) - len, "}");
+        first = 0;
+    }
+    len += snprintf(out + len, sizeof(out) - len, "}}\n");
+
+    // One write per dump, so tools sharing the file in a pipeline append
+    // whole lines
+    int fd = strcmp(instrument.path, "-") == 0 ? STDERR_FILENO :
+             open(instrument.path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror(instrument.path);
+    } else {
+        if (write(fd, out, len) != (ssize_t)len) {
+            perror(instrument.path);
+        }
+        if (fd != STDERR_FILENO) {
+            close(fd);
+        }
+    }
+    pthread_mutex_unlock(&instrument.lock);
+}
+
+static void *dump_thread(void *arg) {
+    sigset_t *set = arg;
+    int sig;
+    while (sigwait(set, &sig) == 0) {
+        hb_instrument_dump();
+    }
+    return NULL;
+}
+
+void hb_instrument_init(const char *tool) {
+    const char *path = getenv("HOTBITS_INSTRUMENT");
+    if (!path || !*path || hb_instrument_enabled) {
+        return;
+    }
+    instrument.tool = tool;
+    instrument.path = path;
+    instrument.started = hb_instrument_now();
+
+    static sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, dump_thread, &set) == 0) {
+        pthread_detach(thread);
+    }
+
+    hb_instrument_enabled = 1;
+    atexit(hb_instrument_dump);
+}
+
+#endif
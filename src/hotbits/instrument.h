@@ -0,0 +1,89 @@
+#ifndef HOTBITS_INSTRUMENT_H
+#define HOTBITS_INSTRUMENT_H
+
+#include <stdint.h>
+#include <time.h>
+
+// Per-stage latency histograms for the hot paths of trng, filter,
+// rng-extractor and the native pipeline.
+//
+// Built with -DHB_INSTRUMENT (the Makefiles' INSTRUMENT=yes, the default)
+// the macros below record into per-thread HDR histograms; without it they
+// compile to nothing. Recording also needs HOTBITS_INSTRUMENT=FILE in the
+// environment ("-" for stderr), otherwise each site costs one predictable
+// branch. A JSON line with count, mean, min, p50, p90, p99, p999 and max
+// per stage is appended to FILE at exit and on every SIGUSR1.
+enum hb_stage {
+    HB_STAGE_PARSE = 0,         // text, packets or GPIO events to values
+    HB_STAGE_FILTER,            // dead time and window filters
+    HB_STAGE_EXTRACT,           // values to bits
+    HB_STAGE_CONDITION,         // debiasing
+    HB_STAGE_SINK,              // output writes and packet sends
+    HB_STAGE_COUNT
+};
+
+#ifdef HB_INSTRUMENT
+
+extern int hb_instrument_enabled;
+
+// Call from main before starting threads: SIGUSR1 is blocked so a
+// dedicated thread can sigwait() for it
+void hb_instrument_init(const char *tool);
+void hb_instrument_record(int stage, uint64_t ns);
+void hb_instrument_count(int stage, uint64_t items);
+void hb_instrument_dump(void);
+
+static inline uint64_t hb_instrument_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct hb_scope {
+    int stage;
+    uint64_t start;             // 0 when recording is off
+};
+
+static inline void hb_scope_end(struct hb_scope *s) {
+    if (s->start) {
+        hb_instrument_record(s->stage, hb_instrument_now() - s->start);
+    }
+}
+
+#define HB_CONCAT_(a, b) a##b
+#define HB_CONCAT(a, b) HB_CONCAT_(a, b)
+
+// Time from here to the end of the enclosing block
+#define HB_SCOPE(stage) \
+    struct hb_scope HB_CONCAT(hb_scope_, __LINE__) __attribute__((cleanup(hb_scope_end))) = \
+        { (stage), hb_instrument_enabled ? hb_instrument_now() : 0 }
+
+// Spans that do not match a block
+#define HB_TIMER_START(t) \
+    uint64_t t = hb_instrument_enabled ? hb_instrument_now() : 0
+#define HB_TIMER_STOP(t, stage) do { \
+        if (t) { \
+            hb_instrument_record((stage), hb_instrument_now() - (t)); \
+        } \
+    } while (0)
+
+#define HB_COUNT(stage, items) do { \
+        if (hb_instrument_enabled) { \
+            hb_instrument_count((stage), (items)); \
+        } \
+    } while (0)
+
+#else
+
+static inline void hb_instrument_init(const char *tool) {
+    (void)tool;
+}
+
+#define HB_SCOPE(stage) do { } while (0)
+#define HB_TIMER_START(t) do { } while (0)
+#define HB_TIMER_STOP(t, stage) do { } while (0)
+#define HB_COUNT(stage, items) do { } while (0)
+
+#endif
+
+#endif
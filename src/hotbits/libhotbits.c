@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "events.h"
+#include "hotbits.h"
+
+#define BATCH_VALUES 1024
+#define MAX_LINE 4096          // longer lines are not events and are dropped
+#define READ_SIZE 65536
+
+struct hb_stream {
+    struct hb_allocator alloc_copy;
+    const struct hb_allocator *alloc;   // &alloc_copy, or NULL for malloc
+    struct hb_pipeline pipeline;
+    struct hb_buffer out;
+    size_t head;                        // first byte of out not yet pulled
+    char line[MAX_LINE + 1];            // partial line between push_text calls
+    size_t line_len;
+    int dropping;                       // inside an overlong line
+    int finished;
+    struct hb_quick_sums sums;
+    uint64_t values[BATCH_VALUES];
+};
+
+struct hb_stream *hb_stream_create(const struct hb_pipeline_config *cfg,
+                                   const struct hb_allocator *alloc) {
+    struct hb_stream *s = hb_alloc(alloc, sizeof(*s));
+    if (!s) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return NULL;
+    }
+    memset(s, 0, sizeof(*s));
+    if (alloc) {
+        s->alloc_copy = *alloc;
+        s->alloc = &s->alloc_copy;
+    }
+
+    struct hb_pipeline_config defaults;
+    if (!cfg) {
+        hb_pipeline_config_default(&defaults);
+        cfg = &defaults;
+    }
+    if (hb_pipeline_init_alloc(&s->pipeline, cfg, s->alloc) < 0) {
+        hb_free(alloc, s, sizeof(*s));
+        return NULL;
+    }
+    hb_buffer_init_alloc(&s->out, s->alloc);
+    return s;
+}
+
+void hb_stream_destroy(struct hb_stream *s) {
+    if (!s) {
+        return;
+    }
+    // The stream holds the allocator, so free it from a copy
+    struct hb_allocator copy = s->alloc_copy;
+    int custom = s->alloc != NULL;
+    hb_pipeline_free(&s->pipeline);
+    hb_buffer_free(&s->out);
+    hb_free(custom ? &copy : NULL, s, sizeof(*s));
+}
+
+// Drop pulled bytes once they are at least half the buffer, so appending
+// stays amortized O(1) without the buffer growing with total output
+static void compact(struct hb_stream *s) {
+    if (s->head == 0 || s->head < s->out.len / 2) {
+        return;
+    }
+    memmove(s->out.data, s->out.data + s->head, s->out.len - s->head);
+    s->out.len -= s->head;
+    s->head = 0;
+}
+
+int hb_stream_push(struct hb_stream *s, const uint64_t *deltas, size_t count) {
+    if (s->finished) {
+        fprintf(stderr, "hb_stream_push after finish\n");
+        return -1;
+    }
+    compact(s);
+    size_t before = s->out.len;
+    if (hb_pipeline_push(&s->pipeline, deltas, count, &s->out) < 0) {
+        return -1;
+    }
+    hb_quick_update(&s->sums, s->out.data + before, s->out.len - before);
+    return 0;
+}
+
+// Parse complete lines from text and push their values; returns the bytes
+// consumed (everything up to the last newline) or -1
+static ssize_t push_lines(struct hb_stream *s, const char *text, size_t len) {
+    size_t pos = 0;
+    for (;;) {
+        size_t consumed;
+        size_t n = hb_parse_deltas(text + pos, len - pos, s->values, BATCH_VALUES, &consumed);
+        if (n > 0 && hb_stream_push(s, s->values, n) < 0) {
+            return -1;
+        }
+        pos += consumed;
+        if (consumed == 0 || n < BATCH_VALUES) {
+            return (ssize_t)pos;
+        }
+    }
+}
+
+int hb_stream_push_text(struct hb_stream *s, const char *text, size_t len) {
+    if (s->finished) {
+        fprintf(stderr, "hb_stream_push_text after finish\n");
+        return -1;
+    }
+
+    // Complete the line held from the previous call first
+    if (s->line_len > 0 || s->dropping) {
+        const char *nl = memchr(text, '\n', len);
+        size_t take = nl ? (size_t)(nl - text) + 1 : len;
+        if (!s->dropping && s->line_len + take <= MAX_LINE) {
+            memcpy(s->line + s->line_len, text, take);
+            s->line_len += take;
+        } else {
+            s->dropping = 1;
+            s->line_len = 0;
+        }
+        if (!nl) {
+            return 0;
+        }
+        if (!s->dropping && push_lines(s, s->line, s->line_len) < 0) {
+            return -1;
+        }
+        s->line_len = 0;
+        s->dropping = 0;
+        text += take;
+        len -= take;
+    }
+
+    ssize_t used = push_lines(s, text, len);
+    if (used < 0) {
+        return -1;
+    }
+
+    size_t rest = len - (size_t)used;
+    if (rest > MAX_LINE) {
+        s->dropping = 1;
+    } else {
+        memcpy(s->line, text + used, rest);
+        s->line_len = rest;
+    }
+    return 0;
+}
+
+ssize_t hb_stream_read_fd(struct hb_stream *s, int fd) {
+    char buf[READ_SIZE];
+    ssize_t r;
+    do {
+        r = read(fd, buf, sizeof(buf));
+    } while (r < 0 && errno == EINTR);
+
+    if (r > 0 && hb_stream_push_text(s, buf, (size_t)r) < 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+    return r;
+}
+
+int hb_stream_finish(struct hb_stream *s) {
+    if (s->finished) {
+        return 0;
+    }
+
+    // Terminate a final unterminated line so it is parsed too
+    if (s->line_len > 0 && !s->dropping) {
+        s->line[s->line_len++] = '\n';
+        if (push_lines(s, s->line, s->line_len) < 0) {
+            return -1;
+        }
+    }
+    s->line_len = 0;
+    s->finished = 1;
+
+    compact(s);
+    size_t before = s->out.len;
+    if (hb_pipeline_finish(&s->pipeline, &s->out) < 0) {
+        return -1;
+    }
+    hb_quick_update(&s->sums, s->out.data + before, s->out.len - before);
+    return 0;
+}
+
+size_t hb_stream_available(const struct hb_stream *s) {
+    return s->out.len - s->head;
+}
+
+size_t hb_stream_pull(struct hb_stream *s, void *out, size_t len) {
+    size_t n = s->out.len - s->head;
+    if (n > len) {
+        n = len;
+    }
+    memcpy(out, s->out.data + s->head, n);
+    s->head += n;
+    if (s->head == s->out.len) {
+        s->head = 0;
+        s->out.len = 0;
+    }
+    return n;
+}
+
+void hb_stream_detach(struct hb_stream *s, struct hb_output *out) {
+    memset(out, 0, sizeof(*out));
+    if (s->out.len == s->head) {
+        return;
+    }
+    out->block = s->out.data;
+    out->size = s->out.cap;
+    out->data = s->out.data + s->head;
+    out->len = s->out.len - s->head;
+    hb_buffer_init_alloc(&s->out, s->alloc);
+    s->head = 0;
+}
+
+uint64_t hb_stream_events(const struct hb_stream *s) {
+    return s->pipeline.events_in;
+}
+
+uint64_t hb_stream_bits(const struct hb_stream *s) {
+    return s->pipeline.bits_out;
+}
+
+void hb_stream_quick_tests(const struct hb_stream *s,
+                           struct hb_test_result results[HB_QUICK_TESTS]) {
+    hb_quick_results(&s->sums, results);
+}
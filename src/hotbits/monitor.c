@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+
+#include "cpu.h"
+#include "monitor.h"
+
+#define BLOCK_WORDS (HB_BLOCK_FREQUENCY_M / 64)
+_Static_assert(BLOCK_WORDS == 2, "block_dev and the block parities assume two-word blocks");
+
+// A word's contribution to hb_quick_sums, apart from its boundary with the
+// previous word
+struct word_terms {
+    uint64_t ones;
+    uint64_t transitions;
+    uint64_t sum;
+    uint64_t sum_sq;
+    uint64_t sum_lag;
+    uint8_t bytes[8];
+};
+
+static void word_terms(uint64_t w, struct word_terms *t) {
+    t->ones = __builtin_popcountll(w);
+    t->transitions = __builtin_popcountll((w ^ (w >> 1)) & 0x7FFFFFFFFFFFFFFFull);
+    t->sum = 0;
+    t->sum_sq = 0;
+    t->sum_lag = 0;
+    for (int k = 0; k < 8; k++) {
+        uint64_t b = (w >> (56 - 8 * k)) & 0xff;
+        t->bytes[k] = (uint8_t)b;
+        t->sum += b;
+        t->sum_sq += b * b;
+        if (k > 0) {
+            t->sum_lag += (uint64_t)t->bytes[k - 1] * b;
+        }
+    }
+}
+
+static inline uint64_t boundary_transitions(uint64_t prev, uint64_t w) {
+    return (prev & 1) != (w >> 63);
+}
+
+static inline uint64_t boundary_lag(uint64_t prev, uint64_t w) {
+    return (prev & 0xff) * (w >> 56);
+}
+
+// sign is 1 or (uint64_t)-1; the sums never go negative, so wrapping
+// arithmetic subtracts exactly
+static void apply(struct hb_quick_sums *s, const struct word_terms *t,
+                  uint64_t prev, int has_prev, uint64_t w, uint64_t sign) {
+    s->bytes += 8 * sign;
+    s->ones += t->ones * sign;
+    s->transitions += t->transitions * sign;
+    s->sum += t->sum * sign;
+    s->sum_sq += t->sum_sq * sign;
+    s->sum_lag += t->sum_lag * sign;
+    for (int k = 0; k < 8; k++) {
+        s->byte_counts[t->bytes[k]] += sign;
+    }
+    if (has_prev) {
+        s->transitions += boundary_transitions(prev, w) * sign;
+        s->sum_lag += boundary_lag(prev, w) * sign;
+    }
+}
+
+static inline uint64_t block_dev(uint64_t a, uint64_t b) {
+    int64_t dev = (int64_t)(__builtin_popcountll(a) + __builtin_popcountll(b)) -
+                  HB_BLOCK_FREQUENCY_M / 2;
+    return (uint64_t)(dev * dev);
+}
+
+int hb_monitor_init(struct hb_monitor *m, const uint64_t *window_bits, size_t count) {
+    memset(m, 0, sizeof(*m));
+    if (count == 0 || count > HB_MONITOR_MAX_WINDOWS) {
+        fprintf(stderr, "Between 1 and %d windows are supported\n", HB_MONITOR_MAX_WINDOWS);
+        return -1;
+    }
+
+    uint64_t longest = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t words = (window_bits[i] + 63) / 64;
+        if (words == 0) {
+            fprintf(stderr, "Window length must be positive\n");
+            return -1;
+        }
+        m->windows[i].words = words;
+        if (words > longest) {
+            longest = words;
+        }
+    }
+    m->window_count = count;
+
+    // The word leaving the longest window and the one before it must still
+    // be in the ring when the next word arrives
+    m->ring_len = longest + 2;
+    m->ring = calloc(m->ring_len, sizeof(uint64_t));
+    if (!m->ring) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+    return 0;
+}
+
+void hb_monitor_free(struct hb_monitor *m) {
+    free(m->ring);
+    m->ring = NULL;
+}
+
+static void push_word(struct hb_monitor *m, uint64_t w) {
+    uint64_t i = m->pushed++;
+    uint64_t prev = i > 0 ? m->ring[(i - 1) % m->ring_len] : 0;
+    m->ring[i % m->ring_len] = w;
+
+    struct word_terms in;
+    word_terms(w, &in);
+
+    for (size_t k = 0; k < m->window_count; k++) {
+        struct hb_window *win = &m->windows[k];
+        struct hb_quick_sums *s = &win->sums;
+
+        apply(s, &in, prev, i > 0, w, 1);
+        // Every word completes the block that starts at the word before it
+        if (i > 0) {
+            win->block_dev[(i - 1) % BLOCK_WORDS] += block_dev(prev, w);
+            win->blocks[(i - 1) % BLOCK_WORDS]++;
+        }
+
+        if (i < win->words) {
+            continue;
+        }
+        uint64_t j = i - win->words;
+        uint64_t out = m->ring[j % m->ring_len];
+        uint64_t out_prev = j > 0 ? m->ring[(j - 1) % m->ring_len] : 0;
+        struct word_terms gone;
+        word_terms(out, &gone);
+        apply(s, &gone, out_prev, j > 0, out, (uint64_t)-1);
+        // A block stops being complete when its first word leaves
+        win->block_dev[j % BLOCK_WORDS] -= block_dev(out, m->ring[(j + 1) % m->ring_len]);
+        win->blocks[j % BLOCK_WORDS]--;
+    }
+}
+
+static inline void monitor_push(struct hb_monitor *m, const uint8_t *data, size_t len) {
+    uint64_t w;
+
+    if (m->pending_len) {
+        size_t n = 8 - m->pending_len < len ? 8 - m->pending_len : len;
+        memcpy(m->pending + m->pending_len, data, n);
+        m->pending_len += n;
+        data += n;
+        len -= n;
+        if (m->pending_len < 8) {
+            return;
+        }
+        memcpy(&w, m->pending, 8);
+        push_word(m, be64toh(w));
+        m->pending_len = 0;
+    }
+
+    for (; len >= 8; data += 8, len -= 8) {
+        memcpy(&w, data, 8);
+        push_word(m, be64toh(w));
+    }
+
+    memcpy(m->pending, data, len);
+    m->pending_len = len;
+}
+
+HB_KERNEL_VOID(monitor_push, (struct hb_monitor *m, const uint8_t *data, size_t len),
+               (m, data, len));
+
+void hb_monitor_push(struct hb_monitor *m, const uint8_t *data, size_t len) {
+    HB_DISPATCH(monitor_push)(m, data, len);
+}
+
+uint64_t hb_monitor_window_bits(const struct hb_monitor *m, size_t i) {
+    uint64_t words = m->pushed < m->windows[i].words ? m->pushed : m->windows[i].words;
+    return words * 64;
+}
+
+void hb_monitor_results(const struct hb_monitor *m, size_t i,
+                        struct hb_test_result results[HB_QUICK_TESTS]) {
+    const struct hb_window *win = &m->windows[i];
+    struct hb_quick_sums s = win->sums;
+
+    if (m->pushed > 0) {
+        uint64_t start = m->pushed > win->words ? m->pushed - win->words : 0;
+        uint64_t first = m->ring[start % m->ring_len];
+        uint64_t last = m->ring[(m->pushed - 1) % m->ring_len];
+        if (start > 0) {
+            uint64_t before = m->ring[(start - 1) % m->ring_len];
+            s.transitions -= boundary_transitions(before, first);
+            s.sum_lag -= boundary_lag(before, first);
+        }
+        s.first = (uint8_t)(first >> 56);
+        s.last = (uint8_t)(last & 0xff);
+        s.blocks = win->blocks[start % BLOCK_WORDS];
+        s.block_dev = win->block_dev[start % BLOCK_WORDS];
+    }
+
+    hb_quick_results(&s, results);
+}
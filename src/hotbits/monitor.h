@@ -0,0 +1,54 @@
+#ifndef HOTBITS_MONITOR_H
+#define HOTBITS_MONITOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "quicktest.h"
+
+// Rolling-window quicktest statistics over an extracted bit stream.
+//
+// The stream is consumed in 64-bit words, read big-endian so bit order
+// matches the pipeline's MSB-first packing. Each window keeps the
+// hb_quick_sums of its last `words` words: pushing a word adds its terms
+// and subtracts those of the word falling out of the window, so the cost
+// per word does not depend on the window length. All windows share one
+// ring buffer sized for the largest. Bytes that do not complete a word
+// wait for the next push. Block frequency counts the 128-bit blocks aligned
+// to the start of the window, as hb_quick_tests would on the window's bytes:
+// blocks are summed separately by the parity of their first word, and the
+// window's start picks the set.
+#define HB_MONITOR_MAX_WINDOWS 8
+
+struct hb_window {
+    uint64_t words;
+    // Sums over the window's words, each including its boundary term with
+    // the word before it (removed again when results are computed)
+    struct hb_quick_sums sums;
+    // Blocks wholly inside the window, by the parity of their first word
+    uint64_t blocks[2];
+    uint64_t block_dev[2];
+};
+
+struct hb_monitor {
+    struct hb_window windows[HB_MONITOR_MAX_WINDOWS];
+    size_t window_count;
+    uint64_t *ring;
+    uint64_t ring_len;
+    uint64_t pushed;         // words consumed
+    uint8_t pending[8];
+    size_t pending_len;
+};
+
+// Window lengths in bits, rounded up to whole words
+int hb_monitor_init(struct hb_monitor *m, const uint64_t *window_bits, size_t count);
+void hb_monitor_free(struct hb_monitor *m);
+
+void hb_monitor_push(struct hb_monitor *m, const uint8_t *data, size_t len);
+
+// Bits window i currently covers (less than its length until it fills)
+uint64_t hb_monitor_window_bits(const struct hb_monitor *m, size_t i);
+void hb_monitor_results(const struct hb_monitor *m, size_t i,
+                        struct hb_test_result results[HB_QUICK_TESTS]);
+
+#endif
@@ -0,0 +1,642 @@
+// hotbits.node - Node-API addon over libhotbits for hotbits-cli.js
+//
+// A Stream wraps an hb_stream plus an optional input (an events file,
+// possibly gzip or zstd compressed). read() pulls text from the input and
+// runs the pipeline on a libuv worker thread, then hands the callback the
+// stream's totals and quick test results, so the event loop never waits
+// on parsing or extraction. pull() detaches the pipeline's output buffer
+// and returns Buffers over it, reference counted so the memory is freed by
+// the last finalizer (or by the stream, if no Buffer took any of it); it
+// copies only to join the rest of a partly pulled buffer to newer output.
+// quickTests() reads a Buffer in place on a worker thread.
+//
+// A stream has at most one read() in flight; its other methods throw while
+// it runs, since the worker thread owns the hb_stream until it completes.
+
+#define NAPI_VERSION 4
+#include <node_api.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "hotbits.h"
+#include "input.h"
+
+// Output detached from the hb_stream. Each Buffer over it holds a
+// reference, and so does the stream while bytes from head on are unpulled.
+// Only the main thread touches it.
+struct region {
+    struct hb_output out;
+    size_t head;
+    int refs;
+};
+
+struct stream {
+    struct hb_stream *s;
+    struct hb_input in;
+    int have_input;
+    int busy;                  // a read() owns the stream
+    napi_ref self;             // held while busy so the object outlives the work
+    struct region *region;     // partly pulled output, or NULL
+};
+
+struct read_work {
+    struct stream *st;
+    napi_async_work work;
+    napi_ref callback;
+    size_t max_bytes;
+    size_t bytes_read;
+    int eof;
+    int err;                   // errno from the read, 0 on success
+    uint64_t events;
+    uint64_t bits;
+    size_t available;
+    struct hb_test_result tests[HB_QUICK_TESTS];
+};
+
+struct quick_work {
+    napi_async_work work;
+    napi_ref callback;
+    napi_ref buffer;           // keeps the Buffer alive while it is read
+    const uint8_t *data;
+    size_t len;
+    struct hb_test_result tests[HB_QUICK_TESTS];
+};
+
+#define CHECK(call)                                                         \
+    do {                                                                    \
+        if ((call) != napi_ok) {                                            \
+            throw_last(env, #call);                                         \
+            return NULL;                                                    \
+        }                                                                   \
+    } while (0)
+
+static void throw_last(napi_env env, const char *what) {
+    const napi_extended_error_info *info;
+    napi_get_last_error_info(env, &info);
+    bool pending = false;
+    napi_is_exception_pending(env, &pending);
+    if (!pending) {
+        napi_throw_error(env, NULL, info && info->error_message ? info->error_message : what);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Argument helpers
+
+static int get_uint64(napi_env env, napi_value obj, const char *key, uint64_t *out) {
+    bool has = false;
+    napi_value v;
+    if (napi_has_named_property(env, obj, key, &has) != napi_ok || !has) {
+        return 0;
+    }
+    napi_get_named_property(env, obj, key, &v);
+    double d;
+    if (napi_get_value_double(env, v, &d) != napi_ok || d < 0) {
+        char msg[96];
+        snprintf(msg, sizeof(msg), "%s must be a non-negative number", key);
+        napi_throw_type_error(env, NULL, msg);
+        return -1;
+    }
+    *out = (uint64_t)d;
+    return 0;
+}
+
+static int get_int(napi_env env, napi_value obj, const char *key, int *out) {
+    uint64_t v = (uint64_t)*out;
+    if (get_uint64(env, obj, key, &v) < 0) {
+        return -1;
+    }
+    *out = (int)v;
+    return 0;
+}
+
+// Named values such as method: 'lsb'. Returns -1 with an exception pending
+// on a bad name, 0 when the key is absent or parsed.
+static int get_name(napi_env env, napi_value obj, const char *key,
+                    int (*parse)(const char *), int *out) {
+    bool has = false;
+    napi_value v;
+    if (napi_has_named_property(env, obj, key, &has) != napi_ok || !has) {
+        return 0;
+    }
+    napi_get_named_property(env, obj, key, &v);
+    char name[64];
+    size_t len;
+    if (napi_get_value_string_utf8(env, v, name, sizeof(name), &len) != napi_ok) {
+        napi_throw_type_error(env, NULL, "expected a string");
+        return -1;
+    }
+    int value = parse(name);
+    if (value < 0) {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "Invalid %s: %s", key, name);
+        napi_throw_range_error(env, NULL, msg);
+        return -1;
+    }
+    *out = value;
+    return 0;
+}
+
+static int parse_config(napi_env env, napi_value obj, struct hb_pipeline_config *cfg) {
+    hb_pipeline_config_default(cfg);
+    napi_valuetype type;
+    napi_typeof(env, obj, &type);
+    if (type == napi_undefined || type == napi_null) {
+        return 0;
+    }
+    if (type != napi_object) {
+        napi_throw_type_error(env, NULL, "options must be an object");
+        return -1;
+    }
+    if (get_name(env, obj, "method", hb_method_parse, &cfg->method) < 0 ||
+        get_name(env, obj, "debias", hb_debias_parse, &cfg->debias) < 0 ||
+        get_int(env, obj, "bitPos", &cfg->bit_pos) < 0 ||
+        get_int(env, obj, "window", &cfg->window) < 0 ||
+        get_int(env, obj, "order", &cfg->order) < 0 ||
+        get_int(env, obj, "rateWindow", &cfg->rate_window) < 0 ||
+        get_uint64(env, obj, "deadTime", &cfg->dead_time_ns) < 0 ||
+        get_uint64(env, obj, "windowNs", &cfg->window_ns) < 0 ||
+        get_int(env, obj, "windowMode", &cfg->window_mode) < 0) {
+        return -1;
+    }
+    if (cfg->bit_pos > 63 || cfg->window < 1 || cfg->window_mode > 2 ||
+        cfg->order < 2 || cfg->order > HB_ORDINAL_MAX || cfg->rate_window < 2) {
+        napi_throw_range_error(env, NULL, "bitPos must be 0-63, window >= 1, windowMode 0-2, "
+                               "order 2-12, rateWindow >= 2");
+        return -1;
+    }
+    return 0;
+}
+
+static struct stream *unwrap(napi_env env, napi_callback_info info, size_t *argc,
+                             napi_value *argv, napi_value *self_out) {
+    napi_value self;
+    void *data;
+    if (napi_get_cb_info(env, info, argc, argv, &self, NULL) != napi_ok ||
+        napi_unwrap(env, self, &data) != napi_ok) {
+        throw_last(env, "not a Stream");
+        return NULL;
+    }
+    struct stream *st = data;
+    if (self_out) {
+        *self_out = self;
+    }
+    if (st->busy) {
+        napi_throw_error(env, "EBUSY", "Stream has a read in progress");
+        return NULL;
+    }
+    if (!st->s) {
+        napi_throw_error(env, NULL, "Stream is closed");
+        return NULL;
+    }
+    return st;
+}
+
+static napi_value make_tests(napi_env env, const struct hb_test_result *tests) {
+    napi_value obj;
+    napi_create_object(env, &obj);
+    for (int t = 0; t < HB_QUICK_TESTS; t++) {
+        napi_value result, stat, p;
+        napi_create_object(env, &result);
+        napi_create_double(env, tests[t].statistic, &stat);
+        napi_create_double(env, tests[t].p_value, &p);
+        napi_set_named_property(env, result, "statistic", stat);
+        napi_set_named_property(env, result, "pValue", p);
+        napi_set_named_property(env, obj, tests[t].name, result);
+    }
+    return obj;
+}
+
+static napi_value make_stats(napi_env env, uint64_t events, uint64_t bits, size_t available,
+                             const struct hb_test_result *tests) {
+    napi_value obj, v;
+    napi_create_object(env, &obj);
+    napi_create_double(env, (double)events, &v);
+    napi_set_named_property(env, obj, "events", v);
+    napi_create_double(env, (double)bits, &v);
+    napi_set_named_property(env, obj, "bits", v);
+    napi_create_double(env, (double)available, &v);
+    napi_set_named_property(env, obj, "available", v);
+    napi_set_named_property(env, obj, "tests", make_tests(env, tests));
+    return obj;
+}
+
+// ---------------------------------------------------------------------------
+// Stream
+
+static void region_unref(struct region *r) {
+    if (--r->refs == 0) {
+        hb_free(NULL, r->out.block, r->out.size);
+        free(r);
+    }
+}
+
+// Bytes of the stream's region not pulled yet
+static size_t region_left(const struct stream *st) {
+    return st->region ? st->region->out.len - st->region->head : 0;
+}
+
+static void drop_region(struct stream *st) {
+    if (st->region) {
+        region_unref(st->region);
+        st->region = NULL;
+    }
+}
+
+static void close_input(struct stream *st) {
+    if (st->have_input) {
+        hb_input_close(&st->in);
+        st->have_input = 0;
+    }
+}
+
+static void stream_finalize(napi_env env, void *data, void *hint) {
+    (void)env;
+    (void)hint;
+    struct stream *st = data;
+    close_input(st);
+    drop_region(st);
+    hb_stream_destroy(st->s);
+    free(st);
+}
+
+// new Stream({method, debias, bitPos, window, order, rateWindow, deadTime, windowNs, windowMode})
+static napi_value stream_new(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value argv[1], self;
+    CHECK(napi_get_cb_info(env, info, &argc, argv, &self, NULL));
+
+    struct hb_pipeline_config cfg;
+    napi_value undefined;
+    napi_get_undefined(env, &undefined);
+    if (parse_config(env, argc > 0 ? argv[0] : undefined, &cfg) < 0) {
+        return NULL;
+    }
+
+    struct stream *st = calloc(1, sizeof(*st));
+    if (!st) {
+        napi_throw_error(env, "ENOMEM", "Memory allocation failed");
+        return NULL;
+    }
+    st->s = hb_stream_create(&cfg, NULL);
+    if (!st->s) {
+        free(st);
+        napi_throw_error(env, NULL, "hb_stream_create failed");
+        return NULL;
+    }
+    if (napi_wrap(env, self, st, stream_finalize, NULL, NULL) != napi_ok) {
+        hb_stream_destroy(st->s);
+        free(st);
+        throw_last(env, "napi_wrap");
+        return NULL;
+    }
+    return self;
+}
+
+// open(path): events file (plain, gzip or zstd) that read() consumes.
+// Opening does no reading; compressed input starts decoding on its own
+// thread.
+static napi_value stream_open(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value argv[1];
+    struct stream *st = unwrap(env, info, &argc, argv, NULL);
+    if (!st) {
+        return NULL;
+    }
+
+    char path[4096];
+    size_t len;
+    if (argc < 1 || napi_get_value_string_utf8(env, argv[0], path, sizeof(path), &len) != napi_ok) {
+        napi_throw_type_error(env, NULL, "open(path) expects a string");
+        return NULL;
+    }
+
+    close_input(st);
+    if (hb_input_open(&st->in, path, 0) < 0) {
+        char msg[4200];
+        snprintf(msg, sizeof(msg), "Cannot open %s: %s", path, strerror(errno));
+        napi_throw_error(env, "ENOENT", msg);
+        return NULL;
+    }
+    st->have_input = 1;
+    return NULL;
+}
+
+static void read_execute(napi_env env, void *data) {
+    (void)env;
+    struct read_work *w = data;
+    struct hb_stream *s = w->st->s;
+
+    while (w->bytes_read < w->max_bytes) {
+        ssize_t r = hb_stream_read_fd(s, w->st->in.fd);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN) w->err = errno;
+            break;
+        }
+        if (r == 0) {
+            w->eof = 1;
+            break;
+        }
+        w->bytes_read += (size_t)r;
+    }
+
+    w->events = hb_stream_events(s);
+    w->bits = hb_stream_bits(s);
+    w->available = hb_stream_available(s);
+    hb_stream_quick_tests(s, w->tests);
+}
+
+static void read_complete(napi_env env, napi_status status, void *data) {
+    struct read_work *w = data;
+    struct stream *st = w->st;
+    napi_value callback, global, argv[2];
+
+    st->busy = 0;
+    napi_get_reference_value(env, w->callback, &callback);
+    napi_get_global(env, &global);
+
+    if (status != napi_ok || w->err) {
+        napi_value msg;
+        const char *text = status != napi_ok ? "read cancelled" : strerror(w->err);
+        napi_create_string_utf8(env, text, NAPI_AUTO_LENGTH, &msg);
+        napi_create_error(env, NULL, msg, &argv[0]);
+        napi_get_undefined(env, &argv[1]);
+    } else {
+        napi_get_null(env, &argv[0]);
+        argv[1] = make_stats(env, w->events, w->bits, w->available + region_left(st), w->tests);
+        napi_value v;
+        napi_create_double(env, (double)w->bytes_read, &v);
+        napi_set_named_property(env, argv[1], "bytesRead", v);
+        napi_get_boolean(env, w->eof, &v);
+        napi_set_named_property(env, argv[1], "eof", v);
+    }
+
+    napi_call_function(env, global, callback, 2, argv, NULL);
+    napi_delete_reference(env, w->callback);
+    napi_delete_reference(env, st->self);
+    st->self = NULL;
+    napi_delete_async_work(env, w->work);
+    free(w);
+}
+
+// read(maxBytes, callback(err, stats)): feed up to maxBytes of input text
+// (Infinity: until end of file) through the pipeline off the main thread.
+// stats adds bytesRead and eof to stats(). A plain file that is still
+// being written can be read again after eof to follow it.
+static napi_value stream_read(napi_env env, napi_callback_info info) {
+    size_t argc = 2;
+    napi_value argv[2], self;
+    struct stream *st = unwrap(env, info, &argc, argv, &self);
+    if (!st) {
+        return NULL;
+    }
+    if (!st->have_input) {
+        napi_throw_error(env, NULL, "read() needs open(path) first");
+        return NULL;
+    }
+
+    double max;
+    napi_valuetype type;
+    if (argc < 2 || napi_get_value_double(env, argv[0], &max) != napi_ok ||
+        napi_typeof(env, argv[1], &type) != napi_ok || type != napi_function) {
+        napi_throw_type_error(env, NULL, "read(maxBytes, callback)");
+        return NULL;
+    }
+
+    struct read_work *w = calloc(1, sizeof(*w));
+    if (!w) {
+        napi_throw_error(env, "ENOMEM", "Memory allocation failed");
+        return NULL;
+    }
+    w->st = st;
+    w->max_bytes = max >= (double)SIZE_MAX ? SIZE_MAX : max < 1 ? 1 : (size_t)max;
+
+    napi_value name;
+    napi_create_string_utf8(env, "hotbits.read", NAPI_AUTO_LENGTH, &name);
+    if (napi_create_reference(env, argv[1], 1, &w->callback) != napi_ok ||
+        napi_create_async_work(env, NULL, name, read_execute, read_complete, w,
+                               &w->work) != napi_ok) {
+        free(w);
+        throw_last(env, "napi_create_async_work");
+        return NULL;
+    }
+    napi_create_reference(env, self, 1, &st->self);
+    st->busy = 1;
+    napi_queue_async_work(env, w->work);
+    return NULL;
+}
+
+// finish(): end of input; flushes the pipeline's held values and last
+// partial byte
+static napi_value stream_finish(napi_env env, napi_callback_info info) {
+    size_t argc = 0;
+    struct stream *st = unwrap(env, info, &argc, NULL, NULL);
+    if (!st) {
+        return NULL;
+    }
+    if (hb_stream_finish(st->s) < 0) {
+        napi_throw_error(env, NULL, "hb_stream_finish failed");
+    }
+    return NULL;
+}
+
+static void free_buffer(napi_env env, void *data, void *hint) {
+    (void)env;
+    (void)hint;
+    free(data);
+}
+
+static void release_region(napi_env env, void *data, void *hint) {
+    (void)env;
+    (void)data;
+    region_unref(hint);
+}
+
+// pull([maxBytes]) -> Buffer of packed output (possibly empty)
+static napi_value stream_pull(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value argv[1];
+    struct stream *st = unwrap(env, info, &argc, argv, NULL);
+    if (!st) {
+        return NULL;
+    }
+
+    size_t left = region_left(st);
+    size_t len = left + hb_stream_available(st->s);
+    double max;
+    if (argc > 0 && napi_get_value_double(env, argv[0], &max) == napi_ok && max >= 0 &&
+        max < (double)len) {
+        len = (size_t)max;
+    }
+
+    napi_value buffer;
+    if (len == 0) {
+        CHECK(napi_create_buffer(env, 0, NULL, &buffer));
+        return buffer;
+    }
+
+    // The rest of a region followed by newer output: join them in a copy
+    if (left > 0 && len > left) {
+        uint8_t *data = malloc(len);
+        if (!data) {
+            napi_throw_error(env, "ENOMEM", "Memory allocation failed");
+            return NULL;
+        }
+        memcpy(data, st->region->out.data + st->region->head, left);
+        len = left + hb_stream_pull(st->s, data + left, len - left);
+        if (napi_create_external_buffer(env, len, data, free_buffer, NULL, &buffer) != napi_ok) {
+            free(data);
+            throw_last(env, "napi_create_external_buffer");
+            return NULL;
+        }
+        drop_region(st);
+        return buffer;
+    }
+
+    if (left == 0) {
+        struct region *r = calloc(1, sizeof(*r));
+        if (!r) {
+            napi_throw_error(env, "ENOMEM", "Memory allocation failed");
+            return NULL;
+        }
+        hb_stream_detach(st->s, &r->out);
+        r->refs = 1;
+        drop_region(st);
+        st->region = r;
+    }
+
+    struct region *r = st->region;
+    if (napi_create_external_buffer(env, len, (void *)(r->out.data + r->head), release_region,
+                                    r, &buffer) != napi_ok) {
+        throw_last(env, "napi_create_external_buffer");
+        return NULL;
+    }
+    r->refs++;
+    r->head += len;
+    if (r->head == r->out.len) {
+        drop_region(st);
+    }
+    return buffer;
+}
+
+// stats() -> {events, bits, available, tests: {name: {statistic, pValue}}}
+static napi_value stream_stats(napi_env env, napi_callback_info info) {
+    size_t argc = 0;
+    struct stream *st = unwrap(env, info, &argc, NULL, NULL);
+    if (!st) {
+        return NULL;
+    }
+    struct hb_test_result tests[HB_QUICK_TESTS];
+    hb_stream_quick_tests(st->s, tests);
+    return make_stats(env, hb_stream_events(st->s), hb_stream_bits(st->s),
+                      region_left(st) + hb_stream_available(st->s), tests);
+}
+
+// close(): release the input and the pipeline now instead of at collection
+static napi_value stream_close(napi_env env, napi_callback_info info) {
+    size_t argc = 0;
+    struct stream *st = unwrap(env, info, &argc, NULL, NULL);
+    if (!st) {
+        return NULL;
+    }
+    close_input(st);
+    drop_region(st);
+    hb_stream_destroy(st->s);
+    st->s = NULL;
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+// quickTests(buffer, callback(err, tests))
+
+static void quick_execute(napi_env env, void *data) {
+    (void)env;
+    struct quick_work *w = data;
+    hb_quick_tests(w->data, w->len, w->tests);
+}
+
+static void quick_complete(napi_env env, napi_status status, void *data) {
+    struct quick_work *w = data;
+    napi_value callback, global, argv[2];
+
+    napi_get_reference_value(env, w->callback, &callback);
+    napi_get_global(env, &global);
+    if (status != napi_ok) {
+        napi_value msg;
+        napi_create_string_utf8(env, "quickTests cancelled", NAPI_AUTO_LENGTH, &msg);
+        napi_create_error(env, NULL, msg, &argv[0]);
+        napi_get_undefined(env, &argv[1]);
+    } else {
+        napi_get_null(env, &argv[0]);
+        argv[1] = make_tests(env, w->tests);
+    }
+
+    napi_call_function(env, global, callback, 2, argv, NULL);
+    napi_delete_reference(env, w->callback);
+    napi_delete_reference(env, w->buffer);
+    napi_delete_async_work(env, w->work);
+    free(w);
+}
+
+static napi_value quick_tests(napi_env env, napi_callback_info info) {
+    size_t argc = 2;
+    napi_value argv[2];
+    CHECK(napi_get_cb_info(env, info, &argc, argv, NULL, NULL));
+
+    bool is_buffer = false;
+    napi_valuetype type;
+    if (argc < 2 || napi_is_buffer(env, argv[0], &is_buffer) != napi_ok || !is_buffer ||
+        napi_typeof(env, argv[1], &type) != napi_ok || type != napi_function) {
+        napi_throw_type_error(env, NULL, "quickTests(buffer, callback)");
+        return NULL;
+    }
+
+    struct quick_work *w = calloc(1, sizeof(*w));
+    if (!w) {
+        napi_throw_error(env, "ENOMEM", "Memory allocation failed");
+        return NULL;
+    }
+    void *data;
+    napi_get_buffer_info(env, argv[0], &data, &w->len);
+    w->data = data;
+
+    napi_value name;
+    napi_create_string_utf8(env, "hotbits.quickTests", NAPI_AUTO_LENGTH, &name);
+    if (napi_create_reference(env, argv[0], 1, &w->buffer) != napi_ok ||
+        napi_create_reference(env, argv[1], 1, &w->callback) != napi_ok ||
+        napi_create_async_work(env, NULL, name, quick_execute, quick_complete, w,
+                               &w->work) != napi_ok) {
+        free(w);
+        throw_last(env, "napi_create_async_work");
+        return NULL;
+    }
+    napi_queue_async_work(env, w->work);
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+
+static napi_value init(napi_env env, napi_value exports) {
+    napi_property_descriptor methods[] = {
+        {"open", NULL, stream_open, NULL, NULL, NULL, napi_default, NULL},
+        {"read", NULL, stream_read, NULL, NULL, NULL, napi_default, NULL},
+        {"finish", NULL, stream_finish, NULL, NULL, NULL, napi_default, NULL},
+        {"pull", NULL, stream_pull, NULL, NULL, NULL, napi_default, NULL},
+        {"stats", NULL, stream_stats, NULL, NULL, NULL, napi_default, NULL},
+        {"close", NULL, stream_close, NULL, NULL, NULL, napi_default, NULL},
+    };
+    napi_value cls, fn;
+    CHECK(napi_define_class(env, "Stream", NAPI_AUTO_LENGTH, stream_new, NULL,
+                            sizeof(methods) / sizeof(methods[0]), methods, &cls));
+    CHECK(napi_set_named_property(env, exports, "Stream", cls));
+    CHECK(napi_create_function(env, "quickTests", NAPI_AUTO_LENGTH, quick_tests, NULL, &fn));
+    CHECK(napi_set_named_property(env, exports, "quickTests", fn));
+    return exports;
+}
+
+NAPI_MODULE(hotbits, init)
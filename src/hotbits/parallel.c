@@ -0,0 +1,512 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "events.h"
+#include "parallel.h"
+#include "instrument.h"
+
+#define DEFAULT_CHUNK_VALUES (1 << 18)
+// Text per parse slice for each value of a chunk: a delta near a
+// millisecond is seven digits and a newline
+#define TEXT_BYTES_PER_VALUE 8
+
+// Bit string packed MSB-first; the final byte is zero padded
+struct bits {
+    struct hb_buffer buf;
+    uint64_t n;
+};
+
+// Bits not yet making a whole byte, low in cur
+struct writer {
+    unsigned cur;
+    int nbits;
+};
+
+struct chunk {
+    struct hb_parallel *px;
+    // Parse phase (text pushes)
+    const char *text;
+    size_t text_len;
+    uint64_t *parsed;
+    size_t parsed_cap;
+    // Extract phase
+    const uint64_t *values;
+    size_t count;
+    uint64_t index;             // stream index of values[0]
+    uint64_t *prev;             // the values before it, for hb_pipeline_resume
+    size_t nprev;
+    int drain;                  // end of stream: the adaptive lookahead tail
+    struct bits raw;            // extracted bits
+    struct bits even;           // von Neumann of raw paired from bit 0
+    struct bits odd;            // ...from bit 1
+    int failed;
+};
+
+struct hb_parallel {
+    struct hb_pipeline_config cfg;  // what each chunk runs: no filters, no debias
+    int debias;
+    int filtered;
+    struct hb_pipeline filter;      // sequential dead-time and window pass
+    struct hb_buffer filtered_values;
+    struct hb_pool *pool;
+    size_t chunk_values;
+
+    size_t keep;                    // values hb_pipeline_resume needs
+    uint64_t *history;              // the last keep values before the next push
+    uint64_t *scratch;
+    size_t history_len;
+    uint64_t index;                 // values extracted so far
+
+    int pending;                    // raw bit waiting for its debias pair, or -1
+    struct writer w;
+    uint64_t events_in;
+    uint64_t bits_out;
+
+    struct chunk *chunks;
+    size_t nchunks;                 // slots allocated
+};
+
+// Von Neumann output for the four bit pairs of a byte
+static uint8_t vn_bits[256];
+static uint8_t vn_count[256];
+static pthread_once_t vn_once = PTHREAD_ONCE_INIT;
+
+static void vn_table_init(void) {
+    for (int b = 0; b < 256; b++) {
+        int bits = 0, n = 0;
+        for (int s = 6; s >= 0; s -= 2) {
+            int hi = (b >> (s + 1)) & 1;
+            if (hi != ((b >> s) & 1)) {
+                bits = (bits << 1) | hi;
+                n++;
+            }
+        }
+        vn_bits[b] = (uint8_t)bits;
+        vn_count[b] = (uint8_t)n;
+    }
+}
+
+static inline int bit_at(const uint8_t *data, uint64_t i) {
+    return (data[i >> 3] >> (7 - (i & 7))) & 1;
+}
+
+static inline void put_bit(struct writer *w, struct hb_buffer *out, int bit) {
+    w->cur = (w->cur << 1) | (unsigned)bit;
+    if (++w->nbits == 8) {
+        out->data[out->len++] = (uint8_t)w->cur;
+        w->cur = 0;
+        w->nbits = 0;
+    }
+}
+
+// n bits of data at the writer's offset into its current byte
+static void put_stream(struct writer *w, struct hb_buffer *out, const uint8_t *data, uint64_t n) {
+    size_t whole = (size_t)(n / 8);
+    if (w->nbits == 0) {
+        memcpy(out->data + out->len, data, whole);
+    } else {
+        int k = w->nbits;
+        unsigned cur = w->cur;
+        uint8_t *dst = out->data + out->len;
+        for (size_t i = 0; i < whole; i++) {
+            dst[i] = (uint8_t)((cur << (8 - k)) | (data[i] >> k));
+            cur = data[i] & ((1u << k) - 1);
+        }
+        w->cur = cur;
+    }
+    out->len += whole;
+    for (int i = 0; i < (int)(n % 8); i++) {
+        put_bit(w, out, (data[whole] >> (7 - i)) & 1);
+    }
+}
+
+// Zero pad the writer's partial byte into out
+static void put_padding(struct writer *w, struct hb_buffer *out) {
+    if (w->nbits > 0) {
+        out->data[out->len++] = (uint8_t)(w->cur << (8 - w->nbits));
+        w->cur = 0;
+        w->nbits = 0;
+    }
+}
+
+// Von Neumann over raw's bits from start, like debias_bit in pipeline.c
+static int vn_debias(const struct bits *raw, uint64_t start, struct bits *dst) {
+    HB_SCOPE(HB_STAGE_CONDITION);
+    uint64_t pairs = raw->n > start ? (raw->n - start) / 2 : 0;
+    struct writer w = { 0, 0 };
+    dst->buf.len = 0;
+    dst->n = 0;
+    if (hb_buffer_reserve(&dst->buf, pairs / 8 + 2) < 0) {
+        return -1;
+    }
+
+    // Four pairs per byte, realigned by one bit for odd starts
+    const uint8_t *d = raw->buf.data;
+    size_t bytes = (size_t)(pairs / 4);
+    for (size_t i = 0; i < bytes; i++) {
+        uint8_t b = start ? (uint8_t)((d[i] << 1) | (d[i + 1] >> 7)) : d[i];
+        for (int j = vn_count[b] - 1; j >= 0; j--) {
+            put_bit(&w, &dst->buf, (vn_bits[b] >> j) & 1);
+        }
+        dst->n += vn_count[b];
+    }
+    for (uint64_t p = (uint64_t)bytes * 4; p < pairs; p++) {
+        int a = bit_at(d, start + 2 * p);
+        if (a != bit_at(d, start + 2 * p + 1)) {
+            put_bit(&w, &dst->buf, a);
+            dst->n++;
+        }
+    }
+    put_padding(&w, &dst->buf);
+    return 0;
+}
+
+static void parse_chunk(void *arg) {
+    struct chunk *c = arg;
+    size_t max = c->text_len / 2 + 1;
+    if (c->parsed_cap < max) {
+        uint64_t *parsed = realloc(c->parsed, max * sizeof(uint64_t));
+        if (!parsed) {
+            fprintf(stderr, "Memory allocation failed\n");
+            c->failed = 1;
+            return;
+        }
+        c->parsed = parsed;
+        c->parsed_cap = max;
+    }
+    size_t consumed;
+    c->count = hb_parse_deltas(c->text, c->text_len, c->parsed, max, &consumed);
+    c->values = c->parsed;
+}
+
+static void extract_chunk(void *arg) {
+    struct chunk *c = arg;
+    struct hb_parallel *px = c->px;
+    struct hb_pipeline p;
+
+    c->raw.buf.len = 0;
+    c->raw.n = 0;
+    if (hb_pipeline_init(&p, &px->cfg) < 0) {
+        c->failed = 1;
+        return;
+    }
+    if (hb_pipeline_resume(&p, c->index, c->prev, c->nprev) < 0 ||
+        (c->drain ? hb_pipeline_drain(&p, &c->raw.buf)
+                  : hb_pipeline_push(&p, c->values, c->count, &c->raw.buf)) < 0 ||
+        hb_buffer_reserve(&c->raw.buf, 1) < 0) {
+        c->failed = 1;
+    } else {
+        c->raw.n = p.bits_out;
+        if (p.nbits > 0) {
+            c->raw.buf.data[c->raw.buf.len++] = (uint8_t)(p.cur << (8 - p.nbits));
+        }
+        if (px->debias && c->raw.n > 0 &&
+            (vn_debias(&c->raw, 0, &c->even) < 0 || vn_debias(&c->raw, 1, &c->odd) < 0)) {
+            c->failed = 1;
+        }
+    }
+    hb_pipeline_free(&p);
+}
+
+struct hb_parallel *hb_parallel_create(const struct hb_pipeline_config *cfg,
+                                       struct hb_pool *pool, size_t chunk_values) {
+    struct hb_parallel *px = calloc(1, sizeof(*px));
+    if (!px) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return NULL;
+    }
+    pthread_once(&vn_once, vn_table_init);
+
+    px->cfg = *cfg;
+    px->cfg.dead_time_ns = 0;
+    px->cfg.window_ns = 0;
+    px->cfg.debias = HB_DEBIAS_NONE;
+    px->debias = cfg->debias;
+    px->filtered = cfg->dead_time_ns > 0 || cfg->window_ns > 0;
+    px->pool = pool;
+    px->chunk_values = chunk_values ? chunk_values : DEFAULT_CHUNK_VALUES;
+    px->pending = -1;
+    hb_buffer_init(&px->filtered_values);
+
+    // Validates the configuration
+    struct hb_pipeline probe;
+    if (hb_pipeline_init(&probe, cfg) < 0) {
+        free(px);
+        return NULL;
+    }
+    hb_pipeline_free(&probe);
+    px->keep = hb_pipeline_history(cfg);
+    if (px->filtered && hb_pipeline_init(&px->filter, cfg) < 0) {
+        free(px);
+        return NULL;
+    }
+
+    px->history = malloc((px->keep + 1) * sizeof(uint64_t));
+    px->scratch = malloc((px->keep + 1) * sizeof(uint64_t));
+    if (!px->history || !px->scratch) {
+        fprintf(stderr, "Memory allocation failed\n");
+        hb_parallel_free(px);
+        return NULL;
+    }
+    return px;
+}
+
+void hb_parallel_free(struct hb_parallel *px) {
+    if (!px) {
+        return;
+    }
+    for (size_t i = 0; i < px->nchunks; i++) {
+        struct chunk *c = &px->chunks[i];
+        free(c->parsed);
+        free(c->prev);
+        hb_buffer_free(&c->raw.buf);
+        hb_buffer_free(&c->even.buf);
+        hb_buffer_free(&c->odd.buf);
+    }
+    free(px->chunks);
+    if (px->filtered) {
+        hb_pipeline_free(&px->filter);
+    }
+    hb_buffer_free(&px->filtered_values);
+    free(px->history);
+    free(px->scratch);
+    free(px);
+}
+
+static int ensure_chunks(struct hb_parallel *px, size_t n) {
+    if (n <= px->nchunks) {
+        return 0;
+    }
+    struct chunk *chunks = realloc(px->chunks, n * sizeof(*chunks));
+    if (!chunks) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+    memset(chunks + px->nchunks, 0, (n - px->nchunks) * sizeof(*chunks));
+    for (size_t i = px->nchunks; i < n; i++) {
+        chunks[i].px = px;
+        hb_buffer_init(&chunks[i].raw.buf);
+        hb_buffer_init(&chunks[i].even.buf);
+        hb_buffer_init(&chunks[i].odd.buf);
+    }
+    px->chunks = chunks;
+    px->nchunks = n;
+    return 0;
+}
+
+// The last n values before chunk i (n at most keep): from the chunks before
+// it, then from the history of earlier pushes
+static void gather(const struct hb_parallel *px, size_t i, size_t n, uint64_t *dst) {
+    size_t got = 0;
+    for (size_t j = i; j-- > 0 && got < n;) {
+        const struct chunk *c = &px->chunks[j];
+        size_t take = n - got < c->count ? n - got : c->count;
+        memcpy(dst + n - got - take, c->values + c->count - take, take * sizeof(uint64_t));
+        got += take;
+    }
+    if (got < n) {
+        memcpy(dst, px->history + px->history_len - (n - got), (n - got) * sizeof(uint64_t));
+    }
+}
+
+// Append c's bits after everything stitched so far
+static int stitch(struct hb_parallel *px, const struct chunk *c, struct hb_buffer *out) {
+    uint64_t n = c->raw.n;
+    if (n == 0) {
+        return 0;
+    }
+    if (hb_buffer_reserve(out, n / 8 + 2) < 0) {
+        return -1;
+    }
+    if (!px->debias) {
+        put_stream(&px->w, out, c->raw.buf.data, n);
+        px->bits_out += n;
+        return 0;
+    }
+
+    // The even pairing when no bit is waiting; otherwise the waiting bit
+    // pairs with the chunk's first and the rest follow the odd pairing
+    const struct bits *b = &c->even;
+    uint64_t start = 0;
+    if (px->pending >= 0) {
+        if (px->pending != bit_at(c->raw.buf.data, 0)) {
+            put_bit(&px->w, out, px->pending);
+            px->bits_out++;
+        }
+        px->pending = -1;
+        b = &c->odd;
+        start = 1;
+    }
+    put_stream(&px->w, out, b->buf.data, b->n);
+    px->bits_out += b->n;
+    if ((n - start) & 1) {
+        px->pending = bit_at(c->raw.buf.data, n - 1);
+    }
+    return 0;
+}
+
+// Extract chunks[0..n) on the pool and stitch them onto out in order
+static int extract_chunks(struct hb_parallel *px, size_t n, struct hb_buffer *out) {
+    uint64_t index = px->index;
+    for (size_t i = 0; i < n; i++) {
+        struct chunk *c = &px->chunks[i];
+        c->index = index;
+        c->nprev = px->keep < index ? px->keep : (size_t)index;
+        if (!c->prev) {
+            c->prev = malloc((px->keep + 1) * sizeof(uint64_t));
+            if (!c->prev) {
+                fprintf(stderr, "Memory allocation failed\n");
+                return -1;
+            }
+        }
+        gather(px, i, c->nprev, c->prev);
+        c->failed = 0;
+        c->raw.n = 0;
+        index += c->count;
+    }
+
+    int rv = 0;
+    for (size_t i = 0; i < n && rv == 0; i++) {
+        struct chunk *c = &px->chunks[i];
+        if ((c->count > 0 || c->drain) && hb_pool_submit(px->pool, extract_chunk, c) < 0) {
+            rv = -1;
+        }
+    }
+    hb_pool_wait(px->pool);
+
+    for (size_t i = 0; i < n && rv == 0; i++) {
+        if (px->chunks[i].failed || stitch(px, &px->chunks[i], out) < 0) {
+            rv = -1;
+        }
+    }
+
+    size_t keep = px->keep < index ? px->keep : (size_t)index;
+    gather(px, n, keep, px->scratch);
+    uint64_t *history = px->history;
+    px->history = px->scratch;
+    px->scratch = history;
+    px->history_len = keep;
+    px->index = index;
+    return rv;
+}
+
+// Cut values into chunks; returns how many
+static ssize_t split(struct hb_parallel *px, const uint64_t *values, size_t count) {
+    size_t n = (count + px->chunk_values - 1) / px->chunk_values;
+    if (ensure_chunks(px, n) < 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        struct chunk *c = &px->chunks[i];
+        c->values = values + i * px->chunk_values;
+        c->count = i + 1 < n ? px->chunk_values : count - i * px->chunk_values;
+        c->drain = 0;
+    }
+    return (ssize_t)n;
+}
+
+int hb_parallel_push(struct hb_parallel *px, const uint64_t *deltas, size_t count,
+                     struct hb_buffer *out) {
+    px->events_in += count;
+    if (px->filtered) {
+        px->filtered_values.len = 0;
+        if (hb_pipeline_filter(&px->filter, deltas, count, &px->filtered_values) < 0) {
+            return -1;
+        }
+        deltas = (const uint64_t *)px->filtered_values.data;
+        count = px->filtered_values.len / sizeof(uint64_t);
+    }
+    ssize_t n = split(px, deltas, count);
+    return n < 0 ? -1 : extract_chunks(px, (size_t)n, out);
+}
+
+int hb_parallel_push_text(struct hb_parallel *px, const char *text, size_t len,
+                          struct hb_buffer *out) {
+    // Slices end on a newline so each parses on its own
+    size_t slice = px->chunk_values * TEXT_BYTES_PER_VALUE;
+    size_t n = 0;
+    for (size_t pos = 0; pos < len; n++) {
+        if (ensure_chunks(px, n + 1) < 0) {
+            return -1;
+        }
+        size_t end = len - pos > slice ? pos + slice : len;
+        const char *nl = end < len ? memchr(text + end, '\n', len - end) : NULL;
+        end = nl ? (size_t)(nl - text) + 1 : len;
+        px->chunks[n].text = text + pos;
+        px->chunks[n].text_len = end - pos;
+        px->chunks[n].failed = 0;
+        px->chunks[n].drain = 0;
+        pos = end;
+    }
+
+    int rv = 0;
+    for (size_t i = 0; i < n && rv == 0; i++) {
+        if (hb_pool_submit(px->pool, parse_chunk, &px->chunks[i]) < 0) {
+            rv = -1;
+        }
+    }
+    hb_pool_wait(px->pool);
+    for (size_t i = 0; i < n; i++) {
+        if (px->chunks[i].failed) {
+            rv = -1;
+        }
+        px->events_in += px->chunks[i].count;
+    }
+    if (rv < 0) {
+        return -1;
+    }
+    if (!px->filtered) {
+        return extract_chunks(px, n, out);
+    }
+
+    px->filtered_values.len = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (hb_pipeline_filter(&px->filter, px->chunks[i].values, px->chunks[i].count,
+                               &px->filtered_values) < 0) {
+            return -1;
+        }
+    }
+    ssize_t m = split(px, (const uint64_t *)px->filtered_values.data,
+                      px->filtered_values.len / sizeof(uint64_t));
+    return m < 0 ? -1 : extract_chunks(px, (size_t)m, out);
+}
+
+int hb_parallel_finish(struct hb_parallel *px, struct hb_buffer *out) {
+    if (px->filtered) {
+        px->filtered_values.len = 0;
+        if (hb_pipeline_filter_finish(&px->filter, &px->filtered_values) < 0) {
+            return -1;
+        }
+        ssize_t n = split(px, (const uint64_t *)px->filtered_values.data,
+                          px->filtered_values.len / sizeof(uint64_t));
+        if (n < 0 || extract_chunks(px, (size_t)n, out) < 0) {
+            return -1;
+        }
+    }
+
+    // Values still waiting for their lookahead window
+    if (ensure_chunks(px, 1) < 0) {
+        return -1;
+    }
+    px->chunks[0].values = NULL;
+    px->chunks[0].count = 0;
+    px->chunks[0].drain = 1;
+    int rv = extract_chunks(px, 1, out);
+    px->chunks[0].drain = 0;
+    if (rv < 0 || hb_buffer_reserve(out, 1) < 0) {
+        return -1;
+    }
+    put_padding(&px->w, out);
+    return 0;
+}
+
+uint64_t hb_parallel_events(const struct hb_parallel *px) {
+    return px->events_in;
+}
+
+uint64_t hb_parallel_bits(const struct hb_parallel *px) {
+    return px->bits_out;
+}
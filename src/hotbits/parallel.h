@@ -0,0 +1,41 @@
+#ifndef HOTBITS_PARALLEL_H
+#define HOTBITS_PARALLEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pipeline.h"
+#include "pool.h"
+
+// Parallel extraction on a work-stealing pool (hotbits-extract -j), with
+// output byte-identical to one hb_pipeline fed the same stream.
+//
+// Each push is cut into chunks of about chunk_values values. The extractor
+// state where a chunk begins depends only on the values just before it
+// (hb_pipeline_resume), so every chunk runs on its own pipeline. What
+// depends on all earlier output is reconciled when the chunks are stitched
+// back together in order: von Neumann debiasing is done by each chunk from
+// both an even and an odd pairing and the stitcher picks the one that
+// matches the bits before it, then shifts the chunk's bits to the current
+// offset in the output byte. Text pushes are parsed on the pool as well.
+// The dead-time and window filters are a running scan over absolute time
+// and stay a sequential pass between parsing and extraction.
+struct hb_parallel;
+
+// chunk_values 0 picks a default
+struct hb_parallel *hb_parallel_create(const struct hb_pipeline_config *cfg,
+                                       struct hb_pool *pool, size_t chunk_values);
+void hb_parallel_free(struct hb_parallel *px);
+
+// Append the complete output bytes to out, like hb_pipeline_push
+int hb_parallel_push(struct hb_parallel *px, const uint64_t *deltas, size_t count,
+                     struct hb_buffer *out);
+// text holds complete newline-terminated lines (hb_parse_deltas rules)
+int hb_parallel_push_text(struct hb_parallel *px, const char *text, size_t len,
+                          struct hb_buffer *out);
+int hb_parallel_finish(struct hb_parallel *px, struct hb_buffer *out);
+
+uint64_t hb_parallel_events(const struct hb_parallel *px);
+uint64_t hb_parallel_bits(const struct hb_parallel *px);
+
+#endif
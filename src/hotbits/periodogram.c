@@ -0,0 +1,195 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "periodogram.h"
+
+#define TWO_PI 6.283185307179586
+
+int hb_periodogram_init(struct hb_periodogram *pg, size_t max_bins,
+                        const struct hb_allocator *alloc) {
+    memset(pg, 0, sizeof(*pg));
+    if (max_bins < 8 || (max_bins & (max_bins - 1))) {
+        fprintf(stderr, "Periodogram size must be a power of two, at least 8\n");
+        return -1;
+    }
+    pg->max_bins = max_bins;
+    pg->alloc = alloc;
+    return 0;
+}
+
+void hb_periodogram_free(struct hb_periodogram *pg) {
+    hb_free(pg->alloc, pg->data, pg->cap * sizeof(double));
+    hb_free(pg->alloc, pg->twiddle, pg->cap * sizeof(double));
+    pg->data = NULL;
+    pg->twiddle = NULL;
+    pg->cap = 0;
+}
+
+// Room for nbins; a smaller scan reads every (cap / nbins)th twiddle of
+// the table
+static int reserve(struct hb_periodogram *pg, size_t nbins) {
+    pg->nbins = nbins;
+    if (nbins <= pg->cap) {
+        return 0;
+    }
+    hb_periodogram_free(pg);
+    pg->data = hb_alloc(pg->alloc, nbins * sizeof(double));
+    pg->twiddle = hb_alloc(pg->alloc, nbins * sizeof(double));
+    if (!pg->data || !pg->twiddle) {
+        fprintf(stderr, "Memory allocation failed\n");
+        hb_free(pg->alloc, pg->data, nbins * sizeof(double));
+        hb_free(pg->alloc, pg->twiddle, nbins * sizeof(double));
+        pg->data = NULL;
+        pg->twiddle = NULL;
+        return -1;
+    }
+    pg->cap = nbins;
+
+    // Each factor from its own sin/cos: a recurrence would drift by
+    // ~nbins ulps over the table
+    for (size_t j = 0; j < nbins / 2; j++) {
+        double a = TWO_PI * (double)j / (double)nbins;
+        pg->twiddle[2 * j] = cos(a);
+        pg->twiddle[2 * j + 1] = -sin(a);
+    }
+    return 0;
+}
+
+// In-place forward FFT of the nbins / 2 complex values in pg->data, with
+// every (2 cap / nbins)th twiddle of the table
+static void fft_half(struct hb_periodogram *pg) {
+    size_t n = pg->nbins / 2;
+    double *x = pg->data;
+    const double *tw = pg->twiddle;
+
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j |= bit;
+        if (i < j) {
+            double re = x[2 * i], im = x[2 * i + 1];
+            x[2 * i] = x[2 * j];
+            x[2 * i + 1] = x[2 * j + 1];
+            x[2 * j] = re;
+            x[2 * j + 1] = im;
+        }
+    }
+
+    for (size_t len = 2; len <= n; len <<= 1) {
+        size_t half = len / 2;
+        size_t step = pg->cap / len;
+        for (size_t i = 0; i < n; i += len) {
+            for (size_t j = 0; j < half; j++) {
+                double wr = tw[2 * j * step], wi = tw[2 * j * step + 1];
+                double *a = x + 2 * (i + j);
+                double *b = x + 2 * (i + j + half);
+                double tr = b[0] * wr - b[1] * wi;
+                double ti = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+}
+
+// |X_k|^2 for the real counts, unpacked from the half-length transform Z
+// of their even and odd bins as real and imaginary parts:
+// X_k = E_k + W^k O_k, with E_k = (Z_k + conj(Z_{m-k})) / 2 and
+// O_k = (Z_k - conj(Z_{m-k})) / 2i
+static double bin_power(const struct hb_periodogram *pg, size_t k) {
+    size_t m = pg->nbins / 2;
+    const double *z = pg->data;
+    size_t c = (m - k) & (m - 1);
+    double er = (z[2 * k] + z[2 * c]) / 2, ei = (z[2 * k + 1] - z[2 * c + 1]) / 2;
+    double orr = (z[2 * k + 1] + z[2 * c + 1]) / 2, oi = (z[2 * c] - z[2 * k]) / 2;
+    size_t t = k * (pg->cap / pg->nbins);
+    double wr = pg->twiddle[2 * t], wi = pg->twiddle[2 * t + 1];
+    double xr = er + wr * orr - wi * oi;
+    double xi = ei + wr * oi + wi * orr;
+    return xr * xr + xi * xi;
+}
+
+int hb_periodogram_peak(struct hb_periodogram *pg, const uint64_t *times, size_t n,
+                        double lo_hz, double hi_hz, double alpha,
+                        struct hb_period *out) {
+    memset(out, 0, sizeof(*out));
+    if (n < 16 || times[n - 1] == 0) {
+        return -1;
+    }
+
+    // Bin k is k cycles per span. The band's top sets the bin width, at
+    // most 1 / (2 hi_hz); bins 0 and 1 are the mean rate and any drift
+    // across the span, not a period, and the last bin below Nyquist is
+    // kept for the interpolation.
+    uint64_t span = times[n - 1] + 1;
+    double seconds = (double)span / 1e9;
+    size_t nbins = 8;
+    while (nbins < pg->max_bins && (double)nbins < 2.0 * hi_hz * seconds) {
+        nbins <<= 1;
+    }
+    double lo_k = ceil(lo_hz * seconds);
+    double hi_k = floor(hi_hz * seconds);
+    size_t first = lo_k > 2.0 ? (size_t)lo_k : 2;
+    size_t last = nbins / 2 - 2;
+    if (hi_k < (double)last) {
+        last = (size_t)hi_k;
+    }
+    if (first > last || reserve(pg, nbins) < 0) {
+        return -1;
+    }
+
+    // Counts in bin order are the half-length input: even bins real, odd
+    // bins imaginary. The bin of a time needs 128 bits once spans pass a
+    // few minutes.
+    double *x = pg->data;
+    memset(x, 0, nbins * sizeof(double));
+    for (size_t i = 0; i < n; i++) {
+        size_t b = (size_t)((unsigned __int128)times[i] * nbins / span);
+        x[b] += 1.0;
+    }
+    fft_half(pg);
+
+    size_t best = first;
+    double best_power = bin_power(pg, best);
+    for (size_t k = first + 1; k <= last; k++) {
+        double power = bin_power(pg, k);
+        if (power > best_power) {
+            best = k;
+            best_power = power;
+        }
+    }
+
+    // Parabola through the magnitudes either side of the peak
+    double a = sqrt(bin_power(pg, best - 1));
+    double b = sqrt(best_power);
+    double c = sqrt(bin_power(pg, best + 1));
+    double denom = a - 2.0 * b + c;
+    double shift = denom < 0.0 ? 0.5 * (a - c) / denom : 0.0;
+    double freq = ((double)best + shift) / (double)span;
+
+    // Rayleigh sum at the refined frequency, with the phase reduced in
+    // integer cycles first so long spans keep their precision
+    double sc = 0.0, ss = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        double cycles = (double)times[i] * freq;
+        double ph = TWO_PI * (cycles - floor(cycles));
+        sc += cos(ph);
+        ss += sin(ph);
+    }
+
+    double period = 1.0 / freq;
+    double offset = atan2(ss, sc) / TWO_PI * period;
+    if (offset < 0.0) {
+        offset += period;
+    }
+    out->period_ns = period;
+    out->offset_ns = offset;
+    out->power = (sc * sc + ss * ss) / (double)n;
+    out->significant = out->power > log((double)(last - first + 1) / alpha);
+    return 0;
+}
@@ -0,0 +1,54 @@
+#ifndef HOTBITS_PERIODOGRAM_H
+#define HOTBITS_PERIODOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alloc.h"
+
+// Periodogram of a point process over a band of frequencies: the event
+// times are binned into counts over their span and transformed with one
+// radix-2 FFT (of half the length, the counts being real), so a scan over
+// every frequency of the band costs O(nbins log nbins) rather than the
+// O(n^2) of extract.py's correlation. The bins are sized from the band's
+// top, not from the number of events: the smallest power of two whose
+// Nyquist frequency reaches it, up to max_bins, past which the scan stops
+// at Nyquist.
+//
+// The strongest bin is refined by parabolic interpolation and its Rayleigh
+// power |sum exp(2 pi i f t)|^2 / n evaluated exactly at the refined
+// frequency. For a Poisson process that power is exponential with mean 1
+// at every frequency, so a peak is significant when it exceeds
+// ln(k / alpha) for the k bins scanned, a false alarm rate of alpha per
+// scan.
+struct hb_periodogram {
+    size_t nbins;               // of the last scan, a power of two
+    size_t cap;                 // allocated, a power of two
+    size_t max_bins;
+    double *data;               // nbins counts, transformed as nbins / 2
+                                // complex values
+    double *twiddle;            // exp(-2 pi i j / cap) for j < cap / 2
+    const struct hb_allocator *alloc;
+};
+
+struct hb_period {
+    double period_ns;           // strongest period, significant or not
+    double offset_ns;           // time of peak event density, in [0, period_ns)
+    double power;               // Rayleigh power there
+    int significant;
+};
+
+// Nothing is allocated until the first scan. alloc must outlive the
+// periodogram.
+int hb_periodogram_init(struct hb_periodogram *pg, size_t max_bins,
+                        const struct hb_allocator *alloc);
+void hb_periodogram_free(struct hb_periodogram *pg);
+
+// times: n event times in nanoseconds, ascending, measured from the start
+// of the span; lo_hz and hi_hz the band to scan. Returns -1 when there are
+// too few events, or too short a span, to scan it.
+int hb_periodogram_peak(struct hb_periodogram *pg, const uint64_t *times, size_t n,
+                        double lo_hz, double hi_hz, double alpha,
+                        struct hb_period *out);
+
+#endif
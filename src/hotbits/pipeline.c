@@ -0,0 +1,1200 @@
+#include <endian.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "pipeline.h"
+#include "instrument.h"
+#include "trace.h"
+
+// Stage helpers take the method and debias (and whether filters are
+// configured) as arguments. The generic loop passes the configuration;
+// the specialised loops below pass constants, and forced inlining lets
+// the switches fold away.
+#define STAGE static inline __attribute__((always_inline))
+
+// Not a method: the filter stage hands its values on unextracted, as
+// native uint64_t in the output buffer (hb_pipeline_filter)
+#define METHOD_VALUES -1
+
+static const char *method_names[] = {
+    "interval", "von_neumann", "xor_fold", "lsb", "adaptive_threshold", "ordinal",
+    "quantile", "phase"
+};
+
+static const char *debias_names[] = {
+    "none", "von_neumann"
+};
+
+void hb_pipeline_config_default(struct hb_pipeline_config *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->method = HB_METHOD_ADAPTIVE;
+    cfg->window = 100;
+    cfg->order = 8;
+    cfg->rate_window = 4096;
+    cfg->debias = HB_DEBIAS_NONE;
+}
+
+int hb_method_parse(const char *name) {
+    for (size_t i = 0; i < sizeof(method_names) / sizeof(method_names[0]); i++) {
+        if (strcmp(name, method_names[i]) == 0) {
+            return (int)i;
+        }
+    }
+    // Accept rng-extractor's numeric methods as well
+    if (name[0] >= '0' && name[0] <= '9' && name[1] == '\0') {
+        int m = name[0] - '0';
+        if (m < (int)(sizeof(method_names) / sizeof(method_names[0]))) {
+            return m;
+        }
+    }
+    if (strcmp(name, "adaptive") == 0) {
+        return HB_METHOD_ADAPTIVE;
+    }
+    return -1;
+}
+
+const char *hb_method_name(int method) {
+    if (method < 0 || method >= (int)(sizeof(method_names) / sizeof(method_names[0]))) {
+        return "unknown";
+    }
+    return method_names[method];
+}
+
+int hb_debias_parse(const char *name) {
+    for (size_t i = 0; i < sizeof(debias_names) / sizeof(debias_names[0]); i++) {
+        if (strcmp(name, debias_names[i]) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+const char *hb_debias_name(int debias) {
+    if (debias < 0 || debias >= (int)(sizeof(debias_names) / sizeof(debias_names[0]))) {
+        return "unknown";
+    }
+    return debias_names[debias];
+}
+
+void hb_buffer_init(struct hb_buffer *buf) {
+    hb_buffer_init_alloc(buf, NULL);
+}
+
+void hb_buffer_init_alloc(struct hb_buffer *buf, const struct hb_allocator *alloc) {
+    buf->data = NULL;
+    buf->len = 0;
+    buf->cap = 0;
+    buf->alloc = alloc;
+}
+
+void hb_buffer_free(struct hb_buffer *buf) {
+    hb_free(buf->alloc, buf->data, buf->cap);
+    hb_buffer_init_alloc(buf, buf->alloc);
+}
+
+int hb_buffer_reserve(struct hb_buffer *buf, size_t extra) {
+    if (buf->len + extra <= buf->cap) {
+        return 0;
+    }
+
+    size_t cap = buf->cap ? buf->cap : 4096;
+    while (cap < buf->len + extra) {
+        cap *= 2;
+    }
+
+    uint8_t *data = hb_realloc(buf->alloc, buf->data, buf->cap, cap);
+    if (!data) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+
+    buf->data = data;
+    buf->cap = cap;
+    return 0;
+}
+
+int hb_pipeline_init(struct hb_pipeline *p, const struct hb_pipeline_config *cfg) {
+    return hb_pipeline_init_alloc(p, cfg, NULL);
+}
+
+int hb_pipeline_init_alloc(struct hb_pipeline *p, const struct hb_pipeline_config *cfg,
+                           const struct hb_allocator *alloc) {
+    memset(p, 0, sizeof(*p));
+    p->cfg = *cfg;
+    p->pending = -1;
+    p->alloc = alloc;
+
+    if (cfg->method < HB_METHOD_INTERVAL || cfg->method > HB_METHOD_PHASE) {
+        fprintf(stderr, "Invalid extraction method: %d\n", cfg->method);
+        return -1;
+    }
+    if (cfg->debias < HB_DEBIAS_NONE || cfg->debias > HB_DEBIAS_VON_NEUMANN) {
+        fprintf(stderr, "Invalid debias method: %d\n", cfg->debias);
+        return -1;
+    }
+    if (cfg->method == HB_METHOD_LSB && (cfg->bit_pos < 0 || cfg->bit_pos > 63)) {
+        fprintf(stderr, "Invalid bit position: %d\n", cfg->bit_pos);
+        return -1;
+    }
+
+    if (cfg->method == HB_METHOD_ORDINAL &&
+        (cfg->order < 2 || cfg->order > HB_ORDINAL_MAX)) {
+        fprintf(stderr, "Ordinal block length must be 2 to %d\n", HB_ORDINAL_MAX);
+        return -1;
+    }
+    p->code_range = 1;
+
+    if (cfg->method == HB_METHOD_ADAPTIVE) {
+        if (cfg->window < 2) {
+            fprintf(stderr, "Adaptive threshold window must be at least 2\n");
+            return -1;
+        }
+        p->half = (size_t)cfg->window / 2;
+        p->ring_cap = 2 * p->half;
+    }
+    if (cfg->method == HB_METHOD_QUANTILE) {
+        if (cfg->rate_window < 2) {
+            fprintf(stderr, "Quantile rate window must be at least 2\n");
+            return -1;
+        }
+        p->ring_cap = (size_t)cfg->rate_window;
+    }
+    if (cfg->method == HB_METHOD_PHASE) {
+        p->ring_cap = HB_PHASE_FRAME;
+        if (hb_periodogram_init(&p->periodogram, HB_PHASE_MAX_BINS, alloc) < 0) {
+            return -1;
+        }
+    }
+    if (p->ring_cap > 0) {
+        p->ring = hb_alloc(alloc, p->ring_cap * sizeof(uint64_t));
+        p->sorted = hb_alloc(alloc, p->ring_cap * sizeof(uint64_t));
+        if (!p->ring || !p->sorted) {
+            fprintf(stderr, "Memory allocation failed\n");
+            hb_pipeline_free(p);
+            return -1;
+        }
+    }
+
+    // The implicit event at time 0 opens the first aggregation window, or
+    // without one is the reference the first delta is measured from.
+    if (cfg->window_ns > 0) {
+        p->win_count = 1;
+    } else {
+        p->have_ref = 1;
+    }
+    return 0;
+}
+
+void hb_pipeline_free(struct hb_pipeline *p) {
+    hb_free(p->alloc, p->ring, p->ring_cap * sizeof(uint64_t));
+    hb_free(p->alloc, p->sorted, p->ring_cap * sizeof(uint64_t));
+    p->ring = NULL;
+    p->sorted = NULL;
+    hb_periodogram_free(&p->periodogram);
+}
+
+STAGE void pack_bit(struct hb_pipeline *p, int bit, struct hb_buffer *out) {
+    p->cur = (uint8_t)((p->cur << 1) | bit);
+    p->bits_out++;
+    if (++p->nbits == 8) {
+        out->data[out->len++] = p->cur;
+        p->cur = 0;
+        p->nbits = 0;
+    }
+}
+
+STAGE void debias_bit(struct hb_pipeline *p, int bit, struct hb_buffer *out, int debias) {
+    if (debias == HB_DEBIAS_NONE) {
+        pack_bit(p, bit, out);
+        return;
+    }
+
+    if (p->pending < 0) {
+        p->pending = bit;
+        return;
+    }
+    if (p->pending != bit) {
+        pack_bit(p, p->pending, out);
+    }
+    p->pending = -1;
+}
+
+// Sorted window maintenance for the adaptive threshold
+static void sorted_insert(struct hb_pipeline *p, uint64_t v) {
+    size_t lo = 0, hi = p->sorted_len;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (p->sorted[mid] < v) lo = mid + 1; else hi = mid;
+    }
+    memmove(p->sorted + lo + 1, p->sorted + lo, (p->sorted_len - lo) * sizeof(uint64_t));
+    p->sorted[lo] = v;
+    p->sorted_len++;
+}
+
+static void sorted_remove(struct hb_pipeline *p, uint64_t v) {
+    size_t lo = 0, hi = p->sorted_len;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (p->sorted[mid] < v) lo = mid + 1; else hi = mid;
+    }
+    memmove(p->sorted + lo, p->sorted + lo + 1, (p->sorted_len - lo - 1) * sizeof(uint64_t));
+    p->sorted_len--;
+}
+
+// np.median of the window: the middle value, or the mean of the two middle
+// values for even lengths. Compared as 2x > a+b to stay exact.
+static inline int above_median(const struct hb_pipeline *p, uint64_t x) {
+    size_t m = p->sorted_len;
+    if (m & 1) {
+        return x > p->sorted[m / 2];
+    }
+    unsigned __int128 twice = (unsigned __int128)x * 2;
+    return twice > (unsigned __int128)p->sorted[m / 2 - 1] + p->sorted[m / 2];
+}
+
+STAGE void adaptive_emit(struct hb_pipeline *p, struct hb_buffer *out, int debias) {
+    uint64_t x = p->ring[p->next_emit % (2 * p->half)];
+    if (p->sorted_len > 1) {
+        debias_bit(p, above_median(p, x), out, debias);
+    }
+    p->next_emit++;
+}
+
+// The top b bits of the coder when it is below 2^b, the largest power of
+// two in its range: uniform given that, so they are emitted and the coder
+// restarts. Otherwise the rest of the range is kept, at least halved.
+static void ordinal_step(struct hb_pipeline *p, struct hb_buffer *out, int debias) {
+    int b = 63 - __builtin_clzll(p->code_range);
+    uint64_t low = 1ULL << b;
+    if (p->code < low) {
+        for (int i = b - 1; i >= 0; i--) {
+            debias_bit(p, (int)((p->code >> i) & 1), out, debias);
+        }
+        p->code = 0;
+        p->code_range = 1;
+    } else {
+        p->code -= low;
+        p->code_range -= low;
+    }
+}
+
+// Emit what the coder holds: at most two bits of its range are lost
+static void ordinal_flush(struct hb_pipeline *p, struct hb_buffer *out, int debias) {
+    while (p->code_range > 1) {
+        ordinal_step(p, out, debias);
+    }
+}
+
+static void ordinal_block(struct hb_pipeline *p, struct hb_buffer *out, int debias) {
+    // Lehmer index: how many later values are smaller than each, in mixed
+    // radix k, k - 1, ..., 1
+    int k = p->cfg.order;
+    uint64_t index = 0;
+    uint64_t symbols = 1;
+    for (int i = 0; i < k; i++) {
+        uint64_t x = p->block[i];
+        int smaller = 0;
+        for (int j = i + 1; j < k; j++) {
+            if (p->block[j] == x) {
+                p->blocks_tied++;
+                return;
+            }
+            smaller += p->block[j] < x;
+        }
+        index = index * (uint64_t)(k - i) + (uint64_t)smaller;
+        symbols *= (uint64_t)(k - i);
+    }
+
+    while (p->code_range > UINT64_MAX / symbols) {
+        ordinal_step(p, out, debias);
+    }
+    p->code = p->code * symbols + index;
+    p->code_range *= symbols;
+}
+
+static inline size_t ring_wrap(const struct hb_pipeline *p, size_t i) {
+    return i >= p->ring_cap ? i - p->ring_cap : i;
+}
+
+// Add value seen at ring position pos (seen % ring_cap), whose previous
+// value has been removed from the rate window
+static void quantile_fill(struct hb_pipeline *p, uint64_t v, size_t pos) {
+    p->seen++;
+    p->ring[pos] = v;
+    p->rate_sum += v;
+    while (p->min_len > 0 &&
+           p->ring[p->sorted[ring_wrap(p, p->min_head + p->min_len - 1)]] >= v) {
+        p->min_len--;
+    }
+    p->sorted[ring_wrap(p, p->min_head + p->min_len++)] = pos;
+}
+
+// Standard deviations of the chi-square statistic above its mean that
+// still count as uniform
+#define QUANTILE_SIGMA 3
+
+// Floating point stays out of the HB_KERNEL variants, which inline
+// (flatten) everything else: the wider levels would contract it into fused
+// multiply-adds, rounded differently from the generic build that
+// hb_pipeline_resume replays with
+#define FLOAT_STAGE static __attribute__((noinline))
+
+// The largest k whose top k bits pass a chi-square check (at most sigma
+// standard deviations above its mean), along with every coarser
+// resolution, given the counts of n values' 2^max_bits finest cells
+static int uniform_bits(const uint32_t *fine, int max_bits, uint64_t n, double sigma) {
+    int k = 0;
+    for (int bits = 1; bits <= max_bits; bits++) {
+        int cells = 1 << bits;
+        int width = 1 << (max_bits - bits);
+        // chi2 = sum((count - n/cells)^2 / (n/cells)), kept in integers
+        // as sum((count * cells - n)^2) / (n * cells)
+        uint64_t scaled = 0;
+        for (int c = 0; c < cells; c++) {
+            uint64_t count = 0;
+            for (int i = 0; i < width; i++) {
+                count += fine[c * width + i];
+            }
+            int64_t d = (int64_t)(count * (uint64_t)cells) - (int64_t)n;
+            scaled += (uint64_t)(d * d);
+        }
+        double df = cells - 1;
+        if ((double)scaled > (df + sigma * sqrt(2 * df)) * (double)n * cells) {
+            break;
+        }
+        k = bits;
+    }
+    return k;
+}
+
+// The largest k whose 2^k quantile cells pass, over the last
+// HB_QUANTILE_CHECK frames. Until half a frame of values has been fitted k
+// is 0. Then the oldest frame's slot is cleared for the one starting at
+// value s.
+FLOAT_STAGE void quantile_frame(struct hb_pipeline *p, uint64_t s) {
+    uint32_t pooled[1 << HB_QUANTILE_MAX_BITS] = {0};
+    uint64_t n = 0;
+    for (int f = 0; f < HB_QUANTILE_CHECK; f++) {
+        for (int i = 0; i < 1 << HB_QUANTILE_MAX_BITS; i++) {
+            pooled[i] += p->quantiles[f][i];
+            n += p->quantiles[f][i];
+        }
+    }
+    int k = 0;
+    if (n >= HB_QUANTILE_FRAME / 2) {
+        k = uniform_bits(pooled, HB_QUANTILE_MAX_BITS, n, QUANTILE_SIGMA);
+    }
+    p->quantile_bits = k;
+    memset(p->quantiles[s / HB_QUANTILE_FRAME % HB_QUANTILE_CHECK], 0, sizeof(p->quantiles[0]));
+}
+
+// Shifted exponential fitted to a window of cap values: location the
+// minimum lo, scale from the excess over it. Rather than plugging the fit
+// into the CDF, which is biased by its own noise (most visibly, one value
+// in cap + 1 falls below lo), use the exact predictive law. The value is
+// below lo with probability 1 / (cap + 1), and then cap times its distance
+// to lo is exponential; otherwise its excess over lo is. Either way, for
+// an exponential t independent of the excess (a sum of cap - 1
+// exponentials), 1 - (excess / (t + excess))^(cap - 1) is uniform. Returns
+// the finest quantile cell of v.
+FLOAT_STAGE uint32_t quantile_cell(uint64_t v, uint64_t lo, uint64_t excess, uint64_t cap) {
+    double below = 1.0 / (double)(cap + 1);
+    double t = v < lo ? (double)(lo - v) * (double)cap : (double)(v - lo);
+    double g = 1 - exp((double)(cap - 1) * log((double)excess / (t + (double)excess)));
+    double u = v < lo ? below * g : below + (1 - below) * g;
+    uint32_t q = (uint32_t)(u * (1 << HB_QUANTILE_MAX_BITS));
+    return q < 1u << HB_QUANTILE_MAX_BITS ? q : (1u << HB_QUANTILE_MAX_BITS) - 1;
+}
+
+STAGE void quantile_value(struct hb_pipeline *p, uint64_t v, struct hb_buffer *out, int debias) {
+    uint64_t cap = p->ring_cap;
+    uint64_t s = p->seen;
+    size_t pos = (size_t)(s % cap);
+    if (s > 0 && s % HB_QUANTILE_FRAME == 0) {
+        quantile_frame(p, s);
+    }
+    if (s < cap) {
+        quantile_fill(p, v, pos);
+        return;
+    }
+
+    uint64_t lo = p->ring[p->sorted[p->min_head]];
+    uint64_t excess = p->rate_sum - lo * cap;
+    if (excess > 0) {
+        uint32_t q = quantile_cell(v, lo, excess, cap);
+        p->quantiles[s / HB_QUANTILE_FRAME % HB_QUANTILE_CHECK][q]++;
+        for (int i = HB_QUANTILE_MAX_BITS - 1; i >= HB_QUANTILE_MAX_BITS - p->quantile_bits; i--) {
+            debias_bit(p, (int)((q >> i) & 1), out, debias);
+        }
+    }
+
+    p->rate_sum -= p->ring[pos];
+    if (p->sorted[p->min_head] == pos) {
+        p->min_head = ring_wrap(p, p->min_head + 1);
+        p->min_len--;
+    }
+    quantile_fill(p, v, pos);
+}
+
+// Time t's distance from the peak at offset + n * period nearest to it,
+// shifted into [0, period)
+FLOAT_STAGE uint64_t phase_residual(uint64_t t, double period, double offset) {
+    double x = (double)t - offset;
+    double r = x - floor(x / period + 0.5) * period + period / 2;
+    return r > 0 ? (uint64_t)r : 0;
+}
+
+// Up to 62 fields are checked per frame, at 16 resolutions each; a looser
+// bound would end the bit window on chance failures, where clock
+// quantisation and the modulation fail by orders of magnitude more
+#define PHASE_SIGMA 5
+
+// 1 when bits [b, b + 8) of n residuals, and their steps between
+// consecutive events, pass at every resolution
+static int phase_field_ok(const uint64_t *r, size_t n, int b) {
+    uint32_t values[256] = {0};
+    uint32_t steps[256] = {0};
+    uint64_t last = (r[0] >> b) & 255;
+    values[last]++;
+    for (size_t i = 1; i < n; i++) {
+        uint64_t f = (r[i] >> b) & 255;
+        values[f]++;
+        steps[(f - last) & 255]++;
+        last = f;
+    }
+    return uniform_bits(values, 8, n, PHASE_SIGMA) == 8 &&
+           uniform_bits(steps, 8, n - 1, PHASE_SIGMA) == 8;
+}
+
+// Bits of the residual kept below its jitter: the bits at and above its
+// standard deviation carry the shape of the modulation
+#define PHASE_JITTER_MARGIN 2
+
+// At the end of a frame: its period, if any, and the residual bits its
+// events would have given, which the next frame emits. Without a
+// significant period nothing is emitted.
+FLOAT_STAGE void phase_frame(struct hb_pipeline *p) {
+    size_t n = p->ring_cap;
+    struct hb_period peak;
+    p->phase_period = 0;
+    p->phase_offset = 0;
+    p->phase_lo = 0;
+    p->phase_hi = 0;
+    p->phase_span = p->phase_now;
+    p->phase_now = 0;
+    if (hb_periodogram_peak(&p->periodogram, p->ring, n, HB_PHASE_BAND_LO, HB_PHASE_BAND_HI,
+                            HB_PHASE_ALPHA, &peak) < 0 ||
+        !peak.significant) {
+        return;
+    }
+    p->phase_period = peak.period_ns;
+    p->phase_offset = peak.offset_ns;
+
+    double sum = 0.0, sum2 = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        p->sorted[i] = phase_residual(p->ring[i], p->phase_period, p->phase_offset);
+        double r = (double)p->sorted[i];
+        sum += r;
+        sum2 += r * r;
+    }
+    double mean = sum / (double)n;
+    double var = sum2 / (double)n - mean * mean;
+    if (var < 1.0) {
+        return;
+    }
+
+    // The top field is the highest passing one under the jitter, and the
+    // window grows downwards from it while fields pass. A single failure
+    // with passing fields either side is taken for chance: a defect in the
+    // bits they share would fail them too.
+    int top = (int)floor(0.5 * log2(var)) - PHASE_JITTER_MARGIN;
+    int hi = top < 64 ? top : 64;
+    while (hi >= 8 && !phase_field_ok(p->sorted, n, hi - 8)) {
+        hi--;
+    }
+    if (hi < 8) {
+        return;
+    }
+    int lo = hi - 8;
+    while (lo > 0 && hi - lo < HB_PHASE_MAX_BITS) {
+        if (phase_field_ok(p->sorted, n, lo - 1)) {
+            lo--;
+        } else if (lo >= 2 && hi - lo + 2 <= HB_PHASE_MAX_BITS &&
+                   phase_field_ok(p->sorted, n, lo - 2)) {
+            lo -= 2;
+        } else {
+            break;
+        }
+    }
+    p->phase_lo = lo;
+    p->phase_hi = hi;
+}
+
+STAGE void phase_value(struct hb_pipeline *p, uint64_t v, struct hb_buffer *out, int debias) {
+    size_t i = (size_t)(p->seen % HB_PHASE_FRAME);
+    if (p->seen > 0 && i == 0) {
+        phase_frame(p);
+    }
+    p->seen++;
+    p->phase_now += v;
+    p->ring[i] = p->phase_now;
+
+    if (p->phase_hi > p->phase_lo) {
+        // Measured from the previous frame's start, like its residuals
+        uint64_t t = p->phase_span + p->phase_now;
+        uint64_t r = phase_residual(t, p->phase_period, p->phase_offset);
+        for (int b = p->phase_hi - 1; b >= p->phase_lo; b--) {
+            debias_bit(p, (int)((r >> b) & 1), out, debias);
+        }
+    }
+}
+
+STAGE void extract_value(struct hb_pipeline *p, uint64_t v, struct hb_buffer *out,
+                         int method, int debias) {
+    switch (method) {
+        case HB_METHOD_INTERVAL:
+            if (p->have_prev) {
+                debias_bit(p, p->prev > v, out, debias);
+                p->have_prev = 0;
+            } else {
+                p->prev = v;
+                p->have_prev = 1;
+            }
+            break;
+        case HB_METHOD_VON_NEUMANN: {
+            int bit = (int)(v & 1);
+            if (p->have_prev) {
+                if ((int)p->prev != bit) {
+                    debias_bit(p, (int)p->prev, out, debias);
+                }
+                p->have_prev = 0;
+            } else {
+                p->prev = (uint64_t)bit;
+                p->have_prev = 1;
+            }
+            break;
+        }
+        case HB_METHOD_XOR_FOLD:
+            if (p->have_prev) {
+                uint8_t byte = (uint8_t)((p->prev ^ v) & 0xFF);
+                for (int b = 7; b >= 0; b--) {
+                    debias_bit(p, (byte >> b) & 1, out, debias);
+                }
+            }
+            p->prev = v;
+            p->have_prev = 1;
+            break;
+        case HB_METHOD_LSB:
+            debias_bit(p, (int)((v >> p->cfg.bit_pos) & 1), out, debias);
+            break;
+        case HB_METHOD_ORDINAL: {
+            uint64_t k = (uint64_t)p->cfg.order;
+            uint64_t i = p->seen++ % k;
+            p->block[i] = v;
+            if (i == k - 1) {
+                ordinal_block(p, out, debias);
+                if (p->seen % (k * HB_ORDINAL_FRAME) == 0) {
+                    ordinal_flush(p, out, debias);
+                }
+            }
+            break;
+        }
+        case HB_METHOD_QUANTILE:
+            quantile_value(p, v, out, debias);
+            break;
+        case HB_METHOD_PHASE:
+            phase_value(p, v, out, debias);
+            break;
+        case METHOD_VALUES:
+            memcpy(out->data + out->len, &v, sizeof(v));
+            out->len += sizeof(v);
+            break;
+        case HB_METHOD_ADAPTIVE: {
+            // Window for value i is [i - half, i + half), so value i can be
+            // decided once value i + half - 1 has arrived.
+            size_t cap = 2 * p->half;
+            uint64_t s = p->seen;
+            if (s >= cap) {
+                sorted_remove(p, p->ring[s % cap]);
+                p->lo_idx++;
+            }
+            p->ring[s % cap] = v;
+            sorted_insert(p, v);
+            p->seen++;
+            if (s + 1 >= p->half) {
+                adaptive_emit(p, out, debias);
+            }
+            break;
+        }
+    }
+}
+
+STAGE void emit_timestamp(struct hb_pipeline *p, uint64_t t, struct hb_buffer *out,
+                          int method, int debias) {
+    if (p->have_ref) {
+        extract_value(p, t - p->last_out, out, method, debias);
+    }
+    p->last_out = t;
+    p->have_ref = 1;
+}
+
+STAGE uint64_t window_value(const struct hb_pipeline *p) {
+    switch (p->cfg.window_mode) {
+        case 1:
+            return p->win_last;
+        case 2:
+            return p->win_sum / p->win_count;
+        default:
+            return p->win_first;
+    }
+}
+
+STAGE void window_close(struct hb_pipeline *p, struct hb_buffer *out, int method, int debias) {
+    emit_timestamp(p, window_value(p), out, method, debias);
+}
+
+// filtered is 0 when neither dead time nor windows are configured
+STAGE void filter_delta(struct hb_pipeline *p, uint64_t d, struct hb_buffer *out,
+                        int method, int debias, int filtered) {
+    p->now += d;
+    uint64_t t = p->now;
+
+    if (!filtered) {
+        emit_timestamp(p, t, out, method, debias);
+        return;
+    }
+    if (p->cfg.dead_time_ns > 0) {
+        if (t - p->last_kept <= p->cfg.dead_time_ns) {
+            return;
+        }
+        p->last_kept = t;
+    }
+
+    if (p->cfg.window_ns == 0) {
+        emit_timestamp(p, t, out, method, debias);
+        return;
+    }
+
+    uint64_t wid = t / p->cfg.window_ns;
+    if (wid > p->win_id) {
+        window_close(p, out, method, debias);
+        p->win_id = wid;
+        p->win_first = t;
+        p->win_sum = 0;
+        p->win_count = 0;
+    }
+    p->win_last = t;
+    p->win_sum += t;
+    p->win_count++;
+}
+
+typedef void (*push_fn)(struct hb_pipeline *p, const uint64_t *deltas, size_t count,
+                        struct hb_buffer *out);
+
+// Any configuration
+static inline void push_deltas(struct hb_pipeline *p, const uint64_t *deltas, size_t count,
+                               struct hb_buffer *out) {
+    int method = p->cfg.method;
+    int debias = p->cfg.debias;
+    int filtered = p->cfg.dead_time_ns > 0 || p->cfg.window_ns > 0;
+    for (size_t i = 0; i < count; i++) {
+        filter_delta(p, deltas[i], out, method, debias, filtered);
+    }
+}
+
+HB_KERNEL_VOID(push_deltas,
+               (struct hb_pipeline *p, const uint64_t *deltas, size_t count,
+                struct hb_buffer *out),
+               (p, deltas, count, out));
+
+// One fused loop per unfiltered method and debias pair that production
+// runs use: hot.sh's adaptive_threshold and the rng-extractor methods
+#define SPECIALISE(name, method, debias) \
+    static inline void name(struct hb_pipeline *p, const uint64_t *deltas, size_t count, \
+                            struct hb_buffer *out) { \
+        for (size_t i = 0; i < count; i++) { \
+            filter_delta(p, deltas[i], out, method, debias, 0); \
+        } \
+    } \
+    HB_KERNEL_VOID(name, \
+                   (struct hb_pipeline *p, const uint64_t *deltas, size_t count, \
+                    struct hb_buffer *out), \
+                   (p, deltas, count, out))
+
+SPECIALISE(push_adaptive, HB_METHOD_ADAPTIVE, HB_DEBIAS_NONE);
+SPECIALISE(push_adaptive_vn, HB_METHOD_ADAPTIVE, HB_DEBIAS_VON_NEUMANN);
+SPECIALISE(push_interval, HB_METHOD_INTERVAL, HB_DEBIAS_NONE);
+SPECIALISE(push_interval_vn, HB_METHOD_INTERVAL, HB_DEBIAS_VON_NEUMANN);
+SPECIALISE(push_von_neumann, HB_METHOD_VON_NEUMANN, HB_DEBIAS_NONE);
+SPECIALISE(push_xor_fold, HB_METHOD_XOR_FOLD, HB_DEBIAS_NONE);
+SPECIALISE(push_lsb, HB_METHOD_LSB, HB_DEBIAS_NONE);
+SPECIALISE(push_lsb_vn, HB_METHOD_LSB, HB_DEBIAS_VON_NEUMANN);
+
+static const struct {
+    int method;
+    int debias;
+    const push_fn *variants;
+} specialised[] = {
+    { HB_METHOD_ADAPTIVE, HB_DEBIAS_NONE, push_adaptive_variants },
+    { HB_METHOD_ADAPTIVE, HB_DEBIAS_VON_NEUMANN, push_adaptive_vn_variants },
+    { HB_METHOD_INTERVAL, HB_DEBIAS_NONE, push_interval_variants },
+    { HB_METHOD_INTERVAL, HB_DEBIAS_VON_NEUMANN, push_interval_vn_variants },
+    { HB_METHOD_VON_NEUMANN, HB_DEBIAS_NONE, push_von_neumann_variants },
+    { HB_METHOD_XOR_FOLD, HB_DEBIAS_NONE, push_xor_fold_variants },
+    { HB_METHOD_LSB, HB_DEBIAS_NONE, push_lsb_variants },
+    { HB_METHOD_LSB, HB_DEBIAS_VON_NEUMANN, push_lsb_vn_variants },
+};
+
+// The specialised loop for p's configuration, or the generic one
+static push_fn push_loop(const struct hb_pipeline *p) {
+    const struct hb_pipeline_config *cfg = &p->cfg;
+    if (cfg->dead_time_ns == 0 && cfg->window_ns == 0) {
+        for (size_t i = 0; i < sizeof(specialised) / sizeof(specialised[0]); i++) {
+            if (specialised[i].method == cfg->method && specialised[i].debias == cfg->debias) {
+                return specialised[i].variants[hb_cpu_level()];
+            }
+        }
+    }
+    return HB_DISPATCH(push_deltas);
+}
+
+int hb_pipeline_push(struct hb_pipeline *p, const uint64_t *deltas, size_t count,
+                     struct hb_buffer *out) {
+    // Filter, extract and debias are fused per event, so they are timed
+    // together per chunk
+    HB_SCOPE(HB_STAGE_EXTRACT);
+    HB_COUNT(HB_STAGE_EXTRACT, count);
+    HB_TRACE2(extract_start, count, p->events_in);
+
+    // Worst case is phase at HB_PHASE_MAX_BITS per input value, otherwise
+    // xor_fold or quantile at 8, or the ordinal coder emitting up to 63 bits
+    // twice in one block
+    size_t per_value = p->cfg.method == HB_METHOD_PHASE ? (HB_PHASE_MAX_BITS + 7) / 8 : 1;
+    if (hb_buffer_reserve(out, count * per_value + 17) < 0) {
+        return -1;
+    }
+
+    push_loop(p)(p, deltas, count, out);
+    p->events_in += count;
+    HB_TRACE3(extract_done, count, p->bits_out, out->len);
+    return 0;
+}
+
+static int compare_values(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+int hb_pipeline_resume(struct hb_pipeline *p, uint64_t index, const uint64_t *prev,
+                       size_t nprev) {
+    const struct hb_pipeline_config *cfg = &p->cfg;
+    if (cfg->dead_time_ns > 0 || cfg->window_ns > 0) {
+        fprintf(stderr, "Only an unfiltered pipeline can resume mid-stream\n");
+        return -1;
+    }
+    size_t need = hb_pipeline_history(cfg);
+    uint64_t start = 0;
+    if (cfg->method == HB_METHOD_ORDINAL) {
+        need = (size_t)(index % ((uint64_t)cfg->order * HB_ORDINAL_FRAME));
+    }
+    if (cfg->method == HB_METHOD_QUANTILE) {
+        // From a rate window before the frames whose quantiles decide the
+        // current frame's k, or from the start
+        uint64_t frame = index - index % HB_QUANTILE_FRAME;
+        uint64_t back = HB_QUANTILE_CHECK * HB_QUANTILE_FRAME + (uint64_t)cfg->rate_window;
+        start = frame >= back ? frame - back : 0;
+        need = (size_t)(index - start);
+    }
+    if (cfg->method == HB_METHOD_PHASE) {
+        // From the start of the frame before, whose times decide the
+        // current frame's period and bits
+        uint64_t frame = index - index % HB_PHASE_FRAME;
+        start = frame >= HB_PHASE_FRAME ? frame - HB_PHASE_FRAME : 0;
+        need = (size_t)(index - start);
+    }
+    if (need > index) {
+        need = (size_t)index;
+    }
+    if (nprev < need) {
+        fprintf(stderr, "Resuming at value %lu needs the %zu values before it\n", index, need);
+        return -1;
+    }
+    prev += nprev - need;
+
+    // With now and last_out equal, each delta is passed on as the value
+    switch (cfg->method) {
+        case HB_METHOD_INTERVAL:
+        case HB_METHOD_VON_NEUMANN:
+            // Values pair up from index 0
+            p->have_prev = (int)(index & 1);
+            if (p->have_prev) {
+                p->prev = cfg->method == HB_METHOD_VON_NEUMANN ? prev[0] & 1 : prev[0];
+            }
+            break;
+        case HB_METHOD_XOR_FOLD:
+            p->have_prev = index > 0;
+            if (p->have_prev) {
+                p->prev = prev[0];
+            }
+            break;
+        case HB_METHOD_ADAPTIVE: {
+            size_t cap = 2 * p->half;
+            for (size_t i = 0; i < need; i++) {
+                p->ring[(index - need + i) % cap] = prev[i];
+            }
+            memcpy(p->sorted, prev, need * sizeof(uint64_t));
+            qsort(p->sorted, need, sizeof(uint64_t), compare_values);
+            p->sorted_len = need;
+            p->seen = index;
+            p->lo_idx = index - need;
+            p->next_emit = index >= p->half ? index - p->half + 1 : 0;
+            break;
+        }
+        case HB_METHOD_ORDINAL: {
+            // Replay the current frame; its bits were someone else's output
+            struct hb_buffer scratch;
+            hb_buffer_init(&scratch);
+            if (hb_buffer_reserve(&scratch, need + 17) < 0) {
+                return -1;
+            }
+            p->seen = index - need;
+            for (size_t i = 0; i < need; i++) {
+                extract_value(p, prev[i], &scratch, HB_METHOD_ORDINAL, HB_DEBIAS_NONE);
+            }
+            hb_buffer_free(&scratch);
+            p->cur = 0;
+            p->nbits = 0;
+            p->bits_out = 0;
+            p->blocks_tied = 0;
+            break;
+        }
+        case HB_METHOD_QUANTILE: {
+            // Past the start, the first rate window only refills the ring;
+            // the replay emits into scratch as for ordinal
+            struct hb_buffer scratch;
+            hb_buffer_init(&scratch);
+            if (hb_buffer_reserve(&scratch, need + 1) < 0) {
+                return -1;
+            }
+            p->seen = start;
+            size_t i = 0;
+            if (start > 0) {
+                for (; i < p->ring_cap; i++) {
+                    quantile_fill(p, prev[i], (size_t)(p->seen % p->ring_cap));
+                }
+            }
+            for (; i < need; i++) {
+                extract_value(p, prev[i], &scratch, HB_METHOD_QUANTILE, HB_DEBIAS_NONE);
+            }
+            hb_buffer_free(&scratch);
+            p->cur = 0;
+            p->nbits = 0;
+            p->bits_out = 0;
+            break;
+        }
+        case HB_METHOD_PHASE: {
+            struct hb_buffer scratch;
+            hb_buffer_init(&scratch);
+            if (hb_buffer_reserve(&scratch, need * ((HB_PHASE_MAX_BITS + 7) / 8) + 1) < 0) {
+                return -1;
+            }
+            // Past the start, the first value closes a frame that was never
+            // seen; an empty one gives no period and no bits
+            memset(p->ring, 0, p->ring_cap * sizeof(uint64_t));
+            p->seen = start;
+            for (size_t i = 0; i < need; i++) {
+                extract_value(p, prev[i], &scratch, HB_METHOD_PHASE, HB_DEBIAS_NONE);
+            }
+            hb_buffer_free(&scratch);
+            p->cur = 0;
+            p->nbits = 0;
+            p->bits_out = 0;
+            break;
+        }
+    }
+    return 0;
+}
+
+size_t hb_pipeline_history(const struct hb_pipeline_config *cfg) {
+    switch (cfg->method) {
+        case HB_METHOD_LSB:
+            return 0;
+        case HB_METHOD_ADAPTIVE:
+            return cfg->window > 1 ? 2 * (size_t)(cfg->window / 2) : 0;
+        case HB_METHOD_ORDINAL:
+            return cfg->order > 1 ? (size_t)cfg->order * HB_ORDINAL_FRAME - 1 : 0;
+        case HB_METHOD_QUANTILE:
+            return (HB_QUANTILE_CHECK + 1) * HB_QUANTILE_FRAME - 1 +
+                   (size_t)(cfg->rate_window > 0 ? cfg->rate_window : 0);
+        case HB_METHOD_PHASE:
+            return 2 * HB_PHASE_FRAME - 1;
+        default:
+            return 1;
+    }
+}
+
+// Filter-only loop: METHOD_VALUES in place of an extractor
+static void filter_values(struct hb_pipeline *p, const uint64_t *deltas, size_t count,
+                          struct hb_buffer *out) {
+    for (size_t i = 0; i < count; i++) {
+        filter_delta(p, deltas[i], out, METHOD_VALUES, HB_DEBIAS_NONE, 1);
+    }
+}
+
+int hb_pipeline_filter(struct hb_pipeline *p, const uint64_t *deltas, size_t count,
+                       struct hb_buffer *out) {
+    HB_SCOPE(HB_STAGE_FILTER);
+    HB_COUNT(HB_STAGE_FILTER, count);
+    if (hb_buffer_reserve(out, (count + 1) * sizeof(uint64_t)) < 0) {
+        return -1;
+    }
+    filter_values(p, deltas, count, out);
+    p->events_in += count;
+    return 0;
+}
+
+int hb_pipeline_filter_finish(struct hb_pipeline *p, struct hb_buffer *out) {
+    if (hb_buffer_reserve(out, sizeof(uint64_t)) < 0) {
+        return -1;
+    }
+    if (p->cfg.window_ns > 0 && p->win_count > 0) {
+        window_close(p, out, METHOD_VALUES, HB_DEBIAS_NONE);
+        p->win_count = 0;
+    }
+    return 0;
+}
+
+int hb_pipeline_drain(struct hb_pipeline *p, struct hb_buffer *out) {
+    if (hb_buffer_reserve(out, 2 * p->half + 10) < 0) {
+        return -1;
+    }
+
+    if (p->cfg.window_ns > 0 && p->win_count > 0) {
+        window_close(p, out, p->cfg.method, p->cfg.debias);
+        p->win_count = 0;
+    }
+
+    if (p->cfg.method == HB_METHOD_ADAPTIVE) {
+        size_t cap = 2 * p->half;
+        while (p->next_emit < p->seen) {
+            // Shrink the window from the left as it runs past the end
+            while (p->next_emit >= p->half && p->lo_idx < p->next_emit - p->half) {
+                sorted_remove(p, p->ring[p->lo_idx % cap]);
+                p->lo_idx++;
+            }
+            adaptive_emit(p, out, p->cfg.debias);
+        }
+    }
+
+    // A partial block has no ranking; drop it
+    if (p->cfg.method == HB_METHOD_ORDINAL) {
+        ordinal_flush(p, out, p->cfg.debias);
+    }
+    return 0;
+}
+
+int hb_pipeline_finish(struct hb_pipeline *p, struct hb_buffer *out) {
+    if (hb_pipeline_drain(p, out) < 0) {
+        return -1;
+    }
+
+    if (p->nbits > 0) {
+        out->data[out->len++] = (uint8_t)(p->cur << (8 - p->nbits));
+        p->cur = 0;
+        p->nbits = 0;
+    }
+    HB_TRACE2(extract_finish, p->events_in, p->bits_out);
+    return 0;
+}
+
+// Checkpoints are written field by field, little-endian and at fixed
+// widths, so the format depends on checkpoint_state below and not on the
+// struct's layout, padding or compiler. Bump the version whenever a field
+// is added to, removed from or moved in that list.
+#define CHECKPOINT_MAGIC 0x4B434248u   // "HBCK"
+#define CHECKPOINT_VERSION 5u
+
+// One routine both writes and reads each field, so the two directions
+// cannot disagree. The first failure sticks and later fields are skipped.
+struct checkpoint_io {
+    FILE *f;
+    int writing;
+    int failed;
+};
+
+static void checkpoint_u64(struct checkpoint_io *io, uint64_t *v) {
+    uint64_t le;
+    if (io->failed) {
+        return;
+    }
+    if (io->writing) {
+        le = htole64(*v);
+        io->failed = fwrite(&le, sizeof(le), 1, io->f) != 1;
+    } else {
+        io->failed = fread(&le, sizeof(le), 1, io->f) != 1;
+        *v = le64toh(le);
+    }
+}
+
+static void checkpoint_u32(struct checkpoint_io *io, uint32_t *v) {
+    uint32_t le;
+    if (io->failed) {
+        return;
+    }
+    if (io->writing) {
+        le = htole32(*v);
+        io->failed = fwrite(&le, sizeof(le), 1, io->f) != 1;
+    } else {
+        io->failed = fread(&le, sizeof(le), 1, io->f) != 1;
+        *v = le32toh(le);
+    }
+}
+
+static void checkpoint_int(struct checkpoint_io *io, int *v) {
+    uint64_t x = (uint64_t)(int64_t)*v;
+    checkpoint_u64(io, &x);
+    *v = (int)(int64_t)x;
+}
+
+static void checkpoint_size(struct checkpoint_io *io, size_t *v) {
+    uint64_t x = *v;
+    checkpoint_u64(io, &x);
+    *v = (size_t)x;
+}
+
+static void checkpoint_double(struct checkpoint_io *io, double *v) {
+    uint64_t x;
+    memcpy(&x, v, sizeof(x));
+    checkpoint_u64(io, &x);
+    memcpy(v, &x, sizeof(x));
+}
+
+static void checkpoint_config(struct checkpoint_io *io, struct hb_pipeline_config *c) {
+    checkpoint_u64(io, &c->dead_time_ns);
+    checkpoint_u64(io, &c->window_ns);
+    checkpoint_int(io, &c->window_mode);
+    checkpoint_int(io, &c->method);
+    checkpoint_int(io, &c->bit_pos);
+    checkpoint_int(io, &c->window);
+    checkpoint_int(io, &c->order);
+    checkpoint_int(io, &c->rate_window);
+    checkpoint_int(io, &c->debias);
+}
+
+// Everything a resumed pipeline needs, after its configuration. When
+// reading, p has been initialised for that configuration, which sizes the
+// ring and sorted arrays.
+static void checkpoint_state(struct checkpoint_io *io, struct hb_pipeline *p) {
+    checkpoint_u64(io, &p->now);
+    checkpoint_u64(io, &p->last_kept);
+    checkpoint_u64(io, &p->win_id);
+    checkpoint_u64(io, &p->win_first);
+    checkpoint_u64(io, &p->win_last);
+    checkpoint_u64(io, &p->win_sum);
+    checkpoint_u64(io, &p->win_count);
+    checkpoint_u64(io, &p->last_out);
+    checkpoint_int(io, &p->have_ref);
+
+    checkpoint_u64(io, &p->prev);
+    checkpoint_int(io, &p->have_prev);
+    size_t cap = p->ring_cap;
+    checkpoint_size(io, &cap);
+    if (cap != p->ring_cap) {
+        io->failed = 1;
+    }
+    checkpoint_size(io, &p->half);
+    checkpoint_size(io, &p->sorted_len);
+    checkpoint_u64(io, &p->seen);
+    checkpoint_u64(io, &p->lo_idx);
+    checkpoint_u64(io, &p->next_emit);
+    for (int i = 0; i < HB_ORDINAL_MAX; i++) {
+        checkpoint_u64(io, &p->block[i]);
+    }
+    checkpoint_u64(io, &p->code);
+    checkpoint_u64(io, &p->code_range);
+    checkpoint_u64(io, &p->blocks_tied);
+    checkpoint_u64(io, &p->rate_sum);
+    checkpoint_size(io, &p->min_head);
+    checkpoint_size(io, &p->min_len);
+    for (int f = 0; f < HB_QUANTILE_CHECK; f++) {
+        for (int q = 0; q < 1 << HB_QUANTILE_MAX_BITS; q++) {
+            checkpoint_u32(io, &p->quantiles[f][q]);
+        }
+    }
+    checkpoint_int(io, &p->quantile_bits);
+    checkpoint_u64(io, &p->phase_now);
+    checkpoint_u64(io, &p->phase_span);
+    checkpoint_double(io, &p->phase_period);
+    checkpoint_double(io, &p->phase_offset);
+    checkpoint_int(io, &p->phase_lo);
+    checkpoint_int(io, &p->phase_hi);
+
+    checkpoint_int(io, &p->pending);
+    uint64_t cur = p->cur;
+    checkpoint_u64(io, &cur);
+    p->cur = (uint8_t)cur;
+    checkpoint_int(io, &p->nbits);
+    checkpoint_u64(io, &p->events_in);
+    checkpoint_u64(io, &p->bits_out);
+
+    for (size_t i = 0; i < p->ring_cap; i++) {
+        checkpoint_u64(io, &p->ring[i]);
+    }
+    for (size_t i = 0; i < p->ring_cap; i++) {
+        checkpoint_u64(io, &p->sorted[i]);
+    }
+}
+
+static int config_equal(const struct hb_pipeline_config *a, const struct hb_pipeline_config *b) {
+    return a->dead_time_ns == b->dead_time_ns && a->window_ns == b->window_ns &&
+           a->window_mode == b->window_mode && a->method == b->method &&
+           a->bit_pos == b->bit_pos && a->window == b->window && a->order == b->order &&
+           a->rate_window == b->rate_window && a->debias == b->debias;
+}
+
+int hb_pipeline_save(const struct hb_pipeline *p, FILE *f) {
+    struct checkpoint_io io = { f, 1, 0 };
+    uint32_t magic = CHECKPOINT_MAGIC, version = CHECKPOINT_VERSION;
+    // Written through a shallow copy; ring and sorted are only read
+    struct hb_pipeline state = *p;
+
+    checkpoint_u32(&io, &magic);
+    checkpoint_u32(&io, &version);
+    checkpoint_config(&io, &state.cfg);
+    checkpoint_state(&io, &state);
+    if (io.failed) {
+        perror("checkpoint write");
+        return -1;
+    }
+    return 0;
+}
+
+int hb_pipeline_load(struct hb_pipeline *p, const struct hb_pipeline_config *cfg, FILE *f) {
+    struct checkpoint_io io = { f, 0, 0 };
+    uint32_t magic = 0, version = 0;
+    struct hb_pipeline_config saved;
+
+    checkpoint_u32(&io, &magic);
+    checkpoint_u32(&io, &version);
+    if (io.failed || magic != CHECKPOINT_MAGIC || version != CHECKPOINT_VERSION) {
+        return -1;
+    }
+    checkpoint_config(&io, &saved);
+    if (io.failed || !config_equal(&saved, cfg)) {
+        return -1;
+    }
+
+    if (hb_pipeline_init(p, cfg) < 0) {
+        return -1;
+    }
+    checkpoint_state(&io, p);
+    if (io.failed) {
+        hb_pipeline_free(p);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,203 @@
+#ifndef HOTBITS_PIPELINE_H
+#define HOTBITS_PIPELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "alloc.h"
+#include "periodogram.h"
+
+// Extraction methods. 0-3 keep the numbering of rng-extractor -m.
+enum hb_method {
+    HB_METHOD_INTERVAL = 0,     // intervals[i] > intervals[i+1], per pair
+    HB_METHOD_VON_NEUMANN = 1,  // Von Neumann over value LSBs
+    HB_METHOD_XOR_FOLD = 2,     // low byte of values[i] ^ values[i+1]
+    HB_METHOD_LSB = 3,          // bit bit_pos of each value
+    HB_METHOD_ADAPTIVE = 4,     // extract.py adaptive_threshold (median window)
+    HB_METHOD_ORDINAL = 5,      // rank order of each block of order values
+    HB_METHOD_QUANTILE = 6,     // top bits of each value's fitted exponential CDF
+    HB_METHOD_PHASE = 7         // event time's residual against the dominant period
+};
+
+// HB_METHOD_ORDINAL: for exchangeable values every ranking of a block of k
+// is equally likely, so its Lehmer index is uniform on [0, k!). The indices
+// are combined by an exact arithmetic coder into unbiased bits, close to
+// log2(k!) per block (interval is the k = 2 case at one bit per pair).
+// Blocks with equal values are dropped. The coder is flushed every
+// HB_ORDINAL_FRAME blocks, which bounds the state a parallel chunk has to
+// rebuild.
+#define HB_ORDINAL_MAX 12       // 12! < 2^29
+#define HB_ORDINAL_FRAME 64
+
+// HB_METHOD_QUANTILE: each value is mapped through the predictive CDF of
+// a shifted exponential fitted to the rate_window values before it (the
+// window's minimum and mean), which is uniform for a Poisson source with
+// dead time, and the top k bits of the result are emitted.
+// k (0 to HB_QUANTILE_MAX_BITS) is chosen per frame of HB_QUANTILE_FRAME
+// values by a chi-square check of the quantiles of the HB_QUANTILE_CHECK
+// frames before it at every resolution up to k; nothing is emitted before
+// the first frame ends.
+#define HB_QUANTILE_MAX_BITS 8
+#define HB_QUANTILE_FRAME 8192
+#define HB_QUANTILE_CHECK 8
+
+// HB_METHOD_PHASE: the event times are cut into frames of HB_PHASE_FRAME
+// values. At the end of each frame a periodogram of its times looks for a
+// dominant period between HB_PHASE_BAND_LO and HB_PHASE_BAND_HI Hz, with
+// bins sized for the band up to HB_PHASE_MAX_BINS, and each event of the
+// next frame emits bits of its residual against that period. A frame with
+// no period significant at HB_PHASE_ALPHA emits nothing: the raw time's low
+// bits would only measure the clock. The window starts below the residuals'
+// standard deviation, where the phase no longer carries the modulation, and
+// extends down at most HB_PHASE_MAX_BITS, through bits whose 8-bit fields of
+// the last frame's residuals, and of their differences between consecutive
+// events, pass a chi-square check at every resolution: it ends above the
+// clock's quantisation. Nothing is emitted in the first frame.
+#define HB_PHASE_FRAME 32768
+#define HB_PHASE_BAND_LO 1.0
+#define HB_PHASE_BAND_HI 250.0
+#define HB_PHASE_MAX_BINS (1 << 22)
+#define HB_PHASE_ALPHA 1e-3
+#define HB_PHASE_MAX_BITS 12
+
+enum hb_debias {
+    HB_DEBIAS_NONE = 0,
+    HB_DEBIAS_VON_NEUMANN = 1
+};
+
+struct hb_pipeline_config {
+    uint64_t dead_time_ns;   // filter -d: drop events closer than this
+    uint64_t window_ns;      // filter -w: aggregate events per time window
+    int window_mode;         // filter -m: 0 first, 1 last, 2 mean
+    int method;              // enum hb_method
+    int bit_pos;             // bit position for HB_METHOD_LSB
+    int window;              // sample window for HB_METHOD_ADAPTIVE
+    int order;               // block length for HB_METHOD_ORDINAL, 2 to HB_ORDINAL_MAX
+    int rate_window;         // values the HB_METHOD_QUANTILE rate is fitted to
+    int debias;              // enum hb_debias applied to extracted bits
+};
+
+// Defaults reproduce `python3 extract.py` with no arguments, which is what
+// scripts/hot.sh runs.
+void hb_pipeline_config_default(struct hb_pipeline_config *cfg);
+int hb_method_parse(const char *name);
+const char *hb_method_name(int method);
+int hb_debias_parse(const char *name);
+const char *hb_debias_name(int debias);
+
+struct hb_buffer {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+    const struct hb_allocator *alloc;
+};
+
+void hb_buffer_init(struct hb_buffer *buf);
+void hb_buffer_init_alloc(struct hb_buffer *buf, const struct hb_allocator *alloc);
+void hb_buffer_free(struct hb_buffer *buf);
+int hb_buffer_reserve(struct hb_buffer *buf, size_t extra);
+
+// Streaming filter -> extract -> debias -> pack chain. Input is the delta
+// stream trng writes; output is packed MSB-first bytes. Feeding a stream in
+// any number of push() calls yields the same bytes as one call.
+struct hb_pipeline {
+    struct hb_pipeline_config cfg;
+
+    // Filter stage: absolute time rebuilt from deltas, starting at 0
+    uint64_t now;
+    uint64_t last_kept;
+    uint64_t win_id;
+    uint64_t win_first;
+    uint64_t win_last;
+    uint64_t win_sum;
+    uint64_t win_count;
+    uint64_t last_out;
+    int have_ref;            // last_out holds an emitted timestamp
+
+    // Extract stage
+    uint64_t prev;
+    int have_prev;
+    uint64_t *ring;          // last 2*half values (adaptive), or rate_window (quantile);
+                             // phase: the frame's times since it began
+    uint64_t *sorted;        // current median window, ascending; quantile: the
+                             // indices of the window's ascending minima; phase:
+                             // residuals of the frame for the bit check
+    size_t ring_cap;         // values allocated for ring and for sorted
+    size_t half;
+    size_t sorted_len;
+    uint64_t seen;           // values received by the extractor
+    uint64_t lo_idx;         // oldest value index held in sorted
+    uint64_t next_emit;      // next value index to emit a bit for
+    uint64_t block[HB_ORDINAL_MAX];  // current ordinal block (seen % order of them)
+    uint64_t code;           // ordinal coder: uniform on [0, code_range)
+    uint64_t code_range;
+    uint64_t blocks_tied;    // ordinal blocks dropped for equal values
+    uint64_t rate_sum;       // quantile: sum of the ring
+    size_t min_head;         // quantile: ring positions of the minima, a deque of
+    size_t min_len;          // min_len in sorted from min_head, wrapping
+    // Finest quantiles of the last HB_QUANTILE_CHECK frames, by frame number
+    uint32_t quantiles[HB_QUANTILE_CHECK][1 << HB_QUANTILE_MAX_BITS];
+    int quantile_bits;       // k for the current frame
+    struct hb_periodogram periodogram;  // phase: scratch for the period search
+    uint64_t phase_now;      // phase: time since the current frame began
+    uint64_t phase_span;     // phase: length of the previous frame
+    double phase_period;     // phase: previous frame's period in ns, 0 for none
+    double phase_offset;     // phase: its time of peak event density
+    int phase_lo;            // phase: residual bits [phase_lo, phase_hi) are
+    int phase_hi;            // emitted, MSB first
+
+    // Debias stage: -1 when no bit is waiting for its pair
+    int pending;
+
+    // Pack stage
+    uint8_t cur;
+    int nbits;
+
+    uint64_t events_in;
+    uint64_t bits_out;
+
+    const struct hb_allocator *alloc;
+};
+
+int hb_pipeline_init(struct hb_pipeline *p, const struct hb_pipeline_config *cfg);
+// alloc must outlive the pipeline
+int hb_pipeline_init_alloc(struct hb_pipeline *p, const struct hb_pipeline_config *cfg,
+                           const struct hb_allocator *alloc);
+void hb_pipeline_free(struct hb_pipeline *p);
+int hb_pipeline_push(struct hb_pipeline *p, const uint64_t *deltas, size_t count,
+                     struct hb_buffer *out);
+// Flush values held for lookahead and the final partial byte (zero padded,
+// like np.packbits and rng-extractor).
+int hb_pipeline_finish(struct hb_pipeline *p, struct hb_buffer *out);
+
+// The pieces parallel.c builds hb_pipeline_finish and a mid-stream start
+// from. drain is finish without padding the final partial byte, which stays
+// in cur/nbits.
+int hb_pipeline_drain(struct hb_pipeline *p, struct hb_buffer *out);
+// Continue a freshly initialised, unfiltered pipeline at extractor value
+// index as if every earlier value had been pushed, given the nprev values
+// just before it (at most hb_pipeline_history of them; fewer near the
+// start). Debias pairing and packing start afresh.
+int hb_pipeline_resume(struct hb_pipeline *p, uint64_t index, const uint64_t *prev,
+                       size_t nprev);
+// Values before a resume point that hb_pipeline_resume may need: the median
+// window for adaptive, the current ordinal frame, the rate window and
+// HB_QUANTILE_CHECK + 1 frames for quantile, two frames for phase, one for
+// the pairwise methods
+size_t hb_pipeline_history(const struct hb_pipeline_config *cfg);
+// Run only the dead-time and window filters, appending the values the
+// extractor would be given to out as native uint64_t. filter_finish closes
+// the last aggregation window.
+int hb_pipeline_filter(struct hb_pipeline *p, const uint64_t *deltas, size_t count,
+                       struct hb_buffer *out);
+int hb_pipeline_filter_finish(struct hb_pipeline *p, struct hb_buffer *out);
+
+// Checkpoint the complete stage state (filter, lookahead window, pending
+// debias bit, partial byte) in a fixed little-endian format. Loading
+// requires the same configuration and format version; a mismatch returns
+// -1 so callers can fall back to a full rebuild.
+int hb_pipeline_save(const struct hb_pipeline *p, FILE *f);
+int hb_pipeline_load(struct hb_pipeline *p, const struct hb_pipeline_config *cfg, FILE *f);
+
+#endif
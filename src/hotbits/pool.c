@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+struct task {
+    hb_task_fn fn;
+    void *arg;
+    struct task *next;
+};
+
+struct queue {
+    pthread_mutex_t lock;
+    struct task *head;
+    struct task *tail;
+};
+
+struct worker {
+    struct hb_pool *pool;
+    int id;
+};
+
+struct hb_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t idle;
+    int queued;         // tasks sitting in any queue
+    int pending;        // queued plus running tasks
+    int stopping;
+    int nthreads;       // workers running
+    int nqueues;
+    unsigned next;      // round-robin target for outside submissions
+    struct queue *queues;
+    struct worker *workers;
+    pthread_t *threads;
+};
+
+// Worker the calling thread belongs to, so nested submissions stay local
+static __thread struct worker *current;
+
+static void queue_push(struct queue *q, struct task *t) {
+    pthread_mutex_lock(&q->lock);
+    if (q->tail) {
+        q->tail->next = t;
+    } else {
+        q->head = t;
+    }
+    q->tail = t;
+    pthread_mutex_unlock(&q->lock);
+}
+
+static struct task *queue_pop(struct queue *q) {
+    pthread_mutex_lock(&q->lock);
+    struct task *t = q->head;
+    if (t) {
+        q->head = t->next;
+        if (!q->head) {
+            q->tail = NULL;
+        }
+    }
+    pthread_mutex_unlock(&q->lock);
+    return t;
+}
+
+// Own queue first, then the other workers' in order from the next one
+static struct task *find_task(struct hb_pool *pool, int id) {
+    for (int i = 0; i < pool->nthreads; i++) {
+        struct task *t = queue_pop(&pool->queues[(id + i) % pool->nthreads]);
+        if (t) {
+            __atomic_sub_fetch(&pool->queued, 1, __ATOMIC_RELAXED);
+            return t;
+        }
+    }
+    return NULL;
+}
+
+static void *worker(void *arg) {
+    struct worker *w = arg;
+    struct hb_pool *pool = w->pool;
+    current = w;
+
+    // Wait for hb_pool_create to settle nthreads
+    pthread_mutex_lock(&pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (;;) {
+        struct task *t = find_task(pool, w->id);
+        if (!t) {
+            // Submitters count the task under the lock after queueing it,
+            // so checking here cannot miss a wakeup
+            pthread_mutex_lock(&pool->lock);
+            while (__atomic_load_n(&pool->queued, __ATOMIC_RELAXED) == 0 && !pool->stopping) {
+                pthread_cond_wait(&pool->work, &pool->lock);
+            }
+            int stop = pool->stopping && __atomic_load_n(&pool->queued, __ATOMIC_RELAXED) == 0;
+            pthread_mutex_unlock(&pool->lock);
+            if (stop) {
+                break;
+            }
+            continue;
+        }
+
+        t->fn(t->arg);
+        free(t);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) {
+            pthread_cond_broadcast(&pool->idle);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+struct hb_pool *hb_pool_create(int nthreads) {
+    if (nthreads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = cpus > 0 ? (int)cpus : 1;
+    }
+
+    struct hb_pool *pool = calloc(1, sizeof(*pool));
+    if (!pool) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return NULL;
+    }
+    pool->threads = calloc(nthreads, sizeof(pthread_t));
+    pool->queues = calloc(nthreads, sizeof(struct queue));
+    pool->workers = calloc(nthreads, sizeof(struct worker));
+    if (!pool->threads || !pool->queues || !pool->workers) {
+        fprintf(stderr, "Memory allocation failed\n");
+        free(pool->threads);
+        free(pool->queues);
+        free(pool->workers);
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+    pool->nqueues = nthreads;
+    for (int i = 0; i < nthreads; i++) {
+        pthread_mutex_init(&pool->queues[i].lock, NULL);
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    for (int i = 0; i < nthreads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, worker, &pool->workers[i]) != 0) {
+            perror("pthread_create");
+            break;
+        }
+        pool->nthreads++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (pool->nthreads == 0) {
+        hb_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+int hb_pool_submit(struct hb_pool *pool, hb_task_fn fn, void *arg) {
+    struct task *t = malloc(sizeof(*t));
+    if (!t) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+    t->fn = fn;
+    t->arg = arg;
+    t->next = NULL;
+
+    int target;
+    if (current && current->pool == pool) {
+        target = current->id;
+    } else {
+        target = (int)(__atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED) % pool->nthreads);
+    }
+    queue_push(&pool->queues[target], t);
+
+    pthread_mutex_lock(&pool->lock);
+    __atomic_add_fetch(&pool->queued, 1, __ATOMIC_RELAXED);
+    pool->pending++;
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+void hb_pool_wait(struct hb_pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void hb_pool_destroy(struct hb_pool *pool) {
+    if (!pool) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->nthreads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->idle);
+    for (int i = 0; i < pool->nqueues; i++) {
+        pthread_mutex_destroy(&pool->queues[i].lock);
+    }
+    free(pool->queues);
+    free(pool->workers);
+    free(pool->threads);
+    free(pool);
+}
+
+int hb_pool_threads(const struct hb_pool *pool) {
+    return pool->nthreads;
+}
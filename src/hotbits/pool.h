@@ -0,0 +1,21 @@
+#ifndef HOTBITS_POOL_H
+#define HOTBITS_POOL_H
+
+// Fixed-size thread pool with work stealing. Each worker has its own task
+// queue: tasks submitted from a worker go to that worker's queue, others
+// are spread round-robin. Workers run their own queue oldest first and,
+// when it is empty, steal the oldest task from another worker, so a few
+// long tasks do not leave the rest of the pool idle behind them.
+typedef void (*hb_task_fn)(void *arg);
+
+struct hb_pool;
+
+// nthreads <= 0 uses one thread per online CPU
+struct hb_pool *hb_pool_create(int nthreads);
+int hb_pool_submit(struct hb_pool *pool, hb_task_fn fn, void *arg);
+// Block until every submitted task has finished
+void hb_pool_wait(struct hb_pool *pool);
+void hb_pool_destroy(struct hb_pool *pool);
+int hb_pool_threads(const struct hb_pool *pool);
+
+#endif
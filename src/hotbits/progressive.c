@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cpu.h"
+#include "progressive.h"
+
+#define PAIR_VALUES 65536
+#define MIN_EXPECTED 5.0      // chi-square needs about 5 expected per cell
+
+int hb_progressive_init(struct hb_progressive *p) {
+    memset(p, 0, sizeof(*p));
+    p->pair_counts = calloc(PAIR_VALUES, sizeof(uint64_t));
+    if (!p->pair_counts) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+
+    for (int b = 0; b < 256; b++) {
+        int walk = 0, max = -8, min = 8;
+        int run = 0, inner = 0, lead = 0;
+        for (int k = 7; k >= 0; k--) {
+            int bit = (b >> k) & 1;
+            walk += bit ? 1 : -1;
+            if (walk > max) max = walk;
+            if (walk < min) min = walk;
+
+            run = k < 7 && bit == ((b >> (k + 1)) & 1) ? run + 1 : 1;
+            if (run > inner) inner = run;
+            if (run == 8 - k) lead = run;
+        }
+        p->prefix_max[b] = (int8_t)max;
+        p->prefix_min[b] = (int8_t)min;
+        p->lead_run[b] = (uint8_t)lead;
+        p->trail_run[b] = (uint8_t)run;
+        p->inner_run[b] = (uint8_t)inner;
+    }
+    return 0;
+}
+
+void hb_progressive_free(struct hb_progressive *p) {
+    free(p->pair_counts);
+    p->pair_counts = NULL;
+}
+
+static inline void progressive_update(struct hb_progressive *p, const uint8_t *data,
+                                      size_t len) {
+    uint64_t offset = p->sums.bytes;
+
+    for (size_t i = 0; i < len; i++) {
+        uint8_t b = data[i];
+
+        if ((offset + i) & 1) {
+            p->pair_counts[(unsigned)p->pair_first << 8 | b]++;
+        } else {
+            p->pair_first = b;
+        }
+
+        // Extremes of the walk inside this byte
+        int64_t hi = p->walk + p->prefix_max[b];
+        int64_t lo = p->walk + p->prefix_min[b];
+        if (hi > 0 && (uint64_t)hi > p->walk_max) p->walk_max = hi;
+        if (lo < 0 && (uint64_t)-lo > p->walk_max) p->walk_max = -lo;
+        p->walk += 2 * __builtin_popcount(b) - 8;
+
+        // Runs continue across byte boundaries through lead/trail lengths
+        int msb = b >> 7;
+        if (offset + i == 0 || msb != p->run_bit) {
+            p->run_len = 0;
+        }
+        p->run_len += p->lead_run[b];
+        if (p->run_len > p->longest) p->longest = p->run_len;
+        if (p->lead_run[b] == 8) {
+            p->run_bit = msb;
+            continue;
+        }
+        if (p->inner_run[b] > p->longest) p->longest = p->inner_run[b];
+        p->run_len = p->trail_run[b];
+        p->run_bit = b & 1;
+    }
+
+    hb_quick_update(&p->sums, data, len);
+}
+
+HB_KERNEL_VOID(progressive_update, (struct hb_progressive *p, const uint8_t *data, size_t len),
+               (p, data, len));
+
+void hb_progressive_update(struct hb_progressive *p, const uint8_t *data, size_t len) {
+    HB_DISPATCH(progressive_update)(p, data, len);
+}
+
+static double normal_cdf(double x) {
+    return 0.5 * erfc(-x / sqrt(2.0));
+}
+
+// NIST SP 800-22 2.13 (forward mode); terms beyond ~10 sigma are zero, so
+// the sums are clipped there instead of running over n/z terms
+static double cumulative_sums_p(double n, double z) {
+    double sqrt_n = sqrt(n);
+    double limit = 10.0 * sqrt_n / (4.0 * z) + 1.0;
+
+    double lo = (-n / z + 1.0) / 4.0, hi = (n / z - 1.0) / 4.0;
+    if (lo < -limit) lo = -limit;
+    if (hi > limit) hi = limit;
+    double sum1 = 0.0;
+    for (long k = (long)lo; k <= (long)hi; k++) {
+        sum1 += normal_cdf((4 * k + 1) * z / sqrt_n) - normal_cdf((4 * k - 1) * z / sqrt_n);
+    }
+
+    lo = (-n / z - 3.0) / 4.0;
+    if (lo < -limit) lo = -limit;
+    double sum2 = 0.0;
+    for (long k = (long)lo; k <= (long)hi; k++) {
+        sum2 += normal_cdf((4 * k + 3) * z / sqrt_n) - normal_cdf((4 * k + 1) * z / sqrt_n);
+    }
+
+    double p = 1.0 - sum1 + sum2;
+    return p < 0.0 ? 0.0 : (p > 1.0 ? 1.0 : p);
+}
+
+void hb_progressive_results(const struct hb_progressive *p,
+                            struct hb_test_result results[HB_PROGRESSIVE_TESTS]) {
+    const struct hb_quick_sums *s = &p->sums;
+    double n = (double)s->bytes * 8.0;
+
+    hb_quick_results(s, results);
+
+    results[HB_PROG_BYTE_PAIRS].name = "byte_pairs";
+    results[HB_PROG_BIT_POSITION].name = "bit_position";
+    results[HB_PROG_CUMULATIVE_SUMS].name = "cumulative_sums";
+    results[HB_PROG_LONGEST_RUN].name = "longest_run";
+    for (int t = HB_QUICK_TESTS; t < HB_PROGRESSIVE_TESTS; t++) {
+        results[t].statistic = 0.0;
+        results[t].p_value = NAN;
+    }
+    if (s->bytes == 0) {
+        return;
+    }
+
+    // Non-overlapping byte pairs, 65535 degrees of freedom
+    double pairs = (double)(s->bytes / 2);
+    double expected = pairs / PAIR_VALUES;
+    if (expected >= MIN_EXPECTED) {
+        double chi = 0.0;
+        for (int v = 0; v < PAIR_VALUES; v++) {
+            double diff = p->pair_counts[v] - expected;
+            chi += diff * diff / expected;
+        }
+        results[HB_PROG_BYTE_PAIRS].statistic = chi;
+        results[HB_PROG_BYTE_PAIRS].p_value = hb_igamc((PAIR_VALUES - 1) / 2.0, chi / 2.0);
+    }
+
+    // Ones per bit position of the byte, 8 degrees of freedom
+    double bytes = (double)s->bytes;
+    double chi = 0.0;
+    for (int k = 0; k < 8; k++) {
+        uint64_t ones = 0;
+        for (int b = 0; b < 256; b++) {
+            if (b & (1 << k)) {
+                ones += s->byte_counts[b];
+            }
+        }
+        double diff = 2.0 * ones - bytes;
+        chi += diff * diff / bytes;
+    }
+    results[HB_PROG_BIT_POSITION].statistic = chi;
+    results[HB_PROG_BIT_POSITION].p_value = hb_igamc(4.0, chi / 2.0);
+
+    // Cumulative sums: largest excursion of the walk
+    double z = (double)p->walk_max;
+    results[HB_PROG_CUMULATIVE_SUMS].statistic = z;
+    results[HB_PROG_CUMULATIVE_SUMS].p_value = z > 0.0 ? cumulative_sums_p(n, z) : 0.0;
+
+    // Longest run of identical bits; runs of length >= L start at a given
+    // bit with probability 2^-L, so their count is about Poisson(n / 2^L)
+    uint64_t longest = p->longest;
+    double too_long = -expm1(-n * ldexp(1.0, -(int)longest));
+    double too_short = exp(-n * ldexp(1.0, -(int)longest - 1));
+    double tail = too_long < too_short ? too_long : too_short;
+    results[HB_PROG_LONGEST_RUN].statistic = (double)longest;
+    results[HB_PROG_LONGEST_RUN].p_value = tail * 2.0 > 1.0 ? 1.0 : tail * 2.0;
+}
+
+enum hb_grade hb_progressive_grade(int test, double p_value) {
+    if (isnan(p_value)) {
+        return HB_GRADE_NORMAL;
+    }
+
+    int chi_square = test == HB_TEST_BLOCK_FREQUENCY || test == HB_TEST_BYTE_CHI_SQUARE ||
+                     test == HB_PROG_BYTE_PAIRS || test == HB_PROG_BIT_POSITION;
+    double tail = chi_square && 1.0 - p_value < p_value ? 1.0 - p_value : p_value;
+
+    if (tail < 1e-12) return HB_GRADE_FAIL;
+    if (tail < 1e-8) return HB_GRADE_VERY_SUSPICIOUS;
+    if (tail < 1e-5) return HB_GRADE_SUSPICIOUS;
+    if (tail < 1e-3) return HB_GRADE_UNUSUAL;
+    return HB_GRADE_NORMAL;
+}
+
+const char *hb_grade_name(enum hb_grade grade) {
+    switch (grade) {
+        case HB_GRADE_UNUSUAL: return "unusual";
+        case HB_GRADE_SUSPICIOUS: return "suspicious";
+        case HB_GRADE_VERY_SUSPICIOUS: return "VERY SUSPICIOUS";
+        case HB_GRADE_FAIL: return "FAIL";
+        default: return "normal";
+    }
+}
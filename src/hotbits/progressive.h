@@ -0,0 +1,61 @@
+#ifndef HOTBITS_PROGRESSIVE_H
+#define HOTBITS_PROGRESSIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "quicktest.h"
+
+// Cumulative test state for progressive testing (PractRand style): the
+// stream is fed once, and the battery can be evaluated at any length from
+// retained sums and counters, never by rescanning. On top of the quicktest
+// battery it keeps non-overlapping byte pair counts, per-bit-position
+// counts (derived from the byte counts), the NIST cumulative sums walk and
+// the longest run of identical bits.
+enum {
+    HB_PROG_BYTE_PAIRS = HB_QUICK_TESTS,
+    HB_PROG_BIT_POSITION,
+    HB_PROG_CUMULATIVE_SUMS,
+    HB_PROG_LONGEST_RUN,
+    HB_PROGRESSIVE_TESTS
+};
+
+// Evaluation grades, with PractRand's names and roughly its thresholds
+enum hb_grade {
+    HB_GRADE_NORMAL,
+    HB_GRADE_UNUSUAL,           // p < 1e-3
+    HB_GRADE_SUSPICIOUS,        // p < 1e-5
+    HB_GRADE_VERY_SUSPICIOUS,   // p < 1e-8
+    HB_GRADE_FAIL               // p < 1e-12
+};
+
+struct hb_progressive {
+    struct hb_quick_sums sums;
+    uint64_t *pair_counts;      // 65536 counters
+    uint8_t pair_first;
+    int64_t walk;               // +1/-1 random walk over all bits
+    uint64_t walk_max;          // max |walk| so far
+    int run_bit;
+    uint64_t run_len;
+    uint64_t longest;
+    // Per-byte lookup tables (MSB first)
+    int8_t prefix_max[256];
+    int8_t prefix_min[256];
+    uint8_t lead_run[256];
+    uint8_t trail_run[256];
+    uint8_t inner_run[256];
+};
+
+int hb_progressive_init(struct hb_progressive *p);
+void hb_progressive_free(struct hb_progressive *p);
+void hb_progressive_update(struct hb_progressive *p, const uint8_t *data, size_t len);
+
+// Tests without enough data yet report a NAN p-value
+void hb_progressive_results(const struct hb_progressive *p,
+                            struct hb_test_result results[HB_PROGRESSIVE_TESTS]);
+
+// Chi-square tests also flag p-values too close to 1 (suspiciously even)
+enum hb_grade hb_progressive_grade(int test, double p_value);
+const char *hb_grade_name(enum hb_grade grade);
+
+#endif
@@ -0,0 +1,569 @@
+// _hotbits - CPython extension over the native kernels
+//
+// Arrays come in through the buffer protocol (NumPy arrays, bytes,
+// memoryviews) and are read in place; results are written into a bytearray
+// allocated up front, which src/analysis/hotbits_native.py wraps with
+// np.frombuffer, so neither direction copies. The GIL is released while a
+// kernel runs. Each kernel reproduces the Python loop it replaces exactly,
+// including its edge cases.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "quicktest.h"
+
+enum elem_type { T_F64, T_F32, T_I8, T_U8, T_I16, T_U16, T_I32, T_U32, T_I64, T_U64 };
+
+struct array {
+    Py_buffer view;
+    enum elem_type type;
+    size_t len;
+};
+
+// Acquire a C-contiguous one-dimensional buffer of a numeric type
+static int array_get(PyObject *obj, struct array *a, const char *what) {
+    if (PyObject_GetBuffer(obj, &a->view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0) {
+        return -1;
+    }
+
+    const char *fmt = a->view.format ? a->view.format : "B";
+    if (*fmt == '@' || *fmt == '=' || *fmt == '<') {
+        fmt++;
+    }
+    Py_ssize_t size = a->view.itemsize;
+    int ok = fmt[0] != '\0' && fmt[1] == '\0';
+    switch (ok ? fmt[0] : 0) {
+        case 'd': a->type = T_F64; ok = size == 8; break;
+        case 'f': a->type = T_F32; ok = size == 4; break;
+        case 'b': a->type = T_I8; break;
+        case 'B': case '?': case 'c': a->type = T_U8; break;
+        case 'h': a->type = T_I16; break;
+        case 'H': a->type = T_U16; break;
+        case 'i': case 'l': case 'q':
+            a->type = size == 8 ? T_I64 : T_I32; ok = size == 4 || size == 8; break;
+        case 'I': case 'L': case 'Q':
+            a->type = size == 8 ? T_U64 : T_U32; ok = size == 4 || size == 8; break;
+        default: ok = 0;
+    }
+    if (!ok || a->view.ndim > 1) {
+        PyErr_Format(PyExc_TypeError, "%s must be a one-dimensional numeric array", what);
+        PyBuffer_Release(&a->view);
+        return -1;
+    }
+    a->len = (size_t)(a->view.len / size);
+    return 0;
+}
+
+static inline double get_f64(const struct array *a, size_t i) {
+    const void *p = a->view.buf;
+    switch (a->type) {
+        case T_F64: return ((const double *)p)[i];
+        case T_F32: return ((const float *)p)[i];
+        case T_I8:  return ((const int8_t *)p)[i];
+        case T_U8:  return ((const uint8_t *)p)[i];
+        case T_I16: return ((const int16_t *)p)[i];
+        case T_U16: return ((const uint16_t *)p)[i];
+        case T_I32: return ((const int32_t *)p)[i];
+        case T_U32: return ((const uint32_t *)p)[i];
+        case T_I64: return (double)((const int64_t *)p)[i];
+        default:    return (double)((const uint64_t *)p)[i];
+    }
+}
+
+// int(value) in Python: integers as they are, floats truncated toward zero
+static inline int64_t get_i64(const struct array *a, size_t i) {
+    const void *p = a->view.buf;
+    double d;
+    switch (a->type) {
+        case T_F64: d = ((const double *)p)[i]; break;
+        case T_F32: d = ((const float *)p)[i]; break;
+        case T_U64: return (int64_t)((const uint64_t *)p)[i];
+        case T_I64: return ((const int64_t *)p)[i];
+        default: return (int64_t)get_f64(a, i);
+    }
+    if (!(d > -9.2e18 && d < 9.2e18)) {
+        return d > 0 ? INT64_MAX : INT64_MIN;
+    }
+    return (int64_t)d;
+}
+
+static inline int get_bit(const struct array *a, size_t i) {
+    return a->type == T_U8 ? ((const uint8_t *)a->view.buf)[i] != 0 : get_f64(a, i) != 0.0;
+}
+
+// bytearray of n bytes written by the kernel, shrunk to *used afterwards
+static PyObject *output_new(size_t n, uint8_t **data) {
+    PyObject *out = PyByteArray_FromStringAndSize(NULL, (Py_ssize_t)n);
+    if (out) {
+        *data = (uint8_t *)PyByteArray_AS_STRING(out);
+    }
+    return out;
+}
+
+static PyObject *output_finish(PyObject *out, size_t used) {
+    if (PyByteArray_Resize(out, (Py_ssize_t)used) < 0) {
+        Py_DECREF(out);
+        return NULL;
+    }
+    return out;
+}
+
+// Sorted window for the adaptive threshold
+static void sorted_insert(double *s, size_t *len, double v) {
+    size_t lo = 0, hi = *len;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (s[mid] < v) lo = mid + 1; else hi = mid;
+    }
+    memmove(s + lo + 1, s + lo, (*len - lo) * sizeof(double));
+    s[lo] = v;
+    (*len)++;
+}
+
+static void sorted_remove(double *s, size_t *len, double v) {
+    size_t lo = 0, hi = *len;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (s[mid] < v) lo = mid + 1; else hi = mid;
+    }
+    memmove(s + lo, s + lo + 1, (*len - lo - 1) * sizeof(double));
+    (*len)--;
+}
+
+// BitExtractor._adaptive_threshold / adaptive_bit_extraction: data[i] above
+// the median of data[i - window//2 : i + window//2], emitted only when that
+// slice holds at least min_len values
+static PyObject *py_adaptive_threshold(PyObject *self, PyObject *args) {
+    PyObject *obj;
+    Py_ssize_t window, min_len = 2;
+    if (!PyArg_ParseTuple(args, "On|n", &obj, &window, &min_len)) {
+        return NULL;
+    }
+    if (window < 0) {
+        PyErr_SetString(PyExc_ValueError, "window must not be negative");
+        return NULL;
+    }
+
+    struct array a;
+    if (array_get(obj, &a, "data") < 0) {
+        return NULL;
+    }
+    size_t n = a.len, half = (size_t)window / 2;
+    uint8_t *bits;
+    PyObject *out = output_new(n, &bits);
+    double *sorted = PyMem_RawMalloc((2 * half + 1) * sizeof(double));
+    if (!out || !sorted) {
+        Py_XDECREF(out);
+        PyMem_RawFree(sorted);
+        PyBuffer_Release(&a.view);
+        return out ? PyErr_NoMemory() : NULL;
+    }
+
+    size_t used = 0;
+    Py_BEGIN_ALLOW_THREADS
+    size_t len = 0, lo = 0, hi = 0;
+    for (size_t i = 0; i < n; i++) {
+        size_t want_lo = i > half ? i - half : 0;
+        size_t want_hi = i + half < n ? i + half : n;
+        while (hi < want_hi) sorted_insert(sorted, &len, get_f64(&a, hi++));
+        while (lo < want_lo) sorted_remove(sorted, &len, get_f64(&a, lo++));
+        if (len >= (size_t)min_len && len > 0) {
+            double median = len % 2 ? sorted[len / 2]
+                                    : (sorted[len / 2 - 1] + sorted[len / 2]) / 2.0;
+            bits[used++] = get_f64(&a, i) > median;
+        }
+    }
+    Py_END_ALLOW_THREADS
+
+    PyMem_RawFree(sorted);
+    PyBuffer_Release(&a.view);
+    return output_finish(out, used);
+}
+
+// BitExtractor._lsb_extraction: n_bits low bits of int(value), LSB first
+static PyObject *py_lsb(PyObject *self, PyObject *args) {
+    PyObject *obj;
+    int n_bits = 8;
+    if (!PyArg_ParseTuple(args, "O|i", &obj, &n_bits)) {
+        return NULL;
+    }
+    if (n_bits < 0 || n_bits > 64) {
+        PyErr_SetString(PyExc_ValueError, "n_bits must be between 0 and 64");
+        return NULL;
+    }
+
+    struct array a;
+    if (array_get(obj, &a, "data") < 0) {
+        return NULL;
+    }
+    uint8_t *bits;
+    PyObject *out = output_new(a.len * (size_t)n_bits, &bits);
+    if (!out) {
+        PyBuffer_Release(&a.view);
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    for (size_t i = 0; i < a.len; i++) {
+        int64_t v = get_i64(&a, i);
+        // Arithmetic shift, like Python's >> on negative ints
+        for (int k = 0; k < n_bits; k++) {
+            *bits++ = (uint8_t)((v >> k) & 1);
+        }
+    }
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&a.view);
+    return out;
+}
+
+// BitExtractor._differential: data[i] > data[i - lag]
+static PyObject *py_differential(PyObject *self, PyObject *args) {
+    PyObject *obj;
+    Py_ssize_t lag = 1;
+    if (!PyArg_ParseTuple(args, "O|n", &obj, &lag)) {
+        return NULL;
+    }
+    if (lag < 0) {
+        PyErr_SetString(PyExc_ValueError, "lag must not be negative");
+        return NULL;
+    }
+
+    struct array a;
+    if (array_get(obj, &a, "data") < 0) {
+        return NULL;
+    }
+    size_t n = a.len > (size_t)lag ? a.len - (size_t)lag : 0;
+    uint8_t *bits;
+    PyObject *out = output_new(n, &bits);
+    if (!out) {
+        PyBuffer_Release(&a.view);
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    for (size_t i = 0; i < n; i++) {
+        bits[i] = get_f64(&a, i + (size_t)lag) > get_f64(&a, i);
+    }
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&a.view);
+    return out;
+}
+
+// Von Neumann over non-overlapping pairs: 01 -> 0, 10 -> 1
+static PyObject *py_von_neumann(PyObject *self, PyObject *args) {
+    PyObject *obj;
+    if (!PyArg_ParseTuple(args, "O", &obj)) {
+        return NULL;
+    }
+
+    struct array a;
+    if (array_get(obj, &a, "bits") < 0) {
+        return NULL;
+    }
+    uint8_t *bits;
+    PyObject *out = output_new(a.len / 2, &bits);
+    if (!out) {
+        PyBuffer_Release(&a.view);
+        return NULL;
+    }
+
+    size_t used = 0;
+    Py_BEGIN_ALLOW_THREADS
+    for (size_t i = 0; i + 1 < a.len; i += 2) {
+        int b = get_bit(&a, i);
+        if (b != get_bit(&a, i + 1)) {
+            bits[used++] = (uint8_t)b;
+        }
+    }
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&a.view);
+    return output_finish(out, used);
+}
+
+// PostProcessor.peres_debias as written: after an equal pair, the first bit
+// of the next unequal pair is emitted and that pair skipped
+static PyObject *py_peres(PyObject *self, PyObject *args) {
+    PyObject *obj;
+    if (!PyArg_ParseTuple(args, "O", &obj)) {
+        return NULL;
+    }
+
+    struct array a;
+    if (array_get(obj, &a, "bits") < 0) {
+        return NULL;
+    }
+    uint8_t *bits;
+    PyObject *out = output_new(a.len / 2, &bits);
+    if (!out) {
+        PyBuffer_Release(&a.view);
+        return NULL;
+    }
+
+    size_t used = 0;
+    Py_BEGIN_ALLOW_THREADS
+    size_t i = 0;
+    while (i + 1 < a.len) {
+        if (get_bit(&a, i) != get_bit(&a, i + 1)) {
+            bits[used++] = (uint8_t)get_bit(&a, i);
+            i += 2;
+            continue;
+        }
+        size_t j = i + 2;
+        while (j + 1 < a.len && get_bit(&a, j) == get_bit(&a, j + 1)) {
+            j += 2;
+        }
+        if (j + 1 < a.len) {
+            bits[used++] = (uint8_t)get_bit(&a, j);
+        }
+        i = j + 2;
+    }
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&a.view);
+    return output_finish(out, used);
+}
+
+// ImprovedTRNGPipeline.xor_whitening: blocks overlapping by half are XORed
+// and the middle half of each result kept
+static PyObject *py_xor_whitening(PyObject *self, PyObject *args) {
+    PyObject *obj;
+    Py_ssize_t block = 16;
+    if (!PyArg_ParseTuple(args, "O|n", &obj, &block)) {
+        return NULL;
+    }
+    if (block < 2) {
+        PyErr_SetString(PyExc_ValueError, "block_size must be at least 2");
+        return NULL;
+    }
+
+    struct array a;
+    if (array_get(obj, &a, "bits") < 0) {
+        return NULL;
+    }
+    size_t bs = (size_t)block, step = bs / 2;
+    size_t keep_lo = bs / 4, keep_hi = 3 * bs / 4;
+    size_t blocks = a.len > bs ? (a.len - bs + step - 1) / step : 0;
+    uint8_t *bits;
+    PyObject *out = output_new(blocks * (keep_hi - keep_lo), &bits);
+    if (!out) {
+        PyBuffer_Release(&a.view);
+        return NULL;
+    }
+
+    size_t used = 0;
+    Py_BEGIN_ALLOW_THREADS
+    for (size_t i = 0; i + bs < a.len; i += step) {
+        // The second block is cut short at the end of the data
+        if (i + step + bs > a.len) {
+            continue;
+        }
+        for (size_t k = keep_lo; k < keep_hi; k++) {
+            bits[used++] = (uint8_t)(get_bit(&a, i + k) ^ get_bit(&a, i + step + k));
+        }
+    }
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&a.view);
+    return output_finish(out, used);
+}
+
+// Runs of equal bits: (count, longest, mean length)
+static PyObject *py_runs(PyObject *self, PyObject *args) {
+    PyObject *obj;
+    if (!PyArg_ParseTuple(args, "O", &obj)) {
+        return NULL;
+    }
+
+    struct array a;
+    if (array_get(obj, &a, "bits") < 0) {
+        return NULL;
+    }
+
+    size_t runs = 0, longest = 0;
+    Py_BEGIN_ALLOW_THREADS
+    size_t current = 1;
+    for (size_t i = 1; i < a.len; i++) {
+        if (get_bit(&a, i) == get_bit(&a, i - 1)) {
+            current++;
+        } else {
+            runs++;
+            if (current > longest) longest = current;
+            current = 1;
+        }
+    }
+    // Python seeds the run list with a length-1 run even for empty input
+    runs++;
+    if (current > longest) longest = current;
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&a.view);
+    double mean = a.len ? (double)a.len / runs : 1.0;
+    return Py_BuildValue("(nnd)", (Py_ssize_t)runs, (Py_ssize_t)longest, mean);
+}
+
+// gm-analysis.py analyze_clustering: events per window_ns window over the
+// running sum of intervals, as float64 counts
+static PyObject *py_window_counts(PyObject *self, PyObject *args) {
+    PyObject *obj;
+    double window_ns;
+    Py_ssize_t n_windows;
+    if (!PyArg_ParseTuple(args, "Odn", &obj, &window_ns, &n_windows)) {
+        return NULL;
+    }
+    if (n_windows < 1) {
+        PyErr_SetString(PyExc_ValueError, "n_windows must be positive");
+        return NULL;
+    }
+
+    struct array a;
+    if (array_get(obj, &a, "intervals") < 0) {
+        return NULL;
+    }
+    uint8_t *data;
+    PyObject *out = output_new((size_t)n_windows * sizeof(double), &data);
+    if (!out) {
+        PyBuffer_Release(&a.view);
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    double *counts = (double *)data;
+    memset(counts, 0, (size_t)n_windows * sizeof(double));
+    double now = 0.0;
+    Py_ssize_t window = 0;
+    size_t count = 0;
+    for (size_t i = 0; i < a.len; i++) {
+        now += get_f64(&a, i);
+        while (now > (window + 1) * window_ns && window < n_windows - 1) {
+            counts[window++] = (double)count;
+            count = 0;
+        }
+        count++;
+    }
+    counts[window] = (double)count;
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&a.view);
+    return out;
+}
+
+// Sums of x[i] * x[i + k] for k = 0..max_lag, with x the data minus center
+// (default: its mean). These are the lag 0..max_lag values of
+// np.correlate(x, x, 'full') without the O(n^2) full correlation.
+static PyObject *py_autocorrelation(PyObject *self, PyObject *args) {
+    PyObject *obj, *center_obj = Py_None;
+    Py_ssize_t max_lag;
+    if (!PyArg_ParseTuple(args, "On|O", &obj, &max_lag, &center_obj)) {
+        return NULL;
+    }
+    double center = 0.0;
+    if (center_obj != Py_None) {
+        center = PyFloat_AsDouble(center_obj);
+        if (center == -1.0 && PyErr_Occurred()) {
+            return NULL;
+        }
+    }
+
+    struct array a;
+    if (array_get(obj, &a, "data") < 0) {
+        return NULL;
+    }
+    if (max_lag < 0) {
+        max_lag = 0;
+    }
+    size_t lags = (size_t)max_lag + 1;
+    uint8_t *data;
+    PyObject *out = output_new(lags * sizeof(double), &data);
+    double *x = PyMem_RawMalloc((a.len ? a.len : 1) * sizeof(double));
+    if (!out || !x) {
+        Py_XDECREF(out);
+        PyMem_RawFree(x);
+        PyBuffer_Release(&a.view);
+        return out ? PyErr_NoMemory() : NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    if (center_obj == Py_None) {
+        for (size_t i = 0; i < a.len; i++) {
+            center += get_f64(&a, i);
+        }
+        center = a.len ? center / a.len : 0.0;
+    }
+    for (size_t i = 0; i < a.len; i++) {
+        x[i] = get_f64(&a, i) - center;
+    }
+    double *acf = (double *)data;
+    for (size_t k = 0; k < lags; k++) {
+        double sum = 0.0;
+        for (size_t i = 0; i + k < a.len; i++) {
+            sum += x[i] * x[i + k];
+        }
+        acf[k] = sum;
+    }
+    Py_END_ALLOW_THREADS
+
+    PyMem_RawFree(x);
+    PyBuffer_Release(&a.view);
+    return out;
+}
+
+// hb_quick_tests over packed bytes: {name: (statistic, p_value)}
+static PyObject *py_quick_tests(PyObject *self, PyObject *args) {
+    Py_buffer view;
+    if (!PyArg_ParseTuple(args, "y*", &view)) {
+        return NULL;
+    }
+
+    struct hb_test_result results[HB_QUICK_TESTS];
+    Py_BEGIN_ALLOW_THREADS
+    hb_quick_tests(view.buf, (size_t)view.len, results);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&view);
+
+    PyObject *dict = PyDict_New();
+    for (int t = 0; dict && t < HB_QUICK_TESTS; t++) {
+        PyObject *v = Py_BuildValue("(dd)", results[t].statistic, results[t].p_value);
+        if (!v || PyDict_SetItemString(dict, results[t].name, v) < 0) {
+            Py_XDECREF(v);
+            Py_DECREF(dict);
+            return NULL;
+        }
+        Py_DECREF(v);
+    }
+    return dict;
+}
+
+static PyMethodDef methods[] = {
+    {"adaptive_threshold", py_adaptive_threshold, METH_VARARGS,
+     "adaptive_threshold(data, window, min_len=2) -> bytearray of bits"},
+    {"lsb", py_lsb, METH_VARARGS, "lsb(data, n_bits=8) -> bytearray of bits"},
+    {"differential", py_differential, METH_VARARGS, "differential(data, lag=1) -> bytearray of bits"},
+    {"von_neumann", py_von_neumann, METH_VARARGS, "von_neumann(bits) -> bytearray of bits"},
+    {"peres", py_peres, METH_VARARGS, "peres(bits) -> bytearray of bits"},
+    {"xor_whitening", py_xor_whitening, METH_VARARGS,
+     "xor_whitening(bits, block_size=16) -> bytearray of bits"},
+    {"runs", py_runs, METH_VARARGS, "runs(bits) -> (count, longest, mean_length)"},
+    {"window_counts", py_window_counts, METH_VARARGS,
+     "window_counts(intervals, window_ns, n_windows) -> bytearray of float64 counts"},
+    {"autocorrelation", py_autocorrelation, METH_VARARGS,
+     "autocorrelation(data, max_lag, center=mean) -> bytearray of float64 sums for lags 0..max_lag"},
+    {"quick_tests", py_quick_tests, METH_VARARGS,
+     "quick_tests(packed_bytes) -> {name: (statistic, p_value)}"},
+    {NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef module = {
+    PyModuleDef_HEAD_INIT, "_hotbits", "Native hotbits kernels", -1, methods,
+    NULL, NULL, NULL, NULL
+};
+
+PyMODINIT_FUNC PyInit__hotbits(void) {
+    return PyModule_Create(&module);
+}
@@ -0,0 +1,177 @@
+#include <math.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "quicktest.h"
+
+#define IGAM_EPS 1e-15
+#define IGAM_MAX_ITER 10000
+
+// Series for P(a, x), valid for x < a + 1
+static double igam_series(double a, double x) {
+    double sum = 1.0 / a;
+    double term = sum;
+    for (int n = 1; n < IGAM_MAX_ITER; n++) {
+        term *= x / (a + n);
+        sum += term;
+        if (fabs(term) < fabs(sum) * IGAM_EPS) {
+            break;
+        }
+    }
+    return sum * exp(-x + a * log(x) - lgamma(a));
+}
+
+// Continued fraction for Q(a, x) (modified Lentz), valid for x >= a + 1
+static double igamc_fraction(double a, double x) {
+    const double tiny = 1e-300;
+    double b = x + 1.0 - a;
+    double c = 1.0 / tiny;
+    double d = 1.0 / b;
+    double h = d;
+
+    for (int i = 1; i < IGAM_MAX_ITER; i++) {
+        double an = -i * (i - a);
+        b += 2.0;
+        d = an * d + b;
+        if (fabs(d) < tiny) d = tiny;
+        c = b + an / c;
+        if (fabs(c) < tiny) c = tiny;
+        d = 1.0 / d;
+        double delta = d * c;
+        h *= delta;
+        if (fabs(delta - 1.0) < IGAM_EPS) {
+            break;
+        }
+    }
+    return exp(-x + a * log(x) - lgamma(a)) * h;
+}
+
+double hb_igamc(double a, double x) {
+    if (x <= 0.0 || a <= 0.0) {
+        return 1.0;
+    }
+    if (x < a + 1.0) {
+        return 1.0 - igam_series(a, x);
+    }
+    return igamc_fraction(a, x);
+}
+
+static inline void quick_update(struct hb_quick_sums *s, const uint8_t *data, size_t len) {
+    size_t block_bytes = HB_BLOCK_FREQUENCY_M / 8;
+
+    if (len == 0) {
+        return;
+    }
+    if (s->bytes == 0) {
+        s->first = data[0];
+    }
+
+    uint8_t prev = s->last;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t b = data[i];
+        int pc = __builtin_popcount(b);
+
+        s->ones += pc;
+        s->block_ones += pc;
+        s->byte_counts[b]++;
+
+        // Transitions inside the byte and across the previous byte boundary
+        s->transitions += __builtin_popcount((b ^ (b >> 1)) & 0x7F);
+        if (s->bytes + i > 0) {
+            s->transitions += ((prev & 1) != (b >> 7));
+            s->sum_lag += (uint64_t)prev * b;
+        }
+        s->sum += b;
+        s->sum_sq += (uint64_t)b * b;
+        prev = b;
+
+        if ((s->bytes + i + 1) % block_bytes == 0) {
+            int64_t dev = (int64_t)s->block_ones - HB_BLOCK_FREQUENCY_M / 2;
+            s->block_dev += dev * dev;
+            s->blocks++;
+            s->block_ones = 0;
+        }
+    }
+    s->bytes += len;
+    s->last = prev;
+}
+
+HB_KERNEL_VOID(quick_update, (struct hb_quick_sums *s, const uint8_t *data, size_t len),
+               (s, data, len));
+
+void hb_quick_update(struct hb_quick_sums *s, const uint8_t *data, size_t len) {
+    HB_DISPATCH(quick_update)(s, data, len);
+}
+
+void hb_quick_tests(const uint8_t *data, size_t len,
+                    struct hb_test_result results[HB_QUICK_TESTS]) {
+    struct hb_quick_sums s;
+
+    memset(&s, 0, sizeof(s));
+    hb_quick_update(&s, data, len);
+    hb_quick_results(&s, results);
+}
+
+void hb_quick_results(const struct hb_quick_sums *s,
+                      struct hb_test_result results[HB_QUICK_TESTS]) {
+    static const char *names[HB_QUICK_TESTS] = {
+        "monobit", "runs", "block_frequency", "byte_chi_square", "serial_correlation"
+    };
+
+    for (int t = 0; t < HB_QUICK_TESTS; t++) {
+        results[t].name = names[t];
+        results[t].statistic = 0.0;
+        results[t].p_value = 0.0;
+    }
+    if (s->bytes == 0) {
+        return;
+    }
+
+    double n = (double)s->bytes * 8.0;
+
+    // Frequency (monobit): S_n = 2 * ones - n
+    double s_obs = fabs(2.0 * s->ones - n) / sqrt(n);
+    results[HB_TEST_MONOBIT].statistic = s_obs;
+    results[HB_TEST_MONOBIT].p_value = erfc(s_obs / sqrt(2.0));
+
+    // Runs: only meaningful when the monobit prerequisite holds
+    double pi = s->ones / n;
+    double v_obs = s->transitions + 1.0;
+    results[HB_TEST_RUNS].statistic = v_obs;
+    if (fabs(pi - 0.5) < 2.0 / sqrt(n)) {
+        double num = fabs(v_obs - 2.0 * n * pi * (1.0 - pi));
+        double den = 2.0 * sqrt(2.0 * n) * pi * (1.0 - pi);
+        results[HB_TEST_RUNS].p_value = erfc(num / den);
+    }
+
+    // Block frequency over complete M-bit blocks:
+    // chi = 4M * sum((ones/M - 1/2)^2) = 4/M * sum((ones - M/2)^2)
+    if (s->blocks > 0) {
+        double chi = 4.0 * s->block_dev / HB_BLOCK_FREQUENCY_M;
+        results[HB_TEST_BLOCK_FREQUENCY].statistic = chi;
+        results[HB_TEST_BLOCK_FREQUENCY].p_value = hb_igamc(s->blocks / 2.0, chi / 2.0);
+    }
+
+    // Byte chi-square with 255 degrees of freedom
+    double expected = s->bytes / 256.0;
+    double chi = 0.0;
+    for (int b = 0; b < 256; b++) {
+        double diff = s->byte_counts[b] - expected;
+        chi += diff * diff / expected;
+    }
+    results[HB_TEST_BYTE_CHI_SQUARE].statistic = chi;
+    results[HB_TEST_BYTE_CHI_SQUARE].p_value = hb_igamc(255.0 / 2.0, chi / 2.0);
+
+    // Lag-1 serial correlation of bytes; z = r * sqrt(N) under H0
+    if (s->bytes > 2) {
+        double m = s->bytes;
+        double sum = s->sum;
+        double mean_a = (sum - s->last) / (m - 1);
+        double mean_b = (sum - s->first) / (m - 1);
+        double cov = s->sum_lag / (m - 1) - mean_a * mean_b;
+        double var = s->sum_sq / m - (sum / m) * (sum / m);
+        double r = var > 0.0 ? cov / var : 1.0;
+        results[HB_TEST_SERIAL_CORRELATION].statistic = r;
+        results[HB_TEST_SERIAL_CORRELATION].p_value = erfc(fabs(r) * sqrt(m) / sqrt(2.0));
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef HOTBITS_QUICKTEST_H
+#define HOTBITS_QUICKTEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// In-process statistical battery over a packed byte stream. These are the
+// cheap checks the shell pipelines approximate with Python and `ent`.
+enum {
+    HB_TEST_MONOBIT,
+    HB_TEST_RUNS,
+    HB_TEST_BLOCK_FREQUENCY,
+    HB_TEST_BYTE_CHI_SQUARE,
+    HB_TEST_SERIAL_CORRELATION,
+    HB_QUICK_TESTS
+};
+
+#define HB_BLOCK_FREQUENCY_M 128   // bits per block (NIST SP 800-22 2.2)
+#define HB_ALPHA 0.01              // significance level for pass/fail
+
+struct hb_test_result {
+    const char *name;
+    double statistic;
+    double p_value;
+};
+
+void hb_quick_tests(const uint8_t *data, size_t len,
+                    struct hb_test_result results[HB_QUICK_TESTS]);
+
+// Sufficient statistics for the battery. Every field is a plain sum over
+// bytes, adjacent byte pairs or complete blocks, so a sliding window can
+// add and remove data without rescanning it (see monitor.h).
+struct hb_quick_sums {
+    uint64_t bytes;
+    uint64_t ones;
+    uint64_t transitions;       // bit changes between adjacent bits
+    uint64_t byte_counts[256];
+    uint64_t sum;               // sum of byte values
+    uint64_t sum_sq;            // sum of squared byte values
+    uint64_t sum_lag;           // sum of products of adjacent bytes
+    uint8_t first;
+    uint8_t last;
+    uint64_t blocks;            // complete HB_BLOCK_FREQUENCY_M-bit blocks
+    uint64_t block_dev;         // sum over blocks of (ones - M/2)^2
+    uint64_t block_ones;        // ones in the block hb_quick_update is filling
+};
+
+// Append data to the sums (start from a zeroed struct); lets a stream be
+// tested at any length without keeping or rescanning it
+void hb_quick_update(struct hb_quick_sums *s, const uint8_t *data, size_t len);
+
+void hb_quick_results(const struct hb_quick_sums *s,
+                      struct hb_test_result results[HB_QUICK_TESTS]);
+
+// Regularized upper incomplete gamma Q(a, x), as igamc() in NIST STS.
+double hb_igamc(double a, double x);
+
+#endif
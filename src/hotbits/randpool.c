@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "randpool.h"
+#include "timing.h"
+
+#define PROBE 8
+
+int hb_randpool_init(struct hb_randpool *p, size_t cap) {
+    memset(p, 0, sizeof(*p));
+    size_t rounded = 1;
+    while (rounded < cap) {
+        rounded <<= 1;
+    }
+    p->data = malloc(rounded);
+    p->marks = malloc(HB_RANDPOOL_MARKS * sizeof(*p->marks));
+    if (!p->data || !p->marks) {
+        fprintf(stderr, "Memory allocation failed\n");
+        hb_randpool_free(p);
+        return -1;
+    }
+    p->cap = rounded;
+    return 0;
+}
+
+void hb_randpool_free(struct hb_randpool *p) {
+    free(p->data);
+    free(p->marks);
+    p->data = NULL;
+    p->marks = NULL;
+}
+
+size_t hb_randpool_level(const struct hb_randpool *p) {
+    uint64_t head = __atomic_load_n(&p->head, __ATOMIC_ACQUIRE);
+    uint64_t tail = __atomic_load_n(&p->tail, __ATOMIC_ACQUIRE);
+    return (size_t)(head - tail);
+}
+
+size_t hb_randpool_space(const struct hb_randpool *p) {
+    return p->cap - hb_randpool_level(p);
+}
+
+size_t hb_randpool_put(struct hb_randpool *p, const uint8_t *data, size_t len) {
+    uint64_t head = p->head;
+    uint64_t tail = __atomic_load_n(&p->tail, __ATOMIC_ACQUIRE);
+    size_t space = p->cap - (size_t)(head - tail);
+    if (len > space) {
+        len = space;
+    }
+
+    size_t at = (size_t)head & (p->cap - 1);
+    size_t first = p->cap - at < len ? p->cap - at : len;
+    memcpy(p->data + at, data, first);
+    memcpy(p->data, data + first, len - first);
+
+    // The mark is published before the bytes, so the consumer finds it
+    // for every byte it can take
+    uint64_t mark_head = p->mark_head;
+    if (len > 0 && mark_head - __atomic_load_n(&p->mark_tail, __ATOMIC_ACQUIRE) <
+        HB_RANDPOOL_MARKS) {
+        struct hb_randpool_mark *m = &p->marks[mark_head & (HB_RANDPOOL_MARKS - 1)];
+        m->end = head + len;
+        m->ns = hb_monotonic_ns();
+        __atomic_store_n(&p->mark_head, mark_head + 1, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&p->head, head + len, __ATOMIC_RELEASE);
+    return len;
+}
+
+int hb_randpool_take(struct hb_randpool *p, uint8_t *out, size_t len) {
+    uint64_t tail = p->tail;
+    uint64_t head = __atomic_load_n(&p->head, __ATOMIC_ACQUIRE);
+    if (head - tail < len) {
+        return -1;
+    }
+
+    size_t at = (size_t)tail & (p->cap - 1);
+    size_t first = p->cap - at < len ? p->cap - at : len;
+    memcpy(out, p->data + at, first);
+    memcpy(out + first, p->data, len - first);
+    // Served bytes must not linger where a later request could see them
+    memset(p->data + at, 0, first);
+    memset(p->data, 0, len - first);
+
+    // Drop the marks of puts that are now served in full
+    uint64_t mark_tail = p->mark_tail;
+    uint64_t mark_head = __atomic_load_n(&p->mark_head, __ATOMIC_ACQUIRE);
+    while (mark_tail != mark_head &&
+           p->marks[mark_tail & (HB_RANDPOOL_MARKS - 1)].end <= tail + len) {
+        mark_tail++;
+    }
+    __atomic_store_n(&p->mark_tail, mark_tail, __ATOMIC_RELEASE);
+    __atomic_store_n(&p->tail, tail + len, __ATOMIC_RELEASE);
+    return 0;
+}
+
+uint64_t hb_randpool_age(struct hb_randpool *p, uint64_t now) {
+    // Marks of served bytes were dropped by take, so the first one left
+    // covers the byte at tail
+    uint64_t mark_head = __atomic_load_n(&p->mark_head, __ATOMIC_ACQUIRE);
+    if (p->mark_tail == mark_head) {
+        return UINT64_MAX;
+    }
+    uint64_t ns = p->marks[p->mark_tail & (HB_RANDPOOL_MARKS - 1)].ns;
+    return now > ns ? now - ns : 0;
+}
+
+int hb_buckets_init(struct hb_buckets *b, size_t count, double rate, double burst) {
+    memset(b, 0, sizeof(*b));
+    size_t rounded = PROBE;
+    while (rounded < count) {
+        rounded <<= 1;
+    }
+    b->slots = calloc(rounded, sizeof(*b->slots));
+    if (!b->slots) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+    b->count = rounded;
+    b->rate = rate;
+    b->burst = burst;
+    return 0;
+}
+
+void hb_buckets_free(struct hb_buckets *b) {
+    free(b->slots);
+    b->slots = NULL;
+}
+
+int hb_buckets_take(struct hb_buckets *b, const uint8_t key[16], double now, double cost,
+                    double *wait) {
+    size_t start = (size_t)hb_hash64(key, 16, 0);
+    struct hb_bucket *bucket = NULL;
+    struct hb_bucket *idlest = NULL;
+
+    for (size_t i = 0; i < PROBE; i++) {
+        struct hb_bucket *slot = &b->slots[(start + i) & (b->count - 1)];
+        if (slot->used && memcmp(slot->key, key, 16) == 0) {
+            bucket = slot;
+            break;
+        }
+        if (!idlest || (idlest->used && (!slot->used || slot->last < idlest->last))) {
+            idlest = slot;
+        }
+    }
+    if (!bucket) {
+        bucket = idlest;
+        memcpy(bucket->key, key, 16);
+        bucket->tokens = b->burst;
+        bucket->last = now;
+        bucket->used = 1;
+    }
+
+    bucket->tokens += (now - bucket->last) * b->rate;
+    if (bucket->tokens > b->burst) {
+        bucket->tokens = b->burst;
+    }
+    bucket->last = now;
+
+    if (bucket->tokens < cost) {
+        *wait = (cost - bucket->tokens) / b->rate;
+        return -1;
+    }
+    bucket->tokens -= cost;
+    return 0;
+}
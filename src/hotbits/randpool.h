@@ -0,0 +1,81 @@
+#ifndef HOTBITS_RANDPOOL_H
+#define HOTBITS_RANDPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Prefilled pool of random bytes for hotbits-serve.
+//
+// A ring with one producer (the fill thread) and one consumer (the event
+// loop). Each side advances only its own counter and publishes it with a
+// release store, so neither takes a lock. Bytes are handed out once and
+// never reused.
+//
+// A second ring of marks records when each put happened, so the consumer
+// can tell how long the bytes it takes sat in the pool. When the marks run
+// out the put goes unmarked and its bytes count as stored by the next
+// marked put (younger than they are).
+#define HB_RANDPOOL_MARKS 4096
+
+struct hb_randpool_mark {
+    uint64_t end;            // head after the put
+    uint64_t ns;             // CLOCK_MONOTONIC at the put
+};
+
+struct hb_randpool {
+    uint8_t *data;
+    size_t cap;              // power of two
+    uint64_t head;           // bytes ever written (producer)
+    uint64_t tail;           // bytes ever taken (consumer)
+    struct hb_randpool_mark *marks;
+    uint64_t mark_head;      // marks ever added (producer)
+    uint64_t mark_tail;      // marks ever dropped (consumer)
+};
+
+int hb_randpool_init(struct hb_randpool *p, size_t cap);
+void hb_randpool_free(struct hb_randpool *p);
+
+// Bytes ready to take, and room left for the producer
+size_t hb_randpool_level(const struct hb_randpool *p);
+size_t hb_randpool_space(const struct hb_randpool *p);
+
+// Producer: store up to len bytes; returns the number stored
+size_t hb_randpool_put(struct hb_randpool *p, const uint8_t *data, size_t len);
+
+// Consumer: take exactly len bytes, or none. Returns 0 or -1 when fewer
+// than len bytes are ready.
+int hb_randpool_take(struct hb_randpool *p, uint8_t *out, size_t len);
+
+// Consumer: nanoseconds since the oldest ready byte was stored, as of now
+// (CLOCK_MONOTONIC), or UINT64_MAX when no mark is left (the pool is
+// empty, or holds only unmarked bytes)
+uint64_t hb_randpool_age(struct hb_randpool *p, uint64_t now);
+
+// Per-client token buckets, keyed by a 16-byte address (IPv4 mapped into
+// IPv6), so a client opening many connections still draws from one bucket.
+// The table is fixed-size and open-addressed; when a client's probe window
+// is full, the slot idle the longest is taken over, which at worst hands a
+// new client a full bucket.
+struct hb_bucket {
+    uint8_t key[16];
+    double tokens;
+    double last;             // time of the last refill, seconds
+    int used;
+};
+
+struct hb_buckets {
+    struct hb_bucket *slots;
+    size_t count;            // power of two
+    double rate;             // tokens per second
+    double burst;            // bucket capacity
+};
+
+int hb_buckets_init(struct hb_buckets *b, size_t count, double rate, double burst);
+void hb_buckets_free(struct hb_buckets *b);
+
+// Take cost tokens from key's bucket at time now. Returns 0, or -1 with
+// *wait set to the seconds until the bucket would hold cost tokens.
+int hb_buckets_take(struct hb_buckets *b, const uint8_t key[16], double now, double cost,
+                    double *wait);
+
+#endif
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glob.h>
+
+#include "segments.h"
+#include "codec.h"
+
+static int list_pattern(const char *data_dir, const char *suffix, glob_t *g) {
+    char pattern[4096];
+    snprintf(pattern, sizeof(pattern), "%s/events-*%s", data_dir, suffix);
+
+    int rv = glob(pattern, 0, NULL, g);
+    if (rv == GLOB_NOMATCH) {
+        g->gl_pathc = 0;
+        g->gl_pathv = NULL;
+        return 0;
+    }
+    if (rv != 0) {
+        fprintf(stderr, "Failed to list %s\n", pattern);
+        return -1;
+    }
+    return 1;
+}
+
+// Compare segment names without their .txt/.hbc suffix
+static int stem_cmp(const char *a, const char *b) {
+    size_t la = strrchr(a, '.') - a;
+    size_t lb = strrchr(b, '.') - b;
+    int c = strncmp(a, b, la < lb ? la : lb);
+    if (c != 0) {
+        return c;
+    }
+    return la < lb ? -1 : la > lb;
+}
+
+int hb_segments_list(const char *data_dir, struct hb_segments *segs) {
+    glob_t text, packed;
+    int have_text, have_packed;
+
+    segs->paths = NULL;
+    segs->count = 0;
+
+    if ((have_text = list_pattern(data_dir, ".txt", &text)) < 0) {
+        return -1;
+    }
+    if ((have_packed = list_pattern(data_dir, HB_CODEC_SUFFIX, &packed)) < 0) {
+        if (have_text) globfree(&text);
+        return -1;
+    }
+
+    size_t total = text.gl_pathc + packed.gl_pathc;
+    segs->paths = calloc(total ? total : 1, sizeof(char *));
+    if (!segs->paths) {
+        fprintf(stderr, "Memory allocation failed\n");
+        if (have_text) globfree(&text);
+        if (have_packed) globfree(&packed);
+        return -1;
+    }
+
+    // Merge the two sorted lists; a segment present in both forms is read
+    // from its text file, which may still be growing
+    size_t i = 0, j = 0;
+    int rv = 0;
+    while (i < text.gl_pathc || j < packed.gl_pathc) {
+        const char *path;
+        if (j == packed.gl_pathc) {
+            path = text.gl_pathv[i++];
+        } else if (i == text.gl_pathc) {
+            path = packed.gl_pathv[j++];
+        } else {
+            int c = stem_cmp(text.gl_pathv[i], packed.gl_pathv[j]);
+            if (c <= 0) {
+                path = text.gl_pathv[i++];
+                j += c == 0;
+            } else {
+                path = packed.gl_pathv[j++];
+            }
+        }
+
+        segs->paths[segs->count] = strdup(path);
+        if (!segs->paths[segs->count]) {
+            fprintf(stderr, "Memory allocation failed\n");
+            hb_segments_free(segs);
+            rv = -1;
+            break;
+        }
+        segs->count++;
+    }
+
+    if (have_text) globfree(&text);
+    if (have_packed) globfree(&packed);
+    return rv;
+}
+
+void hb_segments_free(struct hb_segments *segs) {
+    for (size_t i = 0; i < segs->count; i++) {
+        free(segs->paths[i]);
+    }
+    free(segs->paths);
+    segs->paths = NULL;
+    segs->count = 0;
+}
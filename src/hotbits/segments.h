@@ -0,0 +1,17 @@
+#ifndef HOTBITS_SEGMENTS_H
+#define HOTBITS_SEGMENTS_H
+
+#include <stddef.h>
+
+// Sorted list of events-*.txt and packed events-*.hbc segment files in a
+// data directory. For text segments the order matches
+// `cat data/events-*.txt` in the shell scripts.
+struct hb_segments {
+    char **paths;
+    size_t count;
+};
+
+int hb_segments_list(const char *data_dir, struct hb_segments *segs);
+void hb_segments_free(struct hb_segments *segs);
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef HOTBITS_TIMING_H
+#define HOTBITS_TIMING_H
+
+#include <stdint.h>
+#include <time.h>
+
+// Wall and CPU time of a pipeline stage, in seconds
+struct hb_stage_time {
+    double wall_s;
+    double cpu_s;
+};
+
+static inline double hb_wall_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static inline uint64_t hb_monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline double hb_thread_cpu_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#endif
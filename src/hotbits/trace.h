@@ -0,0 +1,27 @@
+#ifndef HOTBITS_TRACE_H
+#define HOTBITS_TRACE_H
+
+// USDT tracepoints (provider "hotbits") for attaching bpftrace or perf to
+// a running trng or extractor. With <sys/sdt.h> (systemtap-sdt-dev) each
+// probe is a single nop until a tracer enables it; without the header, or
+// with -DHB_NO_USDT, they compile to nothing. Arguments are values the
+// code already has at hand; for the time at a probe use the tracer's clock
+// (bpftrace nsecs), which costs nothing while detached.
+#if !defined(HB_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define HB_HAVE_USDT 1
+#endif
+#endif
+
+#ifdef HB_HAVE_USDT
+#define HB_TRACE1(name, a) DTRACE_PROBE1(hotbits, name, a)
+#define HB_TRACE2(name, a, b) DTRACE_PROBE2(hotbits, name, a, b)
+#define HB_TRACE3(name, a, b, c) DTRACE_PROBE3(hotbits, name, a, b, c)
+#else
+#define HB_TRACE1(name, a) do { } while (0)
+#define HB_TRACE2(name, a, b) do { } while (0)
+#define HB_TRACE3(name, a, b, c) do { } while (0)
+#endif
+
+#endif
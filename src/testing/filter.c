@@ -4,6 +4,9 @@
 #include <stdint.h>
 #include <unistd.h>
 
+#include "input.h"
+#include "instrument.h"
+
 #define MAX_BUFFER 10000000  // Maximum number of timestamps to buffer
 
 // Transformation options
@@ -123,6 +126,7 @@ uint64_t* apply_window(uint64_t *timestamps, size_t count, uint64_t window_size,
 int main(int argc, char *argv[]) {
     struct transform_options opts;
     parse_args(argc, argv, &opts);
+    hb_instrument_init("filter");
     
     // Read timestamps from stdin
     uint64_t *timestamps = malloc(MAX_BUFFER * sizeof(uint64_t));
@@ -131,17 +135,35 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     
+    // gzip/zstd input is decompressed on a separate thread
+    struct hb_input input;
+    if (hb_input_stdin(&input) < 0) {
+        free(timestamps);
+        return 1;
+    }
+
     size_t count = 0;
     char line[100];
     
+    HB_TIMER_START(parse);
     while (fgets(line, sizeof(line), stdin) && count < MAX_BUFFER) {
         timestamps[count++] = strtoull(line, NULL, 10);
     }
+    HB_TIMER_STOP(parse, HB_STAGE_PARSE);
+    HB_COUNT(HB_STAGE_PARSE, count);
+
+    // Stopping at MAX_BUFFER leaves the decoder with nowhere to write
+    if (hb_input_close(&input) < 0 && count < MAX_BUFFER) {
+        free(timestamps);
+        return 1;
+    }
     
     // Apply transformations
     size_t new_count;
     uint64_t *result = timestamps;
     
+    HB_TIMER_START(filter);
+    HB_COUNT(HB_STAGE_FILTER, count);
     if (opts.dead_time_ns > 0) {
         uint64_t *filtered = apply_dead_time(result, count, opts.dead_time_ns, &new_count);
         if (result != timestamps) free(result);
@@ -157,7 +179,11 @@ int main(int argc, char *argv[]) {
         count = new_count;
     }
     
+    HB_TIMER_STOP(filter, HB_STAGE_FILTER);
+    
     // Output results
+    HB_TIMER_START(sink);
+    HB_COUNT(HB_STAGE_SINK, count);
     if (opts.output_mode == 0) {
         // Output timestamps
         for (size_t i = 0; i < count; i++) {
@@ -169,6 +195,8 @@ int main(int argc, char *argv[]) {
             printf("%lu\n", result[i] - result[i-1]);
         }
     }
+    fflush(stdout);
+    HB_TIMER_STOP(sink, HB_STAGE_SINK);
     
     if (result != timestamps) free(result);
     free(timestamps);
@@ -1,10 +1,15 @@
 #!/usr/bin/env python3
+import os
 import sys
 import numpy as np
 from scipy import stats
 from collections import defaultdict
 import json
 
+# Native kernels live with the analysis scripts
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'analysis'))
+import hotbits_native as native
+
 class NumpyEncoder(json.JSONEncoder):
     def default(self, obj):
         if isinstance(obj, np.integer):
@@ -30,21 +35,24 @@ def analyze_clustering(intervals):
         total_time = float(intervals.sum())
         n_windows = int(total_time / window_ns)
         if n_windows > 1:
-            counts = np.zeros(n_windows)
-            current_time = 0
-            current_window = 0
-            current_count = 0
+            if native.available:
+                counts = native.window_counts(intervals, window_ns, n_windows)
+            else:
+                counts = np.zeros(n_windows)
+                current_time = 0
+                current_window = 0
+                current_count = 0
             
-            for interval in intervals:
-                current_time += interval
-                while current_time > (current_window + 1) * window_ns and current_window < n_windows - 1:
-                    counts[current_window] = current_count
-                    current_window += 1
-                    current_count = 0
-                current_count += 1
+                for interval in intervals:
+                    current_time += interval
+                    while current_time > (current_window + 1) * window_ns and current_window < n_windows - 1:
+                        counts[current_window] = current_count
+                        current_window += 1
+                        current_count = 0
+                    current_count += 1
             
-            # Add last window
-            counts[current_window] = current_count
+                # Add last window
+                counts[current_window] = current_count
             
             # Calculate Fano factor
             fano = float(np.var(counts) / np.mean(counts)) if np.mean(counts) > 0 else float('nan')
@@ -107,8 +115,11 @@ def analyze_periodicity(intervals):
     """
     # Calculate autocorrelation up to 100 lags
     n_lags = min(100, len(intervals) - 1)
-    intervals_norm = intervals - np.mean(intervals)
-    acf = np.correlate(intervals_norm, intervals_norm, mode='full')[len(intervals)-1:len(intervals)+n_lags]
+    if native.available:
+        acf = native.autocorrelation(intervals, n_lags)
+    else:
+        intervals_norm = intervals - np.mean(intervals)
+        acf = np.correlate(intervals_norm, intervals_norm, mode='full')[len(intervals)-1:len(intervals)+n_lags]
     acf = acf / acf[0]  # Normalize
     
     # Find peaks in autocorrelation
@@ -4,6 +4,9 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "input.h"
+#include "instrument.h"
+
 #define DEBUG_PRINT(...) fprintf(stderr, __VA_ARGS__)
 #define MAX_BUFFER 10000000  // Maximum number of timestamps to buffer
 			     //
@@ -116,6 +119,7 @@ int main(int argc, char *argv[]) {
     }
     
     DEBUG_PRINT("Selected method: %d\n", method);
+    hb_instrument_init("rng-extractor");
     
     // Read timestamps/intervals from stdin
     uint64_t *values = malloc(MAX_BUFFER * sizeof(uint64_t));
@@ -124,16 +128,32 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     
+    // gzip/zstd input is decompressed on a separate thread
+    struct hb_input input;
+    if (hb_input_stdin(&input) < 0) {
+        free(values);
+        return 1;
+    }
+
     size_t count = 0;
     char line[100];
     DEBUG_PRINT("Reading input values...\n");
     
+    HB_TIMER_START(parse);
     while (fgets(line, sizeof(line), stdin) && count < 10000000) {
         values[count] = strtoull(line, NULL, 10);
         if (values[count] > 0 || line[0] == '0') {  // Valid number or explicit zero
             count++;
         }
     }
+    HB_TIMER_STOP(parse, HB_STAGE_PARSE);
+    HB_COUNT(HB_STAGE_PARSE, count);
+
+    if (hb_input_close(&input) < 0 && count < 10000000) {
+        DEBUG_PRINT("Failed to decompress input\n");
+        free(values);
+        return 1;
+    }
     
     DEBUG_PRINT("Read %zu values\n", count);
     
@@ -156,6 +176,8 @@ int main(int argc, char *argv[]) {
     DEBUG_PRINT("Applying extraction method %d...\n", method);
     
     // Apply selected extraction method
+    HB_TIMER_START(extract);
+    HB_COUNT(HB_STAGE_EXTRACT, count);
     switch (method) {
         case 0:
             DEBUG_PRINT("Using interval comparison...\n");
@@ -192,10 +214,16 @@ int main(int argc, char *argv[]) {
             return 1;
     }
     
+    HB_TIMER_STOP(extract, HB_STAGE_EXTRACT);
+    
     DEBUG_PRINT("Generated %zu output bytes\n", output_len);
     
     // Write output in raw binary format
+    HB_TIMER_START(sink);
     size_t written = fwrite(output, 1, output_len, stdout);
+    fflush(stdout);
+    HB_TIMER_STOP(sink, HB_STAGE_SINK);
+    HB_COUNT(HB_STAGE_SINK, written);
     DEBUG_PRINT("Wrote %zu bytes to output\n", written);
     
     free(values);
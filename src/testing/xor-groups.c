@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+#include "input.h"
+
 int main(int argc, char *argv[]) {
     if (argc != 2) {
         fprintf(stderr, "Usage: %s <group_size>\n", argv[0]);
@@ -20,6 +22,13 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    // gzip/zstd input is decompressed on a separate thread
+    struct hb_input input;
+    if (hb_input_stdin(&input) < 0) {
+        free(buffer);
+        return 1;
+    }
+
     char line[256];
     int count = 0;
 
@@ -46,5 +55,5 @@ int main(int argc, char *argv[]) {
     }
 
     free(buffer);
-    return 0;
+    return hb_input_close(&input) < 0 ? 1 : 0;
 }
@@ -0,0 +1,522 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include "control.h"
+#include "handoff.h"
+
+// Line protocol, one client at a time. Every command is answered by zero
+// or more lines of output followed by "ok" or "error <reason>":
+//
+//   help                     list the commands
+//   show                     current configuration and sinks
+//   stats                    event, output and packet counters
+//   latency                  per source edge-to-receipt and receipt-to-output
+//   sink add HOST PORT       also send event packets to HOST:PORT
+//   sink del HOST PORT       stop sending to HOST:PORT
+//   format text|csv|binary   stdout output format
+//   batch EVENTS MS          flush after EVENTS events or MS milliseconds
+//   packet EVENTS MS         send a datagram per EVENTS events or MS milliseconds
+//   verbose on|off           per-event logging to stderr
+#define LINE_MAX_BYTES 512
+#define MAX_BATCH_EVENTS 100000
+#define MAX_BATCH_MS 60000
+
+TrngStats trng_stats;
+Runtime *runtime_current;
+Source trng_sources[CONTROL_MAX_SOURCES];
+int trng_nsources;
+
+// Odd while the capture thread may hold a Runtime pointer
+static uint64_t reader_epoch;
+
+static struct {
+    int listen_fd;
+    int sink_fd[2];                     // sockets created for runtime sinks
+    pthread_t thread;
+    int started;
+    int stop;
+    time_t started_at;
+    char path[PATH_MAX];                // where the socket is bound now
+    char final_path[PATH_MAX];          // --control PATH
+} control = {
+    .listen_fd = -1,
+    .sink_fd = { -1, -1 }
+};
+
+static const char *format_names[] = { "text", "csv", "binary" };
+
+void runtime_online(void) {
+    __atomic_store_n(&reader_epoch, reader_epoch + 1, __ATOMIC_RELAXED);
+    // Orders the epoch store before the runtime_get() loads that follow
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void runtime_offline(void) {
+    __atomic_store_n(&reader_epoch, reader_epoch + 1, __ATOMIC_RELEASE);
+}
+
+// Wait until the capture thread can no longer hold a Runtime loaded
+// before the last publish: it is offline, or has gone offline since
+static void synchronize(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    uint64_t epoch = __atomic_load_n(&reader_epoch, __ATOMIC_ACQUIRE);
+    if (!(epoch & 1)) {
+        return;
+    }
+    struct timespec pause = { 0, 1000000 };
+    while (__atomic_load_n(&reader_epoch, __ATOMIC_ACQUIRE) == epoch) {
+        nanosleep(&pause, NULL);
+    }
+}
+
+Runtime *runtime_copy(const Runtime *from) {
+    Runtime *rt = malloc(sizeof(*rt));
+    if (!rt) {
+        perror("malloc");
+        return NULL;
+    }
+    if (from) {
+        *rt = *from;
+        return rt;
+    }
+    memset(rt, 0, sizeof(*rt));
+    rt->format = FORMAT_TEXT;
+    rt->batch_events = 1;
+    rt->batch_ms = 1000;
+    rt->packet_events = 1;
+    rt->packet_ms = 10;
+    rt->sink_fd[0] = -1;
+    rt->sink_fd[1] = -1;
+    return rt;
+}
+
+void runtime_publish(Runtime *rt) {
+    Runtime *old = __atomic_load_n(&runtime_current, __ATOMIC_RELAXED);
+    rt->generation = old ? old->generation + 1 : 1;
+    __atomic_store_n(&runtime_current, rt, __ATOMIC_RELEASE);
+    if (old) {
+        synchronize();
+        free(old);
+    }
+}
+
+int sink_parse(Sink *sink, const char *host, int port, int family) {
+    memset(sink, 0, sizeof(*sink));
+    if (port <= 0 || port > 65535) {
+        return -1;
+    }
+
+    struct sockaddr_in *addr4 = (struct sockaddr_in *)&sink->addr;
+    struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)&sink->addr;
+    if (family != AF_INET6 && inet_pton(AF_INET, host, &addr4->sin_addr) == 1) {
+        addr4->sin_family = AF_INET;
+        addr4->sin_port = htons(port);
+        sink->len = sizeof(*addr4);
+        snprintf(sink->name, sizeof(sink->name), "%s:%d", host, port);
+    } else if (family != AF_INET && inet_pton(AF_INET6, host, &addr6->sin6_addr) == 1) {
+        addr6->sin6_family = AF_INET6;
+        addr6->sin6_port = htons(port);
+        sink->len = sizeof(*addr6);
+        snprintf(sink->name, sizeof(sink->name), "[%s]:%d", host, port);
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static int sink_find(const Runtime *rt, const Sink *sink) {
+    for (int i = 0; i < rt->nsinks; i++) {
+        if (rt->sinks[i].len == sink->len &&
+            memcmp(&rt->sinks[i].addr, &sink->addr, sink->len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int runtime_add_sink(Runtime *rt, const Sink *sink) {
+    if (rt->nsinks == CONTROL_MAX_SINKS || sink_find(rt, sink) >= 0) {
+        return -1;
+    }
+    rt->sinks[rt->nsinks++] = *sink;
+    return 0;
+}
+
+int runtime_remove_sink(Runtime *rt, const Sink *sink) {
+    int i = sink_find(rt, sink);
+    if (i < 0) {
+        return -1;
+    }
+    memmove(&rt->sinks[i], &rt->sinks[i + 1], (rt->nsinks - i - 1) * sizeof(Sink));
+    rt->nsinks--;
+    return 0;
+}
+
+// Send socket for the sink's address family, created on first use
+static int sink_socket(Runtime *rt, const Sink *sink) {
+    int v6 = sink->addr.ss_family == AF_INET6;
+    if (rt->sink_fd[v6] >= 0) {
+        return 0;
+    }
+    if (control.sink_fd[v6] < 0) {
+        int sock = socket(v6 ? AF_INET6 : AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (sock < 0) {
+            return -1;
+        }
+        int broadcast = 1;
+        if (!v6 && setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &broadcast, sizeof(broadcast)) < 0) {
+            close(sock);
+            return -1;
+        }
+        control.sink_fd[v6] = sock;
+    }
+    rt->sink_fd[v6] = control.sink_fd[v6];
+    return 0;
+}
+
+static void reply(int fd, const char *fmt, ...) {
+    char line[LINE_MAX_BYTES];
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (len < 0) {
+        return;
+    }
+    if ((size_t)len >= sizeof(line)) {
+        len = sizeof(line) - 1;
+    }
+    // The client may be gone; MSG_NOSIGNAL instead of a process-wide SIGPIPE
+    send(fd, line, len, MSG_NOSIGNAL);
+}
+
+static uint64_t stat_get(const uint64_t *counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+static void show(int fd, const Runtime *rt) {
+    reply(fd, "generation %lu\n", rt->generation);
+    reply(fd, "format %s\n", format_names[rt->format]);
+    reply(fd, "batch %d %d\n", rt->batch_events, rt->batch_ms);
+    reply(fd, "packet %d %d\n", rt->packet_events, rt->packet_ms);
+    reply(fd, "verbose %s\n", rt->verbose ? "on" : "off");
+    for (int i = 0; i < rt->nsinks; i++) {
+        reply(fd, "sink %s\n", rt->sinks[i].name);
+    }
+}
+
+static void stats(int fd, const Runtime *rt) {
+    reply(fd, "uptime_s %ld\n", (long)(time(NULL) - control.started_at));
+    reply(fd, "generation %lu\n", rt->generation);
+    reply(fd, "events %lu\n", stat_get(&trng_stats.events));
+    reply(fd, "bytes %lu\n", stat_get(&trng_stats.bytes));
+    reply(fd, "flushes %lu\n", stat_get(&trng_stats.flushes));
+    reply(fd, "packets %lu\n", stat_get(&trng_stats.packets));
+    reply(fd, "send_errors %lu\n", stat_get(&trng_stats.send_errors));
+    reply(fd, "sinks %d\n", rt->nsinks);
+}
+
+Source *source_lookup(const struct sockaddr_storage *addr, socklen_t len, const char *name) {
+    for (int i = 0; i < trng_nsources; i++) {
+        Source *src = &trng_sources[i];
+        if (src->len == len && memcmp(&src->addr, addr, len) == 0) {
+            return src;
+        }
+    }
+    if (trng_nsources == CONTROL_MAX_SOURCES) {
+        return NULL;
+    }
+    Source *src = &trng_sources[trng_nsources];
+    memset(src, 0, sizeof(*src));
+    memcpy(&src->addr, addr, len);
+    src->len = len;
+    if (len == 0) {
+        snprintf(src->name, sizeof(src->name), "%s", name);
+    } else {
+        // Named like sinks
+        char host[INET6_ADDRSTRLEN];
+        if (addr->ss_family == AF_INET6) {
+            const struct sockaddr_in6 *addr6 = (const struct sockaddr_in6 *)addr;
+            inet_ntop(AF_INET6, &addr6->sin6_addr, host, sizeof(host));
+            snprintf(src->name, sizeof(src->name), "[%s]:%d", host, ntohs(addr6->sin6_port));
+        } else {
+            const struct sockaddr_in *addr4 = (const struct sockaddr_in *)addr;
+            inet_ntop(AF_INET, &addr4->sin_addr, host, sizeof(host));
+            snprintf(src->name, sizeof(src->name), "%s:%d", host, ntohs(addr4->sin_port));
+        }
+    }
+    hb_histogram_init(&src->edge_to_receipt);
+    hb_histogram_init(&src->receipt_to_output);
+    __atomic_store_n(&trng_nsources, trng_nsources + 1, __ATOMIC_RELEASE);
+    return src;
+}
+
+static void latency_line(int fd, const char *what, const char *name,
+                         const struct hb_histogram *src) {
+    // A consistent copy, so the count and percentiles agree; the capture
+    // thread keeps recording into src meanwhile
+    static struct hb_histogram h;
+    hb_histogram_snapshot(&h, src);
+    reply(fd, "%s %s count %lu p50_ns %lu p90_ns %lu p99_ns %lu p999_ns %lu max_ns %lu\n",
+          what, name, h.count, hb_histogram_percentile(&h, 0.50),
+          hb_histogram_percentile(&h, 0.90), hb_histogram_percentile(&h, 0.99),
+          hb_histogram_percentile(&h, 0.999), h.max);
+}
+
+static void latency(int fd) {
+    int n = __atomic_load_n(&trng_nsources, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < n; i++) {
+        const Source *src = &trng_sources[i];
+        reply(fd, "source %s events %lu gaps %lu late %lu duplicates %lu skewed %lu "
+                  "malformed %lu\n",
+              src->name, stat_get(&src->events), stat_get(&src->gaps), stat_get(&src->late),
+              stat_get(&src->duplicates), stat_get(&src->skewed), stat_get(&src->malformed));
+        latency_line(fd, "edge_to_receipt", src->name, &src->edge_to_receipt);
+        latency_line(fd, "receipt_to_output", src->name, &src->receipt_to_output);
+    }
+}
+
+static void help(int fd) {
+    reply(fd, "help\nshow\nstats\nlatency\nsink add HOST PORT\nsink del HOST PORT\n"
+              "format text|csv|binary\nbatch EVENTS MS\npacket EVENTS MS\nverbose on|off\n");
+}
+
+// Returns an error reason, or NULL after publishing the change (or for
+// read-only commands)
+static const char *command(int fd, char *line) {
+    char *save = NULL;
+    char *argv[5];
+    int argc = 0;
+    for (char *tok = strtok_r(line, " \t\r", &save); tok && argc < 5;
+         tok = strtok_r(NULL, " \t\r", &save)) {
+        argv[argc++] = tok;
+    }
+    if (argc == 0) {
+        return "empty command";
+    }
+
+    // Only this thread publishes, so the current Runtime stays valid here
+    const Runtime *cur = __atomic_load_n(&runtime_current, __ATOMIC_ACQUIRE);
+    if (strcmp(argv[0], "help") == 0) {
+        help(fd);
+        return NULL;
+    }
+    if (strcmp(argv[0], "show") == 0) {
+        show(fd, cur);
+        return NULL;
+    }
+    if (strcmp(argv[0], "stats") == 0) {
+        stats(fd, cur);
+        return NULL;
+    }
+    if (strcmp(argv[0], "latency") == 0) {
+        latency(fd);
+        return NULL;
+    }
+
+    Runtime *next = runtime_copy(cur);
+    if (!next) {
+        return "out of memory";
+    }
+    const char *err = NULL;
+
+    if (strcmp(argv[0], "sink") == 0 && argc == 4) {
+        Sink sink;
+        if (sink_parse(&sink, argv[2], atoi(argv[3]), AF_UNSPEC) < 0) {
+            err = "invalid address";
+        } else if (strcmp(argv[1], "add") == 0) {
+            if (runtime_add_sink(next, &sink) < 0) {
+                err = "sink exists or too many sinks";
+            } else if (sink_socket(next, &sink) < 0) {
+                err = strerror(errno);
+            }
+        } else if (strcmp(argv[1], "del") == 0) {
+            if (runtime_remove_sink(next, &sink) < 0) {
+                err = "no such sink";
+            }
+        } else {
+            err = "usage: sink add|del HOST PORT";
+        }
+    } else if (strcmp(argv[0], "format") == 0 && argc == 2) {
+        err = "unknown format";
+        for (int i = 0; i < (int)(sizeof(format_names) / sizeof(format_names[0])); i++) {
+            if (strcmp(argv[1], format_names[i]) == 0) {
+                next->format = i;
+                err = NULL;
+            }
+        }
+    } else if (strcmp(argv[0], "batch") == 0 && argc == 3) {
+        int events = atoi(argv[1]);
+        int ms = atoi(argv[2]);
+        if (events < 1 || events > MAX_BATCH_EVENTS || ms < 1 || ms > MAX_BATCH_MS) {
+            err = "batch needs 1-100000 events and 1-60000 ms";
+        } else {
+            next->batch_events = events;
+            next->batch_ms = ms;
+        }
+    } else if (strcmp(argv[0], "packet") == 0 && argc == 3) {
+        int events = atoi(argv[1]);
+        int ms = atoi(argv[2]);
+        if (events < 1 || events > CONTROL_MAX_PACKET_EVENTS || ms < 1 || ms > MAX_BATCH_MS) {
+            err = "packet needs 1-2048 events and 1-60000 ms";
+        } else {
+            next->packet_events = events;
+            next->packet_ms = ms;
+        }
+    } else if (strcmp(argv[0], "verbose") == 0 && argc == 2 &&
+               (strcmp(argv[1], "on") == 0 || strcmp(argv[1], "off") == 0)) {
+        next->verbose = strcmp(argv[1], "on") == 0;
+    } else {
+        err = "unknown command, try help";
+    }
+
+    if (err) {
+        free(next);
+        return err;
+    }
+    runtime_publish(next);
+    return NULL;
+}
+
+static int stopping(void) {
+    return __atomic_load_n(&control.stop, __ATOMIC_ACQUIRE);
+}
+
+static void serve_client(int fd) {
+    char buf[LINE_MAX_BYTES];
+    size_t len = 0;
+
+    while (!stopping()) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        int ready = poll(&pfd, 1, 1000);
+        if (ready < 0 && errno != EINTR) {
+            break;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+
+        ssize_t n = read(fd, buf + len, sizeof(buf) - 1 - len);
+        if (n <= 0) {
+            break;
+        }
+        len += n;
+
+        char *nl;
+        while ((nl = memchr(buf, '\n', len))) {
+            *nl = '\0';
+            const char *err = command(fd, buf);
+            if (err) {
+                reply(fd, "error %s\n", err);
+            } else {
+                reply(fd, "ok\n");
+            }
+            len -= nl + 1 - buf;
+            memmove(buf, nl + 1, len);
+        }
+        if (len == sizeof(buf) - 1) {
+            reply(fd, "error line too long\n");
+            len = 0;
+        }
+    }
+}
+
+static void *control_thread(void *arg) {
+    (void)arg;
+    while (!stopping()) {
+        struct pollfd pfd = { .fd = control.listen_fd, .events = POLLIN };
+        if (poll(&pfd, 1, 1000) <= 0) {
+            continue;
+        }
+        int fd = accept4(control.listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        serve_client(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+int control_start(const char *path, int staged) {
+    // Same stale-socket handling as the handoff socket
+    if (staged) {
+        snprintf(control.path, sizeof(control.path), "%s.%ld", path, (long)getpid());
+    } else {
+        snprintf(control.path, sizeof(control.path), "%s", path);
+    }
+    snprintf(control.final_path, sizeof(control.final_path), "%s", path);
+    control.listen_fd = handoff_listen(control.path);
+    if (control.listen_fd < 0) {
+        return -1;
+    }
+    control.started_at = time(NULL);
+
+    // SIGINT/SIGTERM go to the capture thread, whose poll they interrupt
+    sigset_t block, saved;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block, &saved);
+    int rc = pthread_create(&control.thread, NULL, control_thread, NULL);
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+    if (rc != 0) {
+        fprintf(stderr, "pthread_create: %s\n", strerror(rc));
+        close(control.listen_fd);
+        control.listen_fd = -1;
+        unlink(control.path);
+        return -1;
+    }
+    control.started = 1;
+    return 0;
+}
+
+int control_commit(int replace) {
+    if (control.listen_fd < 0 || strcmp(control.path, control.final_path) == 0) {
+        return 0;
+    }
+    if (!replace) {
+        int live = handoff_connect(control.final_path);
+        if (live >= 0) {
+            close(live);
+            fprintf(stderr, "%s: in use by a running process\n", control.final_path);
+            return -1;
+        }
+    }
+    if (rename(control.path, control.final_path) < 0) {
+        perror(control.final_path);
+        return -1;
+    }
+    snprintf(control.path, sizeof(control.path), "%s", control.final_path);
+    return 0;
+}
+
+void control_stop(int keep_path) {
+    if (control.started) {
+        __atomic_store_n(&control.stop, 1, __ATOMIC_RELEASE);
+        pthread_join(control.thread, NULL);
+        control.started = 0;
+    }
+    if (control.listen_fd >= 0) {
+        close(control.listen_fd);
+        control.listen_fd = -1;
+        if (!keep_path) {
+            unlink(control.path);
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        if (control.sink_fd[i] >= 0) {
+            close(control.sink_fd[i]);
+            control.sink_fd[i] = -1;
+        }
+    }
+}
@@ -0,0 +1,129 @@
+#ifndef TRNG_CONTROL_H
+#define TRNG_CONTROL_H
+
+#include <stdint.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../hotbits/histogram.h"
+
+// Runtime configuration, changed while capture continues through a line
+// protocol on a Unix socket (--control PATH, see control.c for commands).
+//
+// The capture thread reads the current Runtime without taking a lock. The
+// control thread never modifies it in place: it copies it, edits the copy,
+// publishes the copy with one atomic pointer store and frees the old one
+// after a grace period, once the capture thread has been outside its
+// read-side section (blocked in poll, or between two events).
+#define CONTROL_MAX_SINKS 16
+// Event records per datagram (24 bytes each), under the UDP payload limit
+#define CONTROL_MAX_PACKET_EVENTS 2048
+
+enum {
+    FORMAT_TEXT = 0,                    // delta_ns per line (the segment format)
+    FORMAT_CSV,                         // timestamp_ns,delta_ns per line
+    FORMAT_BINARY                       // delta_ns as little-endian uint64
+};
+
+typedef struct {
+    struct sockaddr_storage addr;
+    socklen_t len;
+    char name[INET6_ADDRSTRLEN + 8];    // "host:port" as given
+} Sink;
+
+typedef struct {
+    uint64_t generation;
+    int verbose;
+    int format;                         // stdout only; segments are always text
+    int batch_events;                   // flush output after this many events
+    int batch_ms;                       // ...or when the oldest unflushed is this old
+    int packet_events;                  // send a datagram once it holds this many events
+    int packet_ms;                      // ...or when its oldest event is this old
+    int nsinks;                         // UDP destinations for event packets
+    Sink sinks[CONTROL_MAX_SINKS];
+    int sink_fd[2];                     // IPv4 and IPv6 send sockets, -1 until needed
+} Runtime;
+
+// Counters written by the capture thread only, read by "stats"
+typedef struct {
+    uint64_t events;
+    uint64_t bytes;
+    uint64_t flushes;
+    uint64_t packets;                   // datagrams sent, counted per sink
+    uint64_t send_errors;
+} TrngStats;
+
+// Where events come from, with their latency from detector edge to
+// output: the local GPIO line, or each sender seen in receive mode. The
+// capture thread fills a slot before publishing trng_nsources (release)
+// and is the only writer; "latency" reads them. Senders beyond the table
+// are passed through without accounting.
+#define CONTROL_MAX_SOURCES 16
+// Sequence numbers remembered per sender to tell late packets from
+// duplicates
+#define SOURCE_SEQ_WINDOW 4096
+
+typedef struct {
+    struct sockaddr_storage addr;
+    socklen_t len;
+    char name[INET6_ADDRSTRLEN + 8];
+    uint64_t events;
+    uint64_t gaps;                      // sequence numbers skipped
+    uint64_t late;                      // ...of which arrived afterwards (reordered)
+    uint64_t duplicates;                // sequence numbers seen before
+    uint64_t skewed;                    // edge timestamps in the future or over a minute old
+    uint64_t malformed;                 // datagrams dropped as truncated or not whole packets
+    uint32_t expected;                  // next sequence number
+    int have_expected;
+    uint64_t seen[SOURCE_SEQ_WINDOW / 64];  // bit (n % window) for the last window numbers
+    struct hb_histogram edge_to_receipt;    // edge to the kernel receive timestamp
+    struct hb_histogram receipt_to_output;  // receipt to output flushed
+} Source;
+
+extern TrngStats trng_stats;
+extern Runtime *runtime_current;
+extern Source trng_sources[CONTROL_MAX_SOURCES];
+extern int trng_nsources;
+
+#define STAT_ADD(field, n) \
+    __atomic_store_n(&trng_stats.field, trng_stats.field + (n), __ATOMIC_RELAXED)
+#define SOURCE_ADD(src, field, n) \
+    __atomic_store_n(&(src)->field, (src)->field + (n), __ATOMIC_RELAXED)
+
+// Capture thread: the slot for sender addr, named host:port, or with len
+// 0 the one for the local line under name. Added if new; NULL when the
+// table is full.
+Source *source_lookup(const struct sockaddr_storage *addr, socklen_t len, const char *name);
+
+// Capture thread: the pointer stays valid until runtime_offline()
+static inline const Runtime *runtime_get(void) {
+    return __atomic_load_n(&runtime_current, __ATOMIC_ACQUIRE);
+}
+void runtime_online(void);
+void runtime_offline(void);
+
+// A copy of from, or the defaults when from is NULL
+Runtime *runtime_copy(const Runtime *from);
+// Make rt current and free the previous one after a grace period. Only
+// one thread may publish at a time (main before control_start, then the
+// control thread).
+void runtime_publish(Runtime *rt);
+
+// family AF_UNSPEC accepts either address family
+int sink_parse(Sink *sink, const char *host, int port, int family);
+int runtime_add_sink(Runtime *rt, const Sink *sink);
+int runtime_remove_sink(Runtime *rt, const Sink *sink);
+
+// Start serving the control socket on its own thread. With staged set it
+// is bound at PATH.PID until control_commit moves it to PATH, so a running
+// trng keeps PATH until it has handed off; control_commit fails if a live
+// process still owns PATH, unless replace is set. control_stop removes the
+// socket file unless keep_path is set (after a hot restart it belongs to
+// the new process).
+int control_start(const char *path, int staged);
+int control_commit(int replace);
+void control_stop(int keep_path);
+
+#endif
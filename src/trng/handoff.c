@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "handoff.h"
+
+#define ACK_ACCEPT 'K'
+#define ACK_REFUSE 'N'
+
+static int make_address(struct sockaddr_un *addr, const char *path) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        fprintf(stderr, "Handoff socket path too long: %s\n", path);
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+int handoff_connect(const char *path) {
+    struct sockaddr_un addr;
+    if (make_address(&addr, path) < 0) {
+        return -1;
+    }
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        int saved = errno;
+        close(sock);
+        errno = saved;
+        return -1;
+    }
+    return sock;
+}
+
+int handoff_listen(const char *path) {
+    struct sockaddr_un addr;
+    if (make_address(&addr, path) < 0) {
+        return -1;
+    }
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (sock < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    // A socket file left by a process that died without handing off: only
+    // one nobody accepts on is removed, never a live process's
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        int live = handoff_connect(path);
+        if (live >= 0) {
+            close(live);
+            fprintf(stderr, "%s: in use by a running process\n", path);
+            close(sock);
+            errno = EADDRINUSE;
+            return -1;
+        }
+        if (errno == ECONNREFUSED) {
+            unlink(path);
+        }
+    }
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(sock, 1) < 0) {
+        perror(path);
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+int handoff_send(int sock, const HandoffState *state, const int fds[HANDOFF_MAX_FDS]) {
+    HandoffState msg = *state;
+    int pass[HANDOFF_MAX_FDS];
+    int npass = 0;
+    for (int i = 0; i < HANDOFF_MAX_FDS; i++) {
+        msg.fd_present[i] = fds[i] >= 0;
+        if (fds[i] >= 0) {
+            pass[npass++] = fds[i];
+        }
+    }
+
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * HANDOFF_MAX_FDS)];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct iovec iov = { .iov_base = &msg, .iov_len = sizeof(msg) };
+    struct msghdr mh = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = npass ? control.buf : NULL,
+        .msg_controllen = npass ? CMSG_SPACE(sizeof(int) * npass) : 0
+    };
+    if (npass) {
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&mh);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * npass);
+        memcpy(CMSG_DATA(cmsg), pass, sizeof(int) * npass);
+    }
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(sock, &mh, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    if (sent != (ssize_t)sizeof(msg)) {
+        perror("handoff sendmsg");
+        return -1;
+    }
+
+    struct pollfd pfd = { .fd = sock, .events = POLLIN };
+    int ready;
+    do {
+        ready = poll(&pfd, 1, HANDOFF_ACK_TIMEOUT_MS);
+    } while (ready < 0 && errno == EINTR);
+    char ack = 0;
+    if (ready <= 0 || read(sock, &ack, 1) != 1) {
+        fprintf(stderr, "No answer from the new process\n");
+        return -1;
+    }
+    return ack == ACK_ACCEPT ? 0 : -1;
+}
+
+int handoff_receive(int sock, HandoffState *state, int fds[HANDOFF_MAX_FDS]) {
+    for (int i = 0; i < HANDOFF_MAX_FDS; i++) {
+        fds[i] = -1;
+    }
+
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * HANDOFF_MAX_FDS)];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = { .iov_base = state, .iov_len = sizeof(*state) };
+    struct msghdr mh = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.buf,
+        .msg_controllen = sizeof(control.buf)
+    };
+
+    ssize_t got;
+    do {
+        got = recvmsg(sock, &mh, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+    } while (got < 0 && errno == EINTR);
+    if (got < 0) {
+        perror("handoff recvmsg");
+        return -1;
+    }
+
+    int received[HANDOFF_MAX_FDS];
+    int nreceived = 0;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&mh); c; c = CMSG_NXTHDR(&mh, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS) {
+            nreceived = (int)((c->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            if (nreceived > HANDOFF_MAX_FDS) {
+                nreceived = HANDOFF_MAX_FDS;
+            }
+            memcpy(received, CMSG_DATA(c), sizeof(int) * nreceived);
+        }
+    }
+
+    if (got != (ssize_t)sizeof(*state) || state->magic != HANDOFF_MAGIC ||
+        state->version != HANDOFF_VERSION || (mh.msg_flags & MSG_CTRUNC)) {
+        fprintf(stderr, "Malformed handoff from the running trng\n");
+        for (int i = 0; i < nreceived; i++) {
+            close(received[i]);
+        }
+        return -1;
+    }
+
+    int next = 0;
+    for (int i = 0; i < HANDOFF_MAX_FDS && next < nreceived; i++) {
+        if (state->fd_present[i]) {
+            fds[i] = received[next++];
+        }
+    }
+    return 0;
+}
+
+int handoff_reply(int sock, int accepted) {
+    char ack = accepted ? ACK_ACCEPT : ACK_REFUSE;
+    if (write(sock, &ack, 1) != 1) {
+        perror("handoff reply");
+        return -1;
+    }
+    return 0;
+}
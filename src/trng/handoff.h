@@ -0,0 +1,58 @@
+#ifndef TRNG_HANDOFF_H
+#define TRNG_HANDOFF_H
+
+#include <stdint.h>
+#include <limits.h>
+
+// Hot restart: a running trng listens on a Unix socket (--handoff PATH).
+// A new trng started with the same PATH connects to it, and the old
+// process stops reading events and sends its capture state together with
+// its open descriptors (SCM_RIGHTS): the handoff socket itself, the GPIO
+// line request or receive socket, and the broadcast socket. Events that
+// arrive meanwhile wait in the kernel queues of those descriptors, so the
+// new process reads them next, as long as the queues have room: the GPIO
+// v1 line event queue holds 16 events and drops further edges silently.
+// The old process exits once the new one acknowledges, or resumes capture
+// if it refuses or goes away.
+#define HANDOFF_MAGIC 0x54524e47u       // "TRNG"
+#define HANDOFF_VERSION 1
+#define HANDOFF_MAX_FDS 3
+#define HANDOFF_ACK_TIMEOUT_MS 5000
+
+enum {
+    HANDOFF_FD_LISTEN = 0,
+    HANDOFF_FD_SOURCE = 1,              // GPIO line request fd or UDP receive socket
+    HANDOFF_FD_BROADCAST = 2            // -1 when not broadcasting
+};
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int32_t mode;
+    char source[128];                   // "chip:line" or "host:port", must match
+    uint32_t sequence;                  // next broadcast sequence number
+    int64_t last_sec;                   // timestamp of the last event read,
+    int64_t last_nsec;                  // zero before the first
+    char output_dir[PATH_MAX];          // segment continued when unchanged
+    char segment_path[PATH_MAX];        // empty when no segment is open
+    int64_t segment_opened;
+    int32_t fd_present[HANDOFF_MAX_FDS];
+} HandoffState;
+
+// Bind and listen on path, replacing a stale socket nobody listens on.
+// Fails with EADDRINUSE when a process still accepts on it.
+int handoff_listen(const char *path);
+
+// Connect to a running trng. Returns the socket, or -1 with errno ENOENT
+// or ECONNREFUSED when none is listening.
+int handoff_connect(const char *path);
+
+// Old process: send the state and descriptors (-1 entries are skipped),
+// then wait for the verdict. Returns 0 if the new process took over.
+int handoff_send(int sock, const HandoffState *state, const int fds[HANDOFF_MAX_FDS]);
+
+// New process: receive them (missing descriptors are -1), then answer
+int handoff_receive(int sock, HandoffState *state, int fds[HANDOFF_MAX_FDS]);
+int handoff_reply(int sock, int accepted);
+
+#endif
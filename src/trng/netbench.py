@@ -0,0 +1,363 @@
+#!/usr/bin/env python3
+"""
+Broadcast -> receive load and loss benchmark for trng
+
+Runs one trng sender with a simulated Poisson source (--simulate) and R
+trng receivers, then reads every process's control socket and reports,
+per (rate, events per datagram, receivers) cell:
+
+  loss        events sent but never received, per receiver
+  reordered   sequence numbers that arrived after a later one ("late")
+  duplicates  sequence numbers received twice
+  malformed   datagrams dropped as truncated or not whole packets
+  throughput  events/s each receiver took in
+  cpu         sender and receiver CPU time per event (/proc/PID/stat)
+  latency     edge to receive-timestamp p50/p99/p99.9, worst receiver
+
+By default everything runs over loopback. With --netns (root, iproute2)
+the sender and the receivers run in two network namespaces joined by a
+veth pair, and --netem adds delay/loss/reordering on the sender's side
+of it, e.g. --netem "delay 1ms 0.5ms loss 0.1% reorder 1%".
+
+Usage:
+  netbench.py [--rates 1,10,...] [--packet-events 1,16,256]
+              [--receivers 1,4] [--duration 2] [--json results.json]
+"""
+
+import argparse
+import json
+import os
+import shutil
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+CLOCK_TICKS = os.sysconf('SC_CLK_TCK')
+NETNS_TX = 'trng-nb-tx'
+NETNS_RX = 'trng-nb-rx'
+NETNS_TX_ADDR = '10.203.0.1'
+NETNS_RX_ADDR = '10.203.0.2'
+
+
+def int_list(text):
+    return [int(float(x)) for x in text.split(',') if x]
+
+
+def control(path, command):
+    """Send one control command; returns its reply lines without 'ok'."""
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+        sock.settimeout(5)
+        sock.connect(path)
+        stream = sock.makefile('rw')
+        stream.write(command + '\n')
+        stream.flush()
+        lines = []
+        for line in stream:
+            line = line.rstrip('\n')
+            if line == 'ok':
+                return lines
+            if line.startswith('error'):
+                raise RuntimeError(f'{command}: {line}')
+            lines.append(line)
+    raise RuntimeError(f'{command}: connection closed')
+
+
+def wait_for_socket(path, proc, timeout=5.0):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        if proc.poll() is not None:
+            raise RuntimeError(f'trng exited with status {proc.returncode}')
+        if os.path.exists(path):
+            try:
+                control(path, 'stats')
+                return
+            except (OSError, RuntimeError):
+                pass
+        time.sleep(0.02)
+    raise RuntimeError(f'no control socket at {path}')
+
+
+def stats(path):
+    """'stats' as a dict of integers."""
+    values = {}
+    for line in control(path, 'stats'):
+        key, _, value = line.partition(' ')
+        try:
+            values[key] = int(value)
+        except ValueError:
+            pass
+    return values
+
+
+def latency(path):
+    """'latency' per source: the counters plus the edge_to_receipt percentiles."""
+    sources = {}
+    for line in control(path, 'latency'):
+        words = line.split()
+        if not words:
+            continue
+        if words[0] == 'source':
+            fields = dict(zip(words[-12::2], (int(x) for x in words[-11::2])))
+            sources[' '.join(words[1:-12])] = fields
+        elif words[0] == 'edge_to_receipt':
+            name = ' '.join(words[1:-12])
+            percentiles = dict(zip(words[-12::2], (int(x) for x in words[-11::2])))
+            sources.setdefault(name, {}).update(
+                {'edge_' + k: v for k, v in percentiles.items()})
+    return sources
+
+
+def cpu_seconds(pid):
+    """User plus system CPU time of pid and its reaped children."""
+    try:
+        with open(f'/proc/{pid}/stat') as f:
+            fields = f.read().rsplit(')', 1)[1].split()
+    except OSError:
+        return 0.0
+    # utime, stime, cutime, cstime are fields 14-17; fields[0] is field 3
+    return sum(int(x) for x in fields[11:15]) / CLOCK_TICKS
+
+
+def trng_pid(proc):
+    """PID of trng itself when it runs under 'ip netns exec'."""
+    try:
+        with open(f'/proc/{proc.pid}/task/{proc.pid}/children') as f:
+            children = f.read().split()
+        return int(children[0]) if children else proc.pid
+    except OSError:
+        return proc.pid
+
+
+class Network:
+    """Where the sender and receivers run, and the addresses they use."""
+
+    def __init__(self, netns=False, netem=None):
+        self.netns = netns
+        self.netem = netem
+        self.tx_prefix = []
+        self.rx_prefix = []
+        self.address = '127.0.0.1'
+
+    def run(self, *args):
+        subprocess.run(['ip', *args], check=True, stdout=subprocess.DEVNULL)
+
+    def __enter__(self):
+        if not self.netns:
+            return self
+        self.__exit__()
+        try:
+            self.setup()
+        except (OSError, subprocess.CalledProcessError):
+            self.__exit__()
+            raise
+        self.tx_prefix = ['ip', 'netns', 'exec', NETNS_TX]
+        self.rx_prefix = ['ip', 'netns', 'exec', NETNS_RX]
+        self.address = NETNS_RX_ADDR
+        return self
+
+    def setup(self):
+        self.run('netns', 'add', NETNS_TX)
+        self.run('netns', 'add', NETNS_RX)
+        self.run('link', 'add', 'nb-tx', 'netns', NETNS_TX, 'type', 'veth',
+                 'peer', 'name', 'nb-rx', 'netns', NETNS_RX)
+        for ns, dev, addr in ((NETNS_TX, 'nb-tx', NETNS_TX_ADDR),
+                              (NETNS_RX, 'nb-rx', NETNS_RX_ADDR)):
+            self.run('-n', ns, 'addr', 'add', addr + '/24', 'dev', dev)
+            self.run('-n', ns, 'link', 'set', dev, 'up')
+            self.run('-n', ns, 'link', 'set', 'lo', 'up')
+        if self.netem:
+            subprocess.run(['ip', 'netns', 'exec', NETNS_TX, 'tc', 'qdisc', 'add',
+                            'dev', 'nb-tx', 'root', 'netem', *self.netem.split()],
+                           check=True)
+
+    def __exit__(self, *exc):
+        if self.netns:
+            for ns in (NETNS_TX, NETNS_RX):
+                subprocess.run(['ip', 'netns', 'del', ns],
+                               stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+
+def stop(procs):
+    for proc in procs:
+        if proc.poll() is None:
+            proc.terminate()
+    for proc in procs:
+        try:
+            proc.wait(timeout=5)
+        except subprocess.TimeoutExpired:
+            proc.kill()
+            proc.wait()
+
+
+def run_cell(args, net, workdir, rate, packet_events, receivers):
+    count = max(2, round(rate * args.duration))
+    ports = [args.port + i for i in range(receivers)]
+    procs = []
+    try:
+        rx_sockets = []
+        for i, port in enumerate(ports):
+            path = os.path.join(workdir, f'rx{i}.sock')
+            proc = subprocess.Popen(
+                net.rx_prefix + [args.trng, '-m', 'receive', '-h', net.address,
+                                 '-p', str(port), '-C', path],
+                stdout=subprocess.DEVNULL)
+            procs.append(proc)
+            wait_for_socket(path, proc)
+            rx_sockets.append(path)
+
+        tx_socket = os.path.join(workdir, 'tx.sock')
+        command = [args.trng, '-m', 'broadcast', '-h', net.address, '-p', str(ports[0]),
+                   '--simulate', f'{rate}:{count}', '--packet-events', str(packet_events),
+                   '--packet-ms', str(args.packet_ms), '-C', tx_socket]
+        for port in ports[1:]:
+            command += ['--sink', f'{net.address}:{port}']
+        started = time.monotonic()
+        sender = subprocess.Popen(net.tx_prefix + command, stdout=subprocess.DEVNULL)
+        procs.append(sender)
+        wait_for_socket(tx_socket, sender)
+
+        # The first edge has no delta: count events give count - 1 deltas
+        deadline = started + args.duration * 3 + 10
+        sent = 0
+        while time.monotonic() < deadline:
+            sent = stats(tx_socket).get('events', 0)
+            if sent >= count - 1:
+                break
+            time.sleep(0.05)
+        generated = time.monotonic() - started
+        time.sleep(args.drain + args.packet_ms / 1000)
+
+        sender_cpu = cpu_seconds(trng_pid(sender))
+        results = []
+        for proc, path in zip(procs, rx_sockets):
+            sources = latency(path)
+            source = max(sources.values(), key=lambda s: s.get('events', 0),
+                         default={})
+            received = source.get('events', 0)
+            duplicates = source.get('duplicates', 0)
+            results.append({
+                'received': received,
+                'lost': max(0, sent - (received - duplicates)),
+                'reordered': source.get('late', 0),
+                'duplicates': duplicates,
+                'malformed': source.get('malformed', 0),
+                'cpu_s': cpu_seconds(trng_pid(proc)),
+                'edge_p50_ns': source.get('edge_p50_ns', 0),
+                'edge_p99_ns': source.get('edge_p99_ns', 0),
+                'edge_p999_ns': source.get('edge_p999_ns', 0),
+            })
+        tx = stats(tx_socket)
+    finally:
+        stop(procs)
+
+    received = sum(r['received'] for r in results)
+    return {
+        'rate': rate,
+        'packet_events': packet_events,
+        'receivers': receivers,
+        'sent': sent,
+        'seconds': round(generated, 3),
+        'datagrams': tx.get('packets', 0),
+        'send_errors': tx.get('send_errors', 0),
+        'lost': sum(r['lost'] for r in results),
+        'loss_ratio': sum(r['lost'] for r in results) / (sent * receivers) if sent else 0.0,
+        'reordered': sum(r['reordered'] for r in results),
+        'duplicates': sum(r['duplicates'] for r in results),
+        'malformed': sum(r['malformed'] for r in results),
+        'throughput': received / receivers / generated if generated else 0.0,
+        'sender_cpu_us_per_event': sender_cpu * 1e6 / sent if sent else 0.0,
+        'receiver_cpu_us_per_event':
+            sum(r['cpu_s'] for r in results) * 1e6 / received if received else 0.0,
+        'edge_p50_ns': max(r['edge_p50_ns'] for r in results),
+        'edge_p99_ns': max(r['edge_p99_ns'] for r in results),
+        'edge_p999_ns': max(r['edge_p999_ns'] for r in results),
+        'per_receiver': results,
+    }
+
+
+def format_ns(ns):
+    if ns >= 1e6:
+        return f'{ns / 1e6:.2f}ms'
+    if ns >= 1e3:
+        return f'{ns / 1e3:.1f}us'
+    return f'{ns}ns'
+
+
+def print_header():
+    print(f"{'rate/s':>9} {'ev/pkt':>6} {'rx':>3} {'sent':>9} {'loss':>8} "
+          f"{'reord':>6} {'dup':>5} {'ev/s':>10} {'tx us/ev':>8} {'rx us/ev':>8} "
+          f"{'p50':>9} {'p99':>9} {'p99.9':>9}")
+
+
+def print_row(r):
+    print(f"{r['rate']:>9} {r['packet_events']:>6} {r['receivers']:>3} {r['sent']:>9} "
+          f"{100 * r['loss_ratio']:>7.3f}% {r['reordered']:>6} {r['duplicates']:>5} "
+          f"{r['throughput']:>10.0f} {r['sender_cpu_us_per_event']:>8.2f} "
+          f"{r['receiver_cpu_us_per_event']:>8.2f} {format_ns(r['edge_p50_ns']):>9} "
+          f"{format_ns(r['edge_p99_ns']):>9} {format_ns(r['edge_p999_ns']):>9}",
+          flush=True)
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(
+        description='Load and loss benchmark for trng broadcast -> receive')
+    parser.add_argument('--trng', default=os.path.join(here, 'trng'),
+                        help='trng binary (default: next to this script)')
+    parser.add_argument('--rates', type=int_list,
+                        default=[1, 10, 100, 1000, 10000, 100000, 1000000],
+                        help='simulated events/s to sweep (default: 1 to 1e6 by decades)')
+    parser.add_argument('--packet-events', type=int_list, default=[1, 16, 256],
+                        help='events per datagram to sweep (default: 1,16,256)')
+    parser.add_argument('--packet-ms', type=int, default=10,
+                        help='longest an event waits for its datagram (default: 10)')
+    parser.add_argument('--receivers', type=int_list, default=[1],
+                        help='receiver counts to sweep (default: 1)')
+    parser.add_argument('--duration', type=float, default=2.0,
+                        help='seconds of events per cell (default: 2)')
+    parser.add_argument('--drain', type=float, default=0.5,
+                        help='seconds to wait for the last datagrams (default: 0.5)')
+    parser.add_argument('--port', type=int, default=17800,
+                        help='first receiver UDP port (default: 17800)')
+    parser.add_argument('--netns', action='store_true',
+                        help='run sender and receivers in two namespaces over veth (root)')
+    parser.add_argument('--netem', help='tc netem options for the veth link (with --netns)')
+    parser.add_argument('--json', help='write the results to this file')
+    args = parser.parse_args()
+
+    if not os.access(args.trng, os.X_OK):
+        sys.exit(f'{args.trng} not found; build it with make')
+    if args.netem and not args.netns:
+        sys.exit('--netem requires --netns')
+    if args.netns and (os.geteuid() != 0 or not shutil.which('ip')):
+        sys.exit('--netns needs root and iproute2')
+    if args.netem and not shutil.which('tc'):
+        sys.exit('--netem needs tc (iproute2)')
+    if any(n < 1 or n > 2048 for n in args.packet_events):
+        sys.exit('--packet-events must be 1 to 2048')
+    if any(n < 1 or n > 16 for n in args.receivers):
+        sys.exit('--receivers must be 1 to 16')
+
+    results = []
+    with Network(args.netns, args.netem) as net, \
+            tempfile.TemporaryDirectory(prefix='trng-netbench-') as workdir:
+        print_header()
+        for receivers in args.receivers:
+            for packet_events in args.packet_events:
+                for rate in args.rates:
+                    result = run_cell(args, net, workdir, rate, packet_events, receivers)
+                    results.append(result)
+                    print_row(result)
+
+    if args.json:
+        with open(args.json, 'w') as f:
+            json.dump({'netns': args.netns, 'netem': args.netem,
+                       'duration': args.duration, 'results': results}, f, indent=2)
+            f.write('\n')
+        print(f'Results written to {args.json}')
+
+
+if __name__ == '__main__':
+    main()
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,17 +8,31 @@
 #include <signal.h>
 #include <errno.h>
 #include <getopt.h>
+#include <poll.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netdb.h>
+#include <limits.h>
+#include <math.h>
+#include <sys/stat.h>
+#ifdef HAVE_GPIOD
 #include <gpiod.h>
+#endif
+
+#include "../hotbits/index.h"
+#include "../hotbits/instrument.h"
+#include "../hotbits/trace.h"
+#include "handoff.h"
+#include "control.h"
 
 #define GPIO_LINE 5
 #define GPIO_CHIP "gpiochip0"
 #define DEFAULT_UDP_PORT 8888
 #define BUFFER_SIZE 1024
 #define MAX_PACKET_SIZE 65507
+#define DEFAULT_SEGMENT_SECONDS 3600
+#define MAX_EDGE_AGE_NS (60 * 1000000000ULL)
 
 typedef enum {
     MODE_LOCAL,
@@ -32,15 +47,43 @@ typedef struct {
     int use_ipv6;
     int gpio_line;
     char *gpio_chip;
+    char *output_dir;
+    int segment_seconds;
+    char *handoff_path;
+    char *control_path;
     int verbose;
+    double simulate_rate;       // events/s of the simulated source, 0 for the GPIO line
+    uint64_t simulate_count;    // events it generates, 0 for no limit
+    int packet_events;
+    int packet_ms;
+    char *sinks[CONTROL_MAX_SINKS - 1];  // --sink HOST:PORT, after the -h/-p destination
+    int nsinks;
 } Config;
 
+// Current events-<epoch>.txt segment when writing to --output-dir. Its
+// sparse index is built as lines are written and saved when it is closed.
+typedef struct {
+    FILE *file;
+    char path[PATH_MAX];
+    time_t opened;
+    struct hb_segment_index index;
+} Segment;
+
 typedef struct {
     uint64_t timestamp_ns;
     uint64_t delta_ns;
     uint32_t sequence;
 } TRNGPacket;
 
+// Capture state carried across a hot restart (see handoff.h)
+typedef struct {
+    uint32_t sequence;
+    struct timespec last_time;
+    int listen_fd;           // handoff socket, -1 without --handoff
+    int source_fd;           // inherited GPIO line request or receive socket
+    int handed_off;          // a successor took over; exit without cleanup
+} Capture;
+
 static volatile int running = 1;
 static Config config = {
     .mode = MODE_LOCAL,
@@ -49,8 +92,40 @@ static Config config = {
     .use_ipv6 = 0,
     .gpio_line = GPIO_LINE,
     .gpio_chip = GPIO_CHIP,
-    .verbose = 0
+    .output_dir = NULL,
+    .segment_seconds = DEFAULT_SEGMENT_SECONDS,
+    .verbose = 0,
+    .packet_events = 1,
+    .packet_ms = 10
 };
+static Segment segment = { .file = NULL };
+static Capture capture = {
+    .listen_fd = -1,
+    .source_fd = -1
+};
+
+// An event waiting for output, for its receipt-to-output latency
+typedef struct {
+    Source *source;
+    uint64_t received_ns;
+} Arrival;
+
+// Output written since the last flush, see --control "batch"
+static struct {
+    int events;
+    struct timespec first;
+    Arrival *arrivals;
+    int narrivals;
+    int arrivals_cap;
+} pending;
+
+// Event records waiting to go out together, see --packet-events. Kept in
+// network byte order.
+static struct {
+    TRNGPacket records[CONTROL_MAX_PACKET_EVENTS];
+    int count;
+    struct timespec first;
+} outgoing;
 
 void signal_handler(int sig) {
     if (sig == SIGINT || sig == SIGTERM) {
@@ -67,6 +142,19 @@ void print_usage(const char *prog) {
     fprintf(stderr, "  -6, --ipv6             Use IPv6 instead of IPv4\n");
     fprintf(stderr, "  -g, --gpio-line NUM    GPIO line number (default: %d)\n", GPIO_LINE);
     fprintf(stderr, "  -c, --chip NAME        GPIO chip name (default: %s)\n", GPIO_CHIP);
+    fprintf(stderr, "  -o, --output-dir DIR   Write events-<epoch>.txt segments (and indexes) to DIR\n");
+    fprintf(stderr, "                         instead of stdout\n");
+    fprintf(stderr, "  -S, --segment-seconds N  Start a new segment every N seconds (default: %d)\n",
+            DEFAULT_SEGMENT_SECONDS);
+    fprintf(stderr, "  -H, --handoff PATH     Take over capture from the trng listening on the Unix\n");
+    fprintf(stderr, "                         socket PATH (if any), then listen there for a successor\n");
+    fprintf(stderr, "  -C, --control PATH     Accept runtime configuration commands on the Unix socket PATH\n");
+    fprintf(stderr, "      --packet-events N  Send up to N events per datagram (default: 1, max: %d)\n",
+            CONTROL_MAX_PACKET_EVENTS);
+    fprintf(stderr, "      --packet-ms MS     ...holding none longer than MS milliseconds (default: 10)\n");
+    fprintf(stderr, "      --sink HOST:PORT   Also send event packets to HOST:PORT (repeatable)\n");
+    fprintf(stderr, "      --simulate RATE[:COUNT]  Generate Poisson events at RATE per second (COUNT of\n");
+    fprintf(stderr, "                         them, then idle) instead of reading the GPIO line\n");
     fprintf(stderr, "  -v, --verbose          Enable verbose output\n");
     fprintf(stderr, "  -?, --help             Show this help message\n");
     fprintf(stderr, "\nExamples:\n");
@@ -74,9 +162,16 @@ void print_usage(const char *prog) {
     fprintf(stderr, "  %s -m broadcast -h 192.168.1.255      # Broadcast to IPv4 network\n", prog);
     fprintf(stderr, "  %s -m broadcast -h ff02::1 -6         # Broadcast to IPv6 multicast\n", prog);
     fprintf(stderr, "  %s -m receive -h 0.0.0.0              # Receive on all interfaces\n", prog);
+    fprintf(stderr, "  %s -o ./data -S 3600                  # Hourly segments in ./data\n", prog);
+    fprintf(stderr, "  %s -o ./data -H ./state/trng.sock     # Restartable in place\n", prog);
+    fprintf(stderr, "  %s -m broadcast -h 127.0.0.1 --simulate 10000 --packet-events 16\n", prog);
+#ifndef HAVE_GPIOD
+    fprintf(stderr, "\nBuilt without libgpiod: local and broadcast mode need --simulate.\n");
+#endif
 }
 
 int parse_arguments(int argc, char *argv[]) {
+    enum { OPT_PACKET_EVENTS = 256, OPT_PACKET_MS, OPT_SINK, OPT_SIMULATE };
     static struct option long_options[] = {
         {"mode",      required_argument, 0, 'm'},
         {"host",      required_argument, 0, 'h'},
@@ -84,13 +179,21 @@ int parse_arguments(int argc, char *argv[]) {
         {"ipv6",      no_argument,       0, '6'},
         {"gpio-line", required_argument, 0, 'g'},
         {"chip",      required_argument, 0, 'c'},
+        {"output-dir", required_argument, 0, 'o'},
+        {"segment-seconds", required_argument, 0, 'S'},
+        {"handoff",   required_argument, 0, 'H'},
+        {"control",   required_argument, 0, 'C'},
+        {"packet-events", required_argument, 0, OPT_PACKET_EVENTS},
+        {"packet-ms", required_argument, 0, OPT_PACKET_MS},
+        {"sink",      required_argument, 0, OPT_SINK},
+        {"simulate",  required_argument, 0, OPT_SIMULATE},
         {"verbose",   no_argument,       0, 'v'},
         {"help",      no_argument,       0, '?'},
         {0, 0, 0, 0}
     };
 
     int opt;
-    while ((opt = getopt_long(argc, argv, "m:h:p:6g:c:v?", long_options, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "m:h:p:6g:c:o:S:H:C:v?", long_options, NULL)) != -1) {
         switch (opt) {
             case 'm':
                 if (strcmp(optarg, "local") == 0) {
@@ -123,6 +226,55 @@ int parse_arguments(int argc, char *argv[]) {
             case 'c':
                 config.gpio_chip = optarg;
                 break;
+            case 'o':
+                config.output_dir = optarg;
+                break;
+            case 'S':
+                config.segment_seconds = atoi(optarg);
+                if (config.segment_seconds <= 0) {
+                    fprintf(stderr, "Invalid segment length: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'H':
+                config.handoff_path = optarg;
+                break;
+            case 'C':
+                config.control_path = optarg;
+                break;
+            case OPT_PACKET_EVENTS:
+                config.packet_events = atoi(optarg);
+                if (config.packet_events < 1 || config.packet_events > CONTROL_MAX_PACKET_EVENTS) {
+                    fprintf(stderr, "Invalid packet events: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPT_PACKET_MS:
+                config.packet_ms = atoi(optarg);
+                if (config.packet_ms < 1) {
+                    fprintf(stderr, "Invalid packet interval: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPT_SINK:
+                if (config.nsinks == CONTROL_MAX_SINKS - 1) {
+                    fprintf(stderr, "Too many sinks (max: %d)\n", CONTROL_MAX_SINKS);
+                    return -1;
+                }
+                config.sinks[config.nsinks++] = optarg;
+                break;
+            case OPT_SIMULATE: {
+                char *end;
+                config.simulate_rate = strtod(optarg, &end);
+                if (*end == ':') {
+                    config.simulate_count = strtoull(end + 1, &end, 10);
+                }
+                if (config.simulate_rate <= 0 || *end != '\0') {
+                    fprintf(stderr, "Invalid simulated source: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            }
             case 'v':
                 config.verbose = 1;
                 break;
@@ -140,10 +292,30 @@ int parse_arguments(int argc, char *argv[]) {
         return -1;
     }
 
+    if (config.nsinks && config.mode != MODE_BROADCAST) {
+        fprintf(stderr, "--sink requires broadcast mode\n");
+        return -1;
+    }
+
     if (config.mode == MODE_RECEIVE && !config.host) {
         config.host = config.use_ipv6 ? "::" : "0.0.0.0";
     }
 
+    if (config.simulate_rate > 0 && config.mode == MODE_RECEIVE) {
+        fprintf(stderr, "--simulate replaces the GPIO line; receive mode has none\n");
+        return -1;
+    }
+    if (config.simulate_rate > 0 && config.handoff_path) {
+        fprintf(stderr, "--simulate has no capture state to hand off\n");
+        return -1;
+    }
+#ifndef HAVE_GPIOD
+    if (config.mode != MODE_RECEIVE && config.simulate_rate <= 0) {
+        fprintf(stderr, "Built without libgpiod: use --simulate or receive mode\n");
+        return -1;
+    }
+#endif
+
     return 0;
 }
 
@@ -214,68 +386,593 @@ int create_socket(int is_receiver) {
     return sock;
 }
 
-int send_packet(int sock, const TRNGPacket *packet) {
-    struct sockaddr_storage addr;
-    socklen_t addr_len;
-    
-    memset(&addr, 0, sizeof(addr));
-    
-    if (config.use_ipv6) {
-        struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)&addr;
-        addr6->sin6_family = AF_INET6;
-        addr6->sin6_port = htons(config.port);
-        
-        if (inet_pton(AF_INET6, config.host, &addr6->sin6_addr) <= 0) {
-            fprintf(stderr, "Invalid IPv6 address: %s\n", config.host);
+static uint64_t clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Account one event whose edge and receipt are both on the wall clock.
+// Edge-to-receipt only means something when the detector's clock is
+// synchronised with ours; anything negative or older than a minute is
+// counted as skewed instead of recorded.
+static void source_receive(Source *src, uint64_t edge_ns, uint64_t received_ns) {
+    SOURCE_ADD(src, events, 1);
+    if (received_ns < edge_ns || received_ns - edge_ns > MAX_EDGE_AGE_NS) {
+        SOURCE_ADD(src, skewed, 1);
+    } else {
+        hb_histogram_record(&src->edge_to_receipt, received_ns - edge_ns);
+    }
+}
+
+// Remember when the event being written arrived, so output_flush can
+// record its receipt-to-output latency
+static void pending_arrival(Source *src, uint64_t received_ns) {
+    if (!src) {
+        return;
+    }
+    if (pending.narrivals == pending.arrivals_cap) {
+        int cap = pending.arrivals_cap ? pending.arrivals_cap * 2 : 64;
+        Arrival *arrivals = realloc(pending.arrivals, cap * sizeof(*arrivals));
+        if (!arrivals) {
+            return;
+        }
+        pending.arrivals = arrivals;
+        pending.arrivals_cap = cap;
+    }
+    pending.arrivals[pending.narrivals++] = (Arrival){ src, received_ns };
+}
+
+static int sequence_seen(const Source *src, uint32_t sequence) {
+    uint32_t bit = sequence % SOURCE_SEQ_WINDOW;
+    return (src->seen[bit / 64] >> (bit % 64)) & 1;
+}
+
+static void sequence_mark(Source *src, uint32_t sequence, int seen) {
+    uint32_t bit = sequence % SOURCE_SEQ_WINDOW;
+    if (seen) {
+        src->seen[bit / 64] |= 1ULL << (bit % 64);
+    } else {
+        src->seen[bit / 64] &= ~(1ULL << (bit % 64));
+    }
+}
+
+// Account a sender's sequence number. Skipped numbers count as gaps, and
+// as late as well when they turn up afterwards, so lost = gaps - late.
+// Numbers already seen within the last SOURCE_SEQ_WINDOW are duplicates;
+// a jump back further than that is a sender that restarted.
+static void source_sequence(Source *src, uint32_t sequence) {
+    int32_t ahead = (int32_t)(sequence - src->expected);
+    if (src->have_expected && ahead < 0 && ahead >= -SOURCE_SEQ_WINDOW) {
+        if (sequence_seen(src, sequence)) {
+            SOURCE_ADD(src, duplicates, 1);
+        } else {
+            SOURCE_ADD(src, late, 1);
+            sequence_mark(src, sequence, 1);
+        }
+        return;
+    }
+
+    if (!src->have_expected || ahead < 0 || ahead >= SOURCE_SEQ_WINDOW) {
+        memset(src->seen, 0, sizeof(src->seen));
+    } else {
+        for (uint32_t s = src->expected; s != sequence; s++) {
+            sequence_mark(src, s, 0);
+        }
+    }
+    if (src->have_expected && ahead > 0) {
+        HB_TRACE2(sequence_gap, src->expected, sequence);
+        SOURCE_ADD(src, gaps, (uint64_t)ahead);
+    }
+    sequence_mark(src, sequence, 1);
+    src->expected = sequence + 1;
+    src->have_expected = 1;
+}
+
+// Verbosity can be changed at runtime through the control socket
+int verbose(void) {
+    const Runtime *rt = runtime_get();
+    return rt ? rt->verbose : config.verbose;
+}
+
+// Send the queued events to every sink as one datagram
+void packets_flush(const Runtime *rt) {
+    if (!outgoing.count) {
+        return;
+    }
+    uint32_t first = ntohl(outgoing.records[0].sequence);
+    size_t len = outgoing.count * sizeof(TRNGPacket);
+    for (int i = 0; i < rt->nsinks; i++) {
+        const Sink *sink = &rt->sinks[i];
+        int sock = rt->sink_fd[sink->addr.ss_family == AF_INET6];
+        ssize_t sent = sendto(sock, outgoing.records, len, 0,
+                              (const struct sockaddr *)&sink->addr, sink->len);
+        if (sent < 0) {
+            // Socket buffer or device queue full
+            if (errno == ENOBUFS || errno == EAGAIN || errno == EWOULDBLOCK) {
+                HB_TRACE2(sink_backpressure, first, i);
+            }
+            perror("sendto");
+            fprintf(stderr, "Failed to send packet %u to %s\n", first, sink->name);
+            STAT_ADD(send_errors, 1);
+        } else {
+            HB_TRACE3(packet_send, first, be64toh(outgoing.records[0].timestamp_ns), i);
+            STAT_ADD(packets, 1);
+            if (rt->verbose) {
+                fprintf(stderr, "Sent packet %u (%d events) to %s: delta=%ld ns\n",
+                        first, outgoing.count, sink->name,
+                        be64toh(outgoing.records[0].delta_ns));
+            }
+        }
+    }
+    outgoing.count = 0;
+}
+
+// Queue one event for the sinks, sending once --packet-events are waiting
+void send_packet(const Runtime *rt, const TRNGPacket *packet) {
+    TRNGPacket *net_packet = &outgoing.records[outgoing.count];
+    memset(net_packet, 0, sizeof(*net_packet));
+    net_packet->timestamp_ns = htobe64(packet->timestamp_ns);
+    net_packet->delta_ns = htobe64(packet->delta_ns);
+    net_packet->sequence = htonl(packet->sequence);
+    if (outgoing.count++ == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &outgoing.first);
+    }
+    if (outgoing.count >= rt->packet_events || outgoing.count == CONTROL_MAX_PACKET_EVENTS) {
+        packets_flush(rt);
+    }
+}
+
+int output_flush(void) {
+    if (!pending.events) {
+        return 0;
+    }
+    HB_TRACE1(batch_flush, pending.events);
+    pending.events = 0;
+    FILE *out = config.output_dir ? segment.file : stdout;
+    int rv = 0;
+    if (out && fflush(out) != 0) {
+        perror(config.output_dir ? segment.path : "stdout");
+        rv = -1;
+    } else {
+        STAT_ADD(flushes, 1);
+    }
+
+    uint64_t now = clock_ns(CLOCK_REALTIME);
+    for (int i = 0; i < pending.narrivals && rv == 0; i++) {
+        const Arrival *a = &pending.arrivals[i];
+        if (now >= a->received_ns) {
+            hb_histogram_record(&a->source->receipt_to_output, now - a->received_ns);
+        }
+    }
+    pending.narrivals = 0;
+    return rv;
+}
+
+static long elapsed_ms(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000 +
+           (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+// Poll timeout that wakes up in time to flush a partial batch or packet
+int output_timeout(const Runtime *rt) {
+    long left = 1000;
+    if (pending.events && rt->batch_ms - elapsed_ms(&pending.first) < left) {
+        left = rt->batch_ms - elapsed_ms(&pending.first);
+    }
+    if (outgoing.count && rt->packet_ms - elapsed_ms(&outgoing.first) < left) {
+        left = rt->packet_ms - elapsed_ms(&outgoing.first);
+    }
+    return left < 0 ? 0 : (int)left;
+}
+
+int output_flush_due(const Runtime *rt) {
+    if (outgoing.count && elapsed_ms(&outgoing.first) >= rt->packet_ms) {
+        packets_flush(rt);
+    }
+    if (pending.events && elapsed_ms(&pending.first) >= rt->batch_ms) {
+        return output_flush();
+    }
+    return 0;
+}
+
+void segment_close(void) {
+    if (!segment.file) {
+        return;
+    }
+    output_flush();
+
+    char index_path[PATH_MAX];
+    hb_index_path(index_path, sizeof(index_path), segment.path);
+
+    if (fclose(segment.file) != 0) {
+        perror(segment.path);
+    }
+    segment.file = NULL;
+
+    if (hb_index_finish(&segment.index, segment.path) < 0 ||
+        hb_index_save(index_path, &segment.index) < 0) {
+        fprintf(stderr, "Failed to write index %s\n", index_path);
+    } else if (verbose()) {
+        fprintf(stderr, "Closed segment %s (%lu events)\n", segment.path, segment.index.events);
+    }
+    hb_index_free(&segment.index);
+}
+
+int segment_open_at(const char *path, time_t opened) {
+    segment.opened = opened;
+    if (path != segment.path) {
+        snprintf(segment.path, sizeof(segment.path), "%s", path);
+    }
+
+    segment.file = fopen(segment.path, "a");
+    if (!segment.file) {
+        perror(segment.path);
+        return -1;
+    }
+    hb_index_init(&segment.index, HB_INDEX_STRIDE);
+
+    // Appending to an existing segment (restart within the same second,
+    // or continuing the segment of the process we took over from)
+    struct stat st;
+    if (fstat(fileno(segment.file), &st) == 0 && st.st_size > 0 &&
+        hb_index_refresh(segment.path, &segment.index) < 0) {
+        fclose(segment.file);
+        segment.file = NULL;
+        return -1;
+    }
+
+    if (verbose()) {
+        fprintf(stderr, "Writing segment %s\n", segment.path);
+    }
+    return 0;
+}
+
+int segment_open(void) {
+    time_t opened = time(NULL);
+    snprintf(segment.path, sizeof(segment.path), "%s/events-%ld.txt",
+             config.output_dir, (long)opened);
+    return segment_open_at(segment.path, opened);
+}
+
+// Write one event to stdout in the runtime format, or its delta to the
+// current segment, rotating it when it is older than --segment-seconds.
+// Output is flushed in batches, see --control "batch". src (may be NULL)
+// and received_ns are where and when the event arrived.
+int emit_delta(const Runtime *rt, Source *src, uint64_t received_ns,
+               uint64_t timestamp_ns, uint64_t delta_ns) {
+    int len;
+    if (!config.output_dir) {
+        if (rt->format == FORMAT_CSV) {
+            len = printf("%lu,%lu\n", timestamp_ns, delta_ns);
+        } else if (rt->format == FORMAT_BINARY) {
+            uint64_t le = htole64(delta_ns);
+            len = fwrite(&le, sizeof(le), 1, stdout) == 1 ? (int)sizeof(le) : -1;
+        } else {
+            len = printf("%lu\n", delta_ns);
+        }
+        if (len < 0) {
+            perror("stdout");
             return -1;
         }
-        addr_len = sizeof(struct sockaddr_in6);
     } else {
-        struct sockaddr_in *addr4 = (struct sockaddr_in *)&addr;
-        addr4->sin_family = AF_INET;
-        addr4->sin_port = htons(config.port);
-        
-        if (inet_pton(AF_INET, config.host, &addr4->sin_addr) <= 0) {
-            fprintf(stderr, "Invalid IPv4 address: %s\n", config.host);
+        if (segment.file && time(NULL) - segment.opened >= config.segment_seconds) {
+            segment_close();
+        }
+        if (!segment.file && segment_open() < 0) {
+            return -1;
+        }
+
+        len = fprintf(segment.file, "%lu\n", delta_ns);
+        if (len < 0) {
+            perror(segment.path);
+            return -1;
+        }
+        if (hb_index_add(&segment.index, delta_ns, (uint64_t)len) < 0) {
             return -1;
         }
-        addr_len = sizeof(struct sockaddr_in);
     }
 
-    TRNGPacket net_packet;
-    net_packet.timestamp_ns = htobe64(packet->timestamp_ns);
-    net_packet.delta_ns = htobe64(packet->delta_ns);
-    net_packet.sequence = htonl(packet->sequence);
+    STAT_ADD(events, 1);
+    STAT_ADD(bytes, len);
+    pending_arrival(src, received_ns);
+    if (pending.events++ == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &pending.first);
+    }
+    if (pending.events >= rt->batch_events) {
+        return output_flush();
+    }
+    return 0;
+}
 
-    ssize_t sent = sendto(sock, &net_packet, sizeof(net_packet), 0,
-                         (struct sockaddr *)&addr, addr_len);
-    
-    if (sent < 0) {
-        perror("sendto");
+// Identifies what we capture from; a handoff is only accepted between
+// processes reading the same source
+void describe_source(char *buf, size_t size) {
+    if (config.mode == MODE_RECEIVE) {
+        snprintf(buf, size, "udp %s:%d", config.host, config.port);
+    } else if (config.simulate_rate > 0) {
+        snprintf(buf, size, "simulated %g/s", config.simulate_rate);
+    } else {
+        snprintf(buf, size, "gpio %s:%d", config.gpio_chip, config.gpio_line);
+    }
+}
+
+void resolve_path(char *buf, const char *path) {
+    if (!path) {
+        buf[0] = '\0';
+    } else if (!realpath(path, buf)) {
+        snprintf(buf, PATH_MAX, "%s", path);
+    }
+}
+
+// A new trng connected to the handoff socket: close the segment, pass it
+// our state and descriptors, and stop capturing if it takes over. Returns
+// 1 after a handoff, 0 to keep capturing, -1 on error.
+int serve_handoff(int source_fd, int broadcast_sock) {
+    int sock = accept4(capture.listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (sock < 0) {
+        if (errno != EAGAIN && errno != EINTR) {
+            perror("accept4");
+        }
+        return 0;
+    }
+
+    HandoffState state;
+    memset(&state, 0, sizeof(state));
+    state.magic = HANDOFF_MAGIC;
+    state.version = HANDOFF_VERSION;
+    state.mode = config.mode;
+    describe_source(state.source, sizeof(state.source));
+    state.sequence = capture.sequence;
+    state.last_sec = capture.last_time.tv_sec;
+    state.last_nsec = capture.last_time.tv_nsec;
+    resolve_path(state.output_dir, config.output_dir);
+    if (segment.file) {
+        resolve_path(state.segment_path, segment.path);
+        state.segment_opened = segment.opened;
+    }
+    segment_close();
+    output_flush();
+    packets_flush(runtime_get());
+
+    int fds[HANDOFF_MAX_FDS];
+    fds[HANDOFF_FD_LISTEN] = capture.listen_fd;
+    fds[HANDOFF_FD_SOURCE] = source_fd;
+    fds[HANDOFF_FD_BROADCAST] = broadcast_sock;
+
+    int taken = handoff_send(sock, &state, fds) == 0;
+    close(sock);
+    if (taken) {
+        capture.handed_off = 1;
+        if (verbose()) {
+            fprintf(stderr, "Handed off capture at sequence %u\n", capture.sequence);
+        }
+        return 1;
+    }
+
+    fprintf(stderr, "Handoff not accepted, resuming capture\n");
+    if (state.segment_path[0] &&
+        segment_open_at(state.segment_path, (time_t)state.segment_opened) < 0) {
         return -1;
     }
-    
     return 0;
 }
 
-int run_gpio_mode(int broadcast_sock) {
+// Refuse a handoff: the running trng resumes capture with its own copies
+// of the descriptors
+static int refuse_handoff(int sock, int fds[HANDOFF_MAX_FDS]) {
+    handoff_reply(sock, 0);
+    close(sock);
+    for (int i = 0; i < HANDOFF_MAX_FDS; i++) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+    }
+    return -1;
+}
+
+// --handoff: take over from the trng listening on the socket, or become
+// the first one to listen there. Runs once the runtime and the (staged)
+// control socket exist; everything that can fail happens before the
+// running trng is told to exit, so on failure it keeps capturing.
+int takeover(int broadcast_sock) {
+    int sock = handoff_connect(config.handoff_path);
+    if (sock < 0) {
+        if (errno != ENOENT && errno != ECONNREFUSED) {
+            perror(config.handoff_path);
+            return -1;
+        }
+        if (control_commit(0) < 0) {
+            return -1;
+        }
+        capture.listen_fd = handoff_listen(config.handoff_path);
+        return capture.listen_fd < 0 ? -1 : 0;
+    }
+
+    HandoffState state;
+    int fds[HANDOFF_MAX_FDS];
+    if (handoff_receive(sock, &state, fds) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    char source[sizeof(state.source)];
+    describe_source(source, sizeof(source));
+    if (strcmp(state.source, source) != 0 ||
+        fds[HANDOFF_FD_LISTEN] < 0 || fds[HANDOFF_FD_SOURCE] < 0) {
+        fprintf(stderr, "Running trng captures from %s, not %s; leaving it running\n",
+                state.source, source);
+        return refuse_handoff(sock, fds);
+    }
+
+    // The broadcast socket the runtime already sends from becomes the
+    // inherited one, keeping the source port receivers know us by
+    if (config.mode == MODE_BROADCAST && fds[HANDOFF_FD_BROADCAST] >= 0 &&
+        dup2(fds[HANDOFF_FD_BROADCAST], broadcast_sock) < 0) {
+        perror("dup2");
+        return refuse_handoff(sock, fds);
+    }
+    if (control_commit(1) < 0) {
+        fprintf(stderr, "Leaving the running trng in place\n");
+        return refuse_handoff(sock, fds);
+    }
+    if (handoff_reply(sock, 1) < 0) {
+        fprintf(stderr, "The running trng may resume capture\n");
+        return refuse_handoff(sock, fds);
+    }
+    close(sock);
+
+    capture.listen_fd = fds[HANDOFF_FD_LISTEN];
+    capture.source_fd = fds[HANDOFF_FD_SOURCE];
+    if (fds[HANDOFF_FD_BROADCAST] >= 0) {
+        close(fds[HANDOFF_FD_BROADCAST]);
+    }
+    capture.sequence = state.sequence;
+    capture.last_time.tv_sec = (time_t)state.last_sec;
+    capture.last_time.tv_nsec = (long)state.last_nsec;
+    if (verbose()) {
+        fprintf(stderr, "Took over capture from %s at sequence %u\n", source, capture.sequence);
+    }
+
+    // Continue the old process's segment so rotation stays on schedule;
+    // otherwise the next event opens a new one
+    char output_dir[PATH_MAX];
+    resolve_path(output_dir, config.output_dir);
+    if (state.segment_path[0] && strcmp(output_dir, state.output_dir) == 0) {
+        segment_open_at(state.segment_path, (time_t)state.segment_opened);
+    }
+    return 0;
+}
+
+// One detector edge: edge_ns on the wall clock, ts as the source stamped
+// it (deltas are taken on that clock). Returns -1 on an output error.
+static int capture_edge(const Runtime *rt, Source *src, const struct timespec *ts,
+                        uint64_t edge_ns, uint64_t received_ns) {
+    if (src) {
+        source_receive(src, edge_ns, received_ns);
+    }
+
+    if (capture.last_time.tv_sec != 0) {
+        uint64_t delta_ns = (ts->tv_sec - capture.last_time.tv_sec) * 1000000000ULL +
+                            (ts->tv_nsec - capture.last_time.tv_nsec);
+
+        HB_TIMER_START(sink);
+        if (emit_delta(rt, src, received_ns, edge_ns, delta_ns) < 0) {
+            return -1;
+        }
+
+        if (rt->nsinks > 0) {
+            TRNGPacket packet = {
+                .timestamp_ns = edge_ns,
+                .delta_ns = delta_ns,
+                .sequence = capture.sequence++
+            };
+            send_packet(rt, &packet);
+        }
+        HB_TIMER_STOP(sink, HB_STAGE_SINK);
+        HB_COUNT(HB_STAGE_SINK, 1);
+    }
+
+    capture.last_time = *ts;
+    return 0;
+}
+
+// xorshift64*
+static uint64_t simulate_random(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+// --simulate: Poisson edges at the given rate, each stamped with the time
+// it was scheduled for, so a loaded capture loop shows up as latency. Edges
+// that fell due while the loop was busy are emitted together.
+int run_simulated_mode(void) {
+    struct sockaddr_storage none;
+    char name[sizeof(((Source *)0)->name)];
+    memset(&none, 0, sizeof(none));
+    describe_source(name, sizeof(name));
+    Source *src = source_lookup(&none, 0, name);
+
+    if (verbose()) {
+        fprintf(stderr, "Simulating %g events/s\n", config.simulate_rate);
+        if (config.mode == MODE_BROADCAST) {
+            fprintf(stderr, "Broadcasting to %s:%d (%s)\n",
+                    config.host, config.port, config.use_ipv6 ? "IPv6" : "IPv4");
+        }
+    }
+
+    uint64_t state = clock_ns(CLOCK_MONOTONIC) ^ ((uint64_t)getpid() << 32);
+    double mean_ns = 1e9 / config.simulate_rate;
+    uint64_t generated = 0;
+    uint64_t next_ns = clock_ns(CLOCK_REALTIME);
+
+    runtime_online();
+    while (running) {
+        const Runtime *rt = runtime_get();
+        uint64_t now_ns = clock_ns(CLOCK_REALTIME);
+        int more = !config.simulate_count || generated < config.simulate_count;
+        while (more && next_ns <= now_ns) {
+            struct timespec ts = {
+                .tv_sec = next_ns / 1000000000ULL,
+                .tv_nsec = next_ns % 1000000000ULL
+            };
+            if (capture_edge(rt, src, &ts, next_ns, now_ns) < 0) {
+                running = 0;
+                break;
+            }
+            double u = ((simulate_random(&state) >> 11) + 0.5) / 9007199254740992.0;
+            next_ns += (uint64_t)(-log(u) * mean_ns) + 1;
+            more = !config.simulate_count || ++generated < config.simulate_count;
+        }
+        if (output_flush_due(rt) < 0) {
+            break;
+        }
+
+        uint64_t wait_ns = (uint64_t)output_timeout(rt) * 1000000ULL;
+        if (more && next_ns - now_ns < wait_ns) {
+            wait_ns = next_ns - now_ns;
+        }
+        struct timespec wait = {
+            .tv_sec = wait_ns / 1000000000ULL,
+            .tv_nsec = wait_ns % 1000000000ULL
+        };
+        runtime_offline();
+        nanosleep(&wait, NULL);
+        runtime_online();
+    }
+    runtime_offline();
+    return 0;
+}
+
+#ifdef HAVE_GPIOD
+typedef struct {
     struct gpiod_chip *chip;
-    struct gpiod_line *line;
-    int rv;
-    struct timespec last_time = {0, 0};
-    uint64_t delta_ns = 0;
-    uint32_t sequence = 0;
-
-    chip = gpiod_chip_open_by_name(config.gpio_chip);
-    if (!chip) {
+    struct gpiod_line *line;         // NULL when the request was handed to us
+    int fd;
+} GpioLine;
+
+int gpio_open(GpioLine *gpio) {
+    gpio->chip = NULL;
+    gpio->line = NULL;
+    if (capture.source_fd >= 0) {
+        gpio->fd = capture.source_fd;
+        return 0;
+    }
+
+    gpio->chip = gpiod_chip_open_by_name(config.gpio_chip);
+    if (!gpio->chip) {
         perror("gpiod_chip_open_by_name");
         return -1;
     }
 
-    line = gpiod_chip_get_line(chip, config.gpio_line);
-    if (!line) {
+    gpio->line = gpiod_chip_get_line(gpio->chip, config.gpio_line);
+    if (!gpio->line) {
         perror("gpiod_chip_get_line");
-        gpiod_chip_close(chip);
+        gpiod_chip_close(gpio->chip);
         return -1;
     }
 
@@ -285,14 +982,55 @@ int run_gpio_mode(int broadcast_sock) {
         .flags = GPIOD_LINE_REQUEST_FLAG_BIAS_DISABLE
     };
 
-    rv = gpiod_line_request(line, &gpio_config, 0);
-    if (rv < 0) {
+    if (gpiod_line_request(gpio->line, &gpio_config, 0) < 0) {
         perror("gpiod_line_request");
-        gpiod_chip_close(chip);
+        gpiod_chip_close(gpio->chip);
+        return -1;
+    }
+
+    gpio->fd = gpiod_line_event_get_fd(gpio->line);
+    if (gpio->fd < 0) {
+        perror("gpiod_line_event_get_fd");
+        gpiod_line_release(gpio->line);
+        gpiod_chip_close(gpio->chip);
+        return -1;
+    }
+    return 0;
+}
+
+void gpio_close(GpioLine *gpio) {
+    if (gpio->line) {
+        gpiod_line_release(gpio->line);
+        gpiod_chip_close(gpio->chip);
+    } else {
+        close(gpio->fd);
+    }
+}
+
+// The edge on the wall clock, given now on it. Line events are stamped
+// with CLOCK_REALTIME before Linux 5.7 and CLOCK_MONOTONIC since.
+static uint64_t edge_realtime_ns(const struct timespec *ts, uint64_t now_ns) {
+    uint64_t edge = (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+    if (edge <= now_ns && now_ns - edge <= MAX_EDGE_AGE_NS) {
+        return edge;
+    }
+    return edge + (now_ns - clock_ns(CLOCK_MONOTONIC));
+}
+
+int run_gpio_mode(int broadcast_sock) {
+    GpioLine gpio;
+
+    if (gpio_open(&gpio) < 0) {
         return -1;
     }
 
-    if (config.verbose) {
+    struct sockaddr_storage none;
+    char name[sizeof(((Source *)0)->name)];
+    memset(&none, 0, sizeof(none));
+    describe_source(name, sizeof(name));
+    Source *src = source_lookup(&none, 0, name);
+
+    if (verbose()) {
         fprintf(stderr, "GPIO initialized on chip %s, line %d\n", 
                 config.gpio_chip, config.gpio_line);
         if (config.mode == MODE_BROADCAST) {
@@ -301,93 +1039,205 @@ int run_gpio_mode(int broadcast_sock) {
         }
     }
 
+    struct pollfd fds[2] = {
+        { .fd = gpio.fd, .events = POLLIN },
+        { .fd = capture.listen_fd, .events = POLLIN }
+    };
+    nfds_t nfds = capture.listen_fd >= 0 ? 2 : 1;
+
+    runtime_online();
     while (running) {
-        struct gpiod_line_event event;
-        struct timespec timeout = {1, 0};
-        
-        rv = gpiod_line_event_wait(line, &timeout);
-        
-        if (rv == 1) {
-            gpiod_line_event_read(line, &event);
-
-            if (last_time.tv_sec != 0) {
-                delta_ns = (event.ts.tv_sec - last_time.tv_sec) * 1000000000ULL + 
-                          (event.ts.tv_nsec - last_time.tv_nsec);
-                
-                uint64_t timestamp_ns = event.ts.tv_sec * 1000000000ULL + event.ts.tv_nsec;
-                
-                printf("%ld\n", delta_ns);
-                fflush(stdout);
-
-                if (broadcast_sock >= 0) {
-                    TRNGPacket packet = {
-                        .timestamp_ns = timestamp_ns,
-                        .delta_ns = delta_ns,
-                        .sequence = sequence++
-                    };
-                    
-                    if (send_packet(broadcast_sock, &packet) < 0) {
-                        fprintf(stderr, "Failed to send packet %u\n", packet.sequence);
-                    } else if (config.verbose) {
-                        fprintf(stderr, "Sent packet %u: delta=%ld ns\n", 
-                                packet.sequence, delta_ns);
-                    }
-                }
+        const Runtime *rt = runtime_get();
+        int timeout = output_timeout(rt);
+
+        // Quiescent while blocked, so configuration changes never wait
+        // for the next event
+        runtime_offline();
+        int rv = poll(fds, nfds, timeout);
+        runtime_online();
+        rt = runtime_get();
+
+        if (rv < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            struct gpiod_line_event event;
+            HB_TIMER_START(parse);
+            if (gpiod_line_event_read_fd(gpio.fd, &event) < 0) {
+                perror("gpiod_line_event_read_fd");
+                break;
             }
-            
-            last_time = event.ts;
-        } else if (rv < 0 && errno != EINTR) {
-            perror("gpiod_line_event_wait");
+            uint64_t received_ns = clock_ns(CLOCK_REALTIME);
+            HB_TIMER_STOP(parse, HB_STAGE_PARSE);
+            HB_COUNT(HB_STAGE_PARSE, 1);
+            HB_TRACE2(event_read, (uint64_t)event.ts.tv_sec * 1000000000ULL + event.ts.tv_nsec,
+                      trng_stats.events);
+
+            // Timestamps go out on the wall clock so receivers can tell
+            // how old an edge is
+            uint64_t timestamp_ns = edge_realtime_ns(&event.ts, received_ns);
+            if (capture_edge(rt, src, &event.ts, timestamp_ns, received_ns) < 0) {
+                break;
+            }
+        }
+
+        if ((fds[1].revents & POLLIN) && serve_handoff(gpio.fd, broadcast_sock) != 0) {
+            break;
+        }
+        if (output_flush_due(rt) < 0) {
             break;
         }
     }
+    runtime_offline();
 
-    gpiod_line_release(line);
-    gpiod_chip_close(chip);
+    gpio_close(&gpio);
     
     return 0;
 }
+#endif
+
+// Kernel receive timestamp (SO_TIMESTAMPNS, CLOCK_REALTIME) of a message,
+// or now if there is none
+static uint64_t receive_time(struct msghdr *msg) {
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(msg); c; c = CMSG_NXTHDR(msg, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+        }
+    }
+    return clock_ns(CLOCK_REALTIME);
+}
 
 int run_receive_mode() {
-    int sock = create_socket(1);
+    int sock = capture.source_fd >= 0 ? capture.source_fd : create_socket(1);
     if (sock < 0) {
         return -1;
     }
 
-    if (config.verbose) {
+    if (verbose()) {
         fprintf(stderr, "Listening on %s:%d (%s)\n",
                 config.host, config.port, config.use_ipv6 ? "IPv6" : "IPv4");
     }
 
-    TRNGPacket packet;
+    // Kernel receive timestamps, for edge-to-receipt latency. Also set on
+    // an inherited socket, in case it came from an older trng.
+    int on = 1;
+    if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) < 0) {
+        perror("setsockopt(SO_TIMESTAMPNS)");
+    }
+
+    static TRNGPacket packets[CONTROL_MAX_PACKET_EVENTS];
     struct sockaddr_storage from_addr;
-    socklen_t from_len;
     char addr_str[INET6_ADDRSTRLEN];
+    union {
+        char buf[CMSG_SPACE(sizeof(struct timespec))];
+        struct cmsghdr align;
+    } cmsg;
+    struct iovec iov = { .iov_base = packets, .iov_len = sizeof(packets) };
+
+    struct pollfd fds[2] = {
+        { .fd = sock, .events = POLLIN },
+        { .fd = capture.listen_fd, .events = POLLIN }
+    };
+    nfds_t nfds = capture.listen_fd >= 0 ? 2 : 1;
 
+    runtime_online();
     while (running) {
-        from_len = sizeof(from_addr);
-        ssize_t received = recvfrom(sock, &packet, sizeof(packet), 0,
-                                   (struct sockaddr *)&from_addr, &from_len);
+        const Runtime *rt = runtime_get();
+        int timeout = output_timeout(rt);
+
+        // Quiescent while blocked, so configuration changes never wait
+        // for the next event
+        runtime_offline();
+        int rv = poll(fds, nfds, timeout);
+        runtime_online();
+        rt = runtime_get();
+
+        if (rv < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+
+        if ((fds[1].revents & POLLIN) && serve_handoff(sock, -1) != 0) {
+            break;
+        }
+        if (output_flush_due(rt) < 0) {
+            break;
+        }
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+
+        HB_TIMER_START(parse);
+        struct msghdr msg = {
+            .msg_name = &from_addr,
+            .msg_namelen = sizeof(from_addr),
+            .msg_iov = &iov,
+            .msg_iovlen = 1,
+            .msg_control = cmsg.buf,
+            .msg_controllen = sizeof(cmsg.buf)
+        };
+        ssize_t received = recvmsg(sock, &msg, 0);
         
         if (received < 0) {
             if (errno == EINTR) continue;
-            perror("recvfrom");
+            perror("recvmsg");
             break;
         }
-        
-        if (received != sizeof(packet)) {
-            fprintf(stderr, "Received invalid packet size: %zd\n", received);
+        uint64_t received_ns = receive_time(&msg);
+        Source *src = source_lookup(&from_addr, msg.msg_namelen, NULL);
+
+        // A datagram longer than the buffer is cut short, possibly on a
+        // packet boundary; its tail is gone either way
+        if (received == 0 || received % sizeof(TRNGPacket) != 0 ||
+            (msg.msg_flags & MSG_TRUNC)) {
+            fprintf(stderr, "Received invalid packet size: %zd%s\n", received,
+                    (msg.msg_flags & MSG_TRUNC) ? " (truncated)" : "");
+            if (src) {
+                SOURCE_ADD(src, malformed, 1);
+            }
             continue;
         }
+        int count = received / sizeof(TRNGPacket);
+        HB_TIMER_STOP(parse, HB_STAGE_PARSE);
+        HB_COUNT(HB_STAGE_PARSE, count);
 
-        packet.timestamp_ns = be64toh(packet.timestamp_ns);
-        packet.delta_ns = be64toh(packet.delta_ns);
-        packet.sequence = ntohl(packet.sequence);
+        int failed = 0;
+        for (int i = 0; i < count; i++) {
+            TRNGPacket packet;
+            packet.timestamp_ns = be64toh(packets[i].timestamp_ns);
+            packet.delta_ns = be64toh(packets[i].delta_ns);
+            packet.sequence = ntohl(packets[i].sequence);
+            HB_TRACE3(packet_receive, packet.sequence, packet.timestamp_ns, packet.delta_ns);
+
+            if (src) {
+                source_receive(src, packet.timestamp_ns, received_ns);
+                source_sequence(src, packet.sequence);
+            }
+
+            HB_TIMER_START(sink);
+            if (emit_delta(rt, src, received_ns, packet.timestamp_ns, packet.delta_ns) < 0) {
+                failed = 1;
+                break;
+            }
 
-        printf("%ld\n", packet.delta_ns);
-        fflush(stdout);
+            // Relay to sinks added through the control socket
+            if (rt->nsinks > 0) {
+                send_packet(rt, &packet);
+            }
+            HB_TIMER_STOP(sink, HB_STAGE_SINK);
+            HB_COUNT(HB_STAGE_SINK, 1);
+        }
+        if (failed) {
+            break;
+        }
 
-        if (config.verbose) {
+        if (verbose()) {
             if (from_addr.ss_family == AF_INET) {
                 struct sockaddr_in *addr4 = (struct sockaddr_in *)&from_addr;
                 inet_ntop(AF_INET, &addr4->sin_addr, addr_str, sizeof(addr_str));
@@ -395,46 +1245,149 @@ int run_receive_mode() {
                 struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)&from_addr;
                 inet_ntop(AF_INET6, &addr6->sin6_addr, addr_str, sizeof(addr_str));
             }
-            fprintf(stderr, "Received packet %u from %s: delta=%ld ns\n",
-                    packet.sequence, addr_str, packet.delta_ns);
+            fprintf(stderr, "Received packet %u (%d events) from %s: delta=%ld ns\n",
+                    ntohl(packets[0].sequence), count, addr_str, be64toh(packets[0].delta_ns));
         }
     }
+    runtime_offline();
 
     close(sock);
     return 0;
 }
 
+// Initial runtime configuration from the command line; the broadcast
+// destination is the first sink, then any --sink
+int runtime_init(int broadcast_sock) {
+    Runtime *rt = runtime_copy(NULL);
+    if (!rt) {
+        return -1;
+    }
+    rt->verbose = config.verbose;
+    rt->packet_events = config.packet_events;
+    rt->packet_ms = config.packet_ms;
+
+    if (broadcast_sock >= 0) {
+        Sink sink;
+        if (sink_parse(&sink, config.host, config.port,
+                       config.use_ipv6 ? AF_INET6 : AF_INET) < 0) {
+            fprintf(stderr, "Invalid %s address: %s\n",
+                    config.use_ipv6 ? "IPv6" : "IPv4", config.host);
+            free(rt);
+            return -1;
+        }
+        runtime_add_sink(rt, &sink);
+        rt->sink_fd[config.use_ipv6] = broadcast_sock;
+    }
+
+    // Extra destinations share the broadcast socket, so the same family
+    for (int i = 0; i < config.nsinks; i++) {
+        char host[INET6_ADDRSTRLEN];
+        char *colon = strrchr(config.sinks[i], ':');
+        size_t len = colon ? (size_t)(colon - config.sinks[i]) : 0;
+        Sink sink;
+        if (!colon || len >= sizeof(host)) {
+            fprintf(stderr, "Invalid sink (expected HOST:PORT): %s\n", config.sinks[i]);
+            free(rt);
+            return -1;
+        }
+        memcpy(host, config.sinks[i], len);
+        host[len] = '\0';
+        // [ADDR]:PORT for IPv6, as "sinks" prints it
+        char *name = host;
+        if (len >= 2 && host[0] == '[' && host[len - 1] == ']') {
+            host[len - 1] = '\0';
+            name++;
+        }
+        if (sink_parse(&sink, name, atoi(colon + 1), config.use_ipv6 ? AF_INET6 : AF_INET) < 0) {
+            fprintf(stderr, "Invalid %s sink: %s\n", config.use_ipv6 ? "IPv6" : "IPv4",
+                    config.sinks[i]);
+            free(rt);
+            return -1;
+        }
+        runtime_add_sink(rt, &sink);
+    }
+
+    runtime_publish(rt);
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
     if (parse_arguments(argc, argv) < 0) {
         return 1;
     }
 
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    // No SA_RESTART: a blocking recvfrom/event wait must return so the
+    // current segment is closed and indexed on shutdown
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = signal_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    // Before control_start, so the control thread also leaves SIGUSR1 to
+    // the instrumentation dump thread
+    hb_instrument_init("trng");
+
+    // Everything that can fail comes before takeover(), which stops the
+    // running trng
+    int broadcast_sock = -1;
+    if (config.mode == MODE_BROADCAST) {
+        broadcast_sock = create_socket(0);
+        if (broadcast_sock < 0) {
+            return 1;
+        }
+    }
+
+    if (runtime_init(broadcast_sock) < 0) {
+        return 1;
+    }
+    if (config.control_path &&
+        control_start(config.control_path, config.handoff_path != NULL) < 0) {
+        return 1;
+    }
+    if (config.handoff_path && takeover(broadcast_sock) < 0) {
+        control_stop(0);
+        return 1;
+    }
 
     int ret = 0;
 
     switch (config.mode) {
         case MODE_LOCAL:
-            ret = run_gpio_mode(-1);
-            break;
-            
-        case MODE_BROADCAST: {
-            int sock = create_socket(0);
-            if (sock < 0) {
-                return 1;
+        case MODE_BROADCAST:
+            if (config.simulate_rate > 0) {
+                ret = run_simulated_mode();
+                break;
             }
-            ret = run_gpio_mode(sock);
-            close(sock);
+#ifdef HAVE_GPIOD
+            ret = run_gpio_mode(broadcast_sock);
+#endif
             break;
-        }
         
         case MODE_RECEIVE:
             ret = run_receive_mode();
             break;
     }
 
-    if (config.verbose) {
+    // After a handoff the control socket path belongs to the new process
+    control_stop(capture.handed_off);
+    output_flush();
+    packets_flush(runtime_get());
+    segment_close();
+    if (broadcast_sock >= 0) {
+        close(broadcast_sock);
+    }
+
+    // Likewise the handoff socket path
+    if (capture.listen_fd >= 0) {
+        close(capture.listen_fd);
+        if (!capture.handed_off) {
+            unlink(config.handoff_path);
+        }
+    }
+
+    if (verbose()) {
         fprintf(stderr, "Shutting down...\n");
     }
 
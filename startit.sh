@@ -2,6 +2,21 @@
 
 cd /home/tinmac/hotbits
 
+function start_trng() {
+    mkdir -p ./state
+    src/trng/trng --output-dir ./data --segment-seconds 3600 --handoff ./state/trng.sock &
+    echo "$!">.pids
+}
+
+# "./startit.sh restart" swaps in a freshly built trng: the new process
+# takes over from the running one, which exits, and reads the events
+# queued in the kernel meanwhile (up to 16 from the GPIO line)
+if [[ "$1" == "restart" ]]; then
+    [[ -f .pids ]] || exit 1
+    start_trng
+    exit
+fi
+
 [[ -f .pids ]] && exit || touch .pids
 
 function handle_ctrlc() {
@@ -12,10 +27,7 @@ function handle_ctrlc() {
 }
 trap handle_ctrlc SIGINT
 
-src/trng/trng >./data/events-$(date +%s).txt &
-
-PID=($!)
-echo "${PID}">.pids
+start_trng
 
 sleep 60m
 handle_ctrlc
@@ -0,0 +1,60 @@
+#!/bin/bash
+# hotbits-pack round trips, compressed input, and hotbits-slice ranges
+# against sed over a three-segment data directory, in text and with its
+# middle segment packed
+source "$(dirname "$0")/lib.sh"
+
+events "${TMP}/all.txt" 20000 1
+mkdir "${TMP}/data"
+split -l 7000 -a 1 --numeric-suffixes=1 --additional-suffix=.txt \
+    "${TMP}/all.txt" "${TMP}/data/events-"
+
+"${BIN}/hotbits-pack" -o "${TMP}/all.hbc" "${TMP}/all.txt"
+same "pack round trip" "${TMP}/all.txt" <("${BIN}/hotbits-pack" -d -c "${TMP}/all.hbc")
+"${BIN}/hotbits-pack" -b 100 -o "${TMP}/small.hbc" "${TMP}/all.txt"
+same "pack round trip, 100-value blocks" "${TMP}/all.txt" \
+    <("${BIN}/hotbits-pack" -d -c "${TMP}/small.hbc")
+
+# gzip and zstd input, from a file and from a pipe, reads as the text
+"${BIN}/hotbits-extract" -o "${TMP}/all.bin" "${TMP}/all.txt"
+for z in gzip zstd; do
+    if ! command -v "${z}" > /dev/null; then
+        skip "${z} input (no ${z})"
+        continue
+    fi
+    "${z}" -c "${TMP}/all.txt" > "${TMP}/all.txt.${z}"
+    same "${z} input: extract" "${TMP}/all.bin" <("${BIN}/hotbits-extract" "${TMP}/all.txt.${z}")
+    same "${z} input: extract from a pipe" "${TMP}/all.bin" \
+        <("${BIN}/hotbits-extract" < "${TMP}/all.txt.${z}")
+    "${BIN}/hotbits-pack" -o "${TMP}/${z}.hbc" "${TMP}/all.txt.${z}"
+    same "${z} input: pack" "${TMP}/all.hbc" "${TMP}/${z}.hbc"
+done
+
+# Without indexes, then again through the ones the first pass wrote
+for pass in "unindexed" "indexed"; do
+    same "slice across segments (${pass})" \
+        <(sed -n '6000,8999p' "${TMP}/all.txt") \
+        <("${BIN}/hotbits-slice" -d "${TMP}/data" -s 6000 -c 3000)
+    same "slice from the end (${pass})" \
+        <(tail -n 5000 "${TMP}/all.txt" | head -n 2000) \
+        <("${BIN}/hotbits-slice" -d "${TMP}/data" -s -5000 -c 2000)
+done
+check "indexes written" test -f "${TMP}/data/events-2.txt.idx"
+
+same "slice by time" \
+    <(awk '{ t += $1 } t >= 1e12 && t < 2e12' "${TMP}/all.txt") \
+    <("${BIN}/hotbits-slice" -d "${TMP}/data" -f 1000000000000 -t 2000000000000)
+same "slice info" \
+    <(awk '{ t += $1 } END { printf "%d %.0f\n", NR, t }' "${TMP}/all.txt") \
+    <("${BIN}/hotbits-slice" -d "${TMP}/data" -i)
+
+"${BIN}/hotbits-pack" -r "${TMP}/data/events-2.txt"
+check "pack --remove replaces the segment" test ! -e "${TMP}/data/events-2.txt"
+same "slice across a packed segment" \
+    <(sed -n '6000,14999p' "${TMP}/all.txt") \
+    <("${BIN}/hotbits-slice" -d "${TMP}/data" -s 6000 -c 9000)
+same "slice by time across a packed segment" \
+    <(awk '{ t += $1 } t >= 1e12 && t < 2e12' "${TMP}/all.txt") \
+    <("${BIN}/hotbits-slice" -d "${TMP}/data" -f 1000000000000 -t 2000000000000)
+
+finish
@@ -0,0 +1,129 @@
+#!/bin/bash
+# The Python extension and the Node addon give the same results as the
+# native tools and the pure Python code paths
+source "$(dirname "$0")/lib.sh"
+
+events "${TMP}/events.txt" 20000 7
+"${BIN}/hotbits-extract" -o "${TMP}/native.bin" "${TMP}/events.txt"
+"${BIN}/hotbits-extract" -m ordinal -o "${TMP}/ordinal.bin" "${TMP}/events.txt"
+
+if PYTHONPATH="${ROOT}/src/analysis" python3 -c 'import _hotbits, numpy' 2>/dev/null; then
+    cd "${ROOT}/src/analysis" || exit 1
+    for m in adaptive_threshold von_neumann lsb xor_fold; do
+        same "python: extract.py -m ${m} matches HOTBITS_NO_NATIVE" \
+            <(python3 extract.py -m "${m}" < "${TMP}/events.txt") \
+            <(HOTBITS_NO_NATIVE=1 python3 extract.py -m "${m}" < "${TMP}/events.txt")
+    done
+    same "python: extract.py matches hotbits-extract" "${TMP}/native.bin" \
+        <(python3 extract.py < "${TMP}/events.txt")
+    cd - > /dev/null || exit 1
+
+    check "python: quick_tests matches numpy" env PYTHONPATH="${ROOT}/src/analysis" python3 -c '
+import sys
+import numpy as np
+import _hotbits
+
+data = open(sys.argv[1], "rb").read()
+tests = _hotbits.quick_tests(data)
+bits = np.unpackbits(np.frombuffer(data, dtype=np.uint8)).astype(np.int64)
+n = len(bits)
+monobit = abs(2 * int(bits.sum()) - n) / np.sqrt(n)
+counts = np.bincount(np.frombuffer(data, dtype=np.uint8), minlength=256)
+chi2 = ((counts - len(data) / 256) ** 2 / (len(data) / 256)).sum()
+runs = 1 + int((bits[1:] != bits[:-1]).sum())
+for name, want in (("monobit", monobit), ("byte_chi_square", chi2), ("runs", runs)):
+    got = tests[name][0]
+    assert abs(got - want) <= 1e-9 * max(1.0, abs(want)), (name, got, want)
+    assert 0.0 <= tests[name][1] <= 1.0, (name, tests[name][1])
+count, longest, mean = _hotbits.runs(bytearray(bits.astype(np.uint8)))
+assert count == runs, (count, runs)
+' "${TMP}/ordinal.bin"
+else
+    skip "python: _hotbits or numpy missing (make python-ext)"
+fi
+
+if [ -f "${ROOT}/lib/hotbits.node" ] && command -v node > /dev/null; then
+    for m in adaptive_threshold ordinal; do
+        "${BIN}/hotbits-extract" -m "${m}" -o "${TMP}/want.bin" "${TMP}/events.txt"
+        # Small reads so the output is pulled in many pieces
+        check "node: Stream -m ${m} matches hotbits-extract" node -e '
+const fs = require("fs");
+const native = require(process.argv[1]);
+const [, , events, method, wantPath] = process.argv;
+const read = (s, n) => new Promise((resolve, reject) =>
+    s.read(n, (err, stats) => err ? reject(err) : resolve(stats)));
+(async () => {
+    const s = new native.Stream({ method });
+    s.open(events);
+    const parts = [];
+    for (;;) {
+        const stats = await read(s, 4096);
+        parts.push(s.pull(100));
+        if (stats.eof) break;
+    }
+    s.finish();
+    parts.push(s.pull());
+    s.close();
+    const got = Buffer.concat(parts);
+    const want = fs.readFileSync(wantPath);
+    if (!got.equals(want)) throw new Error(`${got.length} bytes differ from ${want.length}`);
+})().catch(e => { console.error(e); process.exit(1); });
+' "${ROOT}/lib/hotbits.node" "${TMP}/events.txt" "${m}" "${TMP}/want.bin"
+    done
+
+    # Buffers over the stream's output stay valid after close() and
+    # collection of the stream, and are freed by their own finalizers
+    check "node: pulled Buffers outlive the stream" node --expose-gc -e '
+const fs = require("fs");
+const native = require(process.argv[1]);
+const [, , events, wantPath] = process.argv;
+const want = fs.readFileSync(wantPath);
+(async () => {
+    const parts = [];
+    for (let round = 0; round < 20; round++) {
+        let s = new native.Stream({ method: "ordinal" });
+        s.open(events);
+        await new Promise((resolve, reject) =>
+            s.read(Infinity, (err) => err ? reject(err) : resolve()));
+        s.finish();
+        const first = s.pull(1000);
+        const rest = s.pull();
+        s.close();
+        s = null;
+        global.gc();
+        if (!Buffer.concat([first, rest]).equals(want)) throw new Error(`round ${round}`);
+        parts.push(first);
+    }
+    global.gc();
+    for (const p of parts) {
+        if (!p.equals(want.subarray(0, 1000))) throw new Error("Buffer changed");
+    }
+})().catch(e => { console.error(e); process.exit(1); });
+' "${ROOT}/lib/hotbits.node" "${TMP}/events.txt" "${TMP}/ordinal.bin"
+
+    if PYTHONPATH="${ROOT}/src/analysis" python3 -c 'import _hotbits' 2>/dev/null; then
+        PYTHONPATH="${ROOT}/src/analysis" python3 -c '
+import json, sys, _hotbits
+print(json.dumps(_hotbits.quick_tests(open(sys.argv[1], "rb").read())))
+' "${TMP}/ordinal.bin" > "${TMP}/quick.json"
+        check "node: quickTests matches Python" node -e '
+const fs = require("fs");
+const native = require(process.argv[1]);
+const want = JSON.parse(fs.readFileSync(process.argv[3]));
+native.quickTests(fs.readFileSync(process.argv[2]), (err, tests) => {
+    if (err) throw err;
+    for (const [name, [statistic, pValue]] of Object.entries(want)) {
+        const t = tests[name];
+        if (t.statistic !== statistic || t.pValue !== pValue) {
+            console.error(name, t, statistic, pValue);
+            process.exit(1);
+        }
+    }
+});
+' "${ROOT}/lib/hotbits.node" "${TMP}/ordinal.bin" "${TMP}/quick.json"
+    fi
+else
+    skip "node: lib/hotbits.node or node missing (make node-addon)"
+fi
+
+finish
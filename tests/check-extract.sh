@@ -0,0 +1,63 @@
+#!/bin/bash
+# hotbits-extract: incremental runs and checkpoint resumes give a prefix of
+# the full run, and -j gives the same bytes as one thread, for every method
+source "$(dirname "$0")/lib.sh"
+
+METHODS="interval von_neumann xor_fold lsb adaptive_threshold ordinal quantile phase"
+
+# Modulated at 50 Hz so phase has output; at 200 events/s a frame spans
+# under three minutes, which keeps the periodogram small across the resumes
+events "${TMP}/all.txt" 40000 2 --rate 200 --modulate 0.6
+head -n 14000 "${TMP}/all.txt" > "${TMP}/seg1.txt"
+sed -n '14001,28000p' "${TMP}/all.txt" > "${TMP}/seg2.txt"
+sed -n '28001,34000p' "${TMP}/all.txt" > "${TMP}/seg3a.txt"
+sed -n '28001,$p' "${TMP}/all.txt" > "${TMP}/seg3.txt"
+
+for m in ${METHODS}; do
+    "${BIN}/hotbits-extract" -m "${m}" -o "${TMP}/full.bin" "${TMP}/all.txt"
+
+    for j in 2 4; do
+        "${BIN}/hotbits-extract" -m "${m}" -j "${j}" --chunk 3000 \
+            -o "${TMP}/par.bin" "${TMP}/all.txt"
+        same "${m}: -j ${j} matches one thread" "${TMP}/full.bin" "${TMP}/par.bin"
+    done
+
+    # Two segments, then a third written in two parts: the last run resumes
+    # from the checkpoint after segment 2
+    state="${TMP}/state-${m}"
+    data="${TMP}/data-${m}"
+    mkdir -p "${data}"
+    cp "${TMP}/seg1.txt" "${data}/events-1.txt"
+    cp "${TMP}/seg2.txt" "${data}/events-2.txt"
+    "${BIN}/hotbits-extract" -m "${m}" -i "${state}" -d "${data}" -o "${state}/out.bin"
+    cp "${TMP}/seg3a.txt" "${data}/events-3.txt"
+    "${BIN}/hotbits-extract" -m "${m}" -i "${state}" -d "${data}" -o "${state}/out.bin"
+    cp "${TMP}/seg3.txt" "${data}/events-3.txt"
+    "${BIN}/hotbits-extract" -v -m "${m}" -i "${state}" -d "${data}" -o "${state}/out.bin" \
+        2> "${TMP}/resume.log"
+    check "${m}: resume reused two segments" grep -q "(2 reused, 1 processed)" "${TMP}/resume.log"
+    prefix "${m}: incremental output is a prefix of the full run" \
+        "${state}/out.bin" "${TMP}/full.bin"
+
+    cp "${state}/out.bin" "${TMP}/before.bin"
+    "${BIN}/hotbits-extract" -m "${m}" -i "${state}" -d "${data}" -o "${state}/out.bin"
+    same "${m}: unchanged data leaves the output alone" "${TMP}/before.bin" "${state}/out.bin"
+done
+
+# "HBCK", then the version as a little-endian uint32
+check "checkpoints are version 5" \
+    test "$(od -An -tx1 -j4 -N4 "${TMP}/state-interval/events-2.txt.ckpt" | tr -d ' ')" = 05000000
+
+# Checkpoints of another version are not read: the run starts over and
+# gives the same output
+state="${TMP}/state-quantile"
+cp "${state}/out.bin" "${TMP}/before.bin"
+for ckpt in "${state}"/*.ckpt; do
+    printf '\004' | dd of="${ckpt}" bs=1 seek=4 conv=notrunc status=none
+done
+"${BIN}/hotbits-extract" -v -m quantile -i "${state}" -d "${TMP}/data-quantile" \
+    -o "${state}/out.bin" 2> "${TMP}/stale.log"
+check "version 4 checkpoints are not used" grep -q "(0 reused, 3 processed)" "${TMP}/stale.log"
+same "version 4 checkpoints: same output" "${TMP}/before.bin" "${state}/out.bin"
+
+finish
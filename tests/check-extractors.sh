@@ -0,0 +1,48 @@
+#!/bin/bash
+# The ordinal, quantile and phase extractors on fixed-seed sources: output
+# rate in the expected range and the quick tests passed
+source "$(dirname "$0")/lib.sh"
+
+# bits_per_event NAME FILE EVENTS LO HI: FILE holds LO to HI bits per event
+bits_per_event() {
+    local bits=$(( $(wc -c < "$2") * 8 ))
+    if awk -v b="${bits}" -v n="$3" -v lo="$4" -v hi="$5" \
+        'BEGIN { exit !(b / n >= lo && b / n <= hi) }'; then
+        pass "$1 ($(awk -v b="${bits}" -v n="$3" 'BEGIN { printf "%.2f", b / n }') bits/event)"
+    else
+        fail "$1 (${bits} bits from $3 events, want ${4} to ${5} per event)"
+    fi
+}
+
+events "${TMP}/poisson.txt" 200000 3
+# Rate modulated at 50 Hz, like mains pickup, at the default 5.6 events/s:
+# a frame spans 97 minutes, a quarter of a million periods
+events "${TMP}/mains.txt" 200000 4 --modulate 0.6 --period 20000000
+
+"${BIN}/hotbits-extract" -m ordinal -k 8 -o "${TMP}/ordinal.bin" "${TMP}/poisson.txt"
+# log2(8!) / 8 is 1.91
+bits_per_event "ordinal: rate" "${TMP}/ordinal.bin" 200000 1.85 1.92
+quick_pass "ordinal: quick tests" "${TMP}/ordinal.bin"
+
+"${BIN}/hotbits-extract" -m ordinal -k 4 -o "${TMP}/ordinal4.bin" "${TMP}/poisson.txt"
+bits_per_event "ordinal -k 4: rate" "${TMP}/ordinal4.bin" 200000 1.1 1.15
+quick_pass "ordinal -k 4: quick tests" "${TMP}/ordinal4.bin"
+
+"${BIN}/hotbits-extract" -m quantile -o "${TMP}/quantile.bin" "${TMP}/poisson.txt"
+bits_per_event "quantile: rate" "${TMP}/quantile.bin" 200000 6 8
+quick_pass "quantile: quick tests" "${TMP}/quantile.bin"
+
+# The fitted rate follows a source whose rate drifts by half either way
+events "${TMP}/drift.txt" 200000 5 --drift 0.5
+"${BIN}/hotbits-extract" -m quantile -o "${TMP}/drift.bin" "${TMP}/drift.txt"
+quick_pass "quantile: drifting rate" "${TMP}/drift.bin"
+
+"${BIN}/hotbits-extract" -m phase -o "${TMP}/phase.bin" "${TMP}/mains.txt"
+# Up to 12 bits for each event after the first frame
+bits_per_event "phase: rate on a 50 Hz source" "${TMP}/phase.bin" 200000 8 10.1
+quick_pass "phase: quick tests on a 50 Hz source" "${TMP}/phase.bin"
+
+"${BIN}/hotbits-extract" -m phase -o "${TMP}/phase-none.bin" "${TMP}/poisson.txt"
+check "phase: nothing without a period" test ! -s "${TMP}/phase-none.bin"
+
+finish
@@ -0,0 +1,31 @@
+#!/bin/bash
+# hotbits-monitor's rolling windows report the same statistics as the
+# quick tests run over the bytes each window holds
+source "$(dirname "$0")/lib.sh"
+
+# 37500 whole words and 3 bytes the monitor has not consumed yet. The 1M
+# window starts at word 21875 and the 2M one at word 6250, so both block
+# parities are covered; the 4M window is still filling.
+python3 -c 'import random, sys; sys.stdout.buffer.write(random.Random(10).randbytes(300003))' \
+    > "${TMP}/random.bin"
+"${BIN}/hotbits-monitor" -w 1M,2M,4M -e 1G "${TMP}/random.bin" > "${TMP}/report.json"
+
+for window in 1M 2M 4M; do
+    check "monitor ${window} window matches quick_tests" \
+        env PYTHONPATH="${ROOT}/src/analysis" python3 -c '
+import json, sys
+import _hotbits
+
+report = json.loads(open(sys.argv[1]).read().splitlines()[-1])
+window = next(w for w in report["windows"] if w["window"] == sys.argv[3])
+data = open(sys.argv[2], "rb").read()
+data = data[:len(data) // 8 * 8][-window["bits"] // 8:]
+want = _hotbits.quick_tests(data)
+for name, got in window["tests"].items():
+    # The report prints six significant digits
+    for g, w in ((got["statistic"], want[name][0]), (got["p_value"], want[name][1])):
+        assert abs(g - w) <= 1e-5 * max(abs(w), 1e-3), (name, got, want[name])
+' "${TMP}/report.json" "${TMP}/random.bin" "${window}"
+done
+
+finish
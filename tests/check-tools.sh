@@ -0,0 +1,67 @@
+#!/bin/bash
+# Smoke runs of the remaining tools on small fixed inputs
+source "$(dirname "$0")/lib.sh"
+
+events "${TMP}/events.txt" 20000 8
+mkdir "${TMP}/data"
+split -l 8000 -a 1 --numeric-suffixes=1 --additional-suffix=.txt \
+    "${TMP}/events.txt" "${TMP}/data/events-"
+python3 -c 'import random, sys; sys.stdout.buffer.write(random.Random(9).randbytes(1 << 18))' \
+    > "${TMP}/bytes.bin"
+
+check "progressive: 2^18 bytes, nothing suspicious" \
+    "${BIN}/hotbits-progressive" -m 10 -x 18 "${TMP}/bytes.bin"
+"${BIN}/hotbits-progressive" -j -m 10 -x 18 "${TMP}/bytes.bin" > "${TMP}/progressive.json"
+check "progressive: one JSON line per length" test "$(wc -l < "${TMP}/progressive.json")" -eq 9
+head -c 65536 /dev/zero > "${TMP}/zeros.bin"
+"${BIN}/hotbits-progressive" "${TMP}/zeros.bin" > /dev/null 2>&1
+check "progressive: zeros exit with status 2" test $? -eq 2
+
+"${BIN}/hotbits-sweep" -C '' -m interval,ordinal,quantile -k 4,8 --debias none -j 2 -n 0 \
+    -o "${TMP}/sweep.json" "${TMP}/events.txt" > "${TMP}/sweep.txt"
+check "sweep: ranks the grid" grep -q "ordinal order=8 debias=none" "${TMP}/sweep.txt"
+# interval once, ordinal at two orders, quantile at two rate windows
+check "sweep: JSON results" python3 -c '
+import json, sys
+cells = json.load(open(sys.argv[1]))["cells"]
+assert len(cells) == 5, len(cells)
+assert [c["rank"] for c in cells] == [1, 2, 3, 4, 5], cells
+' "${TMP}/sweep.json"
+for run in first second; do
+    "${BIN}/hotbits-sweep" -C "${TMP}/sweep.tsv" -m interval,ordinal,quantile -k 4,8 --debias none \
+        "${TMP}/events.txt" > "${TMP}/sweep-${run}.log"
+done
+check "sweep: a second run takes every cell from the cache" \
+    grep -q "(5 cached)" "${TMP}/sweep-second.log"
+
+"${BIN}/hotbits-eval" -d "${TMP}/data" -o "${TMP}/eval" -t quick --run-id check \
+    > "${TMP}/eval.log" 2>&1
+same "eval: random.bin is the default extraction" "${TMP}/eval/check/random.bin" \
+    <(cd "${ROOT}/src/analysis" && python3 extract.py < "${TMP}/events.txt")
+check "eval: results.json" python3 -c 'import json, sys; json.load(open(sys.argv[1]))' \
+    "${TMP}/eval/check/results.json"
+
+check "bench: one tiny size" "${BIN}/hotbits-bench" -k extract.interval,pipeline.adaptive \
+    -n 1e3 -N 1e3 -t 0.01 -i synthetic -o "${TMP}/bench.json"
+
+# serve hands out the file's bytes in order; loadgen completes every request
+port=$((20000 + $$ % 20000))
+"${BIN}/hotbits-serve" -p "${port}" -P 65536 -r 0 "${TMP}/bytes.bin" 2> "${TMP}/serve.log" &
+server=$!
+for _ in $(seq 50); do
+    curl -sf "http://127.0.0.1:${port}/stats" > /dev/null && break
+    sleep 0.1
+done
+same "serve: first bytes of the file" <(head -c 64 "${TMP}/bytes.bin") \
+    <(curl -sf "http://127.0.0.1:${port}/random?bytes=64")
+"${BIN}/hotbits-loadgen" -p "${port}" -n 500 -c 4 -D 4 -j > "${TMP}/loadgen.json"
+check "loadgen: 500 responses, all 200" python3 -c '
+import json, sys
+r = json.load(open(sys.argv[1]))
+assert r["responses"] == 500 and r["status"]["200"] == 500 and r["errors"] == 0, r
+' "${TMP}/loadgen.json"
+kill "${server}"
+wait "${server}" 2> /dev/null
+
+
+finish
@@ -0,0 +1,26 @@
+#!/bin/bash
+# Runs every tests/check-*.sh (or those named on the command line) and
+# exits non-zero if any of them failed. `make check` builds the native
+# tools first.
+
+cd "$(dirname "$0")/.." || exit 1
+
+scripts=("$@")
+if [ ${#scripts[@]} -eq 0 ]; then
+    scripts=(tests/check-*.sh)
+fi
+
+failed=()
+for script in "${scripts[@]}"; do
+    echo "${script}"
+    if ! bash "${script}"; then
+        failed+=("${script}")
+    fi
+done
+
+echo
+if [ ${#failed[@]} -gt 0 ]; then
+    echo "Failed: ${failed[*]}"
+    exit 1
+fi
+echo "All ${#scripts[@]} check scripts passed"
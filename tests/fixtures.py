@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+"""Fixed-seed event fixtures for `make check`.
+
+Writes COUNT trng-style event deltas in nanoseconds, one per line, from a
+Poisson source with the given seed. random.Random's exponential variates
+are stable across Python versions, so a seed names the same file
+everywhere.
+
+    fixtures.py COUNT SEED [--rate HZ] [--dead-time NS] [--drift DEPTH]
+                           [--modulate DEPTH --period NS]
+"""
+
+import argparse
+import math
+import random
+import sys
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("count", type=int)
+    parser.add_argument("seed", type=int)
+    parser.add_argument("--rate", type=float, default=5.6, help="mean events per second")
+    parser.add_argument("--dead-time", type=int, default=0, help="minimum delta in ns")
+    parser.add_argument("--drift", type=float, default=0.0,
+                        help="rate drift depth, one sine cycle over the file")
+    parser.add_argument("--modulate", type=float, default=0.0,
+                        help="rate modulation depth, 0 to 1 (thinned Poisson)")
+    parser.add_argument("--period", type=float, default=20e6, help="modulation period in ns")
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    t = 0.0
+    last = 0
+    out = []
+    while len(out) < args.count:
+        drift = 1 + args.drift * math.sin(2 * math.pi * len(out) / args.count)
+        peak = args.rate * drift * (1 + args.modulate) / 1e9
+        t += args.dead_time + rng.expovariate(peak)
+        if args.modulate:
+            keep = (1 + args.modulate * math.cos(2 * math.pi * t / args.period)) / (1 + args.modulate)
+            if rng.random() >= keep:
+                continue
+        now = int(t)
+        out.append(now - last)
+        last = now
+    sys.stdout.write("\n".join(map(str, out)) + "\n")
+
+
+if __name__ == "__main__":
+    main()
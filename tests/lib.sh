@@ -0,0 +1,79 @@
+#!/bin/bash
+# Shared helpers for the tests/check-*.sh scripts run by `make check`.
+# Each script runs in its own scratch directory ($TMP) with the repository
+# root in $ROOT; failures are counted and reported, and the script's exit
+# status says whether any check failed.
+
+ROOT="${ROOT:-$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)}"
+BIN="${ROOT}/bin"
+TMP="$(mktemp -d "${TMPDIR:-/tmp}/hotbits-check.XXXXXX")"
+trap 'rm -rf "${TMP}"' EXIT
+FAILED=0
+
+pass() {
+    echo "  ok    $1"
+}
+
+fail() {
+    echo "  FAIL  $1"
+    FAILED=$((FAILED + 1))
+}
+
+skip() {
+    echo "  skip  $1"
+}
+
+# check NAME COMMAND...: passes when COMMAND succeeds
+check() {
+    local name="$1"
+    shift
+    if "$@" >"${TMP}/last.log" 2>&1; then
+        pass "${name}"
+    else
+        fail "${name}"
+        sed 's/^/        /' "${TMP}/last.log" | tail -20
+    fi
+}
+
+# same NAME A B: files A and B are byte-identical
+same() {
+    check "$1" cmp "$2" "$3"
+}
+
+# prefix NAME SHORT LONG [MISSING]: SHORT is LONG with at most its last
+# MISSING bytes (default 16: lookahead and the partial byte) cut off
+prefix() {
+    local short=$(wc -c < "$2") long=$(wc -c < "$3")
+    if [ "${short}" -le "${long}" ] && [ $((long - short)) -le "${4:-16}" ] &&
+        cmp -s "$2" <(head -c "${short}" "$3"); then
+        pass "$1"
+    else
+        fail "$1 (${short} vs ${long} bytes)"
+    fi
+}
+
+# events FILE COUNT SEED [ARGS]: fixed-seed event deltas (tests/fixtures.py)
+events() {
+    python3 "${ROOT}/tests/fixtures.py" "$2" "$3" "${@:4}" > "$1"
+}
+
+# quick_pass NAME FILE [MIN_PASSED]: FILE passes at least MIN_PASSED (default
+# all five) of the quick tests at the 0.01 level
+quick_pass() {
+    local want="${3:-5}"
+    local passed
+    passed=$(PYTHONPATH="${ROOT}/src/analysis" python3 -c '
+import sys, _hotbits
+data = open(sys.argv[1], "rb").read()
+print(sum(p >= 0.01 for _, p in _hotbits.quick_tests(data).values()) if data else 0)
+' "$2")
+    if [ "${passed}" -ge "${want}" ]; then
+        pass "$1 (${passed}/5)"
+    else
+        fail "$1 (${passed}/5, want ${want})"
+    fi
+}
+
+finish() {
+    exit $((FAILED > 0))
+}